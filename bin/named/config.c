@@ -96,6 +96,7 @@ options {\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
 	resolver-query-timeout 10;\n\
+	reuseport no;\n\
 	secroots-file \"named.secroots\";\n\
 	send-cookie true;\n\
 #	serial-queries <obsolete>;\n\
@@ -191,6 +192,7 @@ options {\n\
 	require-server-cookie no;\n\
 	resolver-nonbackoff-tries 3;\n\
 	resolver-retry-interval 800; /* in milliseconds */\n\
+	response-cache-size 0;\n\
 #	rfc2308-type1 <obsolete>;\n\
 	servfail-ttl 1;\n\
 #	sortlist <none>\n\
@@ -223,6 +225,7 @@ options {\n\
 #	forwarders <none>\n\
 	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	journal-commit-delay 0;\n\
 #	maintain-ixfr-base <obsolete>;\n\
 #	max-ixfr-log-size <obsolete>\n\
 	max-journal-size default;\n\
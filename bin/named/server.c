@@ -83,6 +83,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
 #include <dns/secalg.h>
@@ -4270,12 +4271,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	}
 
 	if (resstats == NULL) {
-		CHECK(isc_stats_create(mctx, &resstats,
-				       dns_resstatscounter_max));
+		CHECK(isc_stats_createpercpu(mctx, &resstats,
+					     dns_resstatscounter_max));
 	}
 	dns_view_setresstats(view, resstats);
 	if (resquerystats == NULL)
-		CHECK(dns_rdatatypestats_create(mctx, &resquerystats));
+		CHECK(dns_rdatatypestats_createpercpu(mctx, &resquerystats));
 	dns_view_setresquerystats(view, resquerystats);
 
 	ndisp = 4 * ISC_MIN(named_g_udpdisp, MAX_UDP_DISPATCH);
@@ -5297,6 +5298,17 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		fail_ttl = 30;
 	dns_view_setfailttl(view, fail_ttl);
 
+	/*
+	 * Set up the rendered response cache.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "response-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint32(obj) != 0) {
+		CHECK(dns_respcache_create(mctx, cfg_obj_asuint32(obj),
+					   &view->respcache));
+	}
+
 	/*
 	 * Name space to look up redirect information in.
 	 */
@@ -8190,6 +8202,15 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	ns_interfacemgr_setbacklog(server->interfacemgr, backlog);
 
+	/*
+	 * Should each UDP listener get its own SO_REUSEPORT socket?
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setreuseport(server->interfacemgr,
+				     cfg_obj_asboolean(obj));
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -9522,8 +9543,8 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 	server->zonestats = NULL;
 	server->resolverstats = NULL;
 	server->sockstats = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_createpercpu(server->mctx, &server->sockstats,
+					  isc_sockstatscounter_max),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(named_g_socketmgr, server->sockstats);
 
@@ -9531,8 +9552,8 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 				    dns_zonestatscounter_max),
 		   "dns_stats_create (zone)");
 
-	CHECKFATAL(isc_stats_create(named_g_mctx, &server->resolverstats,
-				    dns_resstatscounter_max),
+	CHECKFATAL(isc_stats_createpercpu(named_g_mctx, &server->resolverstats,
+					  dns_resstatscounter_max),
 		   "dns_stats_create (resolver)");
 
 	server->flushonshutdown = ISC_FALSE;
@@ -11140,7 +11161,7 @@ isc_result_t
 named_server_status(named_server_t *server, isc_buffer_t **text) {
 	isc_result_t result;
 	unsigned int zonecount, xferrunning, xferdeferred, soaqueries;
-	unsigned int automatic;
+	unsigned int automatic, loading;
 	const char *ob = "", *cb = "", *alt = "";
 	char boottime[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char configtime[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -11163,6 +11184,8 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 					  DNS_ZONESTATE_SOAQUERY);
 	automatic = dns_zonemgr_getcount(server->zonemgr,
 					 DNS_ZONESTATE_AUTOMATIC);
+	loading = dns_zonemgr_getcount(server->zonemgr,
+				       DNS_ZONESTATE_LOADING);
 
 	isc_time_formathttptimestamp(&named_g_boottime, boottime,
 				     sizeof(boottime));
@@ -11216,6 +11239,9 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 		     zonecount, automatic);
 	CHECK(putstr(text, line));
 
+	snprintf(line, sizeof(line), "zones loading: %u\n", loading);
+	CHECK(putstr(text, line));
+
 	snprintf(line, sizeof(line), "debug level: %d\n", named_g_debuglevel);
 	CHECK(putstr(text, line));
 
@@ -13866,13 +13892,14 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	char zonename[DNS_NAME_FORMATSIZE];
 	isc_uint32_t serial, signed_serial, nodes;
 	char serbuf[16], sserbuf[16], nodebuf[16], resignbuf[512];
-	char lbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
+	char lbuf[ISC_FORMATHTTPTIMESTAMP_SIZE], dbuf[64];
 	char xbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char rbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char kbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char rtbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	isc_time_t loadtime, expiretime, refreshtime;
 	isc_time_t refreshkeytime, resigntime;
+	isc_uint64_t loadduration;
 	dns_zonetype_t zonetype;
 	isc_boolean_t dynamic = ISC_FALSE, frozen = ISC_FALSE;
 	isc_boolean_t hasraw = ISC_FALSE;
@@ -13958,6 +13985,10 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	/* Load time */
 	dns_zone_getloadtime(zone, &loadtime);
 	isc_time_formathttptimestamp(&loadtime, lbuf, sizeof(lbuf));
+	loadduration = dns_zone_getloadduration(mayberaw);
+	snprintf(dbuf, sizeof(dbuf), "%" ISC_PRINT_QUADFORMAT "u.%03u seconds",
+		 loadduration / 1000000,
+		 (unsigned int)((loadduration % 1000000) / 1000));
 
 	/* Refresh/expire times */
 	if (zonetype == dns_zone_slave ||
@@ -14052,6 +14083,11 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 		CHECK(putstr(text, lbuf));
 	}
 
+	if (loadduration != 0) {
+		CHECK(putstr(text, "\nload duration: "));
+		CHECK(putstr(text, dbuf));
+	}
+
 	if (! isc_time_isepoch(&refreshtime)) {
 		CHECK(putstr(text, "\nnext refresh: "));
 		CHECK(putstr(text, rbuf));
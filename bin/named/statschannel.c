@@ -1458,6 +1458,7 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	char buf[1024 + 32];	/* sufficiently large for zone name and class */
 	dns_rdataclass_t rdclass;
 	isc_uint32_t serial;
+	isc_uint64_t loadduration;
 	xmlTextWriterPtr writer = arg;
 	dns_zonestat_level_t statlevel;
 	int xmlrc;
@@ -1497,6 +1498,14 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR "-"));
 	TRY0(xmlTextWriterEndElement(writer)); /* serial */
 
+	/* Time taken by the last load, in milliseconds */
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loadduration"));
+	loadduration = dns_zone_getloadduration(zone) / 1000;
+	TRY0(xmlTextWriterWriteFormatString(writer,
+					    "%" ISC_PRINT_QUADFORMAT "u",
+					    loadduration));
+	TRY0(xmlTextWriterEndElement(writer)); /* loadduration */
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -2253,6 +2262,7 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 	char *class_only = NULL;
 	dns_rdataclass_t rdclass;
 	isc_uint32_t serial;
+	isc_uint64_t loadduration;
 	json_object *zonearray = (json_object *) arg;
 	json_object *zoneobj = NULL;
 	dns_zonestat_level_t statlevel;
@@ -2278,6 +2288,10 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 	if (zoneobj == NULL)
 		return (ISC_R_NOMEMORY);
 
+	loadduration = dns_zone_getloadduration(zone) / 1000;
+	json_object_object_add(zoneobj, "loadduration",
+			       json_object_new_int64(loadduration));
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -1433,6 +1433,17 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 				      zname);
 
 		RETERR(configure_zone_ssutable(zoptions, mayberaw, zname));
+
+		obj = NULL;
+		result = named_config_get(maps, "journal-commit-delay", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		if (cfg_obj_asuint32(obj) > 1000) {
+			cfg_obj_log(obj, named_g_lctx, ISC_LOG_ERROR,
+				    "'journal-commit-delay %u' is too large",
+				    cfg_obj_asuint32(obj));
+			RETERR(ISC_R_RANGE);
+		}
+		dns_zone_setcommitdelay(mayberaw, cfg_obj_asuint32(obj));
 	}
 
 	if (ztype == dns_zone_master || raw != NULL) {
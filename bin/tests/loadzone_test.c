@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Time loading a text zone file into an rbt database sequentially and
+ * with dns_master_loadfileparallel().
+ *
+ * Usage: loadzone_test [-g names] [-n workers] origin file
+ *
+ * With -g, 'file' is first overwritten with a generated zone holding
+ * the given number of names.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/name.h>
+#include <dns/result.h>
+
+static isc_mem_t *mctx = NULL;
+
+static inline void
+check_result(isc_result_t result, const char *message) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", message,
+			isc_result_totext(result));
+		exit(1);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: loadzone_test [-g names] [-n workers] origin file\n");
+	exit(1);
+}
+
+static void
+generate(const char *filename, unsigned long count) {
+	FILE *fp;
+	unsigned long i;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot create %s\n", filename);
+		exit(1);
+	}
+
+	fprintf(fp, "$TTL 3600\n"
+		"@\tSOA\tns hostmaster (\n"
+		"\t\t1 ; serial\n"
+		"\t\t3600 1800 604800 300 )\n"
+		"\tNS\tns\n"
+		"ns\tA\t10.53.0.1\n");
+	for (i = 0; i < count; i++) {
+		fprintf(fp, "name%lu\tA\t10.%lu.%lu.%lu\n", i,
+			(i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+		fprintf(fp, "\tTXT\t\"record %lu\"\n", i);
+		if (i % 10 == 0)
+			fprintf(fp, "sub%lu\tNS\tns.sub%lu\n"
+				"ns.sub%lu\tA\t10.53.1.%lu\n",
+				i, i, i, i & 0xff);
+	}
+
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "cannot write %s\n", filename);
+		exit(1);
+	}
+}
+
+static double
+load(dns_name_t *origin, const char *filename, unsigned int nworkers) {
+	dns_db_t *db = NULL;
+	dns_rdatacallbacks_t callbacks;
+	isc_time_t start, finish;
+	isc_result_t result, tresult;
+
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	check_result(result, "dns_db_create()");
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	check_result(result, "dns_db_beginload()");
+
+	TIME_NOW(&start);
+	result = dns_master_loadfileparallel(filename, origin, origin,
+					     dns_rdataclass_in,
+					     DNS_MASTER_ZONE, 0, &callbacks,
+					     NULL, NULL, mctx, 0, nworkers);
+	tresult = dns_db_endload(db, &callbacks);
+	TIME_NOW(&finish);
+	if (result == ISC_R_SUCCESS)
+		result = tresult;
+	check_result(result, "dns_master_loadfileparallel()");
+
+	printf("%u worker%s: %u nodes in %.3f seconds\n", nworkers,
+	       nworkers == 1 ? "" : "s", dns_db_nodecount(db),
+	       isc_time_microdiff(&finish, &start) / 1000000.0);
+
+	dns_db_detach(&db);
+
+	return (isc_time_microdiff(&finish, &start) / 1000000.0);
+}
+
+int
+main(int argc, char *argv[]) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	unsigned int nworkers;
+	unsigned long count = 0;
+	double t1, tn;
+	isc_result_t result;
+	int ch;
+
+	nworkers = isc_os_ncpus();
+	while ((ch = isc_commandline_parse(argc, argv, "g:n:")) != -1) {
+		switch (ch) {
+		case 'g':
+			count = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		case 'n':
+			nworkers = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+	if (argc != 2 || nworkers < 1)
+		usage();
+
+	dns_result_register();
+
+	result = isc_mem_create(0, 0, &mctx);
+	check_result(result, "isc_mem_create()");
+
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(origin, argv[0], 0, NULL);
+	check_result(result, "dns_name_fromstring()");
+
+	if (count != 0)
+		generate(argv[1], count);
+
+	t1 = load(origin, argv[1], 1);
+	if (nworkers > 1) {
+		tn = load(origin, argv[1], nworkers);
+		if (tn > 0)
+			printf("speedup %.2fx\n", t1 / tn);
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
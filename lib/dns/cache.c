@@ -241,8 +241,8 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->serve_stale_ttl = 0;
 
 	cache->stats = NULL;
-	result = isc_stats_create(cmctx, &cache->stats,
-				  dns_cachestatscounter_max);
+	result = isc_stats_createpercpu(cmctx, &cache->stats,
+					dns_cachestatscounter_max);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_filelock;
 
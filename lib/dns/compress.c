@@ -63,79 +63,240 @@ static unsigned char maptolower[] = {
 };
 
 /*
- * The tableindex array below is of size 256, one entry for each
- * unsigned char value. The tableindex array elements are dependent on
- * DNS_COMPRESS_TABLESIZE. The table was created using the following
- * function.
- *
- * static void
- * gentable(unsigned char *table) {
- *         unsigned int i;
- *         const unsigned int left = DNS_COMPRESS_TABLESIZE - 38;
- *         long r;
- *
- *         for (i = 0; i < 26; i++) {
- *                 table['A' + i] = i;
- *                 table['a' + i] = i;
- *         }
- *
- *         for (i = 0; i <= 9; i++)
- *                 table['0' + i] = i + 26;
- *
- *         table['-'] = 36;
- *         table['_'] = 37;
- *
- *         for (i = 0; i < 256; i++) {
- *                 if ((i >= 'a' && i <= 'z') ||
- *                     (i >= 'A' && i <= 'Z') ||
- *                     (i >= '0' && i <= '9') ||
- *                     (i == '-') ||
- *                     (i == '_'))
- *                         continue;
- *                 r = random() % left;
- *                 table[i] = 38 + r;
- *         }
- * }
+ * Probing works on a group of DNS_COMPRESS_GROUPSIZE tags at a time,
+ * loaded as a single 64-bit word.  TAGS_MATCH() sets the high bit of
+ * every byte of 'w' that is equal to the corresponding byte of 'p',
+ * and TAGS_EMPTY() that of every byte that is zero; neither produces
+ * false positives.  TAGS_FIRST() returns the index of the first tag
+ * that is set in such a mask.
  */
-static unsigned char tableindex[256] = {
-	0x3e, 0x3e, 0x33, 0x2d, 0x30, 0x38, 0x31, 0x3c,
-	0x2b, 0x33, 0x30, 0x3f, 0x2d, 0x3c, 0x36, 0x3a,
-	0x28, 0x2c, 0x2a, 0x37, 0x3d, 0x34, 0x35, 0x2d,
-	0x39, 0x2b, 0x2f, 0x2c, 0x3b, 0x32, 0x2b, 0x39,
-	0x30, 0x38, 0x28, 0x3c, 0x32, 0x33, 0x39, 0x38,
-	0x27, 0x2b, 0x39, 0x30, 0x27, 0x24, 0x2f, 0x2b,
-	0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21,
-	0x22, 0x3a, 0x29, 0x36, 0x31, 0x3c, 0x35, 0x26,
-	0x31, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x3e, 0x3b, 0x39, 0x2f, 0x25,
-	0x27, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x36, 0x3b, 0x2f, 0x2f, 0x2e,
-	0x29, 0x33, 0x2a, 0x36, 0x28, 0x3f, 0x2e, 0x29,
-	0x2c, 0x29, 0x36, 0x2d, 0x32, 0x3d, 0x33, 0x2a,
-	0x2e, 0x2f, 0x3b, 0x30, 0x3d, 0x39, 0x2b, 0x36,
-	0x2a, 0x2f, 0x2c, 0x26, 0x3a, 0x37, 0x30, 0x3d,
-	0x2a, 0x36, 0x33, 0x2c, 0x38, 0x3d, 0x32, 0x3e,
-	0x26, 0x2a, 0x2c, 0x35, 0x27, 0x39, 0x3b, 0x31,
-	0x2a, 0x37, 0x3c, 0x27, 0x32, 0x29, 0x39, 0x37,
-	0x34, 0x3f, 0x39, 0x2e, 0x38, 0x2b, 0x2c, 0x3e,
-	0x3b, 0x3b, 0x2d, 0x33, 0x3b, 0x3b, 0x32, 0x3d,
-	0x3f, 0x3a, 0x34, 0x26, 0x35, 0x30, 0x31, 0x39,
-	0x27, 0x2f, 0x3d, 0x35, 0x35, 0x36, 0x2e, 0x29,
-	0x38, 0x27, 0x34, 0x32, 0x2c, 0x3c, 0x31, 0x28,
-	0x37, 0x38, 0x37, 0x34, 0x33, 0x29, 0x32, 0x34,
-	0x3f, 0x26, 0x34, 0x34, 0x32, 0x27, 0x30, 0x33,
-	0x33, 0x2d, 0x2b, 0x28, 0x3f, 0x33, 0x2b, 0x39,
-	0x37, 0x39, 0x2c, 0x3d, 0x35, 0x39, 0x27, 0x2f
+#define GROUPSIZE	DNS_COMPRESS_GROUPSIZE
+#define TAGS_LSB	0x0101010101010101ULL
+#define TAGS_LOW	0x7f7f7f7f7f7f7f7fULL
+#define TAGS_MSB	0x8080808080808080ULL
+
+#define TAGS_ZERO(x) \
+	(~((((x) & TAGS_LOW) + TAGS_LOW) | (x) | TAGS_LOW))
+#define TAGS_MATCH(w, p)	TAGS_ZERO((w) ^ (p))
+#define TAGS_EMPTY(w)		(~(w) & TAGS_MSB)
+
+#ifdef WORDS_BIGENDIAN
+#define TAGS_FIRST(m) \
+	(7 - (unsigned int)(((((m) & (0 - (m))) >> 7) * \
+			      0x0001020304050607ULL) >> 56))
+#else
+#define TAGS_FIRST(m) \
+	((unsigned int)(((((m) & (0 - (m))) >> 7) * \
+			 0x0001020304050607ULL) >> 56))
+#endif
+
+/*
+ * The tag of a node is the top seven bits of its hash with the high
+ * bit set; the group to start probing at is taken from the low bits.
+ */
+#define HASH_INIT	2166136261U
+#define HASH_TAG(h)	((isc_uint8_t)(0x80 | ((h) >> 25)))
+#define HASH_GROUP(h, size) \
+	(((h) ^ ((h) >> 16)) & ((size) - 1) & ~(GROUPSIZE - 1))
+
+/*
+ * The table is grown once it is three quarters full.  There can be
+ * at most 0x4000 distinct offsets, so it never needs to grow past
+ * MAXSIZE slots.
+ */
+#define MAXSIZE		0x8000
+#define NAMEBLOCKSIZE	2048
+
+struct dns_compressblock {
+	dns_compressblock_t	*next;
 };
 
 /***
  ***	Compression
  ***/
 
+static inline isc_uint32_t
+hash_suffix(isc_uint32_t h, const unsigned char *ndata, unsigned int length) {
+	/*
+	 * The bytes are hashed from the end of the name, so that the
+	 * hash of a name can be continued from the hash of its parent.
+	 */
+	while (length > 0) {
+		length--;
+		h = (h ^ maptolower[ndata[length]]) * 16777619U;
+	}
+	return (h);
+}
+
+static inline isc_uint64_t
+load_tags(const isc_uint8_t *tags) {
+	isc_uint64_t word;
+
+	memmove(&word, tags, sizeof(word));
+	return (word);
+}
+
+static inline isc_boolean_t
+node_equal(const dns_compressnode_t *node, const unsigned char *ndata,
+	   isc_boolean_t sensitive)
+{
+	const unsigned char *p1 = node->ndata, *p2 = ndata;
+	unsigned int length = node->length;
+
+	if (sensitive)
+		return (ISC_TF(memcmp(p1, p2, length) == 0));
+
+	/*
+	 * Label lengths are all below 0x40 and are not changed by
+	 * maptolower[], so the names can be compared byte by byte.
+	 */
+	while (ISC_LIKELY(length > 3)) {
+		if (maptolower[p1[0]] != maptolower[p2[0]] ||
+		    maptolower[p1[1]] != maptolower[p2[1]] ||
+		    maptolower[p1[2]] != maptolower[p2[2]] ||
+		    maptolower[p1[3]] != maptolower[p2[3]])
+			return (ISC_FALSE);
+		length -= 4;
+		p1 += 4;
+		p2 += 4;
+	}
+	while (length-- > 0) {
+		if (maptolower[*p1++] != maptolower[*p2++])
+			return (ISC_FALSE);
+	}
+	return (ISC_TRUE);
+}
+
+static dns_compressnode_t *
+find_node(dns_compress_t *cctx, const unsigned char *ndata,
+	  unsigned int length, unsigned int labels, isc_uint32_t hash)
+{
+	isc_boolean_t sensitive;
+	isc_uint64_t pattern, word, match;
+	dns_compressnode_t *node;
+	unsigned int group;
+
+	sensitive = ISC_TF((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+	pattern = TAGS_LSB * HASH_TAG(hash);
+	group = HASH_GROUP(hash, cctx->size);
+
+	for (;;) {
+		word = load_tags(&cctx->tags[group]);
+		match = TAGS_MATCH(word, pattern);
+		while (match != 0) {
+			node = &cctx->nodes[group + TAGS_FIRST(match)];
+			if (ISC_LIKELY(node->hash == hash &&
+				       node->length == length &&
+				       node->labels == labels) &&
+			    node_equal(node, ndata, sensitive))
+				return (node);
+			match &= match - 1;
+		}
+		/*
+		 * A node is always stored in the first group on its
+		 * probe sequence that had a free slot.
+		 */
+		if (ISC_LIKELY(TAGS_EMPTY(word) != 0))
+			return (NULL);
+		group = (group + GROUPSIZE) & (cctx->size - 1);
+	}
+}
+
+/*
+ * Return the first free slot on the probe sequence of 'hash'.
+ */
+static unsigned int
+free_slot(dns_compress_t *cctx, isc_uint32_t hash) {
+	isc_uint64_t empty;
+	unsigned int group;
+
+	group = HASH_GROUP(hash, cctx->size);
+	for (;;) {
+		empty = TAGS_EMPTY(load_tags(&cctx->tags[group]));
+		if (empty != 0)
+			return (group + TAGS_FIRST(empty));
+		group = (group + GROUPSIZE) & (cctx->size - 1);
+	}
+}
+
+static inline void
+insert_node(dns_compress_t *cctx, const dns_compressnode_t *node) {
+	unsigned int slot;
+
+	slot = free_slot(cctx, node->hash);
+	cctx->tags[slot] = HASH_TAG(node->hash);
+	cctx->nodes[slot] = *node;
+	cctx->count++;
+}
+
+static inline void
+free_table(dns_compress_t *cctx) {
+	if (cctx->nodes != cctx->initnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->size * (sizeof(dns_compressnode_t) + 1));
+}
+
+/*
+ * Move the nodes into a table twice the size.  If that cannot be
+ * allocated the table is left as it is.
+ */
+static isc_boolean_t
+grow_table(dns_compress_t *cctx) {
+	dns_compressnode_t *nodes, *oldnodes = cctx->nodes;
+	isc_uint8_t *oldtags = cctx->tags;
+	unsigned int i, size, oldsize = cctx->size;
+
+	if (oldsize >= MAXSIZE)
+		return (ISC_FALSE);
+
+	size = oldsize * 2;
+	nodes = isc_mem_get(cctx->mctx,
+			    size * (sizeof(dns_compressnode_t) + 1));
+	if (nodes == NULL)
+		return (ISC_FALSE);
+
+	cctx->nodes = nodes;
+	cctx->tags = (isc_uint8_t *)(nodes + size);
+	cctx->size = size;
+	cctx->count = 0;
+	memset(cctx->tags, 0, size);
+
+	for (i = 0; i < oldsize; i++) {
+		if (oldtags[i] != 0)
+			insert_node(cctx, &oldnodes[i]);
+	}
+
+	if (oldnodes != cctx->initnodes)
+		isc_mem_put(cctx->mctx, oldnodes,
+			    oldsize * (sizeof(dns_compressnode_t) + 1));
+	return (ISC_TRUE);
+}
+
+/*
+ * Return storage for a copy of a name of 'length' bytes.
+ */
+static unsigned char *
+name_storage(dns_compress_t *cctx, unsigned int length) {
+	dns_compressblock_t *block;
+	unsigned char *p;
+
+	if (cctx->namesleft < length) {
+		block = isc_mem_get(cctx->mctx,
+				    sizeof(*block) + NAMEBLOCKSIZE);
+		if (block == NULL)
+			return (NULL);
+		block->next = cctx->blocks;
+		cctx->blocks = block;
+		cctx->names = (unsigned char *)(block + 1);
+		cctx->namesleft = NAMEBLOCKSIZE;
+	}
+
+	p = cctx->names;
+	cctx->names += length;
+	cctx->namesleft -= length;
+	return (p);
+}
+
 isc_result_t
 dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	REQUIRE(cctx != NULL);
@@ -143,10 +304,18 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 	cctx->edns = edns;
 	cctx->mctx = mctx;
-	cctx->count = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
 
-	memset(&cctx->table[0], 0, sizeof(cctx->table));
+	cctx->size = DNS_COMPRESS_INITIALSIZE;
+	cctx->count = 0;
+	cctx->tags = cctx->inittags;
+	cctx->nodes = cctx->initnodes;
+	memset(cctx->inittags, 0, sizeof(cctx->inittags));
+	cctx->hashlength = 0;
+
+	cctx->names = cctx->initnames;
+	cctx->namesleft = sizeof(cctx->initnames);
+	cctx->blocks = NULL;
 
 	cctx->magic = CCTX_MAGIC;
 
@@ -155,23 +324,23 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
+	dns_compressblock_t *block;
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
+	free_table(cctx);
+	cctx->nodes = NULL;
+	cctx->tags = NULL;
+	cctx->count = 0;
+
+	while (cctx->blocks != NULL) {
+		block = cctx->blocks;
+		cctx->blocks = block->next;
+		isc_mem_put(cctx->mctx, block,
+			    sizeof(*block) + NAMEBLOCKSIZE);
 	}
+	cctx->names = NULL;
+	cctx->namesleft = 0;
 
 	cctx->magic = 0;
 	cctx->allowed = 0;
@@ -230,121 +399,60 @@ isc_boolean_t
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, isc_uint16_t *offset)
 {
-	dns_name_t tname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, i, n;
-	unsigned int numlabels;
-	unsigned char *p;
+	unsigned int labels, n, split;
+	isc_uint32_t hash, phash;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
 	REQUIRE(offset != NULL);
 
-	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
-		return (ISC_FALSE);
+	cctx->hashlength = 0;
 
-	if (cctx->count == 0)
+	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return (ISC_FALSE);
 
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
 
-	dns_name_init(&tname, NULL);
-
-	numlabels = labels > 3U ? 3U : labels;
-	p = name->ndata;
-
-	for (n = 0; n < numlabels - 1; n++) {
-		unsigned char ch, llen;
-		unsigned int firstoffset, length;
+	if (labels == 1)
+		return (ISC_FALSE);
 
-		firstoffset = (unsigned int)(p - name->ndata);
-		length = name->length - firstoffset;
+	/*
+	 * Look up the name itself and, if it has more than two labels,
+	 * the name without its first label.
+	 */
+	if (labels > 2) {
+		split = name->ndata[0] + 1;
+		phash = hash_suffix(HASH_INIT, name->ndata + split,
+				    name->length - split);
+		hash = hash_suffix(phash, name->ndata, split);
+	} else {
+		split = 0;
+		phash = 0;
+		hash = hash_suffix(HASH_INIT, name->ndata, name->length);
+	}
 
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of the suffix name.
-		 */
-		ch = p[1];
-		i = tableindex[ch];
-		if (ISC_LIKELY((cctx->allowed &
-				DNS_COMPRESS_CASESENSITIVE) != 0))
-		{
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				if (ISC_LIKELY(memcmp(node->name.ndata,
-						      p, length) == 0))
-					goto found;
-			}
-		} else {
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				unsigned int l, count;
-				unsigned char c;
-				unsigned char *label1, *label2;
-
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				l = labels - n;
-				if (ISC_UNLIKELY(node->name.labels != l))
-					continue;
-
-				label1 = node->name.ndata;
-				label2 = p;
-				while (ISC_LIKELY(l-- > 0)) {
-					count = *label1++;
-					if (count != *label2++)
-						goto cont1;
-
-					/* no bitstring support */
-					INSIST(count <= 63);
-
-					/* Loop unrolled for performance */
-					while (ISC_LIKELY(count > 3)) {
-						c = maptolower[label1[0]];
-						if (c != maptolower[label2[0]])
-							goto cont1;
-						c = maptolower[label1[1]];
-						if (c != maptolower[label2[1]])
-							goto cont1;
-						c = maptolower[label1[2]];
-						if (c != maptolower[label2[2]])
-							goto cont1;
-						c = maptolower[label1[3]];
-						if (c != maptolower[label2[3]])
-							goto cont1;
-						count -= 4;
-						label1 += 4;
-						label2 += 4;
-					}
-					while (ISC_LIKELY(count-- > 0)) {
-						c = maptolower[*label1++];
-						if (c != maptolower[*label2++])
-							goto cont1;
-					}
-				}
-				break;
- cont1:
-				continue;
-			}
-		}
+	/*
+	 * The name is usually added next if it is not found in full,
+	 * so keep the hashes for dns_compress_add().
+	 */
+	memmove(cctx->hashdata, name->ndata, name->length);
+	cctx->hashlength = name->length;
+	cctx->hash = hash;
+	cctx->phash = phash;
 
-		if (node != NULL)
-			break;
+	if (cctx->count == 0)
+		return (ISC_FALSE);
 
-		llen = *p;
-		p += llen + 1;
+	n = 0;
+	node = find_node(cctx, name->ndata, name->length, labels, hash);
+	if (node == NULL && split != 0) {
+		n = 1;
+		node = find_node(cctx, name->ndata + split,
+				 name->length - split, labels - 1, phash);
 	}
 
- found:
 	/*
 	 * If node == NULL, we found no match at all.
 	 */
@@ -356,143 +464,146 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	else
 		dns_name_getlabelsequence(name, 0, n, prefix);
 
-	*offset = (node->offset & 0x7fff);
+	*offset = node->offset;
 	return (ISC_TRUE);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, isc_uint16_t offset)
 {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int i;
-	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	isc_uint16_t toffset;
+	dns_compressnode_t node[2];
+	unsigned int labels, count, split, i;
 	unsigned char *tmp;
+	isc_boolean_t hashed;
 	isc_region_t r;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
 
+	/*
+	 * The hashes kept by dns_compress_findglobal() are used only if
+	 * this is the same name, which the caller need not guarantee.
+	 */
+	hashed = ISC_TF(cctx->hashlength == name->length &&
+			memcmp(cctx->hashdata, name->ndata,
+			       name->length) == 0);
+	cctx->hashlength = 0;
+
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
 	if (offset >= 0x4000)
 		return;
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
 
-	n = dns_name_countlabels(name);
+	labels = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
 	if (count == 0)
 		return;
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
-		return;
-	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
-	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
-
 	if (count > 2U)
 		count = 2U;
 
-	while (count > 0) {
-		unsigned char ch;
+	/*
+	 * The suffixes added are the name and, if two are to be added,
+	 * the name without its first label.
+	 */
+	dns_name_toregion(name, &r);
+	split = r.base[0] + 1;
+	if (count == 2 && offset + split >= 0x4000)
+		count = 1;
 
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of tname.
-		 */
-		ch = tname.ndata[1];
-		i = tableindex[ch];
-		tlength = name_length(&tname);
-		toffset = (isc_uint16_t)(offset + (length - tlength));
-		if (toffset >= 0x4000)
-			break;
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
-		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
-		 */
-		if (start == 0)
-			toffset |= 0x8000;
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		dns_name_init(&node->name, NULL);
-		node->name.length = node->r.length;
-		node->name.ndata = node->r.base;
-		node->name.labels = tname.labels;
-		node->name.attributes = DNS_NAMEATTR_ABSOLUTE;
-		node->next = cctx->table[i];
-		cctx->table[i] = node;
-		start++;
-		n--;
-		count--;
+	while (ISC_UNLIKELY((cctx->count + count) * 4 > cctx->size * 3)) {
+		if (!grow_table(cctx))
+			return;
 	}
 
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
+	/*
+	 * Copy name data to 'tmp' and make the nodes refer to it.
+	 */
+	tmp = name_storage(cctx, r.length);
+	if (tmp == NULL)
+		return;
+	memmove(tmp, r.base, r.length);
+
+	node[0].ndata = tmp;
+	node[0].length = r.length;
+	node[0].labels = labels;
+	node[0].offset = offset;
+	if (count == 2) {
+		node[1].ndata = tmp + split;
+		node[1].length = r.length - split;
+		node[1].labels = labels - 1;
+		node[1].offset = offset + split;
+	}
+	if (hashed) {
+		node[0].hash = cctx->hash;
+		node[1].hash = cctx->phash;
+	} else if (count == 2) {
+		node[1].hash = hash_suffix(HASH_INIT, node[1].ndata,
+					   node[1].length);
+		node[0].hash = hash_suffix(node[1].hash, tmp, split);
+	} else
+		node[0].hash = hash_suffix(HASH_INIT, tmp, r.length);
+
+	for (i = 0; i < count; i++)
+		insert_node(cctx, &node[i]);
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
-	unsigned int i;
-	dns_compressnode_t *node;
+	dns_compressnode_t tnode;
+	unsigned int i, slot, mask;
+	isc_boolean_t removed = ISC_FALSE;
 
 	REQUIRE(VALID_CCTX(cctx));
 
+	cctx->hashlength = 0;
+
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
+	/*
+	 * Mark the nodes being kept by a non-NULL 'ndata', and free
+	 * all of the slots.
+	 */
+	for (i = 0; i < cctx->size; i++) {
+		if (cctx->tags[i] == 0) {
+			cctx->nodes[i].ndata = NULL;
+			continue;
+		}
+		if (cctx->nodes[i].offset >= offset) {
+			cctx->nodes[i].ndata = NULL;
 			cctx->count--;
-			node = cctx->table[i];
+			removed = ISC_TRUE;
+		}
+	}
+
+	if (!removed)
+		return;
+
+	memset(cctx->tags, 0, cctx->size);
+
+	/*
+	 * Put the remaining nodes back on their probe sequences in
+	 * place.  A node whose first free slot holds another node that
+	 * has still to be placed swaps with it, and the displaced node
+	 * is then placed from the vacated slot.  Once a slot has been
+	 * given a tag it keeps it, so every node stays reachable.
+	 */
+	mask = ~(GROUPSIZE - 1);
+	for (i = 0; i < cctx->size; i++) {
+		while (cctx->nodes[i].ndata != NULL && cctx->tags[i] == 0) {
+			slot = free_slot(cctx, cctx->nodes[i].hash);
+			if ((slot & mask) == (i & mask)) {
+				cctx->tags[i] = HASH_TAG(cctx->nodes[i].hash);
+				break;
+			}
+			cctx->tags[slot] = HASH_TAG(cctx->nodes[i].hash);
+			tnode = cctx->nodes[slot];
+			cctx->nodes[slot] = cctx->nodes[i];
+			cctx->nodes[i] = tnode;
 		}
 	}
 }
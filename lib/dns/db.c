@@ -16,6 +16,7 @@
 
 #include <isc/buffer.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
@@ -59,12 +60,19 @@ static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
 
+/*
+ * Source of database generation numbers; see dns_db_generation().
+ */
+static isc_mutex_t genlock;
+static isc_uint32_t generation = 0;
+
 static dns_dbimplementation_t rbtimp;
 static dns_dbimplementation_t rbt64imp;
 
 static void
 initialize(void) {
 	RUNTIME_CHECK(isc_rwlock_init(&implock, 0, 0) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&genlock) == ISC_R_SUCCESS);
 
 	rbtimp.name = "rbt";
 	rbtimp.create = dns_rbtdb_create;
@@ -95,6 +103,17 @@ impfind(const char *name) {
 	return (NULL);
 }
 
+/*
+ * Give 'db' a generation number that no database has used before.
+ */
+static void
+newgeneration(dns_db_t *db) {
+	RUNTIME_CHECK(isc_once_do(&once, initialize) == ISC_R_SUCCESS);
+
+	LOCK(&genlock);
+	db->generation = ++generation;
+	UNLOCK(&genlock);
+}
 
 /***
  *** Basic DB Methods
@@ -124,6 +143,8 @@ dns_db_create(isc_mem_t *mctx, const char *db_type, const dns_name_t *origin,
 					    rdclass, argc, argv,
 					    impinfo->driverarg, dbp));
 		RWUNLOCK(&implock, isc_rwlocktype_read);
+		if (result == ISC_R_SUCCESS)
+			newgeneration(*dbp);
 		return (result);
 	}
 
@@ -248,6 +269,14 @@ dns_db_issecure(dns_db_t *db) {
 	return ((db->methods->issecure)(db));
 }
 
+isc_uint32_t
+dns_db_generation(dns_db_t *db) {
+
+	REQUIRE(DNS_DB_VALID(db));
+
+	return (db->generation);
+}
+
 isc_boolean_t
 dns_db_ispersistent(dns_db_t *db) {
 
@@ -297,6 +326,7 @@ dns_db_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 isc_result_t
 dns_db_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	dns_dbonupdatelistener_t *listener;
+	isc_result_t result;
 
 	/*
 	 * Finish loading 'db'.
@@ -311,7 +341,10 @@ dns_db_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	     listener = ISC_LIST_NEXT(listener, link))
 		listener->onupdate(db, listener->onupdate_arg);
 
-	return ((db->methods->endload)(db, callbacks));
+	result = (db->methods->endload)(db, callbacks);
+	newgeneration(db);
+
+	return (result);
 }
 
 isc_result_t
@@ -455,6 +488,7 @@ dns_db_closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	(db->methods->closeversion)(db, versionp, commit);
 
 	if (commit == ISC_TRUE) {
+		newgeneration(db);
 		for (listener = ISC_LIST_HEAD(db->update_listeners);
 		     listener != NULL;
 		     listener = ISC_LIST_NEXT(listener, link))
@@ -301,6 +301,7 @@ static isc_result_t get_udpsocket(dns_dispatchmgr_t *mgr,
 				  dns_dispatch_t *disp,
 				  isc_socketmgr_t *sockmgr,
 				  const isc_sockaddr_t *localaddr,
+				  unsigned int attributes,
 				  isc_socket_t **sockp,
 				  isc_socket_t *dup_socket);
 static isc_result_t dispatch_createudp(dns_dispatchmgr_t *mgr,
@@ -2248,10 +2249,13 @@ dispatch_find(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *local,
 	isc_result_t result;
 
 	/*
-	 * Make certain that we will not match a private or exclusive dispatch.
+	 * Make certain that we will not match a private, exclusive or
+	 * SO_REUSEPORT dispatch.
 	 */
-	attributes &= ~(DNS_DISPATCHATTR_PRIVATE|DNS_DISPATCHATTR_EXCLUSIVE);
-	mask |= (DNS_DISPATCHATTR_PRIVATE|DNS_DISPATCHATTR_EXCLUSIVE);
+	attributes &= ~(DNS_DISPATCHATTR_PRIVATE|DNS_DISPATCHATTR_EXCLUSIVE|
+			DNS_DISPATCHATTR_REUSEPORT);
+	mask |= (DNS_DISPATCHATTR_PRIVATE|DNS_DISPATCHATTR_EXCLUSIVE|
+		 DNS_DISPATCHATTR_REUSEPORT);
 
 	disp = ISC_LIST_HEAD(mgr->list);
 	while (disp != NULL) {
@@ -2765,6 +2769,9 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	REQUIRE(increment > buckets);
 	REQUIRE(dispp != NULL && *dispp == NULL);
 	REQUIRE((attributes & DNS_DISPATCHATTR_TCP) == 0);
+	REQUIRE((attributes & DNS_DISPATCHATTR_REUSEPORT) == 0 ||
+		(dup_dispatch == NULL &&
+		 isc_sockaddr_getport(localaddr) != 0));
 
 	result = dns_dispatchmgr_setudp(mgr, buffersize, maxbuffers,
 					maxrequests, buckets, increment);
@@ -2779,9 +2786,12 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	}
 
 	/*
-	 * See if we have a dispatcher that matches.
+	 * See if we have a dispatcher that matches.  Dispatches with
+	 * their own SO_REUSEPORT socket are never shared.
 	 */
-	if (dup_dispatch == NULL) {
+	if (dup_dispatch == NULL &&
+	    (attributes & DNS_DISPATCHATTR_REUSEPORT) == 0)
+	{
 		result = dispatch_find(mgr, localaddr, attributes, mask, &disp);
 		if (result == ISC_R_SUCCESS) {
 			disp->refcount++;
@@ -2855,7 +2865,8 @@ dns_dispatch_getudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 static isc_result_t
 get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 	      isc_socketmgr_t *sockmgr, const isc_sockaddr_t *localaddr,
-	      isc_socket_t **sockp, isc_socket_t *dup_socket)
+	      unsigned int attributes, isc_socket_t **sockp,
+	      isc_socket_t *dup_socket)
 {
 	unsigned int i, j;
 	isc_socket_t *held[DNS_DISPATCH_HELD];
@@ -2912,9 +2923,12 @@ get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 		 * choosing one.
 		 */
 	} else {
+		unsigned int options = ISC_SOCKET_REUSEADDRESS;
+
 		/* Allow to reuse address for non-random ports. */
-		result = open_socket(sockmgr, localaddr,
-				     ISC_SOCKET_REUSEADDRESS, &sock,
+		if ((attributes & DNS_DISPATCHATTR_REUSEPORT) != 0)
+			options |= ISC_SOCKET_REUSEPORT;
+		result = open_socket(sockmgr, localaddr, options, &sock,
 				     dup_socket);
 
 		if (result == ISC_R_SUCCESS)
@@ -2983,8 +2997,8 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	disp->socktype = isc_sockettype_udp;
 
 	if ((attributes & DNS_DISPATCHATTR_EXCLUSIVE) == 0) {
-		result = get_udpsocket(mgr, disp, sockmgr, localaddr, &sock,
-				       dup_socket);
+		result = get_udpsocket(mgr, disp, sockmgr, localaddr,
+				       attributes, &sock, dup_socket);
 		if (result != ISC_R_SUCCESS)
 			goto deallocate_dispatch;
 
@@ -39,22 +39,30 @@ ISC_LANG_BEGINDECLS
 #define DNS_COMPRESS_ENABLED		0x04
 
 /*
- * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
- * utilizes this assumption.
+ * The global compression table is a flat open-addressing hash table
+ * keyed on the hash of each name suffix.  Every slot has a one-byte
+ * tag holding seven bits of the hash with the high bit set (zero marks
+ * an unused slot), and the tags are probed DNS_COMPRESS_GROUPSIZE at
+ * a time so that most non-matching slots are rejected without looking
+ * at the node.  The first DNS_COMPRESS_INITIALSIZE slots are part of
+ * the context; larger tables are allocated from 'mctx' as it fills.
+ *
+ * DNS_COMPRESS_INITIALSIZE must be a power of 2 and a multiple of
+ * DNS_COMPRESS_GROUPSIZE. The compress code utilizes this assumption.
  */
-#define DNS_COMPRESS_TABLEBITS 6
-#define DNS_COMPRESS_TABLESIZE (1U << DNS_COMPRESS_TABLEBITS)
-#define DNS_COMPRESS_TABLEMASK (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 16
+#define DNS_COMPRESS_GROUPSIZE		8
+#define DNS_COMPRESS_INITIALSIZE	128
+#define DNS_COMPRESS_INITIALNAMES	512
 
 typedef struct dns_compressnode dns_compressnode_t;
+typedef struct dns_compressblock dns_compressblock_t;
 
 struct dns_compressnode {
-	dns_compressnode_t	*next;
-	isc_uint16_t		offset;
-	isc_uint16_t		count;
-	isc_region_t            r;
-	dns_name_t              name;
+	unsigned char		*ndata;		/*%< Suffix in wire format. */
+	isc_uint32_t		hash;		/*%< Case-insensitive hash. */
+	isc_uint16_t		offset;		/*%< Offset in the message. */
+	isc_uint8_t		length;		/*%< Length of 'ndata'. */
+	isc_uint8_t		labels;		/*%< Labels in 'ndata'. */
 };
 
 struct dns_compress {
@@ -62,10 +70,23 @@ struct dns_compress {
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
 	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
-	isc_uint16_t		count;		/*%< Number of nodes. */
+	unsigned int		size;		/*%< Number of slots. */
+	unsigned int		count;		/*%< Number of nodes. */
+	isc_uint8_t		*tags;
+	dns_compressnode_t	*nodes;
+	/*% Hashes of the last name looked up, for dns_compress_add(). */
+	unsigned int		hashlength;	/*%< Zero if none. */
+	isc_uint32_t		hash;
+	isc_uint32_t		phash;
+	unsigned char		hashdata[DNS_NAME_MAXWIRE];
+	/*% Preallocated slots for the table. */
+	isc_uint8_t		inittags[DNS_COMPRESS_INITIALSIZE];
+	dns_compressnode_t	initnodes[DNS_COMPRESS_INITIALSIZE];
+	/*% Storage for the copies of the names in the table. */
+	unsigned char		*names;		/*%< Next free byte. */
+	unsigned int		namesleft;	/*%< Bytes left at 'names'. */
+	dns_compressblock_t	*blocks;	/*%< Allocated storage. */
+	unsigned char		initnames[DNS_COMPRESS_INITIALNAMES];
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
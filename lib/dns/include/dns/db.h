@@ -226,6 +226,7 @@ struct dns_db {
 	isc_ondestroy_t				ondest;
 	isc_mem_t *				mctx;
 	ISC_LIST(dns_dbonupdatelistener_t)	update_listeners;
+	isc_uint32_t				generation;
 };
 
 #define DNS_DBATTR_CACHE		0x01
@@ -1406,6 +1407,28 @@ dns_db_settask(dns_db_t *db, isc_task_t *task);
  * \li	'task' to be valid or NULL.
  */
 
+isc_uint32_t
+dns_db_generation(dns_db_t *db);
+/*%<
+ * Return the generation number of 'db'.  A database is given a new,
+ * never before used, generation number when it is created with
+ * dns_db_create(), when loading finishes (dns_db_endload()) and every
+ * time a version is committed (dns_db_closeversion() with 'commit'
+ * set), so two lookups made under the same generation number of the
+ * same database see the same data.
+ *
+ * Notes:
+ * \li	The generation number is read without locking.  A caller that
+ *	associates data with a generation must read the generation
+ *	before opening the version the data is read from, so that a
+ *	concurrent commit can only make the association older, never
+ *	newer, than the data.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ */
+
 isc_boolean_t
 dns_db_ispersistent(dns_db_t *db);
 /*%<
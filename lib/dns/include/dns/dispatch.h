@@ -123,6 +123,11 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The UDP socket is bound with SO_REUSEPORT, so that several
+ *	dispatches can each own a socket bound to the same address and
+ *	port.  Such a dispatch is never shared with other callers.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -134,6 +139,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
@@ -264,6 +270,10 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
  * Attach to existing dns_dispatch_t if one is found with dns_dispatchmgr_find,
  * otherwise create a new UDP dispatch.
  *
+ * If 'dup' is not NULL the new dispatch shares a dup()ed socket with it.
+ * If DNS_DISPATCHATTR_REUSEPORT is set in 'attributes' a new dispatch with
+ * its own SO_REUSEPORT socket is always created.
+ *
  * Requires:
  *\li	All pointer parameters be valid for their respective types.
  *
@@ -279,6 +289,9 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
  *
  *\li	(attributes & DNS_DISPATCHATTR_TCP) == 0
  *
+ *\li	If DNS_DISPATCHATTR_REUSEPORT is set, 'dup' is NULL and
+ *	'localaddr' has a non-zero port.
+ *
  * Returns:
  *\li	ISC_R_SUCCESS	-- success.
  *
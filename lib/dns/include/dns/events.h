@@ -77,6 +77,8 @@
 #define DNS_EVENT_CATZDELZONE			(ISC_EVENTCLASS_DNS + 56)
 #define DNS_EVENT_RPZUPDATED			(ISC_EVENTCLASS_DNS + 57)
 #define DNS_EVENT_STARTUPDATE			(ISC_EVENTCLASS_DNS + 58)
+#define DNS_EVENT_ZONECOMPACT			(ISC_EVENTCLASS_DNS + 59)
+#define DNS_EVENT_XFRINAPPLY			(ISC_EVENTCLASS_DNS + 60)
 
 #define DNS_EVENT_FIRSTEVENT			(ISC_EVENTCLASS_DNS + 0)
 #define DNS_EVENT_LASTEVENT			(ISC_EVENTCLASS_DNS + 65535)
@@ -167,6 +167,26 @@ dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
  *       in arbitrary order.
  */
 
+void
+dns_journal_defersync(dns_journal_t *j);
+/*%<
+ * Switch 'j' to group commit: from now on dns_journal_commit() writes
+ * the transaction but neither syncs it nor updates the journal header
+ * on disk, so other readers of the file do not see it yet.
+ * dns_journal_sync() makes all such transactions durable at once.
+ *
+ * Requires:
+ *\li	'j' is open for writing and has no transaction in progress.
+ */
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Write any transactions committed since dns_journal_defersync() to
+ * stable storage, followed by a journal header covering them.  A no-op
+ * if there are none.  dns_journal_destroy() calls this too.
+ */
+
 /**************************************************************************/
 /*
  * Reading transactions from journals.
@@ -284,6 +304,42 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
  * Attempt to compact the journal if it is greater that 'target_size'.
  * Changes from 'serial' onwards will be preserved.  If the journal
  * exists and is non-empty 'serial' must exist in the journal.
+ *
+ * This is dns_journal_compactprepare() followed by
+ * dns_journal_compactfinish().
+ */
+
+isc_result_t
+dns_journal_compactprepare(isc_mem_t *mctx, const char *filename,
+			   isc_uint32_t serial, isc_uint32_t target_size);
+/*%<
+ * Write a compacted copy of the journal 'filename' next to it, as
+ * dns_journal_compact() would, without replacing the journal.  The
+ * copy keeps changes from 'serial' onwards and gets an index large
+ * enough to hold every transaction in it.  A journal that is not
+ * larger than 'target_size' is still copied if its index is full.
+ *
+ * This does the bulk of the work of compaction and only reads the
+ * journal, so it may run while transactions are being added to it.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	the copy is ready for dns_journal_compactfinish()
+ *\li	DNS_R_UPTODATE	there is nothing to do
+ *\li	ISC_R_RANGE	'serial' is not in the journal
+ */
+
+isc_result_t
+dns_journal_compactfinish(isc_mem_t *mctx, const char *filename);
+/*%<
+ * Append any transactions added to the journal 'filename' since
+ * dns_journal_compactprepare() to the compacted copy and replace the
+ * journal with it.  The caller must prevent the journal from being
+ * written until this returns.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND	there is no copy, or it no longer matches the
+ *			journal and has been removed
  */
 
 isc_boolean_t
@@ -51,6 +51,12 @@
 #define DNS_MASTER_NOTTL	0x00008000	/*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL	0x00010000	/*%< Check max-zone-ttl */
 
+/*%
+ * Text files smaller than this are not worth loading in parallel
+ * with dns_master_loadfileparallel().
+ */
+#define DNS_MASTER_PARALLELMIN	(8 * 1024 * 1024)
+
 ISC_LANG_BEGINDECLS
 
 /*
@@ -164,6 +170,30 @@ dns_master_loadfile5(const char *master_file,
 		     dns_masterformat_t format,
 		     dns_ttl_t maxttl);
 
+isc_result_t
+dns_master_loadfileparallel(const char *master_file,
+			    dns_name_t *top,
+			    dns_name_t *origin,
+			    dns_rdataclass_t zclass,
+			    unsigned int options,
+			    isc_uint32_t resign,
+			    dns_rdatacallbacks_t *callbacks,
+			    dns_masterincludecb_t include_cb,
+			    void *include_arg, isc_mem_t *mctx,
+			    dns_ttl_t maxttl, unsigned int nworkers);
+/*%<
+ * Like dns_master_loadfile5() for a text format file, but the file is
+ * split at record boundaries and the pieces are parsed concurrently by
+ * up to 'nworkers' threads, including the calling one.  Calls to
+ * 'callbacks->add' are serialized but are not made in file order;
+ * 'callbacks->error' and 'callbacks->warn' may be called from any of
+ * the threads.
+ *
+ * Files which cannot be split safely (using $INCLUDE, $GENERATE or
+ * $DATE, or lacking a default TTL) are loaded sequentially, as they
+ * are when 'nworkers' is less than 2.
+ */
+
 isc_result_t
 dns_master_loadstream(FILE *stream,
 		      dns_name_t *top,
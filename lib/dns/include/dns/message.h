@@ -230,18 +230,19 @@ struct dns_message {
 	dns_compress_t		       *cctx;
 
 	isc_mem_t		       *mctx;
-	isc_mempool_t		       *namepool;
-	isc_mempool_t		       *rdspool;
 
 	isc_bufferlist_t		scratchpad;
 	isc_bufferlist_t		cleanup;
 
-	ISC_LIST(dns_msgblock_t)	rdatas;
-	ISC_LIST(dns_msgblock_t)	rdatalists;
-	ISC_LIST(dns_msgblock_t)	offsets;
+	ISC_LIST(dns_msgblock_t)	arena;
+	dns_msgblock_t		       *arenacur;
 
+	ISC_LIST(dns_name_t)		freename;
+	ISC_LIST(dns_rdataset_t)	freerdataset;
 	ISC_LIST(dns_rdata_t)		freerdata;
 	ISC_LIST(dns_rdatalist_t)	freerdatalist;
+	unsigned int			names;		/* in use */
+	unsigned int			rdatasets;	/* in use */
 
 	dns_rcode_t			tsigstatus;
 	dns_rcode_t			querytsigstatus;
@@ -579,6 +580,31 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, dns_section_t section,
+		      const isc_region_t *region, unsigned int count);
+/*%<
+ * Append 'count' records that are already in wire format, held in
+ * 'region', to the given section.  This lets the same records be sent
+ * in many messages while rendering them only once.
+ *
+ * The records are copied as they are: any compression pointers in them
+ * must be valid at the offset at which they land in this message, and
+ * their names are not made available for compressing later names.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section, and no later section has been
+ *	rendered yet.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOSPACE		-- the records do not fit in the buffer.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
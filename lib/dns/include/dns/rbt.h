@@ -106,13 +106,8 @@ struct dns_rbtnode {
 	unsigned int oldnamelen : 8;    /*%< range is 1..255 */
 	/*@}*/
 
-	/* flags needed for serialization to file*/
+	/* node lives in a map-format image rather than the heap */
 	unsigned int is_mmapped : 1;
-	unsigned int parent_is_relative : 1;
-	unsigned int left_is_relative : 1;
-	unsigned int right_is_relative : 1;
-	unsigned int down_is_relative : 1;
-	unsigned int data_is_relative : 1;
 
 	/* node needs to be cleaned from rpz */
 	unsigned int rpz : 1;
@@ -172,13 +167,27 @@ typedef isc_result_t (*dns_rbtfindcallback_t)(dns_rbtnode_t *node,
 					      dns_name_t *name,
 					      void *callback_arg);
 
+/*%
+ * Called to write out the data of a node at the current position of
+ * 'file'.  Pointers written must be those valid when the image is mapped
+ * at 'linkbase'; 'node' is the address the node will have there.
+ */
 typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file,
 					    unsigned char *data,
 					    void *arg,
+					    isc_uint64_t linkbase,
+					    isc_uint64_t node,
 					    isc_uint64_t *crc);
 
+/*%
+ * Called to check the data of a node read from an image of 'filesize'
+ * bytes mapped at 'base', rebasing any pointers written for 'linkbase'.
+ * It should not write to the image when 'base' equals 'linkbase' unless
+ * it has to, so that the pages can stay shared.
+ */
 typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode,
-					   void *base, size_t offset,
+					   void *base, size_t filesize,
+					   isc_uint64_t linkbase,
 					   void *arg, isc_uint64_t *crc);
 
 typedef void (*dns_rbtdeleter_t)(void *, void *);
@@ -729,10 +738,16 @@ dns_rbt_serialize_align(off_t target);
 isc_result_t
 dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 		       dns_rbtdatawriter_t datawriter,
-		       void *writer_arg, off_t *offset);
+		       void *writer_arg, isc_uint64_t linkbase,
+		       off_t *offset);
 /*%<
  * Write out the RBT structure and its data to a file.
  *
+ * The image is laid out to be used in place when the file is mapped at
+ * address 'linkbase'; mapped anywhere else its pointers are rebased
+ * when it is read in.  'linkbase' must be pointer aligned; zero means
+ * no particular address.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  Returns ISC_R_INVALIDFILE if not.
@@ -749,6 +764,9 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
  *
  * If 'originp' is not NULL, then it is pointed to the root node of the RBT.
  *
+ * If the image was mapped at the address it was serialized for, it is
+ * only read, not written.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  This condition is not checked in the code.
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * Defines dns_respcache_t, the rendered response cache.
+ *
+ * Notes:
+ *\li	A response cache holds complete responses in wire format,
+ *	keyed on the query name (compared case-sensitively, so that
+ *	the copy of the question in the response is exact), the query
+ *	type, a caller-defined 32-bit "variant" describing everything
+ *	else in the query that may change the response (header flags,
+ *	EDNS buffer size, ...) and the generation of the database the
+ *	response was built from (see dns_db_generation()).
+ *
+ *\li	The cache is a fixed size, direct-mapped table: an entry that
+ *	hashes to an occupied slot replaces the previous occupant.
+ *	Entries built from an older generation of a database are never
+ *	returned, and are replaced as newer responses are added.
+ *
+ * MP:
+ *\li	The cache is safe to use from multiple threads; the table is
+ *	protected by a set of striped locks.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/buffer.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int size,
+		     dns_respcache_t **rcp);
+/*%
+ * Create a response cache with room for 'size' responses and store it
+ * in '*rcp'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ * \li	rcp != NULL && *rcp == NULL
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp);
+/*%
+ * Flush and then free the response cache in '*rcp'.  '*rcp' is set to
+ * NULL on return.
+ *
+ * Requires:
+ * \li	'*rcp' to be a valid response cache.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_name_t *qname,
+		   dns_rdatatype_t qtype, isc_uint32_t variant,
+		   isc_uint32_t generation, isc_buffer_t *target);
+/*%
+ * Look for a response to 'qname'/'qtype' matching 'variant' and built
+ * from database generation 'generation', and if found copy it to the
+ * available region of 'target'.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ * \li	'qname' to be a valid absolute name.
+ * \li	'target' to be a valid buffer.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ * \li	#ISC_R_NOSPACE	a response was found but does not fit in 'target'.
+ */
+
+void
+dns_respcache_add(dns_respcache_t *rc, const dns_name_t *qname,
+		  dns_rdatatype_t qtype, isc_uint32_t variant,
+		  isc_uint32_t generation, const isc_region_t *response);
+/*%
+ * Store a copy of 'response' as the answer to 'qname'/'qtype' for
+ * 'variant' and 'generation', replacing whatever occupied its slot.
+ * Failure to allocate memory is not reported; the response is simply
+ * not cached.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ * \li	'qname' to be a valid absolute name.
+ * \li	'response' to be non NULL.
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *rc);
+/*%
+ * Remove all entries from the response cache.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
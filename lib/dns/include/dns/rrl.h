@@ -15,6 +15,7 @@
  */
 
 #include <isc/lang.h>
+#include <isc/mutex.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -184,6 +185,10 @@ struct dns_rrl_qname_buf {
 	dns_fixedname_t	    qname;
 };
 
+/*
+ * 'scaled' is set while holding the lock of whichever shard is in use.
+ * Other shards may briefly see the previous value.
+ */
 typedef struct dns_rrl_rate dns_rrl_rate_t;
 struct dns_rrl_rate {
 	int	    r;
@@ -191,11 +196,55 @@ struct dns_rrl_rate {
 	const char  *str;
 };
 
+/*
+ * One shard of the database of rate-limit entries.
+ * All of the entries for a client address block are in the same shard,
+ * so a response needs only that shard's lock.
+ */
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t	lock;
+
+	int		num_entries;
+
+	unsigned int	probes;
+	unsigned int	searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	/*
+	 * Entries are moved from old_hash to hash a few bins at a time,
+	 * starting with bin old_bin.
+	 */
+	dns_rrl_hash_t	*hash;
+	dns_rrl_hash_t	*old_hash;
+	int		old_bin;
+	unsigned int	hash_gen;
+
+	/*
+	 * The table is grown after the lock is released.
+	 */
+	isc_boolean_t	grow_entries;
+	isc_boolean_t	grow_hash;
+
+	unsigned int	ts_gen;
+# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
+	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+
+	isc_stdtime_t	log_stops_time;
+	dns_rrl_entry_t	*last_logged;
+	int		num_logged;
+};
+
 /*
  * Per-view query rate limit parameters and a pointer to database.
  */
 typedef struct dns_rrl dns_rrl_t;
 struct dns_rrl {
+	/*
+	 * Protects the qps estimate and the qname buffers.
+	 */
 	isc_mutex_t	lock;
 	isc_mem_t	*mctx;
 
@@ -213,34 +262,18 @@ struct dns_rrl {
 
 	dns_acl_t	*exempt;
 
-	int		num_entries;
-
 	int		qps_responses;
 	isc_stdtime_t	qps_time;
 	double		qps;
 
-	unsigned int	probes;
-	unsigned int	searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t	*hash;
-	dns_rrl_hash_t	*old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int	ts_gen;
-# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+	dns_rrl_shard_t	*shards;
+	unsigned int	nshards;
 
 	int		ipv4_prefixlen;
 	isc_uint32_t	ipv4_mask;
 	int		ipv6_prefixlen;
 	isc_uint32_t	ipv6_mask[4];
 
-	isc_stdtime_t	log_stops_time;
-	dns_rrl_entry_t	*last_logged;
-	int		num_logged;
 	int		num_qnames;
 	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
 # define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
@@ -535,10 +535,29 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+dns_rdatatypestats_createpercpu(isc_mem_t *mctx, dns_stats_t **statsp);
+/*%<
+ * Like dns_rdatatypestats_create(), but the counters are kept per CPU
+ * (see isc_stats_createpercpu()).  For server-wide statistics updated
+ * on every query.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 isc_result_t
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
  * Create a statistics counter structure per RRset.
+ * The counters are kept per CPU (see isc_stats_createpercpu()).
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -555,6 +574,7 @@ isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
  * Create a statistics counter structure per opcode.
+ * The counters are kept per CPU (see isc_stats_createpercpu()).
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -571,6 +591,7 @@ isc_result_t
 dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
  * Create a statistics counter structure per assigned rcode.
+ * The counters are kept per CPU (see isc_stats_createpercpu()).
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -121,6 +121,7 @@ typedef isc_uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef isc_uint8_t				dns_secalg_t;
 typedef isc_uint8_t				dns_secproto_t;
@@ -180,6 +180,7 @@ struct dns_view {
 	dns_dlzdblist_t 		dlz_unsearched;
 	isc_uint32_t			fail_ttl;
 	dns_badcache_t			*failcache;
+	dns_respcache_t			*respcache;
 
 	/*
 	 * Configurable data for server use only,
@@ -86,6 +86,24 @@ dns_xfrin_create3(dns_zone_t *zone, dns_rdatatype_t xfrtype,
  *	the zone has a database.
  */
 
+isc_result_t
+dns_xfrin_create4(dns_zone_t *zone, dns_rdatatype_t xfrtype,
+		  const isc_sockaddr_t *masteraddr,
+		  const isc_sockaddr_t *sourceaddr,
+		  isc_dscp_t dscp, dns_tsigkey_t *tsigkey, isc_mem_t *mctx,
+		  isc_timermgr_t *timermgr, isc_socketmgr_t *socketmgr,
+		  isc_task_t *task, isc_task_t *applytask,
+		  dns_xfrindone_t done, dns_xfrin_ctx_t **xfrp);
+/*%<
+ * As dns_xfrin_create3(), but if 'applytask' is not NULL the records
+ * of a full zone transfer are loaded into the new database in
+ * 'applytask' while further messages are being received and parsed
+ * in 'task'.  '*done' is still called in the context of 'task'.
+ *
+ * Requires:
+ *\li	'applytask' is NULL or a valid task other than 'task'.
+ */
+
 void
 dns_xfrin_shutdown(dns_xfrin_ctx_t *xfr);
 /*%<
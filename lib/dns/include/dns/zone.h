@@ -22,6 +22,7 @@
 #include <isc/rwlock.h>
 
 #include <dns/catz.h>
+#include <dns/diff.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdatastruct.h>
@@ -46,6 +47,14 @@ typedef enum {
 	dns_zonestat_full
 } dns_zonestat_level_t;
 
+/*%
+ * Called by dns_zone_afterjournalsync() once journal transactions
+ * written by dns_zone_writejournal() are on stable storage, or with
+ * the error that prevented it.
+ */
+typedef void
+(*dns_zone_journalsynced_t)(void *arg, isc_result_t result);
+
 #define DNS_ZONEOPT_SERVERS	  0x00000001U	/*%< perform server checks */
 #define DNS_ZONEOPT_PARENTS	  0x00000002U	/*%< perform parent checks */
 #define DNS_ZONEOPT_CHILDREN	  0x00000004U	/*%< perform child checks */
@@ -127,6 +136,7 @@ typedef enum {
 #define DNS_ZONESTATE_SOAQUERY		3
 #define DNS_ZONESTATE_ANY		4
 #define DNS_ZONESTATE_AUTOMATIC		5
+#define DNS_ZONESTATE_LOADING		6
 
 ISC_LANG_BEGINDECLS
 
@@ -1261,6 +1271,59 @@ dns_zone_getjournalsize(dns_zone_t *zone);
  *\li	'zone' to be a valid zone.
  */
 
+void
+dns_zone_setcommitdelay(dns_zone_t *zone, isc_uint32_t delay);
+/*%<
+ *	Set the longest time, in milliseconds, that transactions written
+ *	with dns_zone_writejournal() may wait to be synced to disk
+ *	together with later ones.  Zero syncs each transaction as it
+ *	is written.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
+isc_uint32_t
+dns_zone_getcommitdelay(dns_zone_t *zone);
+/*%<
+ *	Return the value set with dns_zone_setcommitdelay().
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff);
+/*%<
+ *	Append the transaction in 'diff' to the zone's journal.
+ *
+ *	If a commit delay is set and the zone is managed, the transaction
+ *	is written but not synced: it is synced along with any others
+ *	written within the delay, and until then the journal file still
+ *	reads as it did before.  Callers that must not report success
+ *	before the transaction is durable should wait for it with
+ *	dns_zone_afterjournalsync().
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'diff' to be a valid diff.
+ */
+
+void
+dns_zone_afterjournalsync(dns_zone_t *zone, dns_zone_journalsynced_t done,
+			  void *arg);
+/*%<
+ *	Arrange for 'done' to be called with 'arg' once every transaction
+ *	written so far with dns_zone_writejournal() has been synced.
+ *	'done' is called with the result of the sync, either before this
+ *	function returns or from the zone's task, and must not call back
+ *	into the zone's journal functions.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'done' to be non-NULL.
+ */
+
 isc_result_t
 dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
 		       dns_message_t *msg);
@@ -1796,7 +1859,9 @@ void
 dns_zonemgr_setiolimit(dns_zonemgr_t *zmgr, isc_uint32_t iolimit);
 /*%<
  *	Set the number of simultaneous file descriptors available for
- *	reading and writing masterfiles.
+ *	reading and writing masterfiles.  The default is two per CPU,
+ *	up to a compiled in maximum.  Queued loads are started largest
+ *	master file first.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager.
@@ -1871,6 +1936,8 @@ unsigned int
 dns_zonemgr_getcount(dns_zonemgr_t *zmgr, int state);
 /*%<
  *	Returns the number of zones in the specified state.
+ *	DNS_ZONESTATE_LOADING counts zones whose load has been
+ *	scheduled but has not yet completed.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager.
@@ -2392,6 +2459,13 @@ dns_zone_getloadtime(dns_zone_t *zone, isc_time_t *loadtime);
  * Return the time when the zone was last loaded.
  */
 
+isc_uint64_t
+dns_zone_getloadduration(dns_zone_t *zone);
+/*%
+ * Return how long the last load of the zone from its master file
+ * took, in microseconds, or 0 if it has not been loaded from a file.
+ */
+
 isc_result_t
 dns_zone_getrefreshtime(dns_zone_t *zone, isc_time_t *refreshtime);
 /*%
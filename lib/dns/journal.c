@@ -38,15 +38,19 @@
  *
  *   \li A fixed-size header of type journal_rawheader_t.
  *
- *   \li The index.  This is an unordered array of index entries
+ *   \li The index.  This is an array of index entries
  *     of type journal_rawpos_t giving the locations
- *     of some arbitrary subset of the journal's addressable
- *     transactions.  The index entries are used as hints to
- *     speed up the process of locating a transaction with a given
- *     serial number.  Unused index entries have an "offset"
- *     field of zero.  The size of the index can vary between
- *     journal files, but does not change during the lifetime
- *     of a file.  The size can be zero.
+ *     of a subset of the journal's addressable transactions.
+ *     The index entries are used as hints to speed up the process
+ *     of locating a transaction with a given serial number.
+ *     Unused index entries have an "offset" field of zero.
+ *     The entries are kept in order in memory, and every
+ *     transaction gets one until the index is full (see
+ *     index_add()), so a lookup is normally a binary search.
+ *     On disk the order is not significant.  The size of the
+ *     index can vary between journal files, but does not change
+ *     during the lifetime of a file; compaction picks a size
+ *     to fit the transactions that remain.  The size can be zero.
  *
  *   \li The journal data.  This  consists of one or more transactions.
  *     Each transaction begins with a transaction header of type
@@ -102,7 +106,18 @@ static isc_boolean_t bind8_compat = ISC_TRUE; /* XXX config */
 	} while (0)
 
 #define JOURNAL_SERIALSET	0x01U
+#define JOURNAL_SPARSE		0x02U
 
+/*%
+ * Bounds on the number of index entries in a journal file.  New
+ * journals start with JOURNAL_INDEX_MIN entries; compaction sizes
+ * the index of the rewritten file to twice the number of
+ * transactions it keeps.
+ */
+#define JOURNAL_INDEX_MIN	256
+#define JOURNAL_INDEX_MAX	65536
+
+static void index_sort(dns_journal_t *);
 static isc_result_t index_to_disk(dns_journal_t *);
 
 static inline isc_uint32_t
@@ -253,6 +268,7 @@ typedef struct {
 	isc_uint32_t	index_size;
 	isc_uint32_t	sourceserial;
 	isc_boolean_t	serialset;
+	isc_boolean_t	sparse;		/*%< index has dropped entries */
 } journal_header_t;
 
 /*%
@@ -285,7 +301,9 @@ typedef struct {
  */
 
 static journal_header_t
-initial_journal_header = { ";BIND LOG V9\n", { 0, 0 }, { 0, 0 }, 0, 0, 0 };
+initial_journal_header = {
+	";BIND LOG V9\n", { 0, 0 }, { 0, 0 }, 0, 0, 0, 0
+};
 
 #define JOURNAL_EMPTY(h) ((h)->begin.offset == (h)->end.offset)
 
@@ -307,6 +325,9 @@ struct dns_journal {
 	journal_header_t 	header;		/*%< In-core journal header */
 	unsigned char		*rawindex;	/*%< In-core buffer for journal index in on-disk format */
 	journal_pos_t		*index;		/*%< In-core journal index */
+	unsigned int		index_count;	/*%< Entries in use, in order */
+	unsigned int		index_dirtylo;	/*%< Index slots to rewrite */
+	unsigned int		index_dirtyhi;
 
 	/*% Current transaction state (when writing). */
 	struct {
@@ -314,6 +335,14 @@ struct dns_journal {
 		journal_pos_t	pos[2];		/*%< Begin/end position */
 	} x;
 
+	/*%
+	 * Group commit state.  When 'defer' is set, committed
+	 * transactions are only recorded in the in-core header and
+	 * index; 'unsynced' says the on-disk header lags behind.
+	 */
+	isc_boolean_t		defer;
+	isc_boolean_t		unsynced;
+
 	/*% Iteration state (when reading). */
 	struct {
 		/* These define the part of the journal we iterate over. */
@@ -357,6 +386,7 @@ journal_header_decode(journal_rawheader_t *raw, journal_header_t *cooked) {
 	cooked->index_size = decode_uint32(raw->h.index_size);
 	cooked->sourceserial = decode_uint32(raw->h.sourceserial);
 	cooked->serialset = ISC_TF(raw->h.flags & JOURNAL_SERIALSET);
+	cooked->sparse = ISC_TF(raw->h.flags & JOURNAL_SPARSE);
 }
 
 static void
@@ -372,6 +402,8 @@ journal_header_encode(journal_header_t *cooked, journal_rawheader_t *raw) {
 	encode_uint32(cooked->sourceserial, raw->h.sourceserial);
 	if (cooked->serialset)
 		flags |= JOURNAL_SERIALSET;
+	if (cooked->sparse)
+		flags |= JOURNAL_SPARSE;
 	raw->h.flags = flags;
 }
 
@@ -490,12 +522,13 @@ journal_read_rrhdr(dns_journal_t *j, journal_rrhdr_t *rrhdr) {
 }
 
 static isc_result_t
-journal_file_create(isc_mem_t *mctx, const char *filename) {
+journal_file_create(isc_mem_t *mctx, const char *filename,
+		    unsigned int index_size)
+{
 	FILE *fp = NULL;
 	isc_result_t result;
 	journal_header_t header;
 	journal_rawheader_t rawheader;
-	int index_size = 56; /* XXX configurable */
 	int size;
 	void *mem; /* Memory for temporary index image. */
 
@@ -570,6 +603,11 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t writable,
 	j->filename = isc_mem_strdup(mctx, filename);
 	j->index = NULL;
 	j->rawindex = NULL;
+	j->index_count = 0;
+	j->index_dirtylo = 0;
+	j->index_dirtyhi = 0;
+	j->defer = ISC_FALSE;
+	j->unsynced = ISC_FALSE;
 
 	if (j->filename == NULL)
 		FAIL(ISC_R_NOMEMORY);
@@ -581,7 +619,8 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t writable,
 			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_DEBUG(1),
 				      "journal file %s does not exist, "
 				      "creating it", j->filename);
-			CHECK(journal_file_create(mctx, filename));
+			CHECK(journal_file_create(mctx, filename,
+						 JOURNAL_INDEX_MIN));
 			/*
 			 * Retry.
 			 */
@@ -645,6 +684,7 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t writable,
 			p += 4;
 		}
 		INSIST(p == j->rawindex + rawbytes);
+		index_sort(j);
 	}
 	j->offset = -1; /* Invalid, must seek explicitly. */
 
@@ -835,6 +875,73 @@ journal_next(dns_journal_t *j, journal_pos_t *pos) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Note that index slots 'lo' up to 'hi' need to be written out
+ * by the next index_to_disk().
+ */
+static inline void
+index_dirty(dns_journal_t *j, unsigned int lo, unsigned int hi) {
+	if (j->index_dirtylo == j->index_dirtyhi) {
+		j->index_dirtylo = lo;
+		j->index_dirtyhi = hi;
+		return;
+	}
+	if (lo < j->index_dirtylo)
+		j->index_dirtylo = lo;
+	if (hi > j->index_dirtyhi)
+		j->index_dirtyhi = hi;
+}
+
+static int
+index_compare(const void *av, const void *bv) {
+	const journal_pos_t *a = av;
+	const journal_pos_t *b = bv;
+
+	if (a->offset < b->offset)
+		return (-1);
+	if (a->offset > b->offset)
+		return (1);
+	return (0);
+}
+
+/*
+ * Put the index just read from disk into file order, with the
+ * entries in use first, dropping any that point outside the
+ * addressable part of the journal.  Within that part serial
+ * numbers increase with the file offset, which is what
+ * index_find() relies on.  If anything moved, the whole index
+ * is rewritten on the next update.
+ */
+static void
+index_sort(dns_journal_t *j) {
+	unsigned int i, k = 0;
+	isc_boolean_t changed = ISC_FALSE;
+
+	for (i = 0; i < j->header.index_size; i++) {
+		if (! POS_VALID(j->index[i]))
+			continue;
+		if (j->index[i].offset < j->header.begin.offset ||
+		    j->index[i].offset >= j->header.end.offset)
+		{
+			changed = ISC_TRUE;
+			continue;
+		}
+		if (k != i)
+			changed = ISC_TRUE;
+		if (k > 0 && j->index[i].offset < j->index[k - 1].offset)
+			changed = ISC_TRUE;
+		j->index[k++] = j->index[i];
+	}
+	j->index_count = k;
+	for (i = k; i < j->header.index_size; i++)
+		POS_INVALIDATE(j->index[i]);
+
+	if (changed) {
+		qsort(j->index, k, sizeof(j->index[0]), index_compare);
+		index_dirty(j, 0, j->header.index_size);
+	}
+}
+
 /*
  * If the index of the journal 'j' contains an entry "better"
  * than '*best_guess', replace '*best_guess' with it.
@@ -844,74 +951,120 @@ journal_next(dns_journal_t *j, journal_pos_t *pos) {
  */
 static void
 index_find(dns_journal_t *j, isc_uint32_t serial, journal_pos_t *best_guess) {
-	unsigned int i;
+	unsigned int lo = 0, hi, mid;
+
 	if (j->index == NULL)
 		return;
-	for (i = 0; i < j->header.index_size; i++) {
-		if (POS_VALID(j->index[i]) &&
-		    DNS_SERIAL_GE(serial, j->index[i].serial) &&
-		    DNS_SERIAL_GT(j->index[i].serial, best_guess->serial))
-			*best_guess = j->index[i];
+
+	/*
+	 * Find the first entry with a serial number greater
+	 * than 'serial'; the one before it is the best match.
+	 */
+	hi = j->index_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (DNS_SERIAL_GE(serial, j->index[mid].serial))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	if (lo == 0)
+		return;
+
+	/*
+	 * Transactions that do not change the serial number
+	 * (bind8_compat) can give several entries the same serial.
+	 * Use the first of them.
+	 */
+	while (lo > 1 && j->index[lo - 2].serial == j->index[lo - 1].serial)
+		lo--;
+	if (DNS_SERIAL_GT(j->index[lo - 1].serial, best_guess->serial))
+		*best_guess = j->index[lo - 1];
 }
 
 /*
- * Add a new index entry.  If there is no room, make room by removing
- * the odd-numbered entries and compacting the others into the first
- * half of the index.  This decimates old index entries exponentially
- * over time, so that the index always contains a much larger fraction
- * of recent serial numbers than of old ones.  This is deliberate -
- * most index searches are for outgoing IXFR, and IXFR tends to request
- * recent versions more often than old ones.
+ * Add a new index entry.  Transactions are added in file order, so
+ * this normally just appends.  If there is no room, make room by
+ * removing the odd-numbered entries and compacting the others into
+ * the first half of the index.  This decimates old index entries
+ * exponentially over time, so that the index always contains a much
+ * larger fraction of recent serial numbers than of old ones.  This is
+ * deliberate - most index searches are for outgoing IXFR, and IXFR
+ * tends to request recent versions more often than old ones.  The
+ * journal is then marked sparse so that the next compaction rewrites
+ * it with a larger index.
  */
 static void
 index_add(dns_journal_t *j, journal_pos_t *pos) {
-	unsigned int i;
-	if (j->index == NULL)
+	unsigned int i, k;
+
+	if (j->index == NULL || j->header.index_size == 0)
 		return;
+
 	/*
-	 * Search for a vacant position.
+	 * Forget entries for transactions that were written but never
+	 * committed; 'pos' is overwriting them.
 	 */
-	for (i = 0; i < j->header.index_size; i++) {
-		if (! POS_VALID(j->index[i]))
-			break;
+	k = j->index_count;
+	while (j->index_count > 0 &&
+	       j->index[j->index_count - 1].offset >= pos->offset)
+	{
+		POS_INVALIDATE(j->index[j->index_count - 1]);
+		j->index_count--;
 	}
-	if (i == j->header.index_size) {
-		unsigned int k = 0;
+	if (j->index_count != k)
+		index_dirty(j, j->index_count, k);
+
+	if (j->index_count == j->header.index_size) {
 		/*
 		 * Found no vacant position.  Make some room.
 		 */
-		for (i = 0; i < j->header.index_size; i += 2) {
+		k = 0;
+		for (i = 0; i < j->header.index_size; i += 2)
 			j->index[k++] = j->index[i];
-		}
-		i = k; /* 'i' identifies the first vacant position. */
-		while (k < j->header.index_size) {
-			POS_INVALIDATE(j->index[k]);
-			k++;
-		}
+		j->index_count = k;
+		while (k < j->header.index_size)
+			POS_INVALIDATE(j->index[k++]);
+		index_dirty(j, 0, j->header.index_size);
+		if (j->header.index_size < JOURNAL_INDEX_MAX)
+			j->header.sparse = ISC_TRUE;
 	}
-	INSIST(i < j->header.index_size);
-	INSIST(! POS_VALID(j->index[i]));
+	INSIST(j->index_count < j->header.index_size);
 
 	/*
 	 * Store the new index entry.
 	 */
-	j->index[i] = *pos;
+	j->index[j->index_count] = *pos;
+	index_dirty(j, j->index_count, j->index_count + 1);
+	j->index_count++;
 }
 
 /*
  * Invalidate any existing index entries that could become
- * ambiguous when a new transaction with number 'serial' is added.
+ * ambiguous when a new transaction with number 'serial' is added,
+ * or that point before the start of the journal.  Being the
+ * oldest, they are at the front of the index.
  */
 static void
 index_invalidate(dns_journal_t *j, isc_uint32_t serial) {
-	unsigned int i;
+	unsigned int i, k;
+
 	if (j->index == NULL)
 		return;
-	for (i = 0; i < j->header.index_size; i++) {
-		if (! DNS_SERIAL_GT(serial, j->index[i].serial))
-			POS_INVALIDATE(j->index[i]);
+	for (k = 0; k < j->index_count; k++) {
+		if (j->index[k].offset >= j->header.begin.offset &&
+		    DNS_SERIAL_GT(serial, j->index[k].serial))
+			break;
 	}
+	if (k == 0)
+		return;
+
+	for (i = k; i < j->index_count; i++)
+		j->index[i - k] = j->index[i];
+	for (i = j->index_count - k; i < j->index_count; i++)
+		POS_INVALIDATE(j->index[i]);
+	index_dirty(j, 0, j->index_count);
+	j->index_count -= k;
 }
 
 /*
@@ -1162,7 +1315,8 @@ dns_journal_commit(dns_journal_t *j) {
 	/*
 	 * Commit the transaction data to stable storage.
 	 */
-	CHECK(journal_fsync(j));
+	if (!j->defer)
+		CHECK(journal_fsync(j));
 
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		isc_offset_t offset;
@@ -1182,14 +1336,22 @@ dns_journal_commit(dns_journal_t *j) {
 	if (JOURNAL_EMPTY(&j->header))
 		j->header.begin = j->x.pos[0];
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+	index_add(j, &j->x.pos[0]);
 
 	/*
-	 * Update the index.
+	 * With group commit the header and index are only written
+	 * by dns_journal_sync(), after the data of every transaction
+	 * it covers is on stable storage.
 	 */
-	index_add(j, &j->x.pos[0]);
+	if (j->defer) {
+		j->unsynced = ISC_TRUE;
+		j->state = JOURNAL_STATE_WRITE;
+		return (ISC_R_SUCCESS);
+	}
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Convert the index into on-disk format and write
@@ -1225,11 +1387,55 @@ dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff) {
 	return (result);
 }
 
+void
+dns_journal_defersync(dns_journal_t *j) {
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->state == JOURNAL_STATE_WRITE);
+
+	j->defer = ISC_TRUE;
+}
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+
+	if (!j->unsynced)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * Transaction data first, then the header pointing at it,
+	 * so that a crash in between leaves the previous header.
+	 */
+	CHECK(journal_fsync(j));
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+	CHECK(index_to_disk(j));
+	CHECK(journal_fsync(j));
+	j->unsynced = ISC_FALSE;
+
+ failure:
+	return (result);
+}
+
 void
 dns_journal_destroy(dns_journal_t **journalp) {
 	dns_journal_t *j = *journalp;
+	isc_result_t result;
+
 	REQUIRE(DNS_JOURNAL_VALID(j));
 
+	if (j->unsynced) {
+		result = dns_journal_sync(j);
+		if (result != ISC_R_SUCCESS)
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: sync on close failed: %s",
+				      j->filename, isc_result_totext(result));
+	}
+
 	j->it.result = ISC_R_FAILURE;
 	dns_name_invalidate(&j->it.name);
 	dns_decompress_invalidate(&j->it.dctx);
@@ -2082,9 +2288,98 @@ dns_db_diffx(dns_diff_t *diff, dns_db_t *dba, dns_dbversion_t *dbvera,
 	return (result);
 }
 
+/*
+ * Work out the names of the file a compacted copy of the journal
+ * 'filename' is written to, and of its backup.
+ */
+static isc_result_t
+journal_compactnames(const char *filename, char *newname, size_t newsize,
+		     char *backup, size_t backupsize)
+{
+	isc_result_t result;
+	size_t namelen;
+
+	namelen = strlen(filename);
+	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0)
+		namelen -= 4;
+
+	result = isc_string_printf(newname, newsize, "%.*s.jnw",
+				   (int)namelen, filename);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	return (isc_string_printf(backup, backupsize, "%.*s.jbk",
+				  (int)namelen, filename));
+}
+
+/*
+ * Append the journal data from 'pos' to the end of 'j1' to the
+ * end of 'j2', and index the transactions added.
+ */
+static isc_result_t
+journal_copytail(isc_mem_t *mctx, dns_journal_t *j1, journal_pos_t *pos,
+		 dns_journal_t *j2)
+{
+	journal_pos_t current_pos;
+	unsigned int copy_length, i;
+	unsigned int size = 0;
+	char *buf = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	copy_length = j1->header.end.offset - pos->offset;
+	if (copy_length == 0)
+		return (ISC_R_SUCCESS);
+
+	size = 64*1024;
+	if (copy_length < size)
+		size = copy_length;
+	buf = isc_mem_get(mctx, size);
+	if (buf == NULL)
+		return (ISC_R_NOMEMORY);
+
+	CHECK(journal_seek(j1, pos->offset));
+	CHECK(journal_seek(j2, j2->header.end.offset));
+	for (i = 0; i < copy_length; i += size) {
+		unsigned int len = (copy_length - i) > size ? size :
+							 (copy_length - i);
+		CHECK(journal_read(j1, buf, len));
+		CHECK(journal_write(j2, buf, len));
+	}
+
+	CHECK(journal_fsync(j2));
+
+	current_pos = j2->header.end;
+	j2->header.end.serial = j1->header.end.serial;
+	j2->header.end.offset += copy_length;
+	while (current_pos.serial != j2->header.end.serial) {
+		index_add(j2, &current_pos);
+		CHECK(journal_next(j2, &current_pos));
+	}
+
+ failure:
+	isc_mem_put(mctx, buf, size);
+	return (result);
+}
+
 isc_result_t
 dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 		    isc_uint32_t target_size)
+{
+	isc_result_t result;
+
+	result = dns_journal_compactprepare(mctx, filename, serial,
+					    target_size);
+	if (result == DNS_R_UPTODATE)
+		return (ISC_R_SUCCESS);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	return (dns_journal_compactfinish(mctx, filename));
+}
+
+isc_result_t
+dns_journal_compactprepare(isc_mem_t *mctx, const char *filename,
+			   isc_uint32_t serial, isc_uint32_t target_size)
 {
 	unsigned int i;
 	journal_pos_t best_guess;
@@ -2092,43 +2387,33 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 	dns_journal_t *j1 = NULL;
 	dns_journal_t *j2 = NULL;
 	journal_rawheader_t rawheader;
-	unsigned int copy_length;
-	size_t namelen;
-	char *buf = NULL;
-	unsigned int size = 0;
+	unsigned int count, index_size;
 	isc_result_t result;
 	unsigned int indexend;
 	char newname[1024];
 	char backup[1024];
-	isc_boolean_t is_backup = ISC_FALSE;
 
 	REQUIRE(filename != NULL);
 
-	namelen = strlen(filename);
-	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0)
-		namelen -= 4;
-
-	result = isc_string_printf(newname, sizeof(newname), "%.*s.jnw",
-				   (int)namelen, filename);
+	result = journal_compactnames(filename, newname, sizeof(newname),
+				      backup, sizeof(backup));
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
-	result = isc_string_printf(backup, sizeof(backup), "%.*s.jbk",
-				   (int)namelen, filename);
-	if (result != ISC_R_SUCCESS)
-		return (result);
+	/*
+	 * Anything left over from an earlier attempt is stale.
+	 */
+	(void)isc_file_remove(newname);
 
 	result = journal_open(mctx, filename, ISC_FALSE, ISC_FALSE, &j1);
-	if (result == ISC_R_NOTFOUND) {
-		is_backup = ISC_TRUE;
+	if (result == ISC_R_NOTFOUND)
 		result = journal_open(mctx, backup, ISC_FALSE, ISC_FALSE, &j1);
-	}
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
 	if (JOURNAL_EMPTY(&j1->header)) {
 		dns_journal_destroy(&j1);
-		return (ISC_R_SUCCESS);
+		return (DNS_R_UPTODATE);
 	}
 
 	if (DNS_SERIAL_GT(j1->header.begin.serial, serial) ||
@@ -2148,15 +2433,19 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 		target_size = target_size/2 + indexend;
 
 	/*
-	 * See if there is any work to do.
+	 * See if there is any work to do.  A journal whose index had
+	 * to drop entries is rewritten with a larger one even if it
+	 * is not too big.
 	 */
 	if ((isc_uint32_t) j1->header.end.offset < target_size) {
-		dns_journal_destroy(&j1);
-		return (ISC_R_SUCCESS);
+		if (!j1->header.sparse) {
+			dns_journal_destroy(&j1);
+			return (DNS_R_UPTODATE);
+		}
+		best_guess = j1->header.begin;
+		goto copy;
 	}
 
-	CHECK(journal_open(mctx, newname, ISC_TRUE, ISC_TRUE, &j2));
-
 	/*
 	 * Remove overhead so space test below can succeed.
 	 */
@@ -2167,9 +2456,8 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 	 * Find if we can create enough free space.
 	 */
 	best_guess = j1->header.begin;
-	for (i = 0; i < j1->header.index_size; i++) {
-		if (POS_VALID(j1->index[i]) &&
-		    DNS_SERIAL_GE(serial, j1->index[i].serial) &&
+	for (i = 0; i < j1->index_count; i++) {
+		if (DNS_SERIAL_GE(serial, j1->index[i].serial) &&
 		    ((isc_uint32_t)(j1->header.end.offset - j1->index[i].offset)
 		     >= target_size / 2) &&
 		    j1->index[i].offset > best_guess.offset)
@@ -2195,73 +2483,121 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 	if (best_guess.serial != serial)
 		CHECK(journal_next(j1, &best_guess));
 
+ copy:
 	/*
-	 * We should now be roughly half target_size provided
-	 * we did not reach 'serial'.  If not we will just copy
-	 * all uncommitted deltas regardless of the size.
+	 * Size the new index for the transactions we keep, with room
+	 * for as many again.
 	 */
-	copy_length = j1->header.end.offset - best_guess.offset;
+	count = 0;
+	current_pos = best_guess;
+	while (current_pos.serial != j1->header.end.serial) {
+		CHECK(journal_next(j1, &current_pos));
+		count++;
+	}
+	index_size = JOURNAL_INDEX_MIN;
+	while (index_size < count * 2 && index_size < JOURNAL_INDEX_MAX)
+		index_size *= 2;
 
-	if (copy_length != 0) {
-		/*
-		 * Copy best_guess to end into space just freed.
-		 */
-		size = 64*1024;
-		if (copy_length < size)
-			size = copy_length;
-		buf = isc_mem_get(mctx, size);
-		if (buf == NULL) {
-			result = ISC_R_NOMEMORY;
-			goto failure;
-		}
+	CHECK(journal_file_create(mctx, newname, index_size));
+	CHECK(journal_open(mctx, newname, ISC_TRUE, ISC_FALSE, &j2));
 
-		CHECK(journal_seek(j1, best_guess.offset));
-		CHECK(journal_seek(j2, indexend));
-		for (i = 0; i < copy_length; i += size) {
-			unsigned int len = (copy_length - i) > size ? size :
-							 (copy_length - i);
-			CHECK(journal_read(j1, buf, len));
-			CHECK(journal_write(j2, buf, len));
-		}
+	/*
+	 * The new journal starts out empty at 'best_guess'.
+	 * Copy best_guess to end into it.
+	 */
+	indexend = sizeof(journal_rawheader_t) +
+		   index_size * sizeof(journal_rawpos_t);
+	j2->header.begin.serial = best_guess.serial;
+	j2->header.begin.offset = indexend;
+	j2->header.end = j2->header.begin;
+	CHECK(journal_copytail(mctx, j1, &best_guess, j2));
+	j2->header.sourceserial = j1->header.sourceserial;
+	j2->header.serialset = j1->header.serialset;
 
-		CHECK(journal_fsync(j2));
+	/*
+	 * Update the journal header and write the index.
+	 */
+	journal_header_encode(&j2->header, &rawheader);
+	CHECK(journal_seek(j2, 0));
+	CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
+	CHECK(index_to_disk(j2));
+	CHECK(journal_fsync(j2));
 
-		/*
-		 * Compute new header.
-		 */
-		j2->header.begin.serial = best_guess.serial;
-		j2->header.begin.offset = indexend;
-		j2->header.end.serial = j1->header.end.serial;
-		j2->header.end.offset = indexend + copy_length;
-		j2->header.sourceserial = j1->header.sourceserial;
-		j2->header.serialset = j1->header.serialset;
+	dns_journal_destroy(&j1);
+	dns_journal_destroy(&j2);
+	return (ISC_R_SUCCESS);
 
-		/*
-		 * Update the journal header.
-		 */
-		journal_header_encode(&j2->header, &rawheader);
-		CHECK(journal_seek(j2, 0));
-		CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
-		CHECK(journal_fsync(j2));
+ failure:
+	if (j1 != NULL)
+		dns_journal_destroy(&j1);
+	if (j2 != NULL)
+		dns_journal_destroy(&j2);
+	(void)isc_file_remove(newname);
+	return (result);
+}
 
-		/*
-		 * Build new index.
-		 */
-		current_pos = j2->header.begin;
-		while (current_pos.serial != j2->header.end.serial) {
-			index_add(j2, &current_pos);
-			CHECK(journal_next(j2, &current_pos));
-		}
+isc_result_t
+dns_journal_compactfinish(isc_mem_t *mctx, const char *filename) {
+	journal_pos_t first, pos;
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	journal_rawheader_t rawheader;
+	isc_result_t result;
+	char newname[1024];
+	char backup[1024];
+	isc_boolean_t is_backup = ISC_FALSE;
 
-		/*
-		 * Write index.
-		 */
-		CHECK(index_to_disk(j2));
-		CHECK(journal_fsync(j2));
+	REQUIRE(filename != NULL);
 
-		indexend = j2->header.end.offset;
-		POST(indexend);
+	result = journal_compactnames(filename, newname, sizeof(newname),
+				      backup, sizeof(backup));
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = journal_open(mctx, newname, ISC_TRUE, ISC_FALSE, &j2);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = journal_open(mctx, filename, ISC_FALSE, ISC_FALSE, &j1);
+	if (result == ISC_R_NOTFOUND) {
+		is_backup = ISC_TRUE;
+		result = journal_open(mctx, backup, ISC_FALSE, ISC_FALSE, &j1);
 	}
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+
+	/*
+	 * The copy must still match the journal: the transactions
+	 * it holds have to be found in the same place relative to
+	 * each other.  If the journal was replaced in the meantime,
+	 * throw the copy away.
+	 */
+	result = journal_find(j1, j2->header.end.serial, &pos);
+	if (result == ISC_R_SUCCESS && !JOURNAL_EMPTY(&j2->header)) {
+		result = journal_find(j1, j2->header.begin.serial, &first);
+		if (result == ISC_R_SUCCESS &&
+		    pos.offset - first.offset !=
+		    j2->header.end.offset - j2->header.begin.offset)
+			result = ISC_R_NOTFOUND;
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+			      "%s: compacted copy is stale", filename);
+		FAIL(ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * Bring over the transactions added since the copy was made.
+	 */
+	CHECK(journal_copytail(mctx, j1, &pos, j2));
+	j2->header.sourceserial = j1->header.sourceserial;
+	j2->header.serialset = j1->header.serialset;
+
+	journal_header_encode(&j2->header, &rawheader);
+	CHECK(journal_seek(j2, 0));
+	CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
+	CHECK(index_to_disk(j2));
+	CHECK(journal_fsync(j2));
 
 	/*
 	 * Close both journals before trying to rename files (this is
@@ -2303,8 +2639,6 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 
  failure:
 	(void)isc_file_remove(newname);
-	if (buf != NULL)
-		isc_mem_put(mctx, buf, size);
 	if (j1 != NULL)
 		dns_journal_destroy(&j1);
 	if (j2 != NULL)
@@ -2316,24 +2650,33 @@ static isc_result_t
 index_to_disk(dns_journal_t *j) {
 	isc_result_t result = ISC_R_SUCCESS;
 
-	if (j->header.index_size != 0) {
+	/*
+	 * Only the slots that changed since the last write are
+	 * written; usually that is just the entry for the newest
+	 * transaction.
+	 */
+	if (j->header.index_size != 0 &&
+	    j->index_dirtylo != j->index_dirtyhi)
+	{
 		unsigned int i;
-		unsigned char *p;
-		unsigned int rawbytes;
+		unsigned char *p, *start;
 
-		rawbytes = j->header.index_size * sizeof(journal_rawpos_t);
+		INSIST(j->index_dirtyhi <= j->header.index_size);
 
-		p = j->rawindex;
-		for (i = 0; i < j->header.index_size; i++) {
+		start = p = j->rawindex +
+			    j->index_dirtylo * sizeof(journal_rawpos_t);
+		for (i = j->index_dirtylo; i < j->index_dirtyhi; i++) {
 			encode_uint32(j->index[i].serial, p);
 			p += 4;
 			encode_uint32(j->index[i].offset, p);
 			p += 4;
 		}
-		INSIST(p == j->rawindex + rawbytes);
 
-		CHECK(journal_seek(j, sizeof(journal_rawheader_t)));
-		CHECK(journal_write(j, j->rawindex, rawbytes));
+		CHECK(journal_seek(j, sizeof(journal_rawheader_t) +
+				   j->index_dirtylo *
+				   sizeof(journal_rawpos_t)));
+		CHECK(journal_write(j, start, p - start));
+		j->index_dirtylo = j->index_dirtyhi = 0;
 	}
 failure:
 	return (result);
@@ -12,16 +12,21 @@
 
 #include <config.h>
 
+#include <limits.h>
+
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
@@ -40,6 +45,14 @@
 #include <dns/time.h>
 #include <dns/ttl.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#else
+#define PROT_READ	0x01
+#define MAP_PRIVATE	0x0002
+#define MAP_FAILED	((void *)-1)
+#endif
+
 /*!
  * Grow the number of dns_rdatalist_t (#RDLSZ) and dns_rdata_t (#RDSZ) structures
  * by these sizes when we need to.
@@ -84,6 +97,19 @@
 
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
+/*%
+ * Number of chunks a text file is split into per worker by
+ * dns_master_loadfileparallel(), so that workers which finish early
+ * can pick up more work.
+ */
+#define CHUNKS_PER_WORKER 4
+
+/*%
+ * Chunks are parsed from an isc_buffer_t, so each must stay well
+ * below 4GB.
+ */
+#define CHUNK_MAXSIZE (1024U * 1024U * 1024U)
+
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
@@ -2664,6 +2690,438 @@ dns_master_loadfile5(const char *master_file, dns_name_t *top,
 	return (result);
 }
 
+/*
+ * Parallel loading of text master files.
+ *
+ * The file is mapped into memory and scanned once for lines which
+ * start a record with an explicit owner name, outside of parentheses,
+ * quoted strings and comments.  The file is cut at such lines into
+ * chunks; the $ORIGIN and $TTL in effect at each cut are recorded so
+ * that the chunk can be parsed on its own, with load_text(), by one of
+ * several worker threads.  Calls to callbacks->add are serialized.
+ *
+ * A cut is only made once the default TTL is known, as otherwise a
+ * record without a TTL would inherit the TTL of the previous record.
+ * Files using $INCLUDE, $GENERATE or $DATE are loaded sequentially.
+ */
+typedef struct {
+	size_t			start;
+	size_t			length;
+	unsigned long		line;
+	dns_fixedname_t		origin;
+	isc_boolean_t		ttl_known;
+	isc_uint32_t		ttl;
+	isc_result_t		result;
+} loadchunk_t;
+
+typedef struct {
+	isc_mem_t		*mctx;
+	const char		*master_file;
+	unsigned char		*base;
+	dns_name_t		*top;
+	dns_rdataclass_t	zclass;
+	unsigned int		options;
+	isc_uint32_t		resign;
+	dns_ttl_t		maxttl;
+	dns_rdatacallbacks_t	*callbacks;
+	dns_rdatacallbacks_t	wrapped;
+	isc_mutex_t		lock;
+	/* Locked by lock. */
+	loadchunk_t		*chunks;
+	unsigned int		nchunks;
+	unsigned int		next;
+} parload_t;
+
+/*
+ * Copy the word starting at base[*posp], after any blanks, into 'buf'.
+ * Words needing the lexer's help (quotes, escapes, parentheses) are
+ * rejected.
+ */
+static isc_boolean_t
+scan_word(const unsigned char *base, size_t len, size_t *posp,
+	  char *buf, size_t size)
+{
+	size_t pos = *posp;
+	size_t n = 0;
+
+	while (pos < len && (base[pos] == ' ' || base[pos] == '\t'))
+		pos++;
+	while (pos < len && strchr(" \t\r\n;", base[pos]) == NULL) {
+		if (strchr("\"\\()", base[pos]) != NULL || n + 1 >= size)
+			return (ISC_FALSE);
+		buf[n++] = base[pos++];
+	}
+	buf[n] = '\0';
+	*posp = pos;
+	return (ISC_TF(n != 0));
+}
+
+/*
+ * Handle the $ directive at base[*posp], updating 'origin' and the
+ * default TTL.  Returns ISC_FALSE if the file cannot be split.
+ */
+static isc_boolean_t
+scan_directive(const unsigned char *base, size_t len, size_t *posp,
+	       dns_name_t *origin, isc_boolean_t *ttl_knownp,
+	       isc_uint32_t *ttlp)
+{
+	char keyword[16];
+	char arg[DNS_NAME_FORMATSIZE];
+	isc_textregion_t r;
+	isc_buffer_t b;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	size_t pos = *posp;
+
+	if (!scan_word(base, len, &pos, keyword, sizeof(keyword)) ||
+	    !scan_word(base, len, &pos, arg, sizeof(arg)))
+		return (ISC_FALSE);
+
+	/*
+	 * Nothing but a comment may follow the argument.
+	 */
+	while (pos < len && (base[pos] == ' ' || base[pos] == '\t'))
+		pos++;
+	if (pos < len && strchr("\r\n;", base[pos]) == NULL)
+		return (ISC_FALSE);
+
+	if (strcasecmp(keyword, "$ORIGIN") == 0) {
+		dns_fixedname_init(&fixed);
+		name = dns_fixedname_name(&fixed);
+		isc_buffer_constinit(&b, arg, strlen(arg));
+		isc_buffer_add(&b, strlen(arg));
+		if (dns_name_fromtext(name, &b, origin, 0, NULL) !=
+		    ISC_R_SUCCESS)
+			return (ISC_FALSE);
+		dns_name_copy(name, origin, NULL);
+	} else if (strcasecmp(keyword, "$TTL") == 0) {
+		r.base = arg;
+		r.length = strlen(arg);
+		if (dns_ttl_fromtext(&r, ttlp) != ISC_R_SUCCESS)
+			return (ISC_FALSE);
+		if (*ttlp > 0x7fffffffUL)
+			*ttlp = 0;
+		*ttl_knownp = ISC_TRUE;
+	} else
+		return (ISC_FALSE);
+
+	*posp = pos;
+	return (ISC_TRUE);
+}
+
+/*
+ * Split the 'len' bytes at 'base' into at most 'maxchunks' chunks.
+ * Returns ISC_FALSE if the file cannot be split.
+ */
+static isc_boolean_t
+split_text(parload_t *pl, size_t len, dns_name_t *origin,
+	   unsigned int maxchunks)
+{
+	const unsigned char *base = pl->base;
+	dns_fixedname_t fixed;
+	dns_name_t *current, *name;
+	isc_boolean_t ttl_known;
+	isc_uint32_t ttl = 0;
+	isc_boolean_t linestart = ISC_TRUE;
+	unsigned long line = 1;
+	size_t target, cut;
+	size_t pos = 0;
+	unsigned int depth = 0;
+	unsigned int i;
+	loadchunk_t *chunk;
+
+	dns_fixedname_init(&fixed);
+	current = dns_fixedname_name(&fixed);
+	dns_name_copy(origin, current, NULL);
+	ttl_known = ISC_TF((pl->options & DNS_MASTER_NOTTL) != 0);
+
+	target = len / maxchunks;
+	cut = target;
+
+	chunk = &pl->chunks[0];
+	chunk->start = 0;
+	chunk->line = 1;
+	dns_fixedname_init(&chunk->origin);
+	dns_name_copy(origin, dns_fixedname_name(&chunk->origin), NULL);
+	chunk->ttl_known = ISC_FALSE;
+	chunk->ttl = 0;
+	pl->nchunks = 1;
+
+	while (pos < len) {
+		unsigned char c = base[pos];
+
+		if (linestart) {
+			linestart = ISC_FALSE;
+			if (c == '$') {
+				if (!scan_directive(base, len, &pos, current,
+						    &ttl_known, &ttl))
+					return (ISC_FALSE);
+				continue;
+			}
+			if (strchr(" \t\r\n;", c) == NULL && ttl_known &&
+			    pos >= cut && pl->nchunks < maxchunks)
+			{
+				chunk->length = pos - chunk->start;
+				chunk = &pl->chunks[pl->nchunks++];
+				chunk->start = pos;
+				chunk->line = line;
+				dns_fixedname_init(&chunk->origin);
+				name = dns_fixedname_name(&chunk->origin);
+				dns_name_copy(current, name, NULL);
+				chunk->ttl_known = ISC_TRUE;
+				chunk->ttl = ttl;
+				cut = pos + target;
+			}
+		}
+
+		switch (c) {
+		case ';':
+			while (pos < len && base[pos] != '\n')
+				pos++;
+			continue;
+		case '"':
+			for (pos++; pos < len && base[pos] != '"'; pos++) {
+				if (base[pos] == '\\' && pos + 1 < len)
+					pos++;
+				if (base[pos] == '\n')
+					line++;
+			}
+			break;
+		case '\\':
+			if (pos + 1 < len && base[pos + 1] == '\n')
+				line++;
+			pos++;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (depth == 0)
+				return (ISC_FALSE);
+			depth--;
+			break;
+		case '\n':
+			line++;
+			linestart = ISC_TF(depth == 0);
+			break;
+		}
+		pos++;
+	}
+	chunk->length = len - chunk->start;
+
+	for (i = 0; i < pl->nchunks; i++)
+		if (pl->chunks[i].length > UINT_MAX)
+			return (ISC_FALSE);
+
+	return (ISC_TF(pl->nchunks > 1));
+}
+
+static isc_result_t
+parload_add(void *arg, const dns_name_t *owner, dns_rdataset_t *dataset) {
+	parload_t *pl = arg;
+	isc_result_t result;
+
+	LOCK(&pl->lock);
+	result = (pl->callbacks->add)(pl->callbacks->add_private,
+				      owner, dataset);
+	UNLOCK(&pl->lock);
+
+	return (result);
+}
+
+static isc_result_t
+parload_chunk(parload_t *pl, loadchunk_t *chunk) {
+	dns_loadctx_t *lctx = NULL;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	result = loadctx_create(dns_masterformat_text, pl->mctx, pl->options,
+				pl->resign, pl->top, pl->zclass,
+				dns_fixedname_name(&chunk->origin),
+				&pl->wrapped, NULL, NULL, NULL, NULL, NULL,
+				NULL, &lctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	lctx->maxttl = pl->maxttl;
+	if (chunk->ttl_known) {
+		lctx->ttl = chunk->ttl;
+		lctx->default_ttl = chunk->ttl;
+		lctx->default_ttl_known = ISC_TRUE;
+	}
+
+	isc_buffer_init(&buffer, pl->base + chunk->start,
+			(unsigned int)chunk->length);
+	isc_buffer_add(&buffer, (unsigned int)chunk->length);
+	result = isc_lex_openbuffer(lctx->lex, &buffer);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourcename(lctx->lex, pl->master_file);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourceline(lctx->lex, chunk->line);
+	if (result == ISC_R_SUCCESS)
+		result = load_text(lctx);
+	INSIST(result != DNS_R_CONTINUE);
+
+	dns_loadctx_detach(&lctx);
+	return (result);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+parload_worker(isc_threadarg_t arg) {
+	parload_t *pl = arg;
+	loadchunk_t *chunk;
+	isc_result_t result;
+
+	for (;;) {
+		LOCK(&pl->lock);
+		if (pl->next == pl->nchunks) {
+			UNLOCK(&pl->lock);
+			break;
+		}
+		chunk = &pl->chunks[pl->next++];
+		UNLOCK(&pl->lock);
+
+		result = parload_chunk(pl, chunk);
+		chunk->result = result;
+
+		/*
+		 * Without DNS_MASTER_MANYERRORS the load has failed;
+		 * don't start on any more chunks.
+		 */
+		if (result != ISC_R_SUCCESS &&
+		    (pl->options & DNS_MASTER_MANYERRORS) == 0)
+		{
+			LOCK(&pl->lock);
+			pl->nchunks = pl->next;
+			UNLOCK(&pl->lock);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+isc_result_t
+dns_master_loadfileparallel(const char *master_file, dns_name_t *top,
+			    dns_name_t *origin, dns_rdataclass_t zclass,
+			    unsigned int options, isc_uint32_t resign,
+			    dns_rdatacallbacks_t *callbacks,
+			    dns_masterincludecb_t include_cb,
+			    void *include_arg, isc_mem_t *mctx,
+			    dns_ttl_t maxttl, unsigned int nworkers)
+{
+#ifdef ISC_PLATFORM_USETHREADS
+	parload_t pl;
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads = 0;
+	unsigned int maxchunks;
+	unsigned int i;
+	FILE *f = NULL;
+	off_t size = 0;
+	void *base = NULL;
+	isc_result_t result;
+
+	REQUIRE(master_file != NULL);
+	REQUIRE(callbacks != NULL && callbacks->add != NULL);
+	REQUIRE(dns_name_isabsolute(origin));
+
+	if (nworkers < 2)
+		goto sequential;
+
+	result = isc_stdio_open(master_file, "r", &f);
+	if (result == ISC_R_SUCCESS)
+		result = isc_file_getsizefd(fileno(f), &size);
+	if (result != ISC_R_SUCCESS || size == 0)
+		goto sequential;
+
+	base = isc_file_mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE,
+			     fileno(f), 0);
+	if (base == NULL || base == MAP_FAILED) {
+		base = NULL;
+		goto sequential;
+	}
+
+	memset(&pl, 0, sizeof(pl));
+	pl.mctx = mctx;
+	pl.master_file = master_file;
+	pl.base = base;
+	pl.top = top;
+	pl.zclass = zclass;
+	pl.options = options;
+	pl.resign = resign;
+	pl.maxttl = maxttl;
+	pl.callbacks = callbacks;
+	pl.wrapped = *callbacks;
+	pl.wrapped.add = parload_add;
+	pl.wrapped.add_private = &pl;
+
+	maxchunks = nworkers * CHUNKS_PER_WORKER;
+	if ((isc_uint64_t)size / maxchunks >= CHUNK_MAXSIZE)
+		maxchunks = (unsigned int)(size / CHUNK_MAXSIZE) + 1;
+	pl.chunks = isc_mem_get(mctx, maxchunks * sizeof(loadchunk_t));
+	if (pl.chunks == NULL)
+		goto sequential;
+	if (!split_text(&pl, (size_t)size, origin, maxchunks)) {
+		isc_mem_put(mctx, pl.chunks, maxchunks * sizeof(loadchunk_t));
+		goto sequential;
+	}
+	for (i = 0; i < pl.nchunks; i++)
+		pl.chunks[i].result = ISC_R_SUCCESS;
+
+	result = isc_mutex_init(&pl.lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, pl.chunks, maxchunks * sizeof(loadchunk_t));
+		goto sequential;
+	}
+
+	/*
+	 * The calling thread is one of the workers.
+	 */
+	threads = isc_mem_get(mctx, (nworkers - 1) * sizeof(isc_thread_t));
+	if (threads != NULL) {
+		while (nthreads < nworkers - 1 &&
+		       isc_thread_create(parload_worker, &pl,
+					 &threads[nthreads]) == ISC_R_SUCCESS)
+			nthreads++;
+	}
+	(void)parload_worker(&pl);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+	if (threads != NULL)
+		isc_mem_put(mctx, threads,
+			    (nworkers - 1) * sizeof(isc_thread_t));
+
+	/*
+	 * Report the first failure in file order, as a sequential
+	 * load would.
+	 */
+	result = ISC_R_SUCCESS;
+	for (i = 0; i < pl.nchunks && result == ISC_R_SUCCESS; i++)
+		result = pl.chunks[i].result;
+
+	DESTROYLOCK(&pl.lock);
+	isc_mem_put(mctx, pl.chunks, maxchunks * sizeof(loadchunk_t));
+	isc_file_munmap(base, (size_t)size);
+	(void)isc_stdio_close(f);
+	return (result);
+
+ sequential:
+	if (base != NULL)
+		isc_file_munmap(base, (size_t)size);
+	if (f != NULL)
+		(void)isc_stdio_close(f);
+#else
+	UNUSED(nworkers);
+#endif /* ISC_PLATFORM_USETHREADS */
+
+	return (dns_master_loadfile5(master_file, top, origin, zclass,
+				     options, resign, callbacks,
+				     include_cb, include_arg, mctx,
+				     dns_masterformat_text, maxttl));
+}
+
 isc_result_t
 dns_master_loadfileinc(const char *master_file, dns_name_t *top,
 		       dns_name_t *origin, dns_rdataclass_t zclass,
@@ -96,11 +96,14 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
  * XXXMLG These should come from a config setting.
  */
 #define SCRATCHPAD_SIZE		512
-#define NAME_COUNT		 64
-#define OFFSET_COUNT		  4
-#define RDATA_COUNT		  8
-#define RDATALIST_COUNT		  8
-#define RDATASET_COUNT	         64
+
+/*%
+ * Size of each arena block, and how many of them a message keeps
+ * across dns_message_reset().
+ */
+#define ARENA_BLOCKSIZE		4096
+#define ARENA_KEEP		4
+#define ARENA_ALIGN(x)		(((x) + 7U) & ~7U)
 
 /*%
  * Text representation of the different items, for message_totext
@@ -140,30 +143,21 @@ static const char *opcodetext[] = {
 };
 
 /*%
- * "helper" type, which consists of a block of some type, and is linkable.
- * For it to work, sizeof(dns_msgblock_t) must be a multiple of the pointer
- * size, or the allocated elements will not be aligned correctly.
+ * A block of the message arena.  Names, rdatasets, rdatas, rdatalists,
+ * offsets and scratch buffers are carved from these blocks in order, and
+ * all of them are released at once when the message is reset.  Items
+ * given back earlier go on free lists for reuse.
+ *
+ * sizeof(dns_msgblock_t) must be a multiple of 8, or the allocated
+ * items will not be aligned correctly.
  */
 struct dns_msgblock {
-	unsigned int			count;
-	unsigned int			remaining;
+	unsigned int			length;		/*%< usable bytes */
+	unsigned int			used;
 	ISC_LINK(dns_msgblock_t)	link;
 }; /* dynamically sized */
 
-static inline dns_msgblock_t *
-msgblock_allocate(isc_mem_t *, unsigned int, unsigned int);
-
-#define msgblock_get(block, type) \
-	((type *)msgblock_internalget(block, sizeof(type)))
-
-static inline void *
-msgblock_internalget(dns_msgblock_t *, unsigned int);
-
-static inline void
-msgblock_reset(dns_msgblock_t *);
-
-static inline void
-msgblock_free(isc_mem_t *, dns_msgblock_t *, unsigned int);
+#define ARENA_LENGTH	(ARENA_BLOCKSIZE - sizeof(dns_msgblock_t))
 
 static void
 logfmtpacket(dns_message_t *message, const char *description,
@@ -171,67 +165,108 @@ logfmtpacket(dns_message_t *message, const char *description,
 	     isc_logmodule_t *module, const dns_master_style_t *style,
 	     int level, isc_mem_t *mctx);
 
-/*
- * Allocate a new dns_msgblock_t, and return a pointer to it.  If no memory
- * is free, return NULL.
- */
 static inline dns_msgblock_t *
-msgblock_allocate(isc_mem_t *mctx, unsigned int sizeof_type,
-		  unsigned int count)
-{
+arena_newblock(dns_message_t *msg, unsigned int length) {
 	dns_msgblock_t *block;
-	unsigned int length;
 
-	length = sizeof(dns_msgblock_t) + (sizeof_type * count);
-
-	block = isc_mem_get(mctx, length);
+	block = isc_mem_get(msg->mctx, sizeof(dns_msgblock_t) + length);
 	if (block == NULL)
 		return (NULL);
 
-	block->count = count;
-	block->remaining = count;
-
+	block->length = length;
+	block->used = 0;
 	ISC_LINK_INIT(block, link);
 
 	return (block);
 }
 
 /*
- * Return an element from the msgblock.  If no more are available, return
- * NULL.
+ * Allocate 'size' bytes from the message arena.  If no memory is
+ * free, return NULL.
  */
 static inline void *
-msgblock_internalget(dns_msgblock_t *block, unsigned int sizeof_type) {
+arena_get(dns_message_t *msg, unsigned int size) {
+	dns_msgblock_t *block;
 	void *ptr;
 
-	if (block == NULL || block->remaining == 0)
-		return (NULL);
+	size = ARENA_ALIGN(size);
+
+	block = msg->arenacur;
+	if (block == NULL || block->length - block->used < size) {
+		if (size > ARENA_LENGTH) {
+			/*
+			 * Too big for a normal block: give it a block of
+			 * its own, which is not kept across resets.
+			 */
+			block = arena_newblock(msg, size);
+			if (block == NULL)
+				return (NULL);
+			if (msg->arenacur != NULL)
+				ISC_LIST_INSERTBEFORE(msg->arena,
+						      msg->arenacur,
+						      block, link);
+			else
+				ISC_LIST_APPEND(msg->arena, block, link);
+			block->used = size;
+			return ((unsigned char *)block +
+				sizeof(dns_msgblock_t));
+		}
 
-	block->remaining--;
+		/*
+		 * Move on to the next block kept from an earlier use of
+		 * this message, or start a new one.
+		 */
+		if (block != NULL)
+			block = ISC_LIST_NEXT(block, link);
+		if (block == NULL) {
+			block = arena_newblock(msg, ARENA_LENGTH);
+			if (block == NULL)
+				return (NULL);
+			ISC_LIST_APPEND(msg->arena, block, link);
+		}
+		msg->arenacur = block;
+	}
 
-	ptr = (((unsigned char *)block)
-	       + sizeof(dns_msgblock_t)
-	       + (sizeof_type * block->remaining));
+	ptr = (unsigned char *)block + sizeof(dns_msgblock_t) + block->used;
+	block->used += size;
 
 	return (ptr);
 }
 
-static inline void
-msgblock_reset(dns_msgblock_t *block) {
-	block->remaining = block->count;
-}
-
 /*
- * Release memory associated with a message block.
+ * Release everything allocated from the arena.  Unless 'everything' is
+ * set, up to ARENA_KEEP normal blocks are kept for reuse.
  */
-static inline void
-msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block, unsigned int sizeof_type)
-{
-	unsigned int length;
+static void
+arena_reset(dns_message_t *msg, isc_boolean_t everything) {
+	dns_msgblock_t *block, *next_block;
+	unsigned int kept = 0;
 
-	length = sizeof(dns_msgblock_t) + (sizeof_type * block->count);
+	for (block = ISC_LIST_HEAD(msg->arena);
+	     block != NULL;
+	     block = next_block)
+	{
+		next_block = ISC_LIST_NEXT(block, link);
+		if (!everything && kept < ARENA_KEEP &&
+		    block->length == ARENA_LENGTH)
+		{
+			block->used = 0;
+			kept++;
+			continue;
+		}
+		ISC_LIST_UNLINK(msg->arena, block, link);
+		isc_mem_put(msg->mctx, block,
+			    sizeof(dns_msgblock_t) + block->length);
+	}
+	msg->arenacur = ISC_LIST_HEAD(msg->arena);
 
-	isc_mem_put(mctx, block, length);
+	/*
+	 * The free lists pointed into the arena.
+	 */
+	ISC_LIST_INIT(msg->freename);
+	ISC_LIST_INIT(msg->freerdataset);
+	ISC_LIST_INIT(msg->freerdata);
+	ISC_LIST_INIT(msg->freerdatalist);
 }
 
 /*
@@ -241,14 +276,13 @@ msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block, unsigned int sizeof_type)
  */
 static inline isc_result_t
 newbuffer(dns_message_t *msg, unsigned int size) {
-	isc_result_t result;
 	isc_buffer_t *dynbuf;
 
-	dynbuf = NULL;
-	result = isc_buffer_allocate(msg->mctx, &dynbuf, size);
-	if (result != ISC_R_SUCCESS)
+	dynbuf = arena_get(msg, sizeof(isc_buffer_t) + size);
+	if (dynbuf == NULL)
 		return (ISC_R_NOMEMORY);
 
+	isc_buffer_init(dynbuf, dynbuf + 1, size);
 	ISC_LIST_APPEND(msg->scratchpad, dynbuf, link);
 	return (ISC_R_SUCCESS);
 }
@@ -270,7 +304,6 @@ releaserdata(dns_message_t *msg, dns_rdata_t *rdata) {
 
 static inline dns_rdata_t *
 newrdata(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
 	dns_rdata_t *rdata;
 
 	rdata = ISC_LIST_HEAD(msg->freerdata);
@@ -279,18 +312,9 @@ newrdata(dns_message_t *msg) {
 		return (rdata);
 	}
 
-	msgblock = ISC_LIST_TAIL(msg->rdatas);
-	rdata = msgblock_get(msgblock, dns_rdata_t);
-	if (rdata == NULL) {
-		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_rdata_t),
-					     RDATA_COUNT);
-		if (msgblock == NULL)
-			return (NULL);
-
-		ISC_LIST_APPEND(msg->rdatas, msgblock, link);
-
-		rdata = msgblock_get(msgblock, dns_rdata_t);
-	}
+	rdata = arena_get(msg, sizeof(dns_rdata_t));
+	if (rdata == NULL)
+		return (NULL);
 
 	dns_rdata_init(rdata);
 	return (rdata);
@@ -303,29 +327,14 @@ releaserdatalist(dns_message_t *msg, dns_rdatalist_t *rdatalist) {
 
 static inline dns_rdatalist_t *
 newrdatalist(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
 	dns_rdatalist_t *rdatalist;
 
 	rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
-	if (rdatalist != NULL) {
+	if (rdatalist != NULL)
 		ISC_LIST_UNLINK(msg->freerdatalist, rdatalist, link);
-		goto out;
-	}
-
-	msgblock = ISC_LIST_TAIL(msg->rdatalists);
-	rdatalist = msgblock_get(msgblock, dns_rdatalist_t);
-	if (rdatalist == NULL) {
-		msgblock = msgblock_allocate(msg->mctx,
-					     sizeof(dns_rdatalist_t),
-					     RDATALIST_COUNT);
-		if (msgblock == NULL)
-			return (NULL);
-
-		ISC_LIST_APPEND(msg->rdatalists, msgblock, link);
+	else
+		rdatalist = arena_get(msg, sizeof(dns_rdatalist_t));
 
-		rdatalist = msgblock_get(msgblock, dns_rdatalist_t);
-	}
- out:
 	if (rdatalist != NULL)
 		dns_rdatalist_init(rdatalist);
 
@@ -334,24 +343,53 @@ newrdatalist(dns_message_t *msg) {
 
 static inline dns_offsets_t *
 newoffsets(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
-	dns_offsets_t *offsets;
+	return (arena_get(msg, sizeof(dns_offsets_t)));
+}
 
-	msgblock = ISC_LIST_TAIL(msg->offsets);
-	offsets = msgblock_get(msgblock, dns_offsets_t);
-	if (offsets == NULL) {
-		msgblock = msgblock_allocate(msg->mctx,
-					     sizeof(dns_offsets_t),
-					     OFFSET_COUNT);
-		if (msgblock == NULL)
-			return (NULL);
+static inline void
+releasename(dns_message_t *msg, dns_name_t *name) {
+	INSIST(msg->names > 0);
+	msg->names--;
+	ISC_LIST_PREPEND(msg->freename, name, link);
+}
 
-		ISC_LIST_APPEND(msg->offsets, msgblock, link);
+static inline dns_name_t *
+newname(dns_message_t *msg) {
+	dns_name_t *name;
 
-		offsets = msgblock_get(msgblock, dns_offsets_t);
-	}
+	name = ISC_LIST_HEAD(msg->freename);
+	if (name != NULL)
+		ISC_LIST_UNLINK(msg->freename, name, link);
+	else
+		name = arena_get(msg, sizeof(dns_name_t));
+
+	if (name != NULL)
+		msg->names++;
 
-	return (offsets);
+	return (name);
+}
+
+static inline void
+releaserdataset(dns_message_t *msg, dns_rdataset_t *rdataset) {
+	INSIST(msg->rdatasets > 0);
+	msg->rdatasets--;
+	ISC_LIST_PREPEND(msg->freerdataset, rdataset, link);
+}
+
+static inline dns_rdataset_t *
+newrdataset(dns_message_t *msg) {
+	dns_rdataset_t *rdataset;
+
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	if (rdataset != NULL)
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+	else
+		rdataset = arena_get(msg, sizeof(dns_rdataset_t));
+
+	if (rdataset != NULL)
+		msg->rdatasets++;
+
+	return (rdataset);
 }
 
 static inline void
@@ -450,12 +488,12 @@ msgresetnames(dns_message_t *msg, unsigned int first_section) {
 
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				releaserdataset(msg, rds);
 				rds = next_rds;
 			}
 			if (dns_name_dynamic(name))
 				dns_name_free(name, msg->mctx);
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = next_name;
 		}
 	}
@@ -471,7 +509,7 @@ msgresetopt(dns_message_t *msg)
 		}
 		INSIST(dns_rdataset_isassociated(msg->opt));
 		dns_rdataset_disassociate(msg->opt);
-		isc_mempool_put(msg->rdspool, msg->opt);
+		releaserdataset(msg, msg->opt);
 		msg->opt = NULL;
 		msg->cc_ok = 0;
 		msg->cc_bad = 0;
@@ -486,36 +524,35 @@ msgresetsigs(dns_message_t *msg, isc_boolean_t replying) {
 	}
 	if (msg->tsig != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->tsig));
-		INSIST(msg->namepool != NULL);
 		if (replying) {
 			INSIST(msg->querytsig == NULL);
 			msg->querytsig = msg->tsig;
 		} else {
 			dns_rdataset_disassociate(msg->tsig);
-			isc_mempool_put(msg->rdspool, msg->tsig);
+			releaserdataset(msg, msg->tsig);
 			if (msg->querytsig != NULL) {
 				dns_rdataset_disassociate(msg->querytsig);
-				isc_mempool_put(msg->rdspool, msg->querytsig);
+				releaserdataset(msg, msg->querytsig);
 			}
 		}
 		if (dns_name_dynamic(msg->tsigname))
 			dns_name_free(msg->tsigname, msg->mctx);
-		isc_mempool_put(msg->namepool, msg->tsigname);
+		releasename(msg, msg->tsigname);
 		msg->tsig = NULL;
 		msg->tsigname = NULL;
 	} else if (msg->querytsig != NULL && !replying) {
 		dns_rdataset_disassociate(msg->querytsig);
-		isc_mempool_put(msg->rdspool, msg->querytsig);
+		releaserdataset(msg, msg->querytsig);
 		msg->querytsig = NULL;
 	}
 	if (msg->sig0 != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->sig0));
 		dns_rdataset_disassociate(msg->sig0);
-		isc_mempool_put(msg->rdspool, msg->sig0);
+		releaserdataset(msg, msg->sig0);
 		if (msg->sig0name != NULL) {
 			if (dns_name_dynamic(msg->sig0name))
 				dns_name_free(msg->sig0name, msg->mctx);
-			isc_mempool_put(msg->namepool, msg->sig0name);
+			releasename(msg, msg->sig0name);
 		}
 		msg->sig0 = NULL;
 		msg->sig0name = NULL;
@@ -528,86 +565,29 @@ msgresetsigs(dns_message_t *msg, isc_boolean_t replying) {
  */
 static void
 msgreset(dns_message_t *msg, isc_boolean_t everything) {
-	dns_msgblock_t *msgblock, *next_msgblock;
 	isc_buffer_t *dynbuf, *next_dynbuf;
-	dns_rdata_t *rdata;
-	dns_rdatalist_t *rdatalist;
+	isc_result_t result;
 
 	msgresetnames(msg, 0);
 	msgresetopt(msg);
 	msgresetsigs(msg, ISC_FALSE);
 
-	/*
-	 * Clean up linked lists.
-	 */
+	ENSURE(msg->names == 0);
+	ENSURE(msg->rdatasets == 0);
 
 	/*
-	 * Run through the free lists, and just unlink anything found there.
-	 * The memory isn't lost since these are part of message blocks we
-	 * have allocated.
+	 * The scratch buffers, and everything on the free lists, came
+	 * from the arena.
 	 */
-	rdata = ISC_LIST_HEAD(msg->freerdata);
-	while (rdata != NULL) {
-		ISC_LIST_UNLINK(msg->freerdata, rdata, link);
-		rdata = ISC_LIST_HEAD(msg->freerdata);
-	}
-	rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
-	while (rdatalist != NULL) {
-		ISC_LIST_UNLINK(msg->freerdatalist, rdatalist, link);
-		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
-	}
-
-	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
-	INSIST(dynbuf != NULL);
+	ISC_LIST_INIT(msg->scratchpad);
+	arena_reset(msg, everything);
 	if (!everything) {
-		isc_buffer_clear(dynbuf);
-		dynbuf = ISC_LIST_NEXT(dynbuf, link);
-	}
-	while (dynbuf != NULL) {
-		next_dynbuf = ISC_LIST_NEXT(dynbuf, link);
-		ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
-		isc_buffer_free(&dynbuf);
-		dynbuf = next_dynbuf;
-	}
-
-	msgblock = ISC_LIST_HEAD(msg->rdatas);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatas, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdata_t));
-		msgblock = next_msgblock;
-	}
-
-	/*
-	 * rdatalists could be empty.
-	 */
-
-	msgblock = ISC_LIST_HEAD(msg->rdatalists);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatalists, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdatalist_t));
-		msgblock = next_msgblock;
-	}
-
-	msgblock = ISC_LIST_HEAD(msg->offsets);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->offsets, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_offsets_t));
-		msgblock = next_msgblock;
+		/*
+		 * The first arena block is always kept, so this
+		 * cannot fail.
+		 */
+		result = newbuffer(msg, SCRATCHPAD_SIZE);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 
 	if (msg->tsigkey != NULL) {
@@ -650,9 +630,6 @@ msgreset(dns_message_t *msg, isc_boolean_t everything) {
 	 */
 	if (!everything)
 		msginit(msg);
-
-	ENSURE(isc_mempool_getallocated(msg->namepool) == 0);
-	ENSURE(isc_mempool_getallocated(msg->rdspool) == 0);
 }
 
 static unsigned int
@@ -699,7 +676,6 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 {
 	dns_message_t *m;
 	isc_result_t result;
-	isc_buffer_t *dynbuf;
 	unsigned int i;
 
 	REQUIRE(mctx != NULL);
@@ -729,38 +705,22 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 
 	ISC_LIST_INIT(m->scratchpad);
 	ISC_LIST_INIT(m->cleanup);
-	m->namepool = NULL;
-	m->rdspool = NULL;
-	ISC_LIST_INIT(m->rdatas);
-	ISC_LIST_INIT(m->rdatalists);
-	ISC_LIST_INIT(m->offsets);
+	ISC_LIST_INIT(m->arena);
+	m->arenacur = NULL;
+	ISC_LIST_INIT(m->freename);
+	ISC_LIST_INIT(m->freerdataset);
 	ISC_LIST_INIT(m->freerdata);
 	ISC_LIST_INIT(m->freerdatalist);
+	m->names = 0;
+	m->rdatasets = 0;
 
 	/*
 	 * Ok, it is safe to allocate (and then "goto cleanup" if failure)
 	 */
 
-	result = isc_mempool_create(m->mctx, sizeof(dns_name_t), &m->namepool);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-	isc_mempool_setfillcount(m->namepool, NAME_COUNT);
-	isc_mempool_setfreemax(m->namepool, NAME_COUNT);
-	isc_mempool_setname(m->namepool, "msg:names");
-
-	result = isc_mempool_create(m->mctx, sizeof(dns_rdataset_t),
-				    &m->rdspool);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-	isc_mempool_setfillcount(m->rdspool, RDATASET_COUNT);
-	isc_mempool_setfreemax(m->rdspool, RDATASET_COUNT);
-	isc_mempool_setname(m->rdspool, "msg:rdataset");
-
-	dynbuf = NULL;
-	result = isc_buffer_allocate(mctx, &dynbuf, SCRATCHPAD_SIZE);
+	result = newbuffer(m, SCRATCHPAD_SIZE);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
-	ISC_LIST_APPEND(m->scratchpad, dynbuf, link);
 
 	m->cctx = NULL;
 
@@ -771,17 +731,9 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 	 * Cleanup for error returns.
 	 */
  cleanup:
-	dynbuf = ISC_LIST_HEAD(m->scratchpad);
-	if (dynbuf != NULL) {
-		ISC_LIST_UNLINK(m->scratchpad, dynbuf, link);
-		isc_buffer_free(&dynbuf);
-	}
-	if (m->namepool != NULL)
-		isc_mempool_destroy(&m->namepool);
-	if (m->rdspool != NULL)
-		isc_mempool_destroy(&m->rdspool);
+	arena_reset(m, ISC_TRUE);
 	m->magic = 0;
-	isc_mem_putanddetach(&mctx, m, sizeof(dns_message_t));
+	isc_mem_putanddetach(&m->mctx, m, sizeof(dns_message_t));
 
 	return (ISC_R_NOMEMORY);
 }
@@ -807,8 +759,6 @@ dns_message_destroy(dns_message_t **msgp) {
 	*msgp = NULL;
 
 	msgreset(msg, ISC_TRUE);
-	isc_mempool_destroy(&msg->namepool);
-	isc_mempool_destroy(&msg->rdspool);
 	msg->magic = 0;
 	isc_mem_putanddetach(&msg->mctx, msg, sizeof(dns_message_t));
 }
@@ -1010,7 +960,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	rdatalist = NULL;
 
 	for (count = 0; count < msg->counts[DNS_SECTION_QUESTION]; count++) {
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = ISC_TRUE;
@@ -1055,7 +1005,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			ISC_LIST_APPEND(*section, name, link);
 			free_name = ISC_FALSE;
 		} else {
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = name2;
 			name2 = NULL;
 			free_name = ISC_FALSE;
@@ -1103,7 +1053,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
 		}
-		rdataset =  isc_mempool_get(msg->rdspool);
+		rdataset =  newrdataset(msg);
 		if (rdataset == NULL) {
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
@@ -1134,14 +1084,14 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
  cleanup:
 	if (rdataset != NULL) {
 		INSIST(!dns_rdataset_isassociated(rdataset));
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 	}
 #if 0
 	if (rdatalist != NULL)
 		isc_mempool_put(msg->rdlpool, rdatalist);
 #endif
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 
 	return (result);
 }
@@ -1248,7 +1198,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		skip_type_search = ISC_FALSE;
 		free_rdataset = ISC_FALSE;
 
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = ISC_TRUE;
@@ -1478,7 +1428,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			 * If it is a new name, append to the section.
 			 */
 			if (result == ISC_R_SUCCESS) {
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 				name = name2;
 			} else {
 				ISC_LIST_APPEND(*section, name, link);
@@ -1530,7 +1480,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		}
 
 		if (result == ISC_R_NOTFOUND) {
-			rdataset = isc_mempool_get(msg->rdspool);
+			rdataset = newrdataset(msg);
 			if (rdataset == NULL) {
 				result = ISC_R_NOMEMORY;
 				goto cleanup;
@@ -1599,7 +1549,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 				((msg->opt->ttl & DNS_MESSAGE_EDNSRCODE_MASK)
 				 >> 20);
 			msg->rcode |= ercode;
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			free_name = ISC_FALSE;
 		} else if (issigzero && msg->sig0 == NULL) {
 			msg->sig0 = rdataset;
@@ -1619,9 +1569,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
 		if (seen_problem) {
 			if (free_name)
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 			if (free_rdataset)
-				isc_mempool_put(msg->rdspool, rdataset);
+				releaserdataset(msg, rdataset);
 			free_name = free_rdataset = ISC_FALSE;
 		}
 		INSIST(free_name == ISC_FALSE);
@@ -1647,9 +1597,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
  cleanup:
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 	if (free_rdataset)
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 
 	return (result);
 }
@@ -2198,6 +2148,28 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, dns_section_t sectionid,
+		      const isc_region_t *region, unsigned int count)
+{
+	isc_region_t r;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(region != NULL);
+
+	isc_buffer_availableregion(msg->buffer, &r);
+	if (r.length < msg->reserved ||
+	    r.length - msg->reserved < region->length)
+		return (ISC_R_NOSPACE);
+
+	isc_buffer_putmem(msg->buffer, region->base, region->length);
+	msg->counts[sectionid] += count;
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	isc_uint16_t tmp;
@@ -2570,7 +2542,7 @@ dns_message_gettempname(dns_message_t *msg, dns_name_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->namepool);
+	*item = newname(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 	dns_name_init(*item, NULL);
@@ -2607,7 +2579,7 @@ dns_message_gettemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->rdspool);
+	*item = newrdataset(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 
@@ -2641,7 +2613,7 @@ dns_message_puttempname(dns_message_t *msg, dns_name_t **itemp) {
 	*itemp = NULL;
 	if (dns_name_dynamic(item))
 		dns_name_free(item, msg->mctx);
-	isc_mempool_put(msg->namepool, item);
+	releasename(msg, item);
 }
 
 void
@@ -2659,7 +2631,7 @@ dns_message_puttemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(item != NULL && *item != NULL);
 
 	REQUIRE(!dns_rdataset_isassociated(*item));
-	isc_mempool_put(msg->rdspool, *item);
+	releaserdataset(msg, *item);
 	*item = NULL;
 }
 
@@ -19,11 +19,13 @@
 
 #include <isc/crc64.h>
 #include <isc/file.h>
+#include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/socket.h>
 #include <isc/stdio.h>
@@ -69,6 +71,14 @@
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
 #endif
 
+/*%
+ * When the hash table grows, the buckets of the old table are moved
+ * into the new one a few at a time, by each subsequent insertion or
+ * deletion, instead of all at once.  This is the number of old
+ * buckets migrated per update.
+ */
+#define RBT_HASH_MIGRATE        16
+
 struct dns_rbt {
 	unsigned int		magic;
 	isc_mem_t *		mctx;
@@ -78,6 +88,15 @@ struct dns_rbt {
 	unsigned int		nodecount;
 	size_t			hashsize;
 	dns_rbtnode_t **	hashtable;
+	/*
+	 * While a resize is in progress, the previous table stays live:
+	 * buckets below 'hashiter' have been migrated to 'hashtable',
+	 * the rest are still in 'oldhashtable'.
+	 */
+	size_t			oldhashsize;
+	dns_rbtnode_t **	oldhashtable;
+	size_t			hashiter;
+	isc_uint32_t		hashseed;
 	void *			mmap_location;
 };
 
@@ -110,6 +129,10 @@ struct file_header {
 	unsigned int rdataset_fixed:1;	/* compiled with --enable-rrset-fixed */
 	unsigned int nodecount;		/* shadow from rbt structure */
 	isc_uint64_t crc;
+	isc_uint64_t linkbase;		/* address the image was laid out for */
+	isc_uint32_t hashseed;		/* shadow from rbt structure */
+	isc_uint64_t hashsize;		/* number of hash buckets */
+	isc_uint64_t hashtable;		/* offset of the hash buckets */
 	char version2[32];  		/* repeated; must match version1 */
 };
 
@@ -118,13 +141,18 @@ struct file_header {
  *
  * step one: write out a zeroed header of 1024 bytes
  * step two: walk the tree in a depth-first, left-right-down order, writing
- * out the nodes, reserving space as we go, correcting addresses to point
- * at the proper offset in the file, and setting a flag for each pointer to
- * indicate that it is a reference to a location in the file, rather than in
- * memory.
- * step three: write out the header, adding the information that will be
+ * out the nodes, reserving space as we go, and setting each pointer to
+ * the address it will have if the file is mapped at 'linkbase'.
+ * step three: write out the hash buckets the nodes were chained into as
+ * they were written.
+ * step four: write out the header, adding the information that will be
  * needed to re-create the tree object itself.
  *
+ * When the image is mapped at 'linkbase' it can be used as it is, without
+ * writing to it, so its pages stay shared with the page cache and with
+ * any other process that maps the same file.  Otherwise every pointer is
+ * rebased as the tree is read in.
+ *
  * The RBTDB object will do this three times, once for each of the three
  * RBT objects it contains.
  *
@@ -137,64 +165,39 @@ dns_rbt_zero_header(FILE *file);
 
 static isc_result_t
 write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
-	     isc_uint64_t crc);
+	     isc_uint64_t crc, uintptr_t linkbase, isc_uint64_t hashsize,
+	     isc_uint64_t hashtable);
 
 static isc_boolean_t
 match_header_version(file_header_t *header);
 
-static isc_result_t
-serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
-	       uintptr_t right, uintptr_t down, uintptr_t parent,
-	       uintptr_t data, isc_uint64_t *crc);
-
-static isc_result_t
-serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
-		uintptr_t *where, isc_uint64_t *crc);
 /*
- * The following functions allow you to get the actual address of a pointer
- * without having to use an if statement to check to see if that address is
- * relative or not
+ * State kept while an RBT image is being written out.
  */
-static inline dns_rbtnode_t *
-getparent(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->parent);
-	adjusted_address += node->parent_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getleft(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->left);
-	adjusted_address += node->left_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getright(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->right);
-	adjusted_address += node->right_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getdown(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->down);
-	adjusted_address += node->down_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
+typedef struct serialize_ctx {
+	FILE *			file;
+	dns_rbtdatawriter_t	datawriter;
+	void *			writer_arg;
+	uintptr_t		linkbase;
+	isc_uint64_t		crc;
+#ifdef DNS_RBT_USEHASH
+	isc_mem_t *		mctx;
+	size_t			hashsize;
+	off_t *			hashtable;	/* file offsets of chain heads */
+#endif
+} serialize_ctx_t;
 
-static inline dns_rbtnode_t *
-getdata(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->data);
-	adjusted_address += node->data_is_relative * (uintptr_t)header;
+/*
+ * The address a file offset will have when the image is mapped at
+ * the context's link base.  Offset zero is the NULL pointer.
+ */
+#define LINKPTR(ctx, off) \
+	((off) == 0 ? NULL : (void *)((ctx)->linkbase + (uintptr_t)(off)))
 
-	return ((dns_rbtnode_t *)adjusted_address);
-}
+static isc_result_t
+serialize_node(serialize_ctx_t *ctx, dns_rbtnode_t *node, off_t left,
+	       off_t right, off_t down, off_t parent, off_t upper,
+	       off_t data, off_t location);
 
 /*%
  * Elements of the rbtnode structure.
@@ -354,25 +357,18 @@ get_upper_node(dns_rbtnode_t *node) {
 	return (UPPERNODE(node));
 }
 
-static void
-fixup_uppernodes_helper(dns_rbtnode_t *node, dns_rbtnode_t *uppernode) {
-	if (node == NULL)
-		return;
-
-	UPPERNODE(node) = uppernode;
-
-	fixup_uppernodes_helper(LEFT(node), uppernode);
-	fixup_uppernodes_helper(RIGHT(node), uppernode);
-	fixup_uppernodes_helper(DOWN(node), node);
-}
-
 /*
- * This function is used to fixup uppernode members of all dns_rbtnodes
- * after deserialization.
+ * Hash a name with the tree's own seed.  The seed is saved in map
+ * images, so the hash values stored in their nodes stay valid when
+ * they are read back in.
  */
-static void
-fixup_uppernodes(dns_rbt_t *rbt) {
-	fixup_uppernodes_helper(rbt->root, NULL);
+static inline unsigned int
+rbt_hash(dns_rbt_t *rbt, const dns_name_t *name) {
+	if (name->labels == 0)
+		return (0);
+
+	return (isc_hash_function_reverse(name->ndata, name->length,
+					  ISC_FALSE, &rbt->hashseed));
 }
 
 #else
@@ -431,6 +427,9 @@ static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node);
 static void
 rehash(dns_rbt_t *rbt, unsigned int newcount);
+static inline dns_rbtnode_t *
+hash_lookup(dns_rbt_t *rbt, unsigned int hash, dns_rbtnode_t *up,
+	    const dns_name_t *name);
 #else
 #define hash_node(rbt, node, name)
 #define unhash_node(rbt, node)
@@ -450,7 +449,7 @@ static void
 deletefromlevel(dns_rbtnode_t *item, dns_rbtnode_t **rootp);
 
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t size,
+treefix(dns_rbt_t *rbt, void *base, size_t size, uintptr_t linkbase,
 	dns_rbtnode_t *n, const dns_name_t *name,
 	dns_rbtdatafixer_t datafixer, void *fixer_arg,
 	isc_uint64_t *crc);
@@ -508,7 +507,8 @@ init_file_version(void) {
  */
 static isc_result_t
 write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
-	     isc_uint64_t crc)
+	     isc_uint64_t crc, uintptr_t linkbase, isc_uint64_t hashsize,
+	     isc_uint64_t hashtable)
 {
 	file_header_t header;
 	isc_result_t result;
@@ -532,6 +532,10 @@ write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
 	header.nodecount = rbt->nodecount;
 
 	header.crc = crc;
+	header.linkbase = linkbase;
+	header.hashseed = rbt->hashseed;
+	header.hashsize = hashsize;
+	header.hashtable = hashtable;
 
 	CHECK(isc_stdio_tell(file, &location));
 	location = dns_rbt_serialize_align(location);
@@ -562,66 +566,57 @@ match_header_version(file_header_t *header) {
 }
 
 static isc_result_t
-serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
-	       uintptr_t right, uintptr_t down, uintptr_t parent,
-	       uintptr_t data, isc_uint64_t *crc)
+serialize_node(serialize_ctx_t *ctx, dns_rbtnode_t *node, off_t left,
+	       off_t right, off_t down, off_t parent, off_t upper,
+	       off_t data, off_t location)
 {
 	dns_rbtnode_t temp_node;
-	off_t file_position;
 	unsigned char *node_data;
 	size_t datasize;
 	isc_result_t result;
+#ifdef DNS_RBT_USEHASH
+	size_t bucket;
+#endif
 #ifdef DEBUG
 	dns_name_t nodename;
 #endif
 
 	INSIST(node != NULL);
 
-	CHECK(isc_stdio_tell(file, &file_position));
-	file_position = dns_rbt_serialize_align(file_position);
-	CHECK(isc_stdio_seek(file, file_position, SEEK_SET));
+	CHECK(isc_stdio_seek(ctx->file, location, SEEK_SET));
 
+	/*
+	 * Every pointer is written as the address it will have when
+	 * the image is mapped at the link base.
+	 */
 	temp_node = *node;
-	temp_node.down_is_relative = 0;
-	temp_node.left_is_relative = 0;
-	temp_node.right_is_relative = 0;
-	temp_node.parent_is_relative = 0;
-	temp_node.data_is_relative = 0;
 	temp_node.is_mmapped = 1;
+	temp_node.parent = LINKPTR(ctx, parent);
+	temp_node.left = LINKPTR(ctx, left);
+	temp_node.right = LINKPTR(ctx, right);
+	temp_node.down = LINKPTR(ctx, down);
+	temp_node.data = LINKPTR(ctx, data);
+	ISC_LINK_INIT(&temp_node, deadlink);
 
+#ifdef DNS_RBT_USEHASH
 	/*
-	 * If the next node is not NULL, calculate the next node's location
-	 * in the file.  Note that this will have to change when the data
-	 * structure changes, and it also assumes that we always write the
-	 * nodes out in list order (which we currently do.)
-	*/
-	if (temp_node.parent != NULL) {
-		temp_node.parent = (dns_rbtnode_t *)(parent);
-		temp_node.parent_is_relative = 1;
-	}
-	if (temp_node.left != NULL) {
-		temp_node.left = (dns_rbtnode_t *)(left);
-		temp_node.left_is_relative = 1;
-	}
-	if (temp_node.right != NULL) {
-		temp_node.right = (dns_rbtnode_t *)(right);
-		temp_node.right_is_relative = 1;
-	}
-	if (temp_node.down != NULL) {
-		temp_node.down = (dns_rbtnode_t *)(down);
-		temp_node.down_is_relative = 1;
-	}
-	if (temp_node.data != NULL) {
-		temp_node.data = (dns_rbtnode_t *)(data);
-		temp_node.data_is_relative = 1;
-	}
+	 * Nodes are pushed onto the front of their hash chains in the
+	 * order they are written.
+	 */
+	temp_node.uppernode = LINKPTR(ctx, upper);
+	bucket = HASHVAL(node) % ctx->hashsize;
+	temp_node.hashnext = LINKPTR(ctx, ctx->hashtable[bucket]);
+	ctx->hashtable[bucket] = location;
+#else
+	UNUSED(upper);
+#endif
 
 	node_data = (unsigned char *) node + sizeof(dns_rbtnode_t);
 	datasize = NODE_SIZE(node) - sizeof(dns_rbtnode_t);
 
 	CHECK(isc_stdio_write(&temp_node, 1, sizeof(dns_rbtnode_t),
-			      file, NULL));
-	CHECK(isc_stdio_write(node_data, 1, datasize, file, NULL));
+			      ctx->file, NULL));
+	CHECK(isc_stdio_write(node_data, 1, datasize, ctx->file, NULL));
 
 #ifdef DEBUG
 	dns_name_init(&nodename, NULL);
@@ -634,20 +629,23 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	hexdump("node data", node_data, datasize);
 #endif
 
-	isc_crc64_update(crc, (const isc_uint8_t *) &temp_node,
+	isc_crc64_update(&ctx->crc, (const isc_uint8_t *) &temp_node,
 			 sizeof(dns_rbtnode_t));
-	isc_crc64_update(crc, (const isc_uint8_t *) node_data, datasize);
+	isc_crc64_update(&ctx->crc, (const isc_uint8_t *) node_data, datasize);
 
  cleanup:
 	return (result);
 }
 
+/*
+ * 'upper' is the file offset of the node whose down pointer leads to
+ * the level 'node' is on.
+ */
 static isc_result_t
-serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
-		uintptr_t *where, isc_uint64_t *crc)
+serialize_nodes(serialize_ctx_t *ctx, dns_rbtnode_t *node, off_t parent,
+		off_t upper, off_t *where)
 {
-	uintptr_t left = 0, right = 0, down = 0, data = 0;
+	off_t left = 0, right = 0, down = 0, data = 0;
 	off_t location = 0, offset_adjust;
 	isc_result_t result;
 
@@ -658,12 +656,12 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	}
 
 	/* Reserve space for current node. */
-	CHECK(isc_stdio_tell(file, &location));
+	CHECK(isc_stdio_tell(ctx->file, &location));
 	location = dns_rbt_serialize_align(location);
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
+	CHECK(isc_stdio_seek(ctx->file, location, SEEK_SET));
 
 	offset_adjust = dns_rbt_serialize_align(location + NODE_SIZE(node));
-	CHECK(isc_stdio_seek(file, offset_adjust, SEEK_SET));
+	CHECK(isc_stdio_seek(ctx->file, offset_adjust, SEEK_SET));
 
 	/*
 	 * Serialize the rest of the tree.
@@ -671,40 +669,65 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	 * WARNING: A change in the order (from left, right, down)
 	 * will break the way the crc hash is computed.
 	 */
-	CHECK(serialize_nodes(file, getleft(node, NULL), location,
-			      datawriter, writer_arg, &left, crc));
-	CHECK(serialize_nodes(file, getright(node, NULL), location,
-			      datawriter, writer_arg, &right, crc));
-	CHECK(serialize_nodes(file, getdown(node, NULL), location,
-			      datawriter, writer_arg, &down, crc));
+	CHECK(serialize_nodes(ctx, LEFT(node), location, upper, &left));
+	CHECK(serialize_nodes(ctx, RIGHT(node), location, upper, &right));
+	CHECK(serialize_nodes(ctx, DOWN(node), location, location, &down));
 
 	if (node->data != NULL) {
-		off_t ret;
-
-		CHECK(isc_stdio_tell(file, &ret));
-		ret = dns_rbt_serialize_align(ret);
-		CHECK(isc_stdio_seek(file, ret, SEEK_SET));
-		data = ret;
-
-		datawriter(file, node->data, writer_arg, crc);
+		CHECK(isc_stdio_tell(ctx->file, &data));
+		data = dns_rbt_serialize_align(data);
+		CHECK(isc_stdio_seek(ctx->file, data, SEEK_SET));
+
+		CHECK(ctx->datawriter(ctx->file, node->data, ctx->writer_arg,
+				      ctx->linkbase,
+				      ctx->linkbase + (uintptr_t)location,
+				      &ctx->crc));
 	}
 
-	/* Seek back to reserved space. */
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
-
 	/* Serialize the current node. */
-	CHECK(serialize_node(file, node, left, right, down, parent, data, crc));
+	CHECK(serialize_node(ctx, node, left, right, down, parent, upper,
+			     data, location));
 
 	/* Ensure we are always at the end of the file. */
-	CHECK(isc_stdio_seek(file, 0, SEEK_END));
+	CHECK(isc_stdio_seek(ctx->file, 0, SEEK_END));
 
 	if (where != NULL)
-		*where = (uintptr_t) location;
+		*where = location;
 
  cleanup:
 	return (result);
 }
 
+#ifdef DNS_RBT_USEHASH
+/*
+ * Write out the hash buckets built up by serialize_node(), returning
+ * their offset in '*where'.
+ */
+static isc_result_t
+serialize_hash(serialize_ctx_t *ctx, off_t *where) {
+	isc_result_t result;
+	off_t location;
+	size_t i;
+	void *ptr;
+
+	CHECK(isc_stdio_tell(ctx->file, &location));
+	location = dns_rbt_serialize_align(location);
+	CHECK(isc_stdio_seek(ctx->file, location, SEEK_SET));
+
+	for (i = 0; i < ctx->hashsize; i++) {
+		ptr = LINKPTR(ctx, ctx->hashtable[i]);
+		CHECK(isc_stdio_write(&ptr, 1, sizeof(ptr), ctx->file, NULL));
+		isc_crc64_update(&ctx->crc, (const isc_uint8_t *) &ptr,
+				 sizeof(ptr));
+	}
+
+	*where = location;
+
+ cleanup:
+	return (result);
+}
+#endif /* DNS_RBT_USEHASH */
+
 off_t
 dns_rbt_serialize_align(off_t target) {
 	off_t offset = target % 8;
@@ -718,17 +741,45 @@ dns_rbt_serialize_align(off_t target) {
 isc_result_t
 dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 		       dns_rbtdatawriter_t datawriter,
-		       void *writer_arg, off_t *offset)
+		       void *writer_arg, isc_uint64_t linkbase, off_t *offset)
 {
 	isc_result_t result;
 	off_t header_position, node_position, end_position;
-	isc_uint64_t crc;
+	off_t hashtable = 0;
+	serialize_ctx_t ctx;
 
 	REQUIRE(file != NULL);
+	REQUIRE(datawriter != NULL);
+	REQUIRE(linkbase % 8 == 0);
+
+	if ((uintptr_t)linkbase != linkbase)
+		return (ISC_R_RANGE);
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.file = file;
+	ctx.datawriter = datawriter;
+	ctx.writer_arg = writer_arg;
+	ctx.linkbase = (uintptr_t)linkbase;
+
+#ifdef DNS_RBT_USEHASH
+	/*
+	 * Size the image's hash table the way hash_node() would have
+	 * grown it for this many nodes.
+	 */
+	ctx.mctx = rbt->mctx;
+	ctx.hashsize = RBT_HASH_SIZE;
+	while (rbt->nodecount >= ctx.hashsize * 3)
+		ctx.hashsize = ctx.hashsize * 2 + 1;
+	ctx.hashtable = isc_mem_get(ctx.mctx,
+				    ctx.hashsize * sizeof(off_t));
+	if (ctx.hashtable == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(ctx.hashtable, 0, ctx.hashsize * sizeof(off_t));
+#endif
 
 	CHECK(isc_file_isplainfilefd(fileno(file)));
 
-	isc_crc64_init(&crc);
+	isc_crc64_init(&ctx.crc);
 
 	CHECK(isc_stdio_tell(file, &header_position));
 
@@ -737,30 +788,43 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 
 	/* Serialize nodes */
 	CHECK(isc_stdio_tell(file, &node_position));
-	CHECK(serialize_nodes(file, rbt->root, 0, datawriter,
-			      writer_arg, NULL, &crc));
+	CHECK(serialize_nodes(&ctx, rbt->root, 0, 0, NULL));
 
 	CHECK(isc_stdio_tell(file, &end_position));
 	if (node_position == end_position) {
 		CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
 		*offset = 0;
-		return (ISC_R_SUCCESS);
+		goto cleanup;
 	}
 
-	isc_crc64_final(&crc);
+#ifdef DNS_RBT_USEHASH
+	CHECK(serialize_hash(&ctx, &hashtable));
+#endif
+
+	isc_crc64_final(&ctx.crc);
 #ifdef DEBUG
-	hexdump("serializing CRC", (unsigned char *)&crc, sizeof(crc));
+	hexdump("serializing CRC", (unsigned char *)&ctx.crc,
+		sizeof(ctx.crc));
 #endif
 
 	/* Serialize header */
 	CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
-	CHECK(write_header(file, rbt, HEADER_LENGTH, crc));
+	CHECK(write_header(file, rbt, HEADER_LENGTH, ctx.crc, ctx.linkbase,
+#ifdef DNS_RBT_USEHASH
+			   ctx.hashsize,
+#else
+			   0,
+#endif
+			   hashtable));
 
 	/* Ensure we are always at the end of the file. */
 	CHECK(isc_stdio_seek(file, 0, SEEK_END));
 	*offset = dns_rbt_serialize_align(header_position);
 
  cleanup:
+#ifdef DNS_RBT_USEHASH
+	isc_mem_put(ctx.mctx, ctx.hashtable, ctx.hashsize * sizeof(off_t));
+#endif
 	return (result);
 }
 
@@ -771,10 +835,26 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 	} \
 } while(0);
 
+/*
+ * Rebase a pointer written for 'linkbase' onto the actual mapping at
+ * 'base', checking that it lands no further than 'max' bytes in.
+ * Nothing is written when the pointer is already correct, so an image
+ * mapped at its link base is left untouched.
+ */
+#define RELOCATE(field, type, max) do { \
+	uintptr_t off_ = (uintptr_t)(field) - linkbase; \
+	type *ptr_; \
+	CONFIRM(off_ <= (uintptr_t)(max) && off_ % 8 == 0); \
+	ptr_ = (type *)((char *)base + off_); \
+	if ((field) != ptr_) \
+		(field) = ptr_; \
+} while (0)
+
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
-	const dns_name_t *name, dns_rbtdatafixer_t datafixer,
-	void *fixer_arg, isc_uint64_t *crc)
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, uintptr_t linkbase,
+	dns_rbtnode_t *n, const dns_name_t *name,
+	dns_rbtdatafixer_t datafixer, void *fixer_arg,
+	isc_uint64_t *crc)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_fixedname_t fixed;
@@ -787,8 +867,9 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 		return (ISC_R_SUCCESS);
 
 	CONFIRM((void *) n >= base);
-	CONFIRM((char *) n - (char *) base <= (int) nodemax);
+	CONFIRM((size_t)((char *) n - (char *) base) <= nodemax);
 	CONFIRM(DNS_RBTNODE_VALID(n));
+	CONFIRM(n->is_mmapped == 1);
 
 	dns_name_init(&nodename, NULL);
 	NODENAME(n, &nodename);
@@ -805,63 +886,61 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	/* memorize header contents prior to fixup */
 	memmove(&header, n, sizeof(header));
 
-	if (n->left_is_relative) {
-		CONFIRM(n->left <= (dns_rbtnode_t *) nodemax);
-		n->left = getleft(n, rbt->mmap_location);
-		n->left_is_relative = 0;
+	if (n->left != NULL) {
+		RELOCATE(n->left, dns_rbtnode_t, nodemax);
+		CONFIRM(n->left > n);
 		CONFIRM(DNS_RBTNODE_VALID(n->left));
-	} else
-		CONFIRM(n->left == NULL);
+	}
 
-	if (n->right_is_relative) {
-		CONFIRM(n->right <= (dns_rbtnode_t *) nodemax);
-		n->right = getright(n, rbt->mmap_location);
-		n->right_is_relative = 0;
+	if (n->right != NULL) {
+		RELOCATE(n->right, dns_rbtnode_t, nodemax);
+		CONFIRM(n->right > n);
 		CONFIRM(DNS_RBTNODE_VALID(n->right));
-	} else
-		CONFIRM(n->right == NULL);
+	}
 
-	if (n->down_is_relative) {
-		CONFIRM(n->down <= (dns_rbtnode_t *) nodemax);
-		n->down = getdown(n, rbt->mmap_location);
-		n->down_is_relative = 0;
-		CONFIRM(n->down > (dns_rbtnode_t *) n);
+	if (n->down != NULL) {
+		RELOCATE(n->down, dns_rbtnode_t, nodemax);
+		CONFIRM(n->down > n);
 		CONFIRM(DNS_RBTNODE_VALID(n->down));
-	} else
-		CONFIRM(n->down == NULL);
+	}
 
-	if (n->parent_is_relative) {
-		CONFIRM(n->parent <= (dns_rbtnode_t *) nodemax);
-		n->parent = getparent(n, rbt->mmap_location);
-		n->parent_is_relative = 0;
-		CONFIRM(n->parent < (dns_rbtnode_t *) n);
+	if (n->parent != NULL) {
+		RELOCATE(n->parent, dns_rbtnode_t, nodemax);
+		CONFIRM(n->parent < n);
 		CONFIRM(DNS_RBTNODE_VALID(n->parent));
-	} else
-		CONFIRM(n->parent == NULL);
+	}
 
-	if (n->data_is_relative) {
-		CONFIRM(n->data <= (void *) filesize);
-		n->data = getdata(n, rbt->mmap_location);
-		n->data_is_relative = 0;
+	if (n->data != NULL) {
+		RELOCATE(n->data, void, filesize);
 		CONFIRM(n->data > (void *) n);
-	} else
-		CONFIRM(n->data == NULL);
+	}
 
-	hash_node(rbt, n, fullname);
+#ifdef DNS_RBT_USEHASH
+	if (n->uppernode != NULL) {
+		RELOCATE(n->uppernode, dns_rbtnode_t, nodemax);
+		CONFIRM(n->uppernode < n);
+	}
+
+	/*
+	 * The chains are checked as a whole by deserialize_hash().
+	 */
+	if (n->hashnext != NULL)
+		RELOCATE(n->hashnext, dns_rbtnode_t, nodemax);
+#endif
 
 	/* a change in the order (from left, right, down) will break hashing*/
 	if (n->left != NULL)
-		CHECK(treefix(rbt, base, filesize, n->left, name,
+		CHECK(treefix(rbt, base, filesize, linkbase, n->left, name,
 			      datafixer, fixer_arg, crc));
 	if (n->right != NULL)
-		CHECK(treefix(rbt, base, filesize, n->right, name,
+		CHECK(treefix(rbt, base, filesize, linkbase, n->right, name,
 			      datafixer, fixer_arg, crc));
 	if (n->down != NULL)
-		CHECK(treefix(rbt, base, filesize, n->down, fullname,
-			      datafixer, fixer_arg, crc));
+		CHECK(treefix(rbt, base, filesize, linkbase, n->down,
+			      fullname, datafixer, fixer_arg, crc));
 
 	if (datafixer != NULL && n->data != NULL)
-		CHECK(datafixer(n, base, filesize, fixer_arg, crc));
+		CHECK(datafixer(n, base, filesize, linkbase, fixer_arg, crc));
 
 	rbt->nodecount++;
 	node_data = (unsigned char *) n + sizeof(dns_rbtnode_t);
@@ -884,6 +963,68 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	return (result);
 }
 
+#ifdef DNS_RBT_USEHASH
+/*
+ * Adopt the hash table stored in the image, after checking that every
+ * node is reachable from exactly the bucket its hash value selects.
+ */
+static isc_result_t
+deserialize_hash(dns_rbt_t *rbt, void *base, size_t filesize,
+		 uintptr_t linkbase, file_header_t *header, isc_uint64_t *crc)
+{
+	isc_result_t result = ISC_R_SUCCESS;
+	size_t nodemax = filesize - sizeof(dns_rbtnode_t);
+	dns_rbtnode_t **table = NULL, **image, *n;
+	size_t i, size, bytes = 0;
+	unsigned int count = 0;
+
+	size = (size_t)header->hashsize;
+	CONFIRM(size > 0 && header->hashsize == size);
+	CONFIRM(size <= filesize / sizeof(*image));
+	bytes = size * sizeof(*image);
+	CONFIRM(header->hashtable % 8 == 0);
+	CONFIRM(header->hashtable <= filesize - bytes);
+
+	image = (dns_rbtnode_t **)((char *)base + header->hashtable);
+	isc_crc64_update(crc, (const isc_uint8_t *) image, bytes);
+
+	table = isc_mem_get(rbt->mctx, bytes);
+	if (table == NULL)
+		return (ISC_R_NOMEMORY);
+
+	for (i = 0; i < size; i++) {
+		table[i] = image[i];
+		if (table[i] != NULL)
+			RELOCATE(table[i], dns_rbtnode_t, nodemax);
+		for (n = table[i]; n != NULL; n = HASHNEXT(n)) {
+			/*
+			 * A damaged chain may lead to a node treefix()
+			 * never saw, whose pointers were not rebased.
+			 */
+			CONFIRM((void *) n >= base);
+			CONFIRM((size_t)((char *) n - (char *) base) <= nodemax);
+			CONFIRM(((char *) n - (char *) base) % 8 == 0);
+			CONFIRM(DNS_RBTNODE_VALID(n));
+			CONFIRM(n->is_mmapped == 1);
+			CONFIRM(HASHVAL(n) % size == i);
+			CONFIRM(++count <= rbt->nodecount);
+		}
+	}
+	CONFIRM(count == rbt->nodecount);
+
+	isc_mem_put(rbt->mctx, rbt->hashtable,
+		    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	rbt->hashtable = table;
+	rbt->hashsize = size;
+	table = NULL;
+
+ cleanup:
+	if (table != NULL)
+		isc_mem_put(rbt->mctx, table, bytes);
+	return (result);
+}
+#endif /* DNS_RBT_USEHASH */
+
 isc_result_t
 dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 off_t header_offset, isc_mem_t *mctx,
@@ -896,6 +1037,7 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 	dns_rbt_t *rbt = NULL;
 	isc_uint64_t crc;
 	unsigned int host_big_endian;
+	uintptr_t linkbase;
 
 	REQUIRE(originp == NULL || *originp == NULL);
 	REQUIRE(rbtp != NULL && *rbtp == NULL);
@@ -936,6 +1078,13 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		goto cleanup;
 	}
 
+	linkbase = (uintptr_t)header->linkbase;
+	if (header->linkbase != linkbase || linkbase % 8 != 0) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+	rbt->hashseed = header->hashseed;
+
 	/* Copy other data items from the header into our rbt. */
 	rbt->root = (dns_rbtnode_t *)((char *)base_address +
 				header_offset + header->first_node_offset);
@@ -944,11 +1093,20 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		result = ISC_R_INVALIDFILE;
 		goto cleanup;
 	}
-	rehash(rbt, header->nodecount);
 
-	CHECK(treefix(rbt, base_address, filesize, rbt->root,
+	CHECK(treefix(rbt, base_address, filesize, linkbase, rbt->root,
 		      dns_rootname, datafixer, fixer_arg, &crc));
 
+	if (header->nodecount != rbt->nodecount) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+
+#ifdef DNS_RBT_USEHASH
+	CHECK(deserialize_hash(rbt, base_address, filesize, linkbase,
+			       header, &crc));
+#endif /* DNS_RBT_USEHASH */
+
 	isc_crc64_final(&crc);
 #ifdef DEBUG
 	hexdump("deserializing CRC", (unsigned char *)&crc, sizeof(crc));
@@ -960,15 +1118,6 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		goto cleanup;
 	}
 
-	if (header->nodecount != rbt->nodecount) {
-		result = ISC_R_INVALIDFILE;
-		goto cleanup;
-	}
-
-#ifdef DNS_RBT_USEHASH
-	fixup_uppernodes(rbt);
-#endif /* DNS_RBT_USEHASH */
-
 	*rbtp = rbt;
 	if (originp != NULL)
 		*originp = rbt->root;
@@ -1011,6 +1160,10 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter,
 	rbt->nodecount = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	rbt->oldhashtable = NULL;
+	rbt->oldhashsize = 0;
+	rbt->hashiter = 0;
+	isc_random_get(&rbt->hashseed);
 	rbt->mmap_location = NULL;
 
 #ifdef DNS_RBT_USEHASH
@@ -1055,6 +1208,9 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	if (rbt->oldhashtable != NULL)
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
 
 	rbt->magic = 0;
 
@@ -1612,38 +1768,12 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 						  nlabels - tlabels,
 						  hlabels + tlabels,
 						  &hash_name);
-			hash = dns_name_fullhash(&hash_name, ISC_FALSE);
+			hash = rbt_hash(rbt, &hash_name);
 			dns_name_getlabelsequence(search_name,
 						  nlabels - tlabels,
 						  tlabels, &hash_name);
 
-			/*
-			 * Walk all the nodes in the hash bucket pointed
-			 * by the computed hash value.
-			 */
-			for (hnode = rbt->hashtable[hash % rbt->hashsize];
-			     hnode != NULL;
-			     hnode = hnode->hashnext)
-			{
-				dns_name_t hnode_name;
-
-				if (ISC_LIKELY(hash != HASHVAL(hnode)))
-					continue;
-				/*
-				 * This checks that the hashed label
-				 * sequence being looked up is at the
-				 * same tree level, so that we don't
-				 * match a labelsequence from some other
-				 * subdomain.
-				 */
-				if (ISC_LIKELY(get_upper_node(hnode) != up_current))
-					continue;
-
-				dns_name_init(&hnode_name, NULL);
-				NODENAME(hnode, &hnode_name);
-				if (ISC_LIKELY(dns_name_equal(&hnode_name, &hash_name)))
-					break;
-			}
+			hnode = hash_lookup(rbt, hash, up_current, &hash_name);
 
 			if (hnode != NULL) {
 				current = hnode;
@@ -2259,11 +2389,6 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 	node->is_mmapped = 0;
-	node->down_is_relative = 0;
-	node->left_is_relative = 0;
-	node->right_is_relative = 0;
-	node->parent_is_relative = 0;
-	node->data_is_relative = 0;
 	node->rpz = 0;
 
 #ifdef DNS_RBT_USEHASH
@@ -2318,7 +2443,7 @@ hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 
 	REQUIRE(name != NULL);
 
-	HASHVAL(node) = dns_name_fullhash(name, ISC_FALSE);
+	HASHVAL(node) = rbt_hash(rbt, name);
 
 	hash = HASHVAL(node) % rbt->hashsize;
 	HASHNEXT(node) = rbt->hashtable[hash];
@@ -2342,48 +2467,90 @@ inithash(dns_rbt_t *rbt) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Returns ISC_TRUE if a node with hash value 'hashval' may still be
+ * linked into the old hash table of a resize that is in progress.
+ */
+static inline isc_boolean_t
+hash_inold(dns_rbt_t *rbt, unsigned int hashval) {
+	return (ISC_TF(rbt->oldhashtable != NULL &&
+		       (hashval % rbt->oldhashsize) >= rbt->hashiter));
+}
+
+/*
+ * Move up to 'count' buckets of the old hash table into the current
+ * one, freeing the old table once it is empty.
+ */
 static void
-rehash(dns_rbt_t *rbt, unsigned int newcount) {
-	unsigned int oldsize;
-	dns_rbtnode_t **oldtable;
+hash_migrate(dns_rbt_t *rbt, size_t count) {
 	dns_rbtnode_t *node;
 	dns_rbtnode_t *nextnode;
 	unsigned int hash;
-	unsigned int i;
 
-	oldsize = (unsigned int)rbt->hashsize;
-	oldtable = rbt->hashtable;
-	do {
-		INSIST((rbt->hashsize * 2 + 1) > rbt->hashsize);
-		rbt->hashsize = rbt->hashsize * 2 + 1;
-	} while (newcount >= (rbt->hashsize * 3));
-	rbt->hashtable = isc_mem_get(rbt->mctx,
-				     rbt->hashsize * sizeof(dns_rbtnode_t *));
-	if (rbt->hashtable == NULL) {
-		rbt->hashtable = oldtable;
-		rbt->hashsize = oldsize;
-		return;
-	}
-
-	for (i = 0; i < rbt->hashsize; i++)
-		rbt->hashtable[i] = NULL;
-
-	for (i = 0; i < oldsize; i++) {
-		for (node = oldtable[i]; node != NULL; node = nextnode) {
+	while (rbt->oldhashtable != NULL && count-- > 0) {
+		node = rbt->oldhashtable[rbt->hashiter];
+		for (; node != NULL; node = nextnode) {
 			hash = HASHVAL(node) % rbt->hashsize;
 			nextnode = HASHNEXT(node);
 			HASHNEXT(node) = rbt->hashtable[hash];
 			rbt->hashtable[hash] = node;
 		}
+		rbt->oldhashtable[rbt->hashiter] = NULL;
+
+		if (++rbt->hashiter == rbt->oldhashsize) {
+			isc_mem_put(rbt->mctx, rbt->oldhashtable,
+				    rbt->oldhashsize *
+				    sizeof(dns_rbtnode_t *));
+			rbt->oldhashtable = NULL;
+			rbt->oldhashsize = 0;
+			rbt->hashiter = 0;
+		}
 	}
+}
 
-	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
+/*
+ * Start growing the hash table so that it can hold 'newcount' nodes.
+ * The new table replaces the current one immediately; the nodes are
+ * moved over incrementally by hash_migrate().
+ */
+static void
+rehash(dns_rbt_t *rbt, unsigned int newcount) {
+	size_t newsize;
+	dns_rbtnode_t **newtable;
+	unsigned int i;
+
+	/*
+	 * A previous resize must be complete before starting another.
+	 * With RBT_HASH_MIGRATE buckets moved per update this normally
+	 * happened long ago.
+	 */
+	hash_migrate(rbt, rbt->oldhashsize);
+
+	newsize = rbt->hashsize;
+	do {
+		INSIST((newsize * 2 + 1) > newsize);
+		newsize = newsize * 2 + 1;
+	} while (newcount >= (newsize * 3));
+	newtable = isc_mem_get(rbt->mctx, newsize * sizeof(dns_rbtnode_t *));
+	if (newtable == NULL)
+		return;
+
+	for (i = 0; i < newsize; i++)
+		newtable[i] = NULL;
+
+	rbt->oldhashtable = rbt->hashtable;
+	rbt->oldhashsize = rbt->hashsize;
+	rbt->hashiter = 0;
+	rbt->hashtable = newtable;
+	rbt->hashsize = newsize;
 }
 
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
+	hash_migrate(rbt, RBT_HASH_MIGRATE);
+
 	if (rbt->nodecount >= (rbt->hashsize * 3))
 		rehash(rbt, rbt->nodecount);
 
@@ -2393,15 +2560,35 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 	unsigned int bucket;
+	dns_rbtnode_t **table;
 	dns_rbtnode_t *bucket_node;
 
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
-	bucket = HASHVAL(node) % rbt->hashsize;
-	bucket_node = rbt->hashtable[bucket];
+	if (hash_inold(rbt, HASHVAL(node))) {
+		/*
+		 * The node's old bucket has not been migrated yet, but
+		 * the node may have been added after the resize began.
+		 */
+		table = rbt->oldhashtable;
+		bucket = HASHVAL(node) % rbt->oldhashsize;
+		for (bucket_node = table[bucket];
+		     bucket_node != NULL && bucket_node != node;
+		     bucket_node = HASHNEXT(bucket_node))
+			;
+		if (bucket_node == NULL) {
+			table = rbt->hashtable;
+			bucket = HASHVAL(node) % rbt->hashsize;
+		}
+	} else {
+		table = rbt->hashtable;
+		bucket = HASHVAL(node) % rbt->hashsize;
+	}
+
+	bucket_node = table[bucket];
 
 	if (bucket_node == node) {
-		rbt->hashtable[bucket] = HASHNEXT(node);
+		table[bucket] = HASHNEXT(node);
 	} else {
 		while (HASHNEXT(bucket_node) != node) {
 			INSIST(HASHNEXT(bucket_node) != NULL);
@@ -2409,6 +2596,57 @@ unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 		}
 		HASHNEXT(bucket_node) = HASHNEXT(node);
 	}
+
+	hash_migrate(rbt, RBT_HASH_MIGRATE);
+}
+
+static inline dns_rbtnode_t *
+hash_search(dns_rbtnode_t *hnode, unsigned int hash, dns_rbtnode_t *up,
+	    const dns_name_t *name)
+{
+	dns_name_t hnode_name;
+
+	for (; hnode != NULL; hnode = hnode->hashnext) {
+		if (ISC_LIKELY(hash != HASHVAL(hnode)))
+			continue;
+		/*
+		 * This checks that the hashed label sequence being
+		 * looked up is at the same tree level, so that we
+		 * don't match a labelsequence from some other
+		 * subdomain.
+		 */
+		if (ISC_LIKELY(get_upper_node(hnode) != up))
+			continue;
+
+		dns_name_init(&hnode_name, NULL);
+		NODENAME(hnode, &hnode_name);
+		if (ISC_LIKELY(dns_name_equal(&hnode_name, name)))
+			break;
+	}
+
+	return (hnode);
+}
+
+/*
+ * Look up the node named 'name' whose upper node is 'up'.  While a
+ * resize is in progress the unmigrated bucket of the old table is
+ * searched too.  The tables are only read, so this is safe for
+ * concurrent lookups under a read lock.
+ */
+static inline dns_rbtnode_t *
+hash_lookup(dns_rbt_t *rbt, unsigned int hash, dns_rbtnode_t *up,
+	    const dns_name_t *name)
+{
+	dns_rbtnode_t *hnode;
+
+	hnode = hash_search(rbt->hashtable[hash % rbt->hashsize],
+			    hash, up, name);
+	if (hnode == NULL && hash_inold(rbt, hash))
+		hnode = hash_search(rbt->oldhashtable[hash %
+						      rbt->oldhashsize],
+				    hash, up, name);
+
+	return (hnode);
 }
 #endif /* DNS_RBT_USEHASH */
 
@@ -3013,12 +3251,8 @@ dns_rbt_printnodeinfo(dns_rbtnode_t *n, FILE *f) {
 
 	fprintf(f, "n = %p\n", n);
 
-	fprintf(f, "Relative pointers: %s%s%s%s%s\n",
-			(n->parent_is_relative == 1 ? " P" : ""),
-			(n->right_is_relative == 1 ? " R" : ""),
-			(n->left_is_relative == 1 ? " L" : ""),
-			(n->down_is_relative == 1 ? " D" : ""),
-			(n->data_is_relative == 1 ? " T" : ""));
+	fprintf(f, "Mapped from file: %s\n",
+		n->is_mmapped == 1 ? "yes" : "no");
 
 	fprintf(f, "node lock address = %d\n", n->locknum);
 
@@ -28,6 +28,7 @@
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -38,6 +39,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 #include <isc/hash.h>
@@ -110,6 +112,7 @@ struct rbtdb_file_header {
 	isc_uint64_t tree;
 	isc_uint64_t nsec;
 	isc_uint64_t nsec3;
+	isc_uint64_t linkbase;		/* address the image was laid out for */
 
 	char version2[32];  		/* repeated; must match version1 */
 };
@@ -242,6 +245,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define overmem overmem64
 #define overmem_purge overmem_purge64
 #define previous_closest_nsec previous_closest_nsec64
+#define pick_linkbase pick_linkbase64
 #define printnode printnode64
 #define prune_tree prune_tree64
 #define rbt_datafixer rbt_datafixer64
@@ -287,6 +291,14 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define settask settask64
 #define setup_delegation setup_delegation64
 #define subtractrdataset subtractrdataset64
+#define treelock_destroy treelock_destroy64
+#define treelock_downgrade treelock_downgrade64
+#define treelock_init treelock_init64
+#define treelock_lock treelock_lock64
+#define treelock_tryothers treelock_tryothers64
+#define treelock_trylock treelock_trylock64
+#define treelock_tryupgrade treelock_tryupgrade64
+#define treelock_unlock treelock_unlock64
 #define ttl_sooner ttl_sooner64
 #define update_cachestats update_cachestats64
 #define update_header update_header64
@@ -399,6 +411,159 @@ typedef isc_mutex_t nodelock_t;
 #define NODE_WEAKDOWNGRADE(l)   ((void)0)
 #endif
 
+/*%
+ * The tree lock is split into reader slots, one rwlock each.  A reader
+ * only takes the slot picked by isc_thread_index(), so concurrent cache
+ * lookups on different threads don't all modify the same rwlock word.
+ * A writer takes every slot in ascending order, so writers are still
+ * serialized against each other and against all readers.  An upgrade
+ * or a write trylock only ever uses trylock on the other slots, which
+ * keeps the ascending order from deadlocking against it.
+ *
+ * A reader must unlock the slot it locked; TREE_SLOT() returns the same
+ * value every time it is called from the same thread.
+ */
+typedef struct {
+	unsigned int                    count;
+	isc_rwlock_t *                  slots;
+} treelock_t;
+
+#define TREE_SLOT(l)            ((l)->count == 1 ? 0 :               \
+				 isc_thread_index() % (l)->count)
+#define TREE_LOCK(l, t)         treelock_lock((l), (t))
+#define TREE_UNLOCK(l, t)       treelock_unlock((l), (t))
+#define TREE_SLOTLOCK(l, s)     RWLOCK(&(l)->slots[s], isc_rwlocktype_read)
+#define TREE_SLOTUNLOCK(l, s)   RWUNLOCK(&(l)->slots[s], isc_rwlocktype_read)
+#define TREE_TRYLOCK(l)         treelock_trylock(l)
+#define TREE_TRYUPGRADE(l)      treelock_tryupgrade(l)
+#define TREE_DOWNGRADE(l)       treelock_downgrade(l)
+
+static isc_result_t
+treelock_init(isc_mem_t *mctx, treelock_t *tl, unsigned int count) {
+	isc_result_t result;
+	unsigned int i;
+
+	tl->slots = isc_mem_get(mctx, count * sizeof(isc_rwlock_t));
+	if (tl->slots == NULL)
+		return (ISC_R_NOMEMORY);
+	for (i = 0; i < count; i++) {
+		result = isc_rwlock_init(&tl->slots[i], 0, 0);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				isc_rwlock_destroy(&tl->slots[i]);
+			isc_mem_put(mctx, tl->slots,
+				    count * sizeof(isc_rwlock_t));
+			tl->slots = NULL;
+			return (result);
+		}
+	}
+	tl->count = count;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+treelock_destroy(isc_mem_t *mctx, treelock_t *tl) {
+	unsigned int i;
+
+	for (i = 0; i < tl->count; i++)
+		isc_rwlock_destroy(&tl->slots[i]);
+	isc_mem_put(mctx, tl->slots, tl->count * sizeof(isc_rwlock_t));
+	tl->slots = NULL;
+	tl->count = 0;
+}
+
+static inline void
+treelock_lock(treelock_t *tl, isc_rwlocktype_t type) {
+	unsigned int i;
+
+	if (type == isc_rwlocktype_read) {
+		TREE_SLOTLOCK(tl, TREE_SLOT(tl));
+		return;
+	}
+
+	for (i = 0; i < tl->count; i++)
+		RWLOCK(&tl->slots[i], isc_rwlocktype_write);
+}
+
+static inline void
+treelock_unlock(treelock_t *tl, isc_rwlocktype_t type) {
+	unsigned int i;
+
+	if (type == isc_rwlocktype_read) {
+		TREE_SLOTUNLOCK(tl, TREE_SLOT(tl));
+		return;
+	}
+
+	for (i = tl->count; i-- > 0; )
+		RWUNLOCK(&tl->slots[i], isc_rwlocktype_write);
+}
+
+/*
+ * Try to write lock every slot other than 'skip' (which the caller
+ * holds); on failure, release the ones we got.
+ */
+static isc_result_t
+treelock_tryothers(treelock_t *tl, unsigned int skip) {
+	isc_result_t result;
+	unsigned int i;
+
+	for (i = 0; i < tl->count; i++) {
+		if (i == skip)
+			continue;
+		result = isc_rwlock_trylock(&tl->slots[i],
+					    isc_rwlocktype_write);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				if (i != skip)
+					RWUNLOCK(&tl->slots[i],
+						 isc_rwlocktype_write);
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+treelock_trylock(treelock_t *tl) {
+	isc_result_t result;
+
+	result = isc_rwlock_trylock(&tl->slots[0], isc_rwlocktype_write);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = treelock_tryothers(tl, 0);
+	if (result != ISC_R_SUCCESS)
+		RWUNLOCK(&tl->slots[0], isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+treelock_tryupgrade(treelock_t *tl) {
+	isc_result_t result;
+	unsigned int slot = TREE_SLOT(tl);
+
+	result = isc_rwlock_tryupgrade(&tl->slots[slot]);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = treelock_tryothers(tl, slot);
+	if (result != ISC_R_SUCCESS)
+		isc_rwlock_downgrade(&tl->slots[slot]);
+
+	return (result);
+}
+
+static void
+treelock_downgrade(treelock_t *tl) {
+	unsigned int i, slot = TREE_SLOT(tl);
+
+	for (i = 0; i < tl->count; i++)
+		if (i != slot)
+			RWUNLOCK(&tl->slots[i], isc_rwlocktype_write);
+	isc_rwlock_downgrade(&tl->slots[slot]);
+}
+
 /*%
  * Whether to rate-limit updating the LRU to avoid possible thread contention.
  * Our performance measurement has shown the cost is marginal, so it's defined
@@ -433,8 +598,6 @@ typedef struct rdatasetheader {
 	struct noqname                  *noqname;
 	struct noqname                  *closest;
 	unsigned int 			is_mmapped : 1;
-	unsigned int 			next_is_relative : 1;
-	unsigned int 			node_is_relative : 1;
 	unsigned int 			resign_lsb : 1;
 	/*%<
 	 * We don't use the LIST macros, because the LIST structure has
@@ -567,6 +730,25 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define DEFAULT_CACHE_NODE_LOCK_COUNT   16
 #endif	/* DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
 
+/*%
+ * Maximum number of reader slots in the tree lock of a cache DB.  Readers
+ * on different threads use different slots as long as there are no more
+ * threads than slots; writers have to take all of them.  A cache gets one
+ * slot per CPU up to this limit, since without parallel readers the extra
+ * slots only make writers slower.  Zone DBs are written to far more often
+ * relative to their size and use one slot.  This can be configured at
+ * compilation time via the DNS_RBTDB_CACHE_TREE_LOCK_COUNT variable.
+ */
+#ifdef DNS_RBTDB_CACHE_TREE_LOCK_COUNT
+#if DNS_RBTDB_CACHE_TREE_LOCK_COUNT < 1
+#error "DNS_RBTDB_CACHE_TREE_LOCK_COUNT must be at least 1"
+#else
+#define DEFAULT_CACHE_TREE_LOCK_COUNT DNS_RBTDB_CACHE_TREE_LOCK_COUNT
+#endif
+#else
+#define DEFAULT_CACHE_TREE_LOCK_COUNT   16
+#endif	/* DNS_RBTDB_CACHE_TREE_LOCK_COUNT */
+
 typedef struct {
 	nodelock_t                      lock;
 	/* Protected in the refcount routines. */
@@ -662,7 +844,7 @@ struct dns_rbtdb {
 	isc_mutex_t                     lock;
 #endif
 	/* Locks the tree structure (prevents nodes appearing/disappearing) */
-	isc_rwlock_t                    tree_lock;
+	treelock_t                      tree_lock;
 	/* Locks for individual tree nodes */
 	unsigned int                    node_lock_count;
 	rbtdb_nodelock_t *              node_locks;
@@ -896,12 +1078,15 @@ static dns_dbiteratormethods_t dbiterator_methods = {
 
 /*
  * If 'paused' is ISC_TRUE, then the tree lock is not being held.
+ * Otherwise it is read locked in slot 'tree_slot', which need not be
+ * the slot of the thread now using the iterator.
  */
 typedef struct rbtdb_dbiterator {
 	dns_dbiterator_t                common;
 	isc_boolean_t                   paused;
 	isc_boolean_t                   new_origin;
 	isc_rwlocktype_t                tree_locked;
+	unsigned int                    tree_slot;
 	isc_result_t                    result;
 	dns_fixedname_t                 name;
 	dns_fixedname_t                 origin;
@@ -1330,7 +1515,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 
 	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	treelock_destroy(rbtdb->common.mctx, &rbtdb->tree_lock);
 	isc_refcount_destroy(&rbtdb->references);
 	if (rbtdb->task != NULL)
 		isc_task_detach(&rbtdb->task);
@@ -1631,8 +1816,6 @@ init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 	ISC_LINK_INIT(h, link);
 	h->heap_index = 0;
 	h->is_mmapped = 0;
-	h->next_is_relative = 0;
-	h->node_is_relative = 0;
 
 #if TRACE_HEADER
 	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in)
@@ -1643,22 +1826,10 @@ init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 }
 
 /*
- * Update the copied values of 'next' and 'node' if they are relative.
+ * Carry the owner name case of 'old' over to its replacement.
  */
 static void
 update_newheader(rdatasetheader_t *newh, rdatasetheader_t *old) {
-	char *p;
-
-	if (old->next_is_relative) {
-		p = (char *) old;
-		p += (uintptr_t)old->next;
-		newh->next = (rdatasetheader_t *)p;
-	}
-	if (old->node_is_relative) {
-		p = (char *) old;
-		p += (uintptr_t)old->node;
-		newh->node = (dns_rbtnode_t *)p;
-	}
 	if (CASESET(old)) {
 		isc_uint16_t attr;
 
@@ -2317,10 +2488,9 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		 * we only do a trylock.
 		 */
 		if (tlock == isc_rwlocktype_read)
-			result = isc_rwlock_tryupgrade(&rbtdb->tree_lock);
+			result = TREE_TRYUPGRADE(&rbtdb->tree_lock);
 		else
-			result = isc_rwlock_trylock(&rbtdb->tree_lock,
-						    isc_rwlocktype_write);
+			result = TREE_TRYLOCK(&rbtdb->tree_lock);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS ||
 			      result == ISC_R_LOCKBUSY);
 
@@ -2414,11 +2584,11 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 */
 	if (tlock == isc_rwlocktype_none)
 		if (write_locked)
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	if (tlock == isc_rwlocktype_read)
 		if (write_locked)
-			isc_rwlock_downgrade(&rbtdb->tree_lock);
+			TREE_DOWNGRADE(&rbtdb->tree_lock);
 
 	return (no_reference);
 }
@@ -2441,7 +2611,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	locknum = node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
 	do {
@@ -2481,7 +2651,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 		node = parent;
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2599,7 +2769,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
 	unsigned int count, length;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	version->havensec3 = ISC_FALSE;
 	node = rbtdb->origin_node;
 	NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
@@ -2676,7 +2846,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
  unlock:
 	NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
 		    isc_rwlocktype_read);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 }
 
 static void
@@ -2686,7 +2856,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	unsigned int locknum;
 	unsigned int refs;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
@@ -2696,7 +2866,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	if (again)
 		isc_task_send(task, &event);
 	else {
@@ -2938,7 +3108,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 			 * expensive, but this event should be rare enough
 			 * to justify the cost.
 			 */
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tlock = isc_rwlocktype_write;
 		}
 
@@ -2974,7 +3144,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 			isc_refcount_increment(&rbtdb->references, NULL);
 			isc_task_send(rbtdb->task, &event);
 		} else
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
  end:
@@ -3059,11 +3229,11 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 	INSIST(tree == rbtdb->tree || tree == rbtdb->nsec3);
 
 	dns_name_init(&nodename, NULL);
-	RWLOCK(&rbtdb->tree_lock, locktype);
+	TREE_LOCK(&rbtdb->tree_lock, locktype);
 	result = dns_rbt_findnode(tree, name, NULL, &node, NULL,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
 	if (result != ISC_R_SUCCESS) {
-		RWUNLOCK(&rbtdb->tree_lock, locktype);
+		TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 		if (!create) {
 			if (result == DNS_R_PARTIALMATCH)
 				result = ISC_R_NOTFOUND;
@@ -3074,7 +3244,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 		 * unlocking then relocking.
 		 */
 		locktype = isc_rwlocktype_write;
-		RWLOCK(&rbtdb->tree_lock, locktype);
+		TREE_LOCK(&rbtdb->tree_lock, locktype);
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
 		if (result == ISC_R_SUCCESS) {
@@ -3091,7 +3261,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 				if (dns_name_iswildcard(name)) {
 					result = add_wildcard_magic(rbtdb, name);
 					if (result != ISC_R_SUCCESS) {
-						RWUNLOCK(&rbtdb->tree_lock, locktype);
+						TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 						return (result);
 					}
 				}
@@ -3099,7 +3269,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 			if (tree == rbtdb->nsec3)
 				node->nsec = DNS_RBT_NSEC_NSEC3;
 		} else if (result != ISC_R_EXISTS) {
-			RWUNLOCK(&rbtdb->tree_lock, locktype);
+			TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 			return (result);
 		}
 	}
@@ -3109,7 +3279,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 
 	reactivate_node(rbtdb, node, locktype);
 
-	RWUNLOCK(&rbtdb->tree_lock, locktype);
+	TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 
 	*nodep = (dns_dbnode_t *)node;
 
@@ -4206,7 +4376,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = ISC_FALSE;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4630,7 +4800,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, isc_rwlocktype_read);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -5084,7 +5254,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	update = NULL;
 	updatesig = NULL;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -5364,7 +5534,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -5424,7 +5594,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	if ((options & DNS_DBFIND_NOEXACT) != 0)
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.
@@ -5519,7 +5689,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	INSIST(!search.need_cleanup);
 
@@ -5762,6 +5932,7 @@ createiterator(dns_db_t *db, unsigned int options, dns_dbiterator_t **iteratorp)
 	rbtdbiter->common.cleaning = ISC_FALSE;
 	rbtdbiter->paused = ISC_TRUE;
 	rbtdbiter->tree_locked = isc_rwlocktype_none;
+	rbtdbiter->tree_slot = 0;
 	rbtdbiter->result = ISC_R_SUCCESS;
 	dns_fixedname_init(&rbtdbiter->name);
 	dns_fixedname_init(&rbtdbiter->origin);
@@ -6840,9 +7011,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	dns_fixedname_init(&fixed);
 	name = dns_fixedname_name(&fixed);
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rbt_fullnamefromnode(node, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rdataset_getownercase(rdataset, name);
 
 	newheader = (rdatasetheader_t *)region.base;
@@ -6932,7 +7103,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		cache_is_overmem = ISC_TRUE;
 	if (delegating || newnsec || cache_is_overmem) {
 		tree_locked = ISC_TRUE;
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
 	if (cache_is_overmem)
@@ -6961,7 +7132,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		 * node lock.
 		 */
 		if (tree_locked && !delegating && !newnsec) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tree_locked = ISC_FALSE;
 		}
 	}
@@ -6992,7 +7163,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		    isc_rwlocktype_write);
 
 	if (tree_locked)
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -7458,9 +7629,13 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Fields are only stored when they differ from what is in the image,
+ * so that an image mapped at its link base is not written to.
+ */
 static isc_result_t
 rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
-	      void *arg, isc_uint64_t *crc)
+	      isc_uint64_t linkbase, void *arg, isc_uint64_t *crc)
 {
 	isc_result_t result;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *) arg;
@@ -7485,10 +7660,12 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 		hexdump("hashing slab", p + sizeof(rdatasetheader_t),
 			size - sizeof(rdatasetheader_t));
 #endif
-		header->serial = 1;
-		header->is_mmapped = 1;
-		header->node = rbtnode;
-		header->node_is_relative = 0;
+		if (header->serial != 1)
+			header->serial = 1;
+		if (header->is_mmapped != 1)
+			header->is_mmapped = 1;
+		if (header->node != rbtnode)
+			header->node = rbtnode;
 
 		if (rbtdb != NULL && RESIGN(header) &&
 		    (header->resign != 0 || header->resign_lsb != 0))
@@ -7501,14 +7678,17 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 
 		if (header->next != NULL) {
 			size_t cooked = dns_rbt_serialize_align(size);
-			if ((uintptr_t)header->next !=
-				    (p - (unsigned char *)base) + cooked)
+			rdatasetheader_t *next;
+
+			if ((uintptr_t)header->next != linkbase +
+			    (p - (unsigned char *)base) + cooked)
 				return (ISC_R_INVALIDFILE);
-			header->next = (rdatasetheader_t *)(p + cooked);
-			header->next_is_relative = 0;
-			if ((header->next < (rdatasetheader_t *) base) ||
-			    (header->next > (rdatasetheader_t *) limit))
+			next = (rdatasetheader_t *)(p + cooked);
+			if ((next < (rdatasetheader_t *) base) ||
+			    (next > (rdatasetheader_t *) limit))
 				return (ISC_R_INVALIDFILE);
+			if (header->next != next)
+				header->next = next;
 		}
 	}
 
@@ -7523,10 +7703,11 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	isc_result_t result;
 	rbtdb_load_t *loadctx = arg;
 	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	rbtdb_file_header_t *header;
+	rbtdb_file_header_t *header, fileheader;
 	int fd;
 	off_t filesize = 0;
 	char *base;
+	void *linkbase = NULL;
 	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
 	int protect, flags;
 	dns_rbtnode_t *origin_node = NULL;
@@ -7539,6 +7720,21 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	 * the nodes in the file.
 	 */
 
+	/*
+	 * Ask for the mapping at the address the image was laid out
+	 * for.  If we get it, none of the pointers need rebasing and the
+	 * pages are only read while loading, so they stay shared with the
+	 * page cache until a node is actually modified.
+	 */
+	if (isc_stdio_seek(f, offset, SEEK_SET) == ISC_R_SUCCESS &&
+	    isc_stdio_read(&fileheader, sizeof(fileheader), 1,
+			   f, NULL) == ISC_R_SUCCESS &&
+	    match_header_version(&fileheader) &&
+	    (uintptr_t)fileheader.linkbase == fileheader.linkbase)
+	{
+		linkbase = (void *)(uintptr_t)fileheader.linkbase;
+	}
+
 	/* Map in the whole file in one go */
 	fd = fileno(f);
 	isc_file_getsizefd(fd, &filesize);
@@ -7548,7 +7744,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	flags |= MAP_FILE;
 #endif
 
-	base = isc_file_mmap(NULL, filesize, protect, flags, fd, 0);
+	base = isc_file_mmap(linkbase, filesize, protect, flags, fd, 0);
 	if (base == NULL || base == MAP_FAILED) {
 		return (ISC_R_FAILURE);
 	}
@@ -7714,7 +7910,7 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
  */
 static isc_result_t
 rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
-	       isc_uint64_t *crc)
+	       isc_uint64_t linkbase, isc_uint64_t node, isc_uint64_t *crc)
 {
 	rbtdb_version_t *version = (rbtdb_version_t *) arg;
 	rbtdb_serial_t serial;
@@ -7758,19 +7954,18 @@ rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
 		off = where;
 		if ((off_t)off != where)
 			return (ISC_R_RANGE);
-		newheader.node = (dns_rbtnode_t *) off;
-		newheader.node_is_relative = 1;
+		newheader.node = (dns_rbtnode_t *)(uintptr_t) node;
 		newheader.serial = 1;
+		newheader.is_mmapped = 1;
 
 		/*
 		 * Round size up to the next pointer sized offset so it
 		 * will be properly aligned when read back in.
 		 */
 		cooked = dns_rbt_serialize_align(size);
-		if (next != NULL) {
-			newheader.next = (rdatasetheader_t *) (off + cooked);
-			newheader.next_is_relative = 1;
-		}
+		if (next != NULL)
+			newheader.next = (rdatasetheader_t *)
+				(uintptr_t)(linkbase + off + cooked);
 
 #ifdef DEBUG
 		hexdump("writing header", (unsigned char *) &newheader,
@@ -7839,7 +8034,7 @@ init_file_version(void) {
  */
 static isc_result_t
 rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
-		   off_t nsec3_location)
+		   off_t nsec3_location, uintptr_t linkbase)
 {
 	rbtdb_file_header_t header;
 	isc_result_t result;
@@ -7854,6 +8049,7 @@ rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
 	header.tree = (isc_uint64_t) tree_location;
 	header.nsec = (isc_uint64_t) nsec_location;
 	header.nsec3 = (isc_uint64_t) nsec3_location;
+	header.linkbase = (isc_uint64_t) linkbase;
 	result = isc_stdio_write(&header, 1, sizeof(rbtdb_file_header_t),
 			      rbtfile, NULL);
 	fflush(rbtfile);
@@ -7876,12 +8072,34 @@ match_header_version(rbtdb_file_header_t *header) {
 	return (ISC_TRUE);
 }
 
+/*
+ * Choose the address a new image is laid out for.  On 64-bit
+ * platforms this is a random 2MB aligned slot well away from where
+ * the system places mappings by default, chosen afresh for every dump
+ * so that a new image does not collide with the previous one, which
+ * is still mapped while the zone reloads.  Elsewhere address space is
+ * too scarce to reserve, and images are always rebased when loaded.
+ */
+static uintptr_t
+pick_linkbase(void) {
+	isc_uint32_t r;
+	isc_uint64_t slot;
+
+	if (sizeof(uintptr_t) < sizeof(isc_uint64_t))
+		return (0);
+
+	isc_random_get(&r);
+	slot = r & 0xffffff;
+	return ((uintptr_t)(((isc_uint64_t)1 << 44) + (slot << 21)));
+}
+
 static isc_result_t
 serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	rbtdb_version_t *version = (rbtdb_version_t *) ver;
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
 	off_t tree_location, nsec_location, nsec3_location, header_location;
+	uintptr_t linkbase = pick_linkbase();
 
 	rbtdb = (dns_rbtdb_t *)db;
 
@@ -7906,15 +8124,15 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	CHECK(isc_stdio_tell(rbtfile, &header_location));
 	CHECK(rbtdb_zero_header(rbtfile));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->tree, rbt_datawriter,
-				     version, &tree_location));
+				     version, linkbase, &tree_location));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec, rbt_datawriter,
-				     version, &nsec_location));
+				     version, linkbase, &nsec_location));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec3, rbt_datawriter,
-				     version, &nsec3_location));
+				     version, linkbase, &nsec3_location));
 
 	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
 	CHECK(rbtdb_write_header(rbtfile, tree_location, nsec_location,
-				 nsec3_location));
+				 nsec3_location, linkbase));
  failure:
 	return (result);
 }
@@ -7962,9 +8180,9 @@ issecure(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	secure = ISC_TF(rbtdb->current_version->secure == dns_db_secure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (secure);
 }
@@ -7978,9 +8196,9 @@ isdnssec(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dnssec = ISC_TF(rbtdb->current_version->secure != dns_db_insecure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (dnssec);
 }
@@ -7994,9 +8212,9 @@ nodecount(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	count = dns_rbt_nodecount(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (count);
 }
@@ -8010,9 +8228,9 @@ hashsize(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	size = dns_rbt_hashsize(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (size);
 }
@@ -8078,7 +8296,7 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 	REQUIRE(VALID_RBTDB(rbtdb));
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	if (rbtversion == NULL)
 		rbtversion = rbtdb->current_version;
@@ -8099,7 +8317,7 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 			*flags = rbtversion->flags;
 		result = ISC_R_SUCCESS;
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8192,7 +8410,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
@@ -8228,7 +8446,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	result = ISC_R_SUCCESS;
 
  unlock:
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8258,7 +8476,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	if (header->heap_index == 0)
 		return;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
 		  isc_rwlocktype_write);
 	/*
@@ -8268,7 +8486,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	resign_delete(rbtdb, rbtversion, header);
 	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
 		    isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 }
 
 static isc_result_t
@@ -8315,9 +8533,9 @@ nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	REQUIRE(node != NULL);
 	REQUIRE(name != NULL);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	result = dns_rbt_fullnamefromnode(rbtnode, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8461,6 +8679,7 @@ dns_rbtdb_create
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
 	int i;
+	unsigned int ntreelocks;
 	dns_name_t name;
 	isc_boolean_t (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
@@ -8498,7 +8717,13 @@ dns_rbtdb_create
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbtdb;
 
-	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
+	ntreelocks = 1;
+	if (IS_CACHE(rbtdb)) {
+		ntreelocks = ISC_MIN(isc_os_ncpus(),
+				     DEFAULT_CACHE_TREE_LOCK_COUNT);
+		ntreelocks = ISC_MAX(ntreelocks, 1);
+	}
+	result = treelock_init(mctx, &rbtdb->tree_lock, ntreelocks);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
@@ -8797,7 +9022,7 @@ dns_rbtdb_create
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
 
  cleanup_tree_lock:
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	treelock_destroy(mctx, &rbtdb->tree_lock);
 
  cleanup_lock:
 	RBTDB_DESTROYLOCK(&rbtdb->lock);
@@ -9320,10 +9545,11 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 			      dns_rbt_nodecount(rbtdb->tree));
 
 		if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			TREE_SLOTUNLOCK(&rbtdb->tree_lock,
+					rbtdbiter->tree_slot);
 			was_read_locked = ISC_TRUE;
 		}
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		rbtdbiter->tree_locked = isc_rwlocktype_write;
 
 		for (i = 0; i < rbtdbiter->delcnt; i++) {
@@ -9339,9 +9565,10 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 
 		rbtdbiter->delcnt = 0;
 
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		if (was_read_locked) {
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			rbtdbiter->tree_slot = TREE_SLOT(&rbtdb->tree_lock);
+			TREE_SLOTLOCK(&rbtdb->tree_lock, rbtdbiter->tree_slot);
 			rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 		} else {
@@ -9350,14 +9577,28 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 	}
 }
 
+/*
+ * Make sure the tree lock is read locked in the calling thread's slot,
+ * which decrement_reference() relies on when it tries to upgrade it.
+ * The iterator may have been left unpaused by a task event that ran on
+ * another worker; moving the lock is then no different from a pause
+ * followed by a resume, since the current node stays referenced.
+ */
 static inline void
 resume_iteration(rbtdb_dbiterator_t *rbtdbiter) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)rbtdbiter->common.db;
+	unsigned int slot = TREE_SLOT(&rbtdb->tree_lock);
 
-	REQUIRE(rbtdbiter->paused);
-	REQUIRE(rbtdbiter->tree_locked == isc_rwlocktype_none);
+	if (!rbtdbiter->paused) {
+		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_read);
+		if (rbtdbiter->tree_slot == slot)
+			return;
+		TREE_SLOTUNLOCK(&rbtdb->tree_lock, rbtdbiter->tree_slot);
+	} else
+		REQUIRE(rbtdbiter->tree_locked == isc_rwlocktype_none);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_SLOTLOCK(&rbtdb->tree_lock, slot);
+	rbtdbiter->tree_slot = slot;
 	rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 	rbtdbiter->paused = ISC_FALSE;
@@ -9370,7 +9611,7 @@ dbiterator_destroy(dns_dbiterator_t **iteratorp) {
 	dns_db_t *db = NULL;
 
 	if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_SLOTUNLOCK(&rbtdb->tree_lock, rbtdbiter->tree_slot);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	} else
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_none);
@@ -9403,8 +9644,7 @@ dbiterator_first(dns_dbiterator_t *iterator) {
 	    rbtdbiter->result != ISC_R_NOMORE)
 		return (rbtdbiter->result);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	dereference_iter_node(rbtdbiter);
 
@@ -9461,8 +9701,7 @@ dbiterator_last(dns_dbiterator_t *iterator) {
 	    rbtdbiter->result != ISC_R_NOMORE)
 		return (rbtdbiter->result);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	dereference_iter_node(rbtdbiter);
 
@@ -9512,8 +9751,7 @@ dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
 	    rbtdbiter->result != ISC_R_NOMORE)
 		return (rbtdbiter->result);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	dereference_iter_node(rbtdbiter);
 
@@ -9588,8 +9826,7 @@ dbiterator_prev(dns_dbiterator_t *iterator) {
 	if (rbtdbiter->result != ISC_R_SUCCESS)
 		return (rbtdbiter->result);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	name = dns_fixedname_name(&rbtdbiter->name);
 	origin = dns_fixedname_name(&rbtdbiter->origin);
@@ -9633,8 +9870,7 @@ dbiterator_next(dns_dbiterator_t *iterator) {
 	if (rbtdbiter->result != ISC_R_SUCCESS)
 		return (rbtdbiter->result);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	name = dns_fixedname_name(&rbtdbiter->name);
 	origin = dns_fixedname_name(&rbtdbiter->origin);
@@ -9678,8 +9914,7 @@ dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
 	REQUIRE(rbtdbiter->result == ISC_R_SUCCESS);
 	REQUIRE(rbtdbiter->node != NULL);
 
-	if (rbtdbiter->paused)
-		resume_iteration(rbtdbiter);
+	resume_iteration(rbtdbiter);
 
 	if (name != NULL) {
 		if (rbtdbiter->common.relative_names)
@@ -9746,7 +9981,7 @@ dbiterator_pause(dns_dbiterator_t *iterator) {
 
 	if (rbtdbiter->tree_locked != isc_rwlocktype_none) {
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_read);
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_SLOTUNLOCK(&rbtdb->tree_lock, rbtdbiter->tree_slot);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	}
 
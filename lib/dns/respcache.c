@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/respcache.h>
+#include <dns/types.h>
+
+/*
+ * Number of locks protecting the table.  Slot 'i' is protected by
+ * lock 'i % nlocks'.
+ */
+#define RESPCACHE_NLOCKS	64
+
+typedef struct dns_rcentry dns_rcentry_t;
+
+struct dns_respcache {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_mutex_t		*locks;
+	unsigned int		nlocks;
+	dns_rcentry_t		**table;
+	unsigned int		size;
+};
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(m)		ISC_MAGIC_VALID(m, RESPCACHE_MAGIC)
+
+/*
+ * The query name (uncompressed wire format, case preserved) and the
+ * response are stored immediately after the entry.
+ */
+struct dns_rcentry {
+	isc_uint32_t		hashval;
+	isc_uint32_t		variant;
+	isc_uint32_t		generation;
+	dns_rdatatype_t		type;
+	unsigned int		namelen;
+	unsigned int		length;
+};
+
+#define ENTRY_NAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_DATA(e)		(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)		(sizeof(*(e)) + (e)->namelen + (e)->length)
+
+static inline isc_uint32_t
+rc_hash(const dns_name_t *qname, dns_rdatatype_t qtype, isc_uint32_t variant) {
+	isc_uint32_t hashval, key[2];
+
+	/*
+	 * The generation is deliberately left out of the hash so that
+	 * a response for a newer generation replaces the stale one.
+	 */
+	hashval = isc_hash_function(qname->ndata, qname->length,
+				    ISC_TRUE, NULL);
+	key[0] = qtype;
+	key[1] = variant;
+	return (isc_hash_function(key, sizeof(key), ISC_TRUE, &hashval));
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int size,
+		     dns_respcache_t **rcp)
+{
+	isc_result_t result;
+	dns_respcache_t *rc = NULL;
+	unsigned int i;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(rcp != NULL && *rcp == NULL);
+
+	rc = isc_mem_get(mctx, sizeof(dns_respcache_t));
+	if (rc == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(rc, 0, sizeof(dns_respcache_t));
+	isc_mem_attach(mctx, &rc->mctx);
+
+	rc->size = size;
+	rc->table = isc_mem_get(rc->mctx, sizeof(*rc->table) * size);
+	if (rc->table == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	memset(rc->table, 0, sizeof(*rc->table) * size);
+
+	rc->nlocks = ISC_MIN(size, RESPCACHE_NLOCKS);
+	rc->locks = isc_mem_get(rc->mctx, sizeof(*rc->locks) * rc->nlocks);
+	if (rc->locks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_table;
+	}
+	for (i = 0; i < rc->nlocks; i++) {
+		result = isc_mutex_init(&rc->locks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_locks;
+	}
+
+	rc->magic = RESPCACHE_MAGIC;
+	*rcp = rc;
+	return (ISC_R_SUCCESS);
+
+ cleanup_locks:
+	while (i-- > 0)
+		DESTROYLOCK(&rc->locks[i]);
+	isc_mem_put(rc->mctx, rc->locks, sizeof(*rc->locks) * rc->nlocks);
+ cleanup_table:
+	isc_mem_put(rc->mctx, rc->table, sizeof(*rc->table) * rc->size);
+ cleanup:
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(dns_respcache_t));
+	return (result);
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	unsigned int i;
+
+	REQUIRE(rcp != NULL && VALID_RESPCACHE(*rcp));
+
+	rc = *rcp;
+	*rcp = NULL;
+
+	dns_respcache_flush(rc);
+
+	rc->magic = 0;
+	for (i = 0; i < rc->nlocks; i++)
+		DESTROYLOCK(&rc->locks[i]);
+	isc_mem_put(rc->mctx, rc->locks, sizeof(*rc->locks) * rc->nlocks);
+	isc_mem_put(rc->mctx, rc->table, sizeof(*rc->table) * rc->size);
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(dns_respcache_t));
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_name_t *qname,
+		   dns_rdatatype_t qtype, isc_uint32_t variant,
+		   isc_uint32_t generation, isc_buffer_t *target)
+{
+	isc_result_t result = ISC_R_NOTFOUND;
+	dns_rcentry_t *entry;
+	isc_uint32_t hashval;
+	unsigned int slot;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(dns_name_isabsolute(qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	hashval = rc_hash(qname, qtype, variant);
+	slot = hashval % rc->size;
+
+	LOCK(&rc->locks[slot % rc->nlocks]);
+	entry = rc->table[slot];
+	if (entry != NULL && entry->hashval == hashval &&
+	    entry->generation == generation && entry->type == qtype &&
+	    entry->variant == variant && entry->namelen == qname->length &&
+	    memcmp(ENTRY_NAME(entry), qname->ndata, qname->length) == 0)
+	{
+		if (isc_buffer_availablelength(target) < entry->length) {
+			result = ISC_R_NOSPACE;
+		} else {
+			isc_buffer_putmem(target, ENTRY_DATA(entry),
+					  entry->length);
+			result = ISC_R_SUCCESS;
+		}
+	}
+	UNLOCK(&rc->locks[slot % rc->nlocks]);
+
+	return (result);
+}
+
+void
+dns_respcache_add(dns_respcache_t *rc, const dns_name_t *qname,
+		  dns_rdatatype_t qtype, isc_uint32_t variant,
+		  isc_uint32_t generation, const isc_region_t *response)
+{
+	dns_rcentry_t *entry, *old;
+	unsigned int slot;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(dns_name_isabsolute(qname));
+	REQUIRE(response != NULL);
+
+	/*
+	 * Build the entry before taking the lock.
+	 */
+	entry = isc_mem_get(rc->mctx,
+			    sizeof(*entry) + qname->length + response->length);
+	if (entry == NULL)
+		return;
+	entry->hashval = rc_hash(qname, qtype, variant);
+	entry->variant = variant;
+	entry->generation = generation;
+	entry->type = qtype;
+	entry->namelen = qname->length;
+	entry->length = response->length;
+	memmove(ENTRY_NAME(entry), qname->ndata, qname->length);
+	memmove(ENTRY_DATA(entry), response->base, response->length);
+
+	slot = entry->hashval % rc->size;
+	LOCK(&rc->locks[slot % rc->nlocks]);
+	old = rc->table[slot];
+	rc->table[slot] = entry;
+	UNLOCK(&rc->locks[slot % rc->nlocks]);
+
+	if (old != NULL)
+		isc_mem_put(rc->mctx, old, ENTRY_SIZE(old));
+}
+
+void
+dns_respcache_flush(dns_respcache_t *rc) {
+	dns_rcentry_t *entry;
+	unsigned int i;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+
+	for (i = 0; i < rc->size; i++) {
+		LOCK(&rc->locks[i % rc->nlocks]);
+		entry = rc->table[i];
+		rc->table[i] = NULL;
+		UNLOCK(&rc->locks[i % rc->nlocks]);
+		if (entry != NULL)
+			isc_mem_put(rc->mctx, entry, ENTRY_SIZE(entry));
+	}
+}
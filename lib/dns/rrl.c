@@ -15,9 +15,11 @@
 /* #define ISC_LIST_CHECKINIT */
 
 #include <config.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/net.h>
 #include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/util.h>
 
@@ -29,9 +31,31 @@
 #include <dns/rrl.h>
 #include <dns/view.h>
 
+/*%
+ * Maximum number of shards in the database of rate-limit entries.
+ * A view gets one shard per CPU up to this limit; with a single CPU
+ * there is one shard and one lock as before.  This can be configured
+ * at compilation time via the DNS_RRL_SHARDS variable.
+ */
+#ifdef DNS_RRL_SHARDS
+#if DNS_RRL_SHARDS < 1
+#error "DNS_RRL_SHARDS must be at least 1"
+#else
+#define DEFAULT_RRL_SHARDS	DNS_RRL_SHARDS
+#endif
+#else
+#define DEFAULT_RRL_SHARDS	16
+#endif	/* DNS_RRL_SHARDS */
+
+/*%
+ * Number of bins of the previous hash table moved to the current one
+ * on each search.
+ */
+#define RRL_MIGRATE_BINS	4
+
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len);
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len);
 
 /*
  * Get a modulus for a hash function that is tolerably likely to be
@@ -124,20 +148,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static inline int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now)
+{
 	if (!e->ts_valid)
 		return (DNS_RRL_FOREVER);
-	return (delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now));
+	return (delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now));
 }
 
 static inline void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL)
 			ts = DNS_RRL_FOREVER;
@@ -159,7 +185,7 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
 		     e_old != NULL && (e_old->ts_gen == ts_gen ||
 				       !ISC_LINK_LINKED(e_old, hlink));
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
@@ -171,15 +197,15 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "rrl new time base scanned %d entries"
 				      " at %d for %d %d %d %d",
-				      i, now, rrl->ts_bases[ts_gen],
-				      rrl->ts_bases[(ts_gen + 1) %
+				      i, now, shard->ts_bases[ts_gen],
+				      shard->ts_bases[(ts_gen + 1) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 2) %
+				      shard->ts_bases[(ts_gen + 2) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 3) %
+				      shard->ts_bases[(ts_gen + 3) %
 					DNS_RRL_TS_BASES]);
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -188,20 +214,59 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	e->ts_valid = ISC_TRUE;
 }
 
+static inline isc_boolean_t
+key_cmp(const dns_rrl_key_t *a, const dns_rrl_key_t *b) {
+	if (memcmp(a, b, sizeof(dns_rrl_key_t)) == 0)
+		return (ISC_TRUE);
+	return (ISC_FALSE);
+}
+
+static inline isc_uint32_t
+hash_key(const dns_rrl_key_t *key) {
+	isc_uint32_t hval;
+	int i;
+
+	hval = key->w[0];
+	for (i = sizeof(key->w) / sizeof(key->w[0]) - 1; i >= 0; --i) {
+		hval = key->w[i] + (hval<<1);
+	}
+	return (hval);
+}
+
+/*
+ * The share of max-table-size allowed to one shard.
+ */
+static inline int
+shard_max_entries(const dns_rrl_t *rrl) {
+	if (rrl->max_entries == 0)
+		return (0);
+	return (ISC_MAX(rrl->max_entries / (int)rrl->nshards, 1));
+}
+
+/*
+ * Add 'newsize' free entries to a shard, or if 'newsize' is 0 then
+ * half again as many as it has, up to 1000.
+ * The entries are allocated without holding the shard lock.
+ */
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int newsize) {
+expand_entries(dns_rrl_t *rrl, dns_rrl_shard_t *shard, int newsize) {
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
-	int i;
+	int i, max_entries;
 
-	if (rrl->num_entries + newsize >= rrl->max_entries &&
-	    rrl->max_entries != 0)
-	{
-		newsize = rrl->max_entries - rrl->num_entries;
-		if (newsize <= 0)
+	max_entries = shard_max_entries(rrl);
+
+	LOCK(&shard->lock);
+	if (newsize == 0)
+		newsize = ISC_MIN((shard->num_entries + 1) / 2, 1000);
+	if (shard->num_entries + newsize >= max_entries && max_entries != 0) {
+		newsize = max_entries - shard->num_entries;
+		if (newsize <= 0) {
+			UNLOCK(&shard->lock);
 			return (ISC_R_SUCCESS);
+		}
 	}
 
 	/*
@@ -209,17 +274,18 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	 * and min-table-size.
 	 */
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) &&
-	    rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+	    shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL entries with"
 			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries+newsize,
-			      rrl->hash->length, rate);
+			      shard->num_entries, shard->num_entries+newsize,
+			      shard->hash->length, rate);
 	}
+	UNLOCK(&shard->lock);
 
 	bsize = sizeof(dns_rrl_block_t) + (newsize-1)*sizeof(dns_rrl_entry_t);
 	b = isc_mem_get(rrl->mctx, bsize);
@@ -232,14 +298,21 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	}
 	memset(b, 0, bsize);
 	b->size = bsize;
+	ISC_LINK_INIT(b, link);
 
 	e = b->entries;
 	for (i = 0; i < newsize; ++i, ++e) {
 		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LINK_INIT(e, lru);
 	}
-	rrl->num_entries += newsize;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+
+	LOCK(&shard->lock);
+	e = b->entries;
+	for (i = 0; i < newsize; ++i, ++e)
+		ISC_LIST_APPEND(shard->lru, e, lru);
+	shard->num_entries += newsize;
+	ISC_LIST_APPEND(shard->blocks, b, link);
+	UNLOCK(&shard->lock);
 
 	return (ISC_R_SUCCESS);
 }
@@ -250,46 +323,65 @@ get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
 	return (&hash->bins[hval % hash->length]);
 }
 
+static inline void
+free_hash(dns_rrl_t *rrl, dns_rrl_hash_t *hash) {
+	isc_mem_put(rrl->mctx, hash,
+		    sizeof(*hash) + (hash->length - 1) * sizeof(hash->bins[0]));
+}
+
+/*
+ * Move the entries in the next few bins of the previous hash table to
+ * the current table, and discard the previous table once it is empty.
+ * This spreads the cost of growing the hash table over many searches.
+ */
 static void
-free_old_hash(dns_rrl_t *rrl) {
+migrate_bins(dns_rrl_t *rrl, dns_rrl_shard_t *shard, int count) {
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
-	dns_rrl_entry_t *e, *e_next;
+	dns_rrl_entry_t *e;
 
-	old_hash = rrl->old_hash;
-	for (old_bin = &old_hash->bins[0];
-	     old_bin < &old_hash->bins[old_hash->length];
-	     ++old_bin)
-	{
-		for (e = ISC_LIST_HEAD(*old_bin); e != NULL; e = e_next) {
-			e_next = ISC_LIST_NEXT(e, hlink);
-			ISC_LINK_INIT(e, hlink);
+	old_hash = shard->old_hash;
+	if (old_hash == NULL)
+		return;
+
+	while (count-- > 0 && shard->old_bin < old_hash->length) {
+		old_bin = &old_hash->bins[shard->old_bin++];
+		while ((e = ISC_LIST_HEAD(*old_bin)) != NULL) {
+			ISC_LIST_UNLINK(*old_bin, e, hlink);
+			ISC_LIST_PREPEND(*get_bin(shard->hash,
+						  hash_key(&e->key)),
+					 e, hlink);
+			e->hash_gen = shard->hash_gen;
 		}
 	}
 
-	isc_mem_put(rrl->mctx, old_hash,
-		    sizeof(*old_hash)
-		      + (old_hash->length - 1) * sizeof(old_hash->bins[0]));
-	rrl->old_hash = NULL;
+	if (shard->old_bin >= old_hash->length) {
+		free_hash(rrl, old_hash);
+		shard->old_hash = NULL;
+	}
 }
 
+/*
+ * Replace the hash table of a shard with a larger one.
+ * The new table is allocated without holding the shard lock, and the
+ * entries are moved to it later by migrate_bins().
+ */
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now) {
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL)
-		free_old_hash(rrl);
-
 	/*
 	 * Most searches fail and so go to the end of the chain.
 	 * Use a small hash table load factor.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	LOCK(&shard->lock);
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins/8 + old_bins;
-	if (new_bins < rrl->num_entries)
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries)
+		new_bins = shard->num_entries;
+	UNLOCK(&shard->lock);
 	new_bins = hash_divisor(new_bins);
 
 	hsize = sizeof(dns_rrl_hash_t) + (new_bins-1)*sizeof(hash->bins[0]);
@@ -304,75 +396,90 @@ expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
 	}
 	memset(hash, 0, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+
+	LOCK(&shard->lock);
+	if (shard->old_hash != NULL ||
+	    (shard->hash != NULL && shard->hash->length != old_bins))
+	{
+		/*
+		 * Someone else got here first.
+		 */
+		UNLOCK(&shard->lock);
+		free_hash(rrl, hash);
+		return (ISC_R_SUCCESS);
+	}
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL bins for"
 			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      old_bins, new_bins, shard->num_entries, rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL)
-		rrl->old_hash->check_time = now;
-	rrl->hash = hash;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
+	hash->check_time = now;
+	shard->old_hash = shard->hash;
+	shard->old_bin = 0;
+	shard->hash = hash;
+	UNLOCK(&shard->lock);
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, int probes,
+	  isc_stdtime_t now)
+{
 	/*
 	 * Make the entry most recently used.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged)
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e) {
+		if (e == shard->last_logged)
+			shard->last_logged = ISC_LIST_PREV(e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
-	 * Expand the hash table if it is time and necessary.
-	 * This will leave the newly referenced entry in a chain in the
-	 * old hash table.  It will migrate to the new hash table the next
-	 * time it is used or be cut loose when the old hash table is destroyed.
+	 * Ask for a larger hash table if it is time and necessary.
+	 * Wait until the entries have left the previous table.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1) {
-		if (rrl->probes/rrl->searches > 2)
-			expand_rrl_hash(rrl, now);
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1) {
+		if (shard->probes/shard->searches > 2 &&
+		    shard->old_hash == NULL)
+			shard->grow_hash = ISC_TRUE;
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
-static inline isc_boolean_t
-key_cmp(const dns_rrl_key_t *a, const dns_rrl_key_t *b) {
-	if (memcmp(a, b, sizeof(dns_rrl_key_t)) == 0)
-		return (ISC_TRUE);
-	return (ISC_FALSE);
-}
-
-static inline isc_uint32_t
-hash_key(const dns_rrl_key_t *key) {
-	isc_uint32_t hval;
-	int i;
-
-	hval = key->w[0];
-	for (i = sizeof(key->w) / sizeof(key->w[0]) - 1; i >= 0; --i) {
-		hval = key->w[i] + (hval<<1);
-	}
-	return (hval);
+/*
+ * Release the shard lock and then do any growing that was asked for
+ * while it was held.
+ */
+static void
+unlock_shard(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now) {
+	isc_boolean_t grow_entries, grow_hash;
+
+	grow_entries = shard->grow_entries;
+	grow_hash = shard->grow_hash;
+	shard->grow_entries = ISC_FALSE;
+	shard->grow_hash = ISC_FALSE;
+	UNLOCK(&shard->lock);
+
+	if (grow_entries)
+		(void)expand_entries(rrl, shard, 0);
+	if (grow_hash)
+		(void)expand_rrl_hash(rrl, shard, now);
 }
 
 /*
@@ -484,7 +591,8 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
  * Search for an entry for a response and optionally create it.
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
+get_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard,
+	  const isc_sockaddr_t *client_addr,
 	  dns_rdataclass_t qclass, dns_rdatatype_t qtype,
 	  const dns_name_t *qname, dns_rrl_rtype_t rtype, isc_stdtime_t now,
 	  isc_boolean_t create, char *log_buf, unsigned int log_buf_len)
@@ -494,7 +602,7 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	dns_rrl_entry_t *e;
 	dns_rrl_hash_t *hash;
 	dns_rrl_bin_t *new_bin, *old_bin;
-	int probes, age;
+	int probes, age, max_entries;
 
 	make_key(rrl, &key, client_addr, qtype, qname, qclass, rtype);
 	hval = hash_key(&key);
@@ -502,12 +610,12 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
+	new_bin = get_bin(shard->hash, hval);
 	probes = 1;
 	e = ISC_LIST_HEAD(*new_bin);
 	while (e != NULL) {
 		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
+			ref_entry(shard, e, probes, now);
 			return (e);
 		}
 		++probes;
@@ -515,28 +623,24 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	}
 
 	/*
-	 * Look in the old hash table.
+	 * Look in the old hash table, and move a few more of its bins
+	 * to the current table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
+	if (shard->old_hash != NULL) {
+		old_bin = get_bin(shard->old_hash, hval);
 		e = ISC_LIST_HEAD(*old_bin);
 		while (e != NULL) {
 			if (key_cmp(&e->key, &key)) {
 				ISC_LIST_UNLINK(*old_bin, e, hlink);
 				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
+				e->hash_gen = shard->hash_gen;
+				ref_entry(shard, e, probes, now);
+				migrate_bins(rrl, shard, RRL_MIGRATE_BINS);
 				return (e);
 			}
 			e = ISC_LIST_NEXT(e, hlink);
 		}
-
-		/*
-		 * Discard prevous hash table when all of its entries are old.
-		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
-		if (age > rrl->window)
-			free_old_hash(rrl);
+		migrate_bins(rrl, shard, RRL_MIGRATE_BINS);
 	}
 
 	if (!create)
@@ -545,16 +649,16 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * The entry does not exist, so create it by finding a free entry.
 	 * Keep currently penalized and logged entries.
-	 * Try to make more entries if none are idle.
-	 * Steal the oldest entry if we cannot create more.
+	 * If none are idle, steal the oldest entry and ask for more
+	 * entries to be made once the shard lock is released.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru);
+	for (e = ISC_LIST_TAIL(shard->lru);
 	     e != NULL;
 	     e = ISC_LIST_PREV(e, lru))
 	{
 		if (!ISC_LINK_LINKED(e, hlink))
 			break;
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
@@ -563,24 +667,26 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 			break;
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries+1)/2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		max_entries = shard_max_entries(rrl);
+		if (max_entries == 0 || shard->num_entries < max_entries)
+			shard->grow_entries = ISC_TRUE;
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged)
-		log_end(rrl, e, ISC_TRUE, log_buf, log_buf_len);
+		log_end(rrl, shard, e, ISC_TRUE, log_buf, log_buf_len);
 	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen)
-			hash = rrl->hash;
+		if (e->hash_gen == shard->hash_gen)
+			hash = shard->hash;
 		else
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		old_bin = get_bin(hash, hash_key(&e->key));
 		ISC_LIST_UNLINK(*old_bin, e, hlink);
 	}
 	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
+	e->hash_gen = shard->hash_gen;
 	e->key = key;
 	e->ts_valid = ISC_FALSE;
-	ref_entry(rrl, e, probes, now);
+	ref_entry(shard, e, probes, now);
 	return (e);
 }
 
@@ -602,9 +708,9 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 }
 
 static inline dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
-		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
-		char *log_buf, unsigned int log_buf_len)
+debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+		double qps, double scale, const isc_sockaddr_t *client_addr,
+		isc_stdtime_t now, char *log_buf, unsigned int log_buf_len)
 {
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
@@ -623,12 +729,12 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		/*
 		 * The limit for clients that have used TCP is not scaled.
 		 */
-		credit_e = get_entry(rrl, client_addr,
+		credit_e = get_entry(rrl, shard, client_addr,
 				     0, dns_rdatatype_none, NULL,
 				     DNS_RRL_RTYPE_TCP, now, ISC_FALSE,
 				     log_buf, log_buf_len);
 		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < rrl->window)
 				scale = 1.0;
 		}
@@ -657,7 +763,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -688,7 +794,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -739,6 +845,11 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	return (DNS_RRL_RESULT_DROP);
 }
 
+/*
+ * The qname buffers are shared by all shards and protected by rrl->lock.
+ * A buffer belongs to an entry while the entry is logged, so its name
+ * can be read while holding only the lock of the entry's shard.
+ */
 static inline dns_rrl_qname_buf_t *
 get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
@@ -753,11 +864,16 @@ static inline void
 free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
+	if (!e->logged)
+		return;
+
+	LOCK(&rrl->lock);
 	qbuf = get_qname(rrl, e);
 	if (qbuf != NULL) {
 		qbuf->e = NULL;
 		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
 	}
+	UNLOCK(&rrl->lock);
 }
 
 static void
@@ -872,6 +988,7 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 	    e->key.s.rtype == DNS_RRL_RTYPE_REFERRAL ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NODATA ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NXDOMAIN) {
+		LOCK(&rrl->lock);
 		qbuf = get_qname(rrl, e);
 		if (save_qname && qbuf == NULL &&
 		    qname != NULL && dns_name_isabsolute(qname)) {
@@ -907,6 +1024,7 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 					      NULL);
 			}
 		}
+		UNLOCK(&rrl->lock);
 		if (qbuf != NULL)
 			qname = dns_fixedname_name(&qbuf->qname);
 		if (qname != NULL) {
@@ -935,8 +1053,8 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len)
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len)
 {
 	if (e->logged) {
 		make_log_buf(rrl, e,
@@ -951,7 +1069,7 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
 			      "%s", log_buf);
 		free_qname(rrl, e);
 		e->logged = ISC_FALSE;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -959,39 +1077,56 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit,
-	  char *log_buf, unsigned int log_buf_len)
+log_stops(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now,
+	  int limit, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged)
 			continue;
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
 			    response_balance(rrl, e, age) < 0)
 				break;
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0)
+		log_end(rrl, shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0)
 			break;
 
 		/*
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
+}
+
+/*
+ * All of the entries for a client address block are kept in one shard.
+ */
+static inline dns_rrl_shard_t *
+get_shard(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	dns_rrl_key_t key;
+	isc_uint32_t hval;
+
+	if (rrl->nshards == 1)
+		return (&rrl->shards[0]);
+
+	make_key(rrl, &key, client_addr, dns_rdatatype_none, NULL, 0,
+		 DNS_RRL_RTYPE_ALL);
+	hval = isc_hash_function(key.s.ip, sizeof(key.s.ip), ISC_TRUE, NULL);
+	return (&rrl->shards[hval % rrl->nshards]);
 }
 
 /*
@@ -1005,6 +1140,7 @@ dns_rrl(dns_view_t *view,
 	isc_boolean_t wouldlog, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
@@ -1025,8 +1161,6 @@ dns_rrl(dns_view_t *view,
 			return (DNS_RRL_RESULT_OK);
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1034,6 +1168,7 @@ dns_rrl(dns_view_t *view,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
+		LOCK(&rrl->lock);
 		++rrl->qps_responses;
 		secs = delta_rrl_time(rrl->qps_time, now);
 		if (secs <= 0) {
@@ -1058,14 +1193,18 @@ dns_rrl(dns_view_t *view,
 				qps = rrl->qps;
 			}
 		}
+		UNLOCK(&rrl->lock);
 		scale = rrl->qps_scale / qps;
 	}
 
+	shard = get_shard(rrl, client_addr);
+	LOCK(&shard->lock);
+
 	/*
 	 * Do maintenance once per second.
 	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now)
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
+	if (shard->num_logged > 0 && shard->log_stops_time != now)
+		log_stops(rrl, shard, now, 8, log_buf, log_buf_len);
 
 	/*
 	 * Notice TCP responses when scaling limits by qps.
@@ -1073,16 +1212,16 @@ dns_rrl(dns_view_t *view,
 	 */
 	if (is_tcp) {
 		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr,
+			e = get_entry(rrl, shard, client_addr,
 				      0, dns_rdatatype_none, NULL,
 				      DNS_RRL_RTYPE_TCP, now, ISC_TRUE,
 				      log_buf, log_buf_len);
 			if (e != NULL) {
 				e->responses = -(rrl->window+1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
 		}
-		UNLOCK(&rrl->lock);
+		unlock_shard(rrl, shard, now);
 		return (ISC_R_SUCCESS);
 	}
 
@@ -1107,10 +1246,10 @@ dns_rrl(dns_view_t *view,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, qclass, qtype, qname, rtype,
+	e = get_entry(rrl, shard, client_addr, qclass, qtype, qname, rtype,
 		      now, ISC_TRUE, log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		unlock_shard(rrl, shard, now);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1127,8 +1266,8 @@ dns_rrl(dns_view_t *view,
 			      "%s", log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
-				     log_buf, log_buf_len);
+	rrl_result = debit_rrl_entry(rrl, shard, e, qps, scale, client_addr,
+				     now, log_buf, log_buf_len);
 
 	if (rrl->all_per_second.r != 0) {
 		/*
@@ -1142,15 +1281,15 @@ dns_rrl(dns_view_t *view,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr,
+		e_all = get_entry(rrl, shard, client_addr,
 				  0, dns_rdatatype_none, NULL,
 				  DNS_RRL_RTYPE_ALL, now, ISC_TRUE,
 				  log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			unlock_shard(rrl, shard, now);
 			return (DNS_RRL_RESULT_OK);
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
+		rrl_all_result = debit_rrl_entry(rrl, shard, e_all, qps, scale,
 						 client_addr, now,
 						 log_buf, log_buf_len);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
@@ -1171,7 +1310,7 @@ dns_rrl(dns_view_t *view,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		unlock_shard(rrl, shard, now);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1187,8 +1326,8 @@ dns_rrl(dns_view_t *view,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = ISC_TRUE;
-			if (++rrl->num_logged <= 1)
-				rrl->last_logged = e;
+			if (++shard->num_logged <= 1)
+				shard->last_logged = e;
 		}
 		e->log_secs = 0;
 
@@ -1196,7 +1335,7 @@ dns_rrl(dns_view_t *view,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			unlock_shard(rrl, shard, now);
 			e = NULL;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1220,7 +1359,7 @@ dns_rrl(dns_view_t *view,
 		 */
 		if (!e->logged)
 			free_qname(rrl, e);
-		UNLOCK(&rrl->lock);
+		unlock_shard(rrl, shard, now);
 	}
 
 	return (rrl_result);
@@ -1229,9 +1368,10 @@ dns_rrl(dns_view_t *view,
 void
 dns_rrl_view_destroy(dns_view_t *view) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	dns_rrl_block_t *b;
-	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	unsigned int n;
 	int i;
 
 	rrl = view->rrl;
@@ -1243,8 +1383,12 @@ dns_rrl_view_destroy(dns_view_t *view) {
 	 * Assume the caller takes care of locking the view and anything else.
 	 */
 
-	if (rrl->num_logged > 0)
-		log_stops(rrl, 0, ISC_INT32_MAX, log_buf, sizeof(log_buf));
+	for (n = 0; n < rrl->nshards; n++) {
+		shard = &rrl->shards[n];
+		if (shard->num_logged > 0)
+			log_stops(rrl, shard, 0, ISC_INT32_MAX,
+				  log_buf, sizeof(log_buf));
+	}
 
 	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
 		if (rrl->qnames[i] == NULL)
@@ -1257,21 +1401,24 @@ dns_rrl_view_destroy(dns_view_t *view) {
 
 	DESTROYLOCK(&rrl->lock);
 
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
-		isc_mem_put(rrl->mctx, b, b->size);
-	}
+	for (n = 0; n < rrl->nshards; n++) {
+		shard = &rrl->shards[n];
+		DESTROYLOCK(&shard->lock);
 
-	h = rrl->hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+		while (!ISC_LIST_EMPTY(shard->blocks)) {
+			b = ISC_LIST_HEAD(shard->blocks);
+			ISC_LIST_UNLINK(shard->blocks, b, link);
+			isc_mem_put(rrl->mctx, b, b->size);
+		}
 
-	h = rrl->old_hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+		if (shard->hash != NULL)
+			free_hash(rrl, shard->hash);
+		if (shard->old_hash != NULL)
+			free_hash(rrl, shard->old_hash);
+	}
+	if (rrl->shards != NULL)
+		isc_mem_put(rrl->mctx, rrl->shards,
+			    sizeof(*rrl->shards) * DEFAULT_RRL_SHARDS);
 
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
@@ -1279,7 +1426,10 @@ dns_rrl_view_destroy(dns_view_t *view) {
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	isc_result_t result;
+	unsigned int nshards, n;
+	isc_stdtime_t now;
 
 	*rrlp = NULL;
 
@@ -1293,19 +1443,46 @@ dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 		isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 		return (result);
 	}
-	isc_stdtime_get(&rrl->ts_bases[0]);
 
 	view->rrl = rrl;
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
+	rrl->shards = isc_mem_get(rrl->mctx,
+				  sizeof(*rrl->shards) * DEFAULT_RRL_SHARDS);
+	if (rrl->shards == NULL) {
 		dns_rrl_view_destroy(view);
-		return (result);
+		return (ISC_R_NOMEMORY);
 	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+	memset(rrl->shards, 0, sizeof(*rrl->shards) * DEFAULT_RRL_SHARDS);
+
+	nshards = ISC_MIN(isc_os_ncpus(), DEFAULT_RRL_SHARDS);
+	nshards = ISC_MAX(nshards, 1);
+	isc_stdtime_get(&now);
+	for (n = 0; n < nshards; n++) {
+		shard = &rrl->shards[n];
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		rrl->nshards++;
+		ISC_LIST_INIT(shard->blocks);
+		ISC_LIST_INIT(shard->lru);
+		shard->ts_bases[0] = now;
+	}
+
+	min_entries = ISC_MAX(min_entries / (int)nshards, 1);
+	for (n = 0; n < nshards; n++) {
+		shard = &rrl->shards[n];
+		result = expand_entries(rrl, shard, min_entries);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		result = expand_rrl_hash(rrl, shard, 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
 	}
 
 	*rrlp = rrl;
@@ -122,7 +122,7 @@ dns_stats_detach(dns_stats_t **statsp) {
  */
 static isc_result_t
 create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
-	     dns_stats_t **statsp)
+	     isc_boolean_t percpu, dns_stats_t **statsp)
 {
 	dns_stats_t *stats;
 	isc_result_t result;
@@ -138,7 +138,11 @@ create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	if (percpu)
+		result = isc_stats_createpercpu(mctx, &stats->counters,
+						ncounters);
+	else
+		result = isc_stats_create(mctx, &stats->counters, ncounters);
 	if (result != ISC_R_SUCCESS)
 		goto clean_mutex;
 
@@ -162,7 +166,8 @@ isc_result_t
 dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_general, ncounters, statsp));
+	return (create_stats(mctx, dns_statstype_general, ncounters, ISC_FALSE,
+			     statsp));
 }
 
 isc_result_t
@@ -170,7 +175,15 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdtype, rdtypecounter_max,
-			     statsp));
+			     ISC_FALSE, statsp));
+}
+
+isc_result_t
+dns_rdatatypestats_createpercpu(isc_mem_t *mctx, dns_stats_t **statsp) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, dns_statstype_rdtype, rdtypecounter_max,
+			     ISC_TRUE, statsp));
 }
 
 isc_result_t
@@ -178,14 +191,14 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdataset,
-			     rdatasettypecounter_max, statsp));
+			     rdatasettypecounter_max, ISC_TRUE, statsp));
 }
 
 isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_opcode, 16, statsp));
+	return (create_stats(mctx, dns_statstype_opcode, 16, ISC_TRUE, statsp));
 }
 
 isc_result_t
@@ -193,7 +206,7 @@ dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rcode,
-			     dns_rcode_badcookie + 1, statsp));
+			     dns_rcode_badcookie + 1, ISC_TRUE, statsp));
 }
 
 /*%
@@ -17,6 +17,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <isc/os.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/journal.h>
@@ -33,6 +38,108 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+#define CT_THREADS	4
+#define CT_NAMES	300
+#define CT_ROUNDS	5
+
+typedef struct {
+	dns_db_t	*db;
+	unsigned int	id;
+	isc_result_t	result;
+} cachethread_t;
+
+/*
+ * Add CT_NAMES names of our own to the cache, look up names added by
+ * every thread, and walk the whole cache once per round.
+ */
+static isc_threadresult_t
+cache_thread(isc_threadarg_t arg) {
+	cachethread_t *ct = arg;
+	dns_fixedname_t fixed, ffixed;
+	dns_name_t *name, *found;
+	dns_dbnode_t *node;
+	dns_dbiterator_t *iter;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+	char buf[BUFLEN];
+	unsigned int i, round;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&ffixed);
+	found = dns_fixedname_name(&ffixed);
+
+	for (round = 0; round < CT_ROUNDS; round++) {
+		for (i = 0; i < CT_NAMES; i++) {
+			snprintf(buf, sizeof(buf), "n%u.t%u.example",
+				 i, ct->id);
+			CHECK(dns_name_fromstring(name, buf, 0, NULL));
+
+			dns_rdata_init(&rdata);
+			rdata.data = data;
+			rdata.length = 4;
+			rdata.rdclass = dns_rdataclass_in;
+			rdata.type = dns_rdatatype_a;
+			dns_rdatalist_init(&rdatalist);
+			rdatalist.ttl = 300;
+			rdatalist.type = dns_rdatatype_a;
+			rdatalist.rdclass = dns_rdataclass_in;
+			ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+			dns_rdataset_init(&rdataset);
+			CHECK(dns_rdatalist_tordataset(&rdatalist, &rdataset));
+
+			node = NULL;
+			CHECK(dns_db_findnode(ct->db, name, ISC_TRUE, &node));
+			result = dns_db_addrdataset(ct->db, node, NULL, 0,
+						    &rdataset, 0, NULL);
+			dns_db_detachnode(ct->db, &node);
+			dns_rdataset_disassociate(&rdataset);
+			if (result != ISC_R_SUCCESS &&
+			    result != DNS_R_UNCHANGED)
+				goto cleanup;
+
+			snprintf(buf, sizeof(buf), "n%u.t%u.example",
+				 i, (ct->id + i) % CT_THREADS);
+			CHECK(dns_name_fromstring(name, buf, 0, NULL));
+			dns_rdataset_init(&rdataset);
+			node = NULL;
+			result = dns_db_find(ct->db, name, NULL,
+					     dns_rdatatype_a, 0, 0, &node,
+					     found, &rdataset, NULL);
+			if (result == ISC_R_SUCCESS) {
+				dns_db_detachnode(ct->db, &node);
+				dns_rdataset_disassociate(&rdataset);
+			} else if (result != ISC_R_NOTFOUND &&
+				   result != DNS_R_NXDOMAIN)
+				goto cleanup;
+		}
+
+		iter = NULL;
+		CHECK(dns_db_createiterator(ct->db, 0, &iter));
+		for (result = dns_dbiterator_first(iter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_dbiterator_next(iter))
+		{
+			node = NULL;
+			result = dns_dbiterator_current(iter, &node, NULL);
+			if (result != ISC_R_SUCCESS)
+				break;
+			dns_db_detachnode(ct->db, &node);
+		}
+		dns_dbiterator_destroy(&iter);
+		if (result != ISC_R_NOMORE)
+			goto cleanup;
+	}
+	result = ISC_R_SUCCESS;
+
+ cleanup:
+	ct->result = result;
+	return ((isc_threadresult_t)0);
+}
+
 /*
  * Individual unit tests
  */
@@ -109,6 +216,65 @@ ATF_TC_BODY(getsetservestalettl, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+ATF_TC(generation);
+ATF_TC_HEAD(generation, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "test that commits and loads change dns_db_generation");
+}
+ATF_TC_BODY(generation, tc) {
+	dns_db_t *db = NULL, *db2 = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_rdatacallbacks_t callbacks;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_uint32_t gen;
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	gen = dns_db_generation(db);
+	ATF_CHECK(dns_db_generation(db2) != gen);
+
+	/* Reading and rolling back leave the generation alone. */
+	dns_db_currentversion(db, &version);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	ATF_CHECK_EQ(dns_db_generation(db), gen);
+
+	/* Committing a version changes it ... */
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	ATF_CHECK(dns_db_generation(db) != gen);
+	ATF_CHECK(dns_db_generation(db) != dns_db_generation(db2));
+
+	/* ... and so does finishing a load. */
+	gen = dns_db_generation(db2);
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db2, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_endload(db2, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_db_generation(db2) != gen);
+	ATF_CHECK(dns_db_generation(db2) != dns_db_generation(db));
+
+	dns_db_detach(&db2);
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+}
+
 ATF_TC(dns_dbfind_staleok);
 ATF_TC_HEAD(dns_dbfind_staleok, tc) {
 	atf_tc_set_md_var(tc, "descr",
@@ -273,12 +439,258 @@ ATF_TC_BODY(dns_dbfind_staleok, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+ATF_TC(cache_threads);
+ATF_TC_HEAD(cache_threads, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "add, find and iterate in a cache from "
+			  "several threads");
+}
+ATF_TC_BODY(cache_threads, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_thread_t threads[CT_THREADS];
+	cachethread_t ct[CT_THREADS];
+	char buf[BUFLEN];
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < CT_THREADS; i++) {
+		ct[i].db = db;
+		ct[i].id = i;
+		ct[i].result = ISC_R_UNEXPECTED;
+		result = isc_thread_create(cache_thread, &ct[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < CT_THREADS; i++) {
+		result = isc_thread_join(threads[i], NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(ct[i].result, ISC_R_SUCCESS);
+	}
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (i = 0; i < CT_THREADS; i++) {
+		for (j = 0; j < CT_NAMES; j++) {
+			snprintf(buf, sizeof(buf), "n%u.t%u.example", j, i);
+			result = dns_name_fromstring(name, buf, 0, NULL);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			node = NULL;
+			result = dns_db_findnode(db, name, ISC_FALSE, &node);
+			ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+			if (result == ISC_R_SUCCESS)
+				dns_db_detachnode(db, &node);
+		}
+	}
+
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#ifdef DNS_BENCHMARK_TESTS
+
+/*
+ * Mixed read/write load on a cache database.  Lookups take the tree lock
+ * for reading; adding a new name takes it for writing.  Build once with
+ * -DDNS_RBTDB_CACHE_TREE_LOCK_COUNT=1 to compare against a single lock.
+ */
+
+#define CB_NAMES	20000
+#define CB_OPS		100000
+
+typedef struct {
+	dns_db_t	*db;
+	unsigned int	id;
+	unsigned int	writepct;
+	isc_result_t	result;
+} benchthread_t;
+
+static isc_threadresult_t
+cache_bench_thread(isc_threadarg_t arg) {
+	benchthread_t *bt = arg;
+	dns_fixedname_t fixed, ffixed;
+	dns_name_t *name, *found;
+	dns_dbnode_t *node;
+	dns_rdataset_t rdataset;
+	char buf[BUFLEN];
+	unsigned int i, n, seed = bt->id + 1;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&ffixed);
+	found = dns_fixedname_name(&ffixed);
+
+	for (i = 0; i < CB_OPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		n = (seed >> 8) % CB_NAMES;
+		node = NULL;
+		if ((seed >> 4) % 100 < bt->writepct) {
+			snprintf(buf, sizeof(buf), "w%u.t%u.p%u.example",
+				 i, bt->id, bt->writepct);
+			CHECK(dns_name_fromstring(name, buf, 0, NULL));
+			CHECK(dns_db_findnode(bt->db, name, ISC_TRUE, &node));
+			dns_db_detachnode(bt->db, &node);
+			continue;
+		}
+		snprintf(buf, sizeof(buf), "n%u.example", n);
+		CHECK(dns_name_fromstring(name, buf, 0, NULL));
+		dns_rdataset_init(&rdataset);
+		result = dns_db_find(bt->db, name, NULL, dns_rdatatype_a, 0, 0,
+				     &node, found, &rdataset, NULL);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		dns_db_detachnode(bt->db, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	result = ISC_R_SUCCESS;
+
+ cleanup:
+	bt->result = result;
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(cache_benchmark);
+ATF_TC_HEAD(cache_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "benchmark cache lookups mixed with additions");
+}
+ATF_TC_BODY(cache_benchmark, tc) {
+	static const unsigned int writepcts[] = { 0, 1, 10, 30 };
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_thread_t threads[32];
+	benchthread_t bt[32];
+	isc_time_t ts1, ts2;
+	char buf[BUFLEN];
+	unsigned int i, p, nthreads;
+	double t;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (i = 0; i < CB_NAMES; i++) {
+		snprintf(buf, sizeof(buf), "n%u.example", i);
+		result = dns_name_fromstring(name, buf, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		dns_rdata_init(&rdata);
+		rdata.data = data;
+		rdata.length = 4;
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_a;
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.ttl = 3600;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.rdclass = dns_rdataclass_in;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		dns_rdataset_init(&rdataset);
+		result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		node = NULL;
+		result = dns_db_findnode(db, name, ISC_TRUE, &node);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0,
+					    NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	nthreads = ISC_MIN(isc_os_ncpus(), 32);
+	nthreads = ISC_MAX(nthreads, 2);
+
+	for (p = 0; p < sizeof(writepcts) / sizeof(writepcts[0]); p++) {
+		result = isc_time_now(&ts1);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		for (i = 0; i < nthreads; i++) {
+			bt[i].db = db;
+			bt[i].id = i;
+			bt[i].writepct = writepcts[p];
+			bt[i].result = ISC_R_UNEXPECTED;
+			result = isc_thread_create(cache_bench_thread, &bt[i],
+						   &threads[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		for (i = 0; i < nthreads; i++) {
+			result = isc_thread_join(threads[i], NULL);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			ATF_CHECK_EQ(bt[i].result, ISC_R_SUCCESS);
+		}
+
+		result = isc_time_now(&ts2);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		t = isc_time_microdiff(&ts2, &ts1);
+
+		printf("%u threads, %u%% additions: %u calls, %f seconds, "
+		       "%f calls/second\n", nthreads, writepcts[p],
+		       nthreads * CB_OPS, t / 1000000.0,
+		       (nthreads * CB_OPS) / (t / 1000000.0));
+	}
+
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+#endif /* ISC_PLATFORM_USETHREADS */
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
 	ATF_TP_ADD_TC(tp, getsetservestalettl);
+	ATF_TP_ADD_TC(tp, generation);
 	ATF_TP_ADD_TC(tp, dns_dbfind_staleok);
+	ATF_TP_ADD_TC(tp, cache_threads);
+#ifdef ISC_PLATFORM_USETHREADS
+#ifdef DNS_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, cache_benchmark);
+#endif /* DNS_BENCHMARK_TESTS */
+#endif /* ISC_PLATFORM_USETHREADS */
 	return (atf_no_error());
 }
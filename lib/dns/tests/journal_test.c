@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+
+#include <isc/file.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/diff.h>
+#include <dns/fixedname.h>
+#include <dns/journal.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+
+#include "dnstest.h"
+
+#define JOURNAL		"journal_test.jnl"
+#define COMPACTED	"journal_test.jnw"
+
+static void
+cleanup(void) {
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(COMPACTED);
+}
+
+static void
+addtuple(dns_diff_t *diff, dns_diffop_t op, const char *owner,
+	 dns_rdatatype_t type, const char *text)
+{
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_difftuple_t *tuple = NULL;
+	unsigned char buf[1024];
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_rdata_fromstring(&rdata, dns_rdataclass_in, type,
+					   buf, sizeof(buf), text);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_difftuple_create(mctx, op, name, 300, &rdata, &tuple);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_append(diff, &tuple);
+}
+
+/*
+ * Append transactions taking the zone from serial 'first' to
+ * 'first' + 'count', each adding one A record.
+ */
+static void
+writejournal(isc_uint32_t first, unsigned int count) {
+	dns_journal_t *j = NULL;
+	dns_diff_t diff;
+	char text[100];
+	char owner[100];
+	isc_result_t result;
+	unsigned int i;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_journal_defersync(j);
+
+	for (i = 0; i < count; i++) {
+		dns_diff_init(mctx, &diff);
+		snprintf(text, sizeof(text), "ns.example. hostmaster.example. "
+			 "%u 3600 1800 604800 300", first + i);
+		addtuple(&diff, DNS_DIFFOP_DEL, "example.",
+			 dns_rdatatype_soa, text);
+		snprintf(text, sizeof(text), "ns.example. hostmaster.example. "
+			 "%u 3600 1800 604800 300", first + i + 1);
+		addtuple(&diff, DNS_DIFFOP_ADD, "example.",
+			 dns_rdatatype_soa, text);
+		snprintf(owner, sizeof(owner), "name%u.example.", first + i);
+		addtuple(&diff, DNS_DIFFOP_ADD, owner, dns_rdatatype_a,
+			 "10.53.0.1");
+		result = dns_journal_write_transaction(j, &diff);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_diff_clear(&diff);
+	}
+
+	result = dns_journal_sync(j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Check that every serial from 'first' to 'last' can be found
+ * and that the transactions after it carry the right changes.
+ */
+static void
+checkjournal(isc_uint32_t first, isc_uint32_t last) {
+	dns_journal_t *j = NULL;
+	dns_name_t *name = NULL;
+	isc_uint32_t ttl, serial;
+	dns_rdata_t *rdata = NULL;
+	isc_result_t result;
+	unsigned int n;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_journal_first_serial(j), first);
+	ATF_CHECK_EQ(dns_journal_last_serial(j), last);
+
+	for (serial = first; serial < last; serial++) {
+		result = dns_journal_iter_init(j, serial, last);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_journal_first_rr(j);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		ATF_CHECK_EQ(rdata->type, dns_rdatatype_soa);
+	}
+
+	/*
+	 * Three RRs per transaction.
+	 */
+	result = dns_journal_iter_init(j, first, last);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	n = 0;
+	for (result = dns_journal_first_rr(j);
+	     result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+		n++;
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK_EQ(n, (last - first) * 3);
+
+	if (first != 1) {
+		result = dns_journal_iter_init(j, first - 1, last);
+		ATF_CHECK_EQ(result, ISC_R_RANGE);
+	}
+
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(lookup);
+ATF_TC_HEAD(lookup, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "every serial in a large journal is found");
+}
+ATF_TC_BODY(lookup, tc) {
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	/*
+	 * More transactions than a new journal has index entries,
+	 * added in two sessions.
+	 */
+	writejournal(1, 700);
+	writejournal(701, 300);
+	checkjournal(1, 1001);
+
+	cleanup();
+	dns_test_end();
+}
+
+ATF_TC(compact);
+ATF_TC_HEAD(compact, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "compaction keeps the requested transactions");
+}
+ATF_TC_BODY(compact, tc) {
+	char filename[] = JOURNAL;
+	off_t before, after;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, 1000);
+
+	/*
+	 * The journal is small enough, but its index overflowed:
+	 * it is rewritten without losing anything.
+	 */
+	result = isc_file_getsize(JOURNAL, &before);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_journal_compact(mctx, filename, 1, 100000000);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	checkjournal(1, 1001);
+
+	/*
+	 * The new index has room for twice as many transactions
+	 * (2048 entries of 8 bytes), up from 256.
+	 */
+	result = isc_file_getsize(JOURNAL, &after);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(after - before, (2048 - 256) * 8);
+
+	/*
+	 * Once rewritten there is nothing more to do.
+	 */
+	result = dns_journal_compactprepare(mctx, JOURNAL, 1, 100000000);
+	ATF_CHECK_EQ(result, DNS_R_UPTODATE);
+
+	result = dns_journal_compact(mctx, filename, 900, 4096);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	checkjournal(900, 1001);
+
+	cleanup();
+	dns_test_end();
+}
+
+ATF_TC(background);
+ATF_TC_HEAD(background, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "transactions added during compaction are kept");
+}
+ATF_TC_BODY(background, tc) {
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, 500);
+	result = dns_journal_compactprepare(mctx, JOURNAL, 400, 4096);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(isc_file_exists(COMPACTED));
+
+	writejournal(501, 50);
+	result = dns_journal_compactfinish(mctx, JOURNAL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!isc_file_exists(COMPACTED));
+	checkjournal(400, 551);
+
+	/*
+	 * The journal can be written after compaction.
+	 */
+	writejournal(551, 10);
+	checkjournal(400, 561);
+
+	/*
+	 * A copy of a journal that has since been replaced is
+	 * thrown away.
+	 */
+	result = dns_journal_compactprepare(mctx, JOURNAL, 500, 4096);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_file_remove(JOURNAL);
+	writejournal(5000, 20);
+	result = dns_journal_compactfinish(mctx, JOURNAL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	ATF_CHECK(!isc_file_exists(COMPACTED));
+	checkjournal(5000, 5020);
+
+	cleanup();
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, lookup);
+	ATF_TP_ADD_TC(tp, compact);
+	ATF_TP_ADD_TC(tp, background);
+	return (atf_no_error());
+}
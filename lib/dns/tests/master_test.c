@@ -390,6 +390,108 @@ ATF_TC_BODY(master_includelist, tc) {
 	dns_test_end();
 }
 
+/*
+ * Render every rdataset added during a load, one record per line, and
+ * sort the lines so that loads adding them in different orders can be
+ * compared.
+ */
+static char loaded[64 * 1024];
+static isc_buffer_t loadedbuf;
+
+static isc_result_t
+collect_callback(void *arg, const dns_name_t *owner,
+		 dns_rdataset_t *dataset)
+{
+	UNUSED(arg);
+
+	return (dns_rdataset_totext(dataset, owner, ISC_FALSE, ISC_FALSE,
+				    &loadedbuf));
+}
+
+static int
+compare_lines(const void *a, const void *b) {
+	return (strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+static char *
+sorted_load(const char *testfile, unsigned int nworkers, isc_result_t *resultp)
+{
+	char *lines[1024];
+	char *p, *copy;
+	size_t n = 0, i, len;
+
+	isc_buffer_init(&loadedbuf, loaded, sizeof(loaded) - 1);
+	*resultp = dns_master_loadfileparallel(testfile, &dns_origin,
+					       &dns_origin, dns_rdataclass_in,
+					       0, 0, &callbacks, NULL, NULL,
+					       mctx, 0, nworkers);
+	loaded[isc_buffer_usedlength(&loadedbuf)] = '\0';
+
+	for (p = strtok(loaded, "\n"); p != NULL && n < 1024;
+	     p = strtok(NULL, "\n"))
+		lines[n++] = p;
+	qsort(lines, n, sizeof(lines[0]), compare_lines);
+
+	len = 1;
+	for (i = 0; i < n; i++)
+		len += strlen(lines[i]) + 1;
+	copy = isc_mem_allocate(mctx, len);
+	ATF_REQUIRE(copy != NULL);
+	copy[0] = '\0';
+	for (i = 0; i < n; i++) {
+		strlcat(copy, lines[i], len);
+		strlcat(copy, "\n", len);
+	}
+	return (copy);
+}
+
+/* Parallel load test */
+ATF_TC(parallel);
+ATF_TC_HEAD(parallel, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_loadfileparallel() "
+				       "loads the same data as a sequential "
+				       "load");
+}
+ATF_TC_BODY(parallel, tc) {
+	isc_result_t result;
+	char *sequential, *parallel;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = setup_master(NULL, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	callbacks.add = collect_callback;
+
+	/*
+	 * The file changes $ORIGIN and $TTL part way through and has
+	 * multi-line records, quoted strings and comments containing
+	 * parentheses.
+	 */
+	sequential = sorted_load("testdata/master/master18.data", 1, &result);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(strstr(sequential, "a40.sub.test.") != NULL);
+	ATF_CHECK(strstr(sequential, "mx50.test.") != NULL);
+
+	parallel = sorted_load("testdata/master/master18.data", 4, &result);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(sequential, parallel);
+
+	isc_mem_free(mctx, sequential);
+	isc_mem_free(mctx, parallel);
+
+	/*
+	 * Files using $INCLUDE are loaded sequentially.
+	 */
+	parallel = sorted_load("testdata/master/master8.data", 4, &result);
+	ATF_CHECK_EQ(result, DNS_R_SEENINCLUDE);
+	isc_mem_free(mctx, parallel);
+
+	dns_test_end();
+}
+
 /* Include failure test */
 ATF_TC(includefail);
 ATF_TC_HEAD(includefail, tc) {
@@ -673,6 +775,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, toobig);
 	ATF_TP_ADD_TC(tp, maxrdata);
 	ATF_TP_ADD_TC(tp, neworigin);
+	ATF_TP_ADD_TC(tp, parallel);
 
 	return (atf_no_error());
 }
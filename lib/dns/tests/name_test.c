@@ -24,6 +24,7 @@
 #include <isc/os.h>
 #include <isc/print.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
@@ -277,6 +278,308 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+#define MANYNAMES	800
+
+static void
+many_name(dns_name_t *name, unsigned int i, isc_boolean_t upper) {
+	char namestr[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+
+	snprintf(namestr, sizeof(namestr), "%s%u.sub%u.example%u.test.",
+		 upper ? "HOST" : "host", i, i % 37, i % 5);
+	result = dns_name_fromstring(name, namestr, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+ATF_TC(compression_many);
+ATF_TC_HEAD(compression_many, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "name compression with many names and rollback");
+}
+ATF_TC_BODY(compression_many, tc) {
+	dns_compress_t cctx;
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed1, fixed2;
+	dns_name_t *name, *expected, wirename;
+	isc_buffer_t source, target;
+	unsigned char *buf1, *buf2;
+	unsigned int i, used, count;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	buf1 = isc_mem_get(mctx, 65535);
+	ATF_REQUIRE(buf1 != NULL);
+	buf2 = isc_mem_get(mctx, 65535);
+	ATF_REQUIRE(buf2 != NULL);
+
+	dns_fixedname_init(&fixed1);
+	name = dns_fixedname_name(&fixed1);
+	dns_fixedname_init(&fixed2);
+	expected = dns_fixedname_name(&fixed2);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf1, 65535);
+
+	/*
+	 * Render the first half of the names twice; the second time
+	 * each of them must be a single compression pointer.
+	 */
+	for (i = 0; i < MANYNAMES / 2; i++) {
+		many_name(name, i, ISC_FALSE);
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < MANYNAMES / 2; i++) {
+		many_name(name, i, ISC_TRUE);
+		used = isc_buffer_usedlength(&source);
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(isc_buffer_usedlength(&source) - used, 2);
+	}
+
+	/*
+	 * Render the second half, roll it back, and render it again
+	 * with different case.  Nothing may point into the part of the
+	 * message that was rolled back.
+	 */
+	used = isc_buffer_usedlength(&source);
+	count = cctx.count;
+	for (i = MANYNAMES / 2; i < MANYNAMES; i++) {
+		many_name(name, i, ISC_FALSE);
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK(cctx.count > count);
+	dns_compress_rollback(&cctx, (isc_uint16_t)used);
+	ATF_CHECK_EQ(cctx.count, count);
+	memset(buf1 + used, 0xff, isc_buffer_usedlength(&source) - used);
+	isc_buffer_subtract(&source, isc_buffer_usedlength(&source) - used);
+
+	for (i = MANYNAMES / 2; i < MANYNAMES; i++) {
+		many_name(name, i, ISC_TRUE);
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * Everything must decompress back to the names rendered.
+	 */
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_setactive(&source, isc_buffer_usedlength(&source));
+	for (i = 0; i < MANYNAMES + MANYNAMES / 2; i++) {
+		if (i < MANYNAMES / 2)
+			many_name(expected, i, ISC_FALSE);
+		else
+			many_name(expected, i - MANYNAMES / 2, ISC_TRUE);
+		isc_buffer_init(&target, buf2, 65535);
+		dns_name_init(&wirename, NULL);
+		result = dns_name_fromwire(&wirename, &source, &dctx, 0,
+					   &target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(&wirename, expected));
+	}
+	dns_decompress_invalidate(&dctx);
+
+	isc_mem_put(mctx, buf1, 65535);
+	isc_mem_put(mctx, buf2, 65535);
+
+	dns_test_end();
+}
+
+ATF_TC(compression_reuse);
+ATF_TC_HEAD(compression_reuse, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "name compression with a reused name buffer");
+}
+ATF_TC_BODY(compression_reuse, tc) {
+	dns_compress_t cctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_buffer_t target;
+	unsigned char buf[1024];
+	unsigned int used;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	isc_buffer_init(&target, buf, sizeof(buf));
+
+	/*
+	 * The second rendering of the first name is a full match, so
+	 * it is looked up but not added.
+	 */
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	result = dns_name_fromstring(name, "aaaa.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &target), ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &target), ISC_R_SUCCESS);
+
+	/*
+	 * A different name of the same shape in the same buffer is
+	 * added without being looked up first...
+	 */
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_NONE);
+	result = dns_name_fromstring(name, "bbbb.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &target), ISC_R_SUCCESS);
+
+	/*
+	 * ...and must then be found.
+	 */
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	used = isc_buffer_usedlength(&target);
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &target), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&target) - used, 2);
+
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
+#ifdef DNS_BENCHMARK_TESTS
+
+/*
+ * XXXMUKS: Don't delete this code. It is useful in benchmarking the
+ * name compression code, but we don't require it as part of the unit
+ * test runs.
+ */
+
+#define REFERRALNAMES	53
+#define LARGENAMES	400
+
+static void
+render_names(dns_name_t *names, unsigned int count, unsigned int loops,
+	     const char *what)
+{
+	unsigned char buf[65535];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+	isc_result_t result;
+	isc_time_t ts1, ts2;
+	unsigned int i, j;
+	double t;
+
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < loops; i++) {
+		isc_buffer_init(&target, buf, sizeof(buf));
+		isc_buffer_add(&target, 12);
+		result = dns_compress_init(&cctx, -1, mctx);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		for (j = 0; j < count; j++)
+			(void)dns_name_towire(&names[j], &cctx, &target);
+		dns_compress_invalidate(&cctx);
+	}
+
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u %s responses (%u names, %u bytes), %f seconds, "
+	       "%f responses/second\n", loops, what, count,
+	       isc_buffer_usedlength(&target), t / 1000000.0,
+	       loops / (t / 1000000.0));
+}
+
+ATF_TC(compression_benchmark);
+ATF_TC_HEAD(compression_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark dns_compress_findglobal() and "
+			  "dns_compress_add()");
+}
+ATF_TC_BODY(compression_benchmark, tc) {
+	dns_fixedname_t *fixed;
+	dns_name_t *names;
+	char namestr[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+	unsigned int i, n;
+
+	UNUSED(tc);
+
+	debug_mem_record = ISC_FALSE;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fixed = isc_mem_get(mctx, LARGENAMES * sizeof(*fixed));
+	ATF_REQUIRE(fixed != NULL);
+	names = isc_mem_get(mctx, LARGENAMES * sizeof(*names));
+	ATF_REQUIRE(names != NULL);
+
+	/*
+	 * A referral to the com servers: the question, thirteen NS
+	 * records with their targets, and A and AAAA glue for each.
+	 */
+	n = 0;
+	for (i = 0; i < REFERRALNAMES; i++) {
+		if (i == 0)
+			strlcpy(namestr, "www.example.com.", sizeof(namestr));
+		else if (i <= 26 && i % 2 == 1)
+			strlcpy(namestr, "com.", sizeof(namestr));
+		else
+			snprintf(namestr, sizeof(namestr),
+				 "%c.gtld-servers.net.",
+				 'a' + ((i < 27 ? i / 2 - 1 : i - 27) % 13));
+		dns_fixedname_init(&fixed[n]);
+		result = dns_name_fromstring(dns_fixedname_name(&fixed[n]),
+					     namestr, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		names[n] = *dns_fixedname_name(&fixed[n]);
+		n++;
+	}
+	render_names(names, n, 200000, "referral");
+
+	/*
+	 * A large ANY-style response: owner names and targets spread
+	 * over a number of subdomains and other zones.
+	 */
+	n = 0;
+	for (i = 0; i < LARGENAMES; i++) {
+		if (i % 4 == 0)
+			strlcpy(namestr, "example.com.", sizeof(namestr));
+		else if (i % 4 == 1)
+			snprintf(namestr, sizeof(namestr),
+				 "host%u.dept%u.example.com.", i, i % 23);
+		else if (i % 4 == 2)
+			snprintf(namestr, sizeof(namestr),
+				 "mail%u.example.com.", i % 31);
+		else
+			snprintf(namestr, sizeof(namestr),
+				 "ns%u.dns%u.example.net.", i % 17, i % 3);
+		dns_fixedname_init(&fixed[n]);
+		result = dns_name_fromstring(dns_fixedname_name(&fixed[n]),
+					     namestr, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		names[n] = *dns_fixedname_name(&fixed[n]);
+		n++;
+	}
+	render_names(names, n, 10000, "large");
+
+	isc_mem_put(mctx, names, LARGENAMES * sizeof(*names));
+	isc_mem_put(mctx, fixed, LARGENAMES * sizeof(*fixed));
+
+	dns_test_end();
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
 ATF_TC(istat);
 ATF_TC_HEAD(istat, tc) {
 	atf_tc_set_md_var(tc, "descr", "is trust-anchor-telementry test");
@@ -429,6 +732,11 @@ ATF_TC_BODY(benchmark, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_many);
+	ATF_TP_ADD_TC(tp, compression_reuse);
+#ifdef DNS_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, compression_benchmark);
+#endif /* DNS_BENCHMARK_TESTS */
 	ATF_TP_ADD_TC(tp, istat);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
@@ -100,7 +100,9 @@ delete_data(void *data, void *arg) {
 }
 
 static isc_result_t
-write_data(FILE *file, unsigned char *datap, void *arg, isc_uint64_t *crc) {
+write_data(FILE *file, unsigned char *datap, void *arg,
+	   isc_uint64_t linkbase, isc_uint64_t node, isc_uint64_t *crc)
+{
 	isc_result_t result;
 	size_t ret = 0;
 	data_holder_t *data = (data_holder_t *)datap;
@@ -108,6 +110,7 @@ write_data(FILE *file, unsigned char *datap, void *arg, isc_uint64_t *crc) {
 	off_t where;
 
 	UNUSED(arg);
+	UNUSED(node);
 
 	REQUIRE(file != NULL);
 	REQUIRE(crc != NULL);
@@ -122,7 +125,8 @@ write_data(FILE *file, unsigned char *datap, void *arg, isc_uint64_t *crc) {
 	temp = *data;
 	temp.data = (data->len == 0
 		     ? NULL
-		     : (char *)((uintptr_t)where + sizeof(data_holder_t)));
+		     : (char *)(uintptr_t)(linkbase + where +
+					   sizeof(data_holder_t)));
 
 	isc_crc64_update(crc, (void *)&temp, sizeof(temp));
 	ret = fwrite(&temp, sizeof(data_holder_t), 1, file);
@@ -139,10 +143,11 @@ write_data(FILE *file, unsigned char *datap, void *arg, isc_uint64_t *crc) {
 }
 
 static isc_result_t
-fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
-	 isc_uint64_t *crc)
+fix_data(dns_rbtnode_t *p, void *base, size_t max, isc_uint64_t linkbase,
+	 void *arg, isc_uint64_t *crc)
 {
 	data_holder_t *data = p->data;
+	char *expected;
 	size_t size;
 
 	UNUSED(base);
@@ -163,18 +168,27 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 	    (data->len != 0 && data->data == NULL))
 		return (ISC_R_INVALIDFILE);
 
-	size = max - ((char *)p - (char *)base);
+	size = max - ((char *)data - (char *)base);
+	expected = (char *)(uintptr_t)(linkbase +
+				       ((char *)data - (char *)base) +
+				       sizeof(data_holder_t));
 
-	if (data->len > (int) size || data->data > (const char *) max) {
+	if (size < sizeof(data_holder_t) || data->len < 0 ||
+	    (size_t)data->len > size - sizeof(data_holder_t) ||
+	    (data->len != 0 && data->data != expected))
+	{
 		printf("data invalid\n");
 		return (ISC_R_INVALIDFILE);
 	}
 
 	isc_crc64_update(crc, (void *)data, sizeof(*data));
 
-	data->data = (data->len == 0)
-		? NULL
-		: (char *)data + sizeof(data_holder_t);
+	/*
+	 * Leave the image alone if it is mapped where it was linked.
+	 */
+	if (data->len > 0 &&
+	    data->data != (char *)data + sizeof(data_holder_t))
+		data->data = (char *)data + sizeof(data_holder_t);
 
 	if (data->len > 0)
 		isc_crc64_update(crc, (const void *)data->data, data->len);
@@ -304,7 +318,7 @@ ATF_TC_BODY(serialize, tc) {
 	rbtfile = fopen("./zone.bin", "w+b");
 	ATF_REQUIRE(rbtfile != NULL);
 	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
-					&offset);
+					0, &offset);
 	ATF_REQUIRE(result == ISC_R_SUCCESS);
 	dns_rbt_destroy(&rbt);
 
@@ -343,6 +357,80 @@ ATF_TC_BODY(serialize, tc) {
 	dns_test_end();
 }
 
+ATF_TC(deserialize_inplace);
+ATF_TC_HEAD(deserialize_inplace, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test that an image mapped at its link base "
+			  "is used without being written to");
+}
+ATF_TC_BODY(deserialize_inplace, tc) {
+	dns_rbt_t *rbt = NULL;
+	isc_result_t result;
+	FILE *rbtfile = NULL;
+	dns_rbt_t *rbt_deserialized = NULL;
+	uintptr_t linkbase;
+	off_t offset;
+	int fd;
+	off_t filesize = 0;
+	char *base;
+
+	UNUSED(tc);
+
+	if (sizeof(uintptr_t) < sizeof(isc_uint64_t))
+		atf_tc_skip("no spare address space for a link base");
+
+	/* A 2MB aligned address well clear of the default mappings. */
+	linkbase = (uintptr_t)(((isc_uint64_t)1 << 44) +
+			       ((isc_uint64_t)12345 << 21));
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_create(mctx, delete_data, NULL, &rbt);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	add_test_data(mctx, rbt);
+
+	rbtfile = fopen("./zone.bin", "w+b");
+	ATF_REQUIRE(rbtfile != NULL);
+	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
+					linkbase, &offset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	fclose(rbtfile);
+	dns_rbt_destroy(&rbt);
+
+	/*
+	 * Map the image read-only at its link base: any write while
+	 * reading it in, or while looking names up, would fault.
+	 */
+	fd = open("zone.bin", O_RDWR);
+	ATF_REQUIRE(fd >= 0);
+	isc_file_getsizefd(fd, &filesize);
+	base = mmap((void *)linkbase, filesize, PROT_READ,
+		    MAP_FILE|MAP_PRIVATE, fd, 0);
+	ATF_REQUIRE(base != NULL && base != MAP_FAILED);
+	close(fd);
+	if (base != (char *)linkbase) {
+		munmap(base, filesize);
+		unlink("zone.bin");
+		dns_test_end();
+		atf_tc_skip("link base address is not available");
+	}
+
+	result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
+					  delete_data, NULL, fix_data, NULL,
+					  NULL, &rbt_deserialized);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(rbt_deserialized != NULL);
+
+	check_test_data(rbt_deserialized);
+
+	ATF_REQUIRE(mprotect(base, filesize, PROT_READ|PROT_WRITE) == 0);
+	dns_rbt_destroy(&rbt_deserialized);
+	munmap(base, filesize);
+	unlink("zone.bin");
+	dns_test_end();
+}
+
 ATF_TC(deserialize_corrupt);
 ATF_TC_HEAD(deserialize_corrupt, tc) {
 	atf_tc_set_md_var(tc, "descr", "Test reading a corrupt map file");
@@ -373,7 +461,7 @@ ATF_TC_BODY(deserialize_corrupt, tc) {
 	rbtfile = fopen("./zone.bin", "w+b");
 	ATF_REQUIRE(rbtfile != NULL);
 	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
-					&offset);
+					0, &offset);
 	ATF_REQUIRE(result == ISC_R_SUCCESS);
 	dns_rbt_destroy(&rbt);
 
@@ -450,6 +538,7 @@ ATF_TC_BODY(serialize_align, tc) {
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, serialize);
+	ATF_TP_ADD_TC(tp, deserialize_inplace);
 	ATF_TP_ADD_TC(tp, deserialize_corrupt);
 	ATF_TP_ADD_TC(tp, serialize_align);
 
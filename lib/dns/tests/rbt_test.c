@@ -1078,6 +1078,82 @@ ATF_TC_BODY(rbt_insert_and_remove, tc) {
 	dns_test_end();
 }
 
+static isc_boolean_t
+find_helper(dns_rbt_t *rbt, unsigned int i) {
+	char namestr[sizeof("name4294967295.example.org.")];
+	dns_fixedname_t fname;
+	dns_rbtnode_t *node = NULL;
+	isc_result_t result;
+
+	snprintf(namestr, sizeof(namestr), "name%u.example.org.", i);
+	build_name_from_str(namestr, &fname);
+	result = dns_rbt_findnode(rbt, dns_fixedname_name(&fname), NULL,
+				  &node, NULL, DNS_RBTFIND_EMPTYDATA,
+				  NULL, NULL);
+	return (ISC_TF(result == ISC_R_SUCCESS && node != NULL &&
+		       node->data == (void *)(uintptr_t)(i + 1)));
+}
+
+ATF_TC(rbt_hash_grow);
+ATF_TC_HEAD(rbt_hash_grow, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test lookups and removals while the hash table "
+			  "is being resized");
+}
+ATF_TC_BODY(rbt_hash_grow, tc) {
+	char namestr[sizeof("name4294967295.example.org.")];
+	dns_fixedname_t fname;
+	dns_rbt_t *mytree = NULL;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+	const unsigned int count = 20000;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, NULL, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Every insertion must be visible immediately, and earlier
+	 * names must stay visible, whichever table they are in.
+	 */
+	for (i = 0; i < count; i++) {
+		snprintf(namestr, sizeof(namestr), "name%u.example.org.", i);
+		node = NULL;
+		result = insert_helper(mytree, namestr, &node);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		node->data = (void *)(uintptr_t)(i + 1);
+
+		ATF_REQUIRE(find_helper(mytree, i));
+		ATF_REQUIRE(find_helper(mytree, i / 2));
+	}
+	ATF_CHECK(dns_rbt_hashsize(mytree) * 3 > count);
+
+	for (i = 0; i < count; i++)
+		ATF_REQUIRE(find_helper(mytree, i));
+
+	/*
+	 * Remove every other name; the rest must still be found.
+	 */
+	for (i = 0; i < count; i += 2) {
+		snprintf(namestr, sizeof(namestr), "name%u.example.org.", i);
+		build_name_from_str(namestr, &fname);
+		result = dns_rbt_deletename(mytree, dns_fixedname_name(&fname),
+					    ISC_FALSE);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < count; i++)
+		ATF_CHECK_EQ(find_helper(mytree, i), ISC_TF(i % 2 == 1));
+
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -1220,6 +1296,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, rbt_insert);
 	ATF_TP_ADD_TC(tp, rbt_remove);
 	ATF_TP_ADD_TC(tp, rbt_insert_and_remove);
+	ATF_TP_ADD_TC(tp, rbt_hash_grow);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+static void
+makename(const char *text, dns_fixedname_t *fixed, dns_name_t **namep) {
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	*namep = dns_fixedname_name(fixed);
+	result = dns_name_fromstring(*namep, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+addresponse(dns_respcache_t *rc, dns_name_t *name, dns_rdatatype_t type,
+	    isc_uint32_t variant, isc_uint32_t generation, const char *data)
+{
+	isc_region_t r;
+
+	DE_CONST(data, r.base);
+	r.length = strlen(data);
+	dns_respcache_add(rc, name, type, variant, generation, &r);
+}
+
+static isc_result_t
+findresponse(dns_respcache_t *rc, dns_name_t *name, dns_rdatatype_t type,
+	     isc_uint32_t variant, isc_uint32_t generation, char *buf,
+	     size_t size)
+{
+	isc_buffer_t b;
+	isc_result_t result;
+
+	memset(buf, 0, size);
+	isc_buffer_init(&b, buf, size - 1);
+	result = dns_respcache_find(rc, name, type, variant, generation, &b);
+	if (result == ISC_R_SUCCESS)
+		ATF_CHECK_EQ(isc_buffer_usedlength(&b), strlen(buf));
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(findadd);
+ATF_TC_HEAD(findadd, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "responses are only found under their exact key");
+}
+ATF_TC_BODY(findadd, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_fixedname_t f1, f2, f3;
+	dns_name_t *name, *upper, *other;
+	isc_result_t result;
+	char buf[64];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makename("www.example.", &f1, &name);
+	makename("WWW.example.", &f2, &upper);
+	makename("ftp.example.", &f3, &other);
+
+	result = dns_respcache_create(mctx, 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	addresponse(rc, name, dns_rdatatype_a, 0, 1, "response one");
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(buf, "response one");
+
+	/*
+	 * Every part of the key must match, and the name must match
+	 * case-sensitively.
+	 */
+	result = findresponse(rc, name, dns_rdatatype_aaaa, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findresponse(rc, name, dns_rdatatype_a, 1, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 2,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findresponse(rc, upper, dns_rdatatype_a, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findresponse(rc, other, dns_rdatatype_a, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/*
+	 * A response for a newer generation replaces the old one.
+	 */
+	addresponse(rc, name, dns_rdatatype_a, 0, 2, "response two");
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 1,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 2,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(buf, "response two");
+
+	/*
+	 * The response does not fit.
+	 */
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 2, buf, 5);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	dns_respcache_flush(rc);
+	result = findresponse(rc, name, dns_rdatatype_a, 0, 2,
+			      buf, sizeof(buf));
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&rc);
+	ATF_CHECK_EQ(rc, NULL);
+
+	dns_test_end();
+}
+
+ATF_TC(collisions);
+ATF_TC_HEAD(collisions, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a full cache keeps working and frees replaced "
+			  "entries");
+}
+ATF_TC_BODY(collisions, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+	unsigned int i, found = 0;
+	size_t inuse;
+	char text[64], buf[64];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Eight slots for a hundred responses: most are replaced, and
+	 * all of them must have been freed once the cache is destroyed.
+	 */
+	inuse = isc_mem_inuse(mctx);
+	result = dns_respcache_create(mctx, 8, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 100; i++) {
+		snprintf(text, sizeof(text), "name%u.example.", i);
+		makename(text, &fixed, &name);
+		addresponse(rc, name, dns_rdatatype_a, 0, 1, text);
+	}
+
+	for (i = 0; i < 100; i++) {
+		snprintf(text, sizeof(text), "name%u.example.", i);
+		makename(text, &fixed, &name);
+		result = findresponse(rc, name, dns_rdatatype_a, 0, 1,
+				      buf, sizeof(buf));
+		if (result == ISC_R_SUCCESS) {
+			ATF_CHECK_STREQ(buf, text);
+			found++;
+		} else
+			ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	}
+	ATF_CHECK(found > 0 && found <= 8);
+
+	dns_respcache_destroy(&rc);
+	ATF_CHECK_EQ(isc_mem_inuse(mctx), inuse);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, findadd);
+	ATF_TP_ADD_TC(tp, collisions);
+	return (atf_no_error());
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/net.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rrl.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define SET_RATE(rrl, rate, value)			\
+	do {						\
+		(rrl)->rate.r = (value);		\
+		(rrl)->rate.scaled = (value);		\
+		(rrl)->rate.str = #rate;		\
+	} while (0)
+
+/*
+ * Set up a view with response rate limiting as named would for
+ * "responses-per-second 2; slip 0; window 15;".
+ */
+static dns_rrl_t *
+setup(dns_view_t **viewp, int min_entries, int max_entries) {
+	dns_rrl_t *rrl = NULL;
+	isc_result_t result;
+	int i;
+
+	result = dns_test_makeview("view", viewp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rrl_init(&rrl, *viewp, min_entries);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rrl->max_entries = max_entries;
+	SET_RATE(rrl, responses_per_second, 2);
+	SET_RATE(rrl, referrals_per_second, 2);
+	SET_RATE(rrl, nodata_per_second, 2);
+	SET_RATE(rrl, nxdomains_per_second, 2);
+	SET_RATE(rrl, errors_per_second, 2);
+	SET_RATE(rrl, all_per_second, 0);
+	SET_RATE(rrl, slip, 0);
+	rrl->window = 15;
+	rrl->qps_scale = 0;
+	rrl->ipv4_prefixlen = 24;
+	rrl->ipv4_mask = htonl(0xffffff00);
+	rrl->ipv6_prefixlen = 56;
+	for (i = 0; i < 4; i++)
+		rrl->ipv6_mask[i] = 0;
+	rrl->ipv6_mask[0] = 0xffffffff;
+	rrl->ipv6_mask[1] = htonl(0xffffff00);
+
+	return (rrl);
+}
+
+static dns_rrl_result_t
+respond(dns_view_t *view, isc_uint32_t addr, const dns_name_t *qname,
+	isc_stdtime_t now)
+{
+	isc_sockaddr_t client;
+	struct in_addr ina;
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+
+	ina.s_addr = htonl(addr);
+	isc_sockaddr_fromin(&client, &ina, 53);
+	return (dns_rrl(view, &client, ISC_FALSE, dns_rdataclass_in,
+			dns_rdatatype_a, qname, ISC_R_SUCCESS, now,
+			ISC_FALSE, log_buf, sizeof(log_buf)));
+}
+
+static int
+count_entries(dns_rrl_t *rrl) {
+	unsigned int i;
+	int n = 0;
+
+	for (i = 0; i < rrl->nshards; i++)
+		n += rrl->shards[i].num_entries;
+	return (n);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(limit);
+ATF_TC_HEAD(limit, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "responses are limited per client address block");
+}
+ATF_TC_BODY(limit, tc) {
+	dns_view_t *view = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *qname;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	qname = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(qname, "www.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	(void)setup(&view, 10, 100);
+	isc_stdtime_get(&now);
+
+	ATF_CHECK_EQ(respond(view, 0x0a000001, qname, now),
+		     DNS_RRL_RESULT_OK);
+	ATF_CHECK_EQ(respond(view, 0x0a000001, qname, now),
+		     DNS_RRL_RESULT_OK);
+	ATF_CHECK_EQ(respond(view, 0x0a000001, qname, now),
+		     DNS_RRL_RESULT_DROP);
+
+	/*
+	 * The same /24 shares the limit; other blocks do not.
+	 */
+	ATF_CHECK_EQ(respond(view, 0x0a000002, qname, now),
+		     DNS_RRL_RESULT_DROP);
+	ATF_CHECK_EQ(respond(view, 0x0a000101, qname, now),
+		     DNS_RRL_RESULT_OK);
+	ATF_CHECK_EQ(respond(view, 0xc0000201, qname, now),
+		     DNS_RRL_RESULT_OK);
+
+	/*
+	 * Credit is earned back over time.
+	 */
+	ATF_CHECK_EQ(respond(view, 0x0a000001, qname, now + 5),
+		     DNS_RRL_RESULT_OK);
+
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "the table grows under load up to max-table-size");
+}
+ATF_TC_BODY(grow, tc) {
+	dns_view_t *view = NULL;
+	dns_rrl_t *rrl;
+	dns_fixedname_t fixed;
+	dns_name_t *qname;
+	isc_stdtime_t now;
+	isc_result_t result;
+	isc_uint32_t i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	qname = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(qname, "www.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Without a maximum, every busy client gets an entry.
+	 */
+	rrl = setup(&view, 4, 0);
+	isc_stdtime_get(&now);
+	for (i = 0; i < 2000; i++)
+		(void)respond(view, 0x0a000000 + (i << 8), qname, now);
+	ATF_CHECK(count_entries(rrl) >= 1000);
+
+	/*
+	 * Clients that are still remembered are still limited.
+	 */
+	for (i = 0; i < 2; i++)
+		(void)respond(view, 0x0b000001, qname, now);
+	ATF_CHECK_EQ(respond(view, 0x0b000001, qname, now),
+		     DNS_RRL_RESULT_DROP);
+	dns_view_detach(&view);
+
+	/*
+	 * With a maximum, the oldest entries are recycled instead.
+	 */
+	rrl = setup(&view, 4, 64);
+	for (i = 0; i < 2000; i++)
+		(void)respond(view, 0x0a000000 + (i << 8), qname, now);
+	ATF_CHECK(count_entries(rrl) > 4);
+	ATF_CHECK(count_entries(rrl) <= 64);
+	dns_view_detach(&view);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, limit);
+	ATF_TP_ADD_TC(tp, grow);
+	return (atf_no_error());
+}
@@ -20,6 +20,8 @@
 #include <isc/task.h>
 #include <isc/timer.h>
 
+#include <dns/diff.h>
+#include <dns/journal.h>
 #include <dns/name.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -219,6 +221,177 @@ ATF_TC_BODY(zonemgr_unreachable, tc) {
 }
 
 
+ATF_TC(zonemgr_iolimit);
+ATF_TC_HEAD(zonemgr_iolimit, tc) {
+	atf_tc_set_md_var(tc, "descr", "zone file I/O concurrency limit");
+}
+ATF_TC_BODY(zonemgr_iolimit, tc) {
+	dns_zonemgr_t *myzonemgr = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
+				    &myzonemgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The default allows more than one load per CPU. */
+	ATF_CHECK(dns_zonemgr_getiolimit(myzonemgr) > 1);
+	ATF_CHECK_EQ(dns_zonemgr_getcount(myzonemgr, DNS_ZONESTATE_LOADING),
+		     0);
+
+	dns_zonemgr_setiolimit(myzonemgr, 7);
+	ATF_CHECK_EQ(dns_zonemgr_getiolimit(myzonemgr), 7);
+
+	dns_zonemgr_shutdown(myzonemgr);
+	dns_zonemgr_detach(&myzonemgr);
+	ATF_REQUIRE_EQ(myzonemgr, NULL);
+
+	dns_test_end();
+}
+
+static isc_boolean_t synced;
+static isc_result_t syncresult;
+
+static void
+journalsynced(void *arg, isc_result_t result) {
+	UNUSED(arg);
+
+	syncresult = result;
+	synced = ISC_TRUE;
+}
+
+static void
+addtuple(dns_diff_t *diff, dns_diffop_t op, dns_name_t *name,
+	 dns_rdatatype_t type, const char *text)
+{
+	unsigned char buf[1024];
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_difftuple_t *tuple = NULL;
+	isc_result_t result;
+
+	result = dns_test_rdata_fromstring(&rdata, dns_rdataclass_in, type,
+					   buf, sizeof(buf), text);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_difftuple_create(mctx, op, name, 300, &rdata, &tuple);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_append(diff, &tuple);
+}
+
+static void
+writeupdate(dns_zone_t *zone, isc_uint32_t serial) {
+	dns_name_t *origin = dns_zone_getorigin(zone);
+	char text[100];
+	dns_diff_t diff;
+	isc_result_t result;
+
+	dns_diff_init(mctx, &diff);
+	snprintf(text, sizeof(text), ". . %u 0 0 0 0", serial);
+	addtuple(&diff, DNS_DIFFOP_DEL, origin, dns_rdatatype_soa, text);
+	snprintf(text, sizeof(text), ". . %u 0 0 0 0", serial + 1);
+	addtuple(&diff, DNS_DIFFOP_ADD, origin, dns_rdatatype_soa, text);
+	snprintf(text, sizeof(text), "10.0.0.%u", serial);
+	addtuple(&diff, DNS_DIFFOP_ADD, origin, dns_rdatatype_a, text);
+
+	result = dns_zone_writejournal(zone, &diff);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_clear(&diff);
+}
+
+ATF_TC(zonemgr_journalcommit);
+ATF_TC_HEAD(zonemgr_journalcommit, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "journal group commit with a commit delay");
+}
+ATF_TC_BODY(zonemgr_journalcommit, tc) {
+	const char *journalfile = "zonemgr_test.jnl";
+	dns_zonemgr_t *myzonemgr = NULL;
+	dns_zone_t *zone = NULL;
+	dns_journal_t *journal = NULL;
+	isc_result_t result;
+	int i;
+
+	UNUSED(tc);
+
+	(void)unlink(journalfile);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
+				    &myzonemgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_setsize(myzonemgr, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makezone("example", &zone, NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_managezone(myzonemgr, zone);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zone_setjournal(zone, journalfile);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_zone_setcommitdelay(zone, 200);
+	ATF_CHECK_EQ(dns_zone_getcommitdelay(zone), 200);
+
+	/*
+	 * Transactions written within the delay are not yet visible.
+	 */
+	writeupdate(zone, 1);
+	writeupdate(zone, 2);
+	result = dns_journal_open(mctx, journalfile, DNS_JOURNAL_READ,
+				  &journal);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_journal_empty(journal));
+	dns_journal_destroy(&journal);
+
+	/*
+	 * Once the commit timer has fired, both are there.
+	 */
+	synced = ISC_FALSE;
+	dns_zone_afterjournalsync(zone, journalsynced, NULL);
+	for (i = 0; i < 50 && !synced; i++)
+		dns_test_nap(100000);
+	ATF_REQUIRE(synced);
+	ATF_CHECK_EQ(syncresult, ISC_R_SUCCESS);
+
+	result = dns_journal_open(mctx, journalfile, DNS_JOURNAL_READ,
+				  &journal);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_journal_first_serial(journal), 1);
+	ATF_CHECK_EQ(dns_journal_last_serial(journal), 3);
+	dns_journal_destroy(&journal);
+
+	/*
+	 * With nothing pending, waiters are told at once.
+	 */
+	synced = ISC_FALSE;
+	dns_zone_afterjournalsync(zone, journalsynced, NULL);
+	ATF_CHECK(synced);
+
+	/*
+	 * Without a delay, each transaction is synced as it is written.
+	 */
+	dns_zone_setcommitdelay(zone, 0);
+	writeupdate(zone, 3);
+	result = dns_journal_open(mctx, journalfile, DNS_JOURNAL_READ,
+				  &journal);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_journal_last_serial(journal), 4);
+	dns_journal_destroy(&journal);
+
+	dns_zonemgr_releasezone(myzonemgr, zone);
+	dns_zone_detach(&zone);
+	dns_zonemgr_shutdown(myzonemgr);
+	dns_zonemgr_detach(&myzonemgr);
+
+	(void)unlink(journalfile);
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -227,6 +400,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, zonemgr_managezone);
 	ATF_TP_ADD_TC(tp, zonemgr_createzone);
 	ATF_TP_ADD_TC(tp, zonemgr_unreachable);
+	ATF_TP_ADD_TC(tp, zonemgr_iolimit);
+	ATF_TP_ADD_TC(tp, zonemgr_journalcommit);
 	return (atf_no_error());
 }
 
@@ -243,8 +418,6 @@ ATF_TP_ADD_TCS(tp) {
  * 	- dns_zonemgr_getttransfersin
  * 	- dns_zonemgr_settransfersperns
  * 	- dns_zonemgr_getttransfersperns
- * 	- dns_zonemgr_setiolimit
- * 	- dns_zonemgr_getiolimit
  * 	- dns_zonemgr_dbdestroyed
  * 	- dns_zonemgr_setserialqueryrate
  * 	- dns_zonemgr_getserialqueryrate
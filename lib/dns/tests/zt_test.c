@@ -182,6 +182,8 @@ ATF_TC_BODY(asyncload_zone, tc) {
 	ATF_CHECK(db != NULL);
 	if (db != NULL)
 		dns_db_detach(&db);
+	ATF_CHECK(dns_zone_getloadduration(zone) > 0);
+	ATF_CHECK_EQ(dns_zonemgr_getcount(zonemgr, DNS_ZONESTATE_LOADING), 0);
 
 	dns_test_releasezone(zone);
 	dns_test_closezonemgr();
@@ -46,6 +46,7 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
@@ -248,6 +249,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->failcache = NULL;
 	(void)dns_badcache_init(view->mctx, DNS_VIEW_FAILCACHESIZE,
 				   &view->failcache);
+	view->respcache = NULL;
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
@@ -532,6 +534,8 @@ destroy(dns_view_t *view) {
 	dns_aclenv_destroy(&view->aclenv);
 	if (view->failcache != NULL)
 		dns_badcache_destroy(&view->failcache);
+	if (view->respcache != NULL)
+		dns_respcache_destroy(&view->respcache);
 	DESTROYLOCK(&view->new_zone_lock);
 	DESTROYLOCK(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -61,6 +61,14 @@
 		if (result != ISC_R_SUCCESS) goto failure;	\
 	} while (0)
 
+/*%
+ * When an AXFR is loaded in a separate task, the records are handed
+ * over in batches of about XFRIN_BATCH, and reading from the master
+ * stops while XFRIN_MAXAPPLIES batches are waiting to be loaded.
+ */
+#define XFRIN_BATCH		1000
+#define XFRIN_MAXAPPLIES	4
+
 /*%
  * The states of the *XFR state machine.  We handle both IXFR and AXFR
  * with a single integrated state machine because they cannot be distinguished
@@ -93,12 +101,16 @@ struct dns_xfrin_ctx {
 	int			refcount;
 
 	isc_task_t 		*task;
+	isc_task_t		*applytask;	/*%< Loads AXFR data, or NULL */
 	isc_timer_t		*timer;
 	isc_socketmgr_t 	*socketmgr;
 
 	int			connects; 	/*%< Connect in progress */
 	int			sends;		/*%< Send in progress */
 	int			recvs;	  	/*%< Receive in progress */
+	int			applies;	/*%< AXFR batches being loaded */
+	isc_boolean_t		stalled;	/*%< Waiting for 'applies' to
+						     drop before reading */
 	isc_boolean_t		shuttingdown;
 	isc_result_t		shutdown_result;
 
@@ -161,6 +173,12 @@ struct dns_xfrin_ctx {
 	 */
 	dns_rdatacallbacks_t	axfr;
 
+	/*%
+	 * Result of the first AXFR batch that failed to load.  Only
+	 * touched in 'applytask'.
+	 */
+	isc_result_t		applyresult;
+
 	struct {
 		isc_uint32_t 	request_serial;
 		isc_uint32_t 	current_serial;
@@ -169,6 +187,16 @@ struct dns_xfrin_ctx {
 	} ixfr;
 };
 
+/*%
+ * A batch of AXFR records on its way to 'applytask' and back.
+ */
+typedef struct {
+	isc_event_t		event;
+	dns_diff_t		diff;
+	isc_boolean_t		commit;		/*%< Last batch: end the load */
+	isc_result_t		result;
+} xfrin_apply_t;
+
 #define XFRIN_MAGIC		  ISC_MAGIC('X', 'f', 'r', 'I')
 #define VALID_XFRIN(x)		  ISC_MAGIC_VALID(x, XFRIN_MAGIC)
 
@@ -182,6 +210,7 @@ xfrin_create(isc_mem_t *mctx,
 	     dns_zone_t *zone,
 	     dns_db_t *db,
 	     isc_task_t *task,
+	     isc_task_t *applytask,
 	     isc_timermgr_t *timermgr,
 	     isc_socketmgr_t *socketmgr,
 	     dns_name_t *zonename,
@@ -199,6 +228,7 @@ static isc_result_t axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 				   dns_name_t *name, dns_ttl_t ttl,
 				   dns_rdata_t *rdata);
 static isc_result_t axfr_apply(dns_xfrin_ctx_t *xfr);
+static isc_result_t axfr_queue(dns_xfrin_ctx_t *xfr, isc_boolean_t commit);
 static isc_result_t axfr_commit(dns_xfrin_ctx_t *xfr);
 static isc_result_t axfr_finalize(dns_xfrin_ctx_t *xfr);
 
@@ -213,12 +243,15 @@ static isc_result_t xfr_rr(dns_xfrin_ctx_t *xfr, dns_name_t *name,
 			   isc_uint32_t ttl, dns_rdata_t *rdata);
 
 static isc_result_t xfrin_start(dns_xfrin_ctx_t *xfr);
+static isc_result_t xfrin_end(dns_xfrin_ctx_t *xfr);
 
 static void xfrin_connect_done(isc_task_t *task, isc_event_t *event);
 static isc_result_t xfrin_send_request(dns_xfrin_ctx_t *xfr);
 static void xfrin_send_done(isc_task_t *task, isc_event_t *event);
 static void xfrin_recv_done(isc_task_t *task, isc_event_t *event);
 static void xfrin_timeout(isc_task_t *task, isc_event_t *event);
+static void xfrin_apply(isc_task_t *task, isc_event_t *event);
+static void xfrin_applydone(isc_task_t *task, isc_event_t *event);
 
 static void maybe_free(dns_xfrin_ctx_t *xfr);
 
@@ -296,7 +329,7 @@ axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op,
 				   name, ttl, rdata, &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100)
+	if (++xfr->difflen > (xfr->applytask != NULL ? XFRIN_BATCH : 100))
 		CHECK(axfr_apply(xfr));
 	result = ISC_R_SUCCESS;
  failure:
@@ -311,6 +344,9 @@ axfr_apply(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 	isc_uint64_t records;
 
+	if (xfr->applytask != NULL)
+		return (axfr_queue(xfr, ISC_FALSE));
+
 	CHECK(dns_diff_load(&xfr->diff, xfr->axfr.add, xfr->axfr.add_private));
 	xfr->difflen = 0;
 	dns_diff_clear(&xfr->diff);
@@ -330,6 +366,9 @@ static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 
+	if (xfr->applytask != NULL)
+		return (axfr_queue(xfr, ISC_TRUE));
+
 	CHECK(axfr_apply(xfr));
 	CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 
@@ -338,6 +377,101 @@ axfr_commit(dns_xfrin_ctx_t *xfr) {
 	return (result);
 }
 
+/*
+ * Hand the pending AXFR records to 'applytask'.  With 'commit',
+ * this is the last batch and the load is ended once it is in.
+ */
+static isc_result_t
+axfr_queue(dns_xfrin_ctx_t *xfr, isc_boolean_t commit) {
+	xfrin_apply_t *ap;
+
+	ap = (xfrin_apply_t *)isc_event_allocate(xfr->mctx, xfr,
+						 DNS_EVENT_XFRINAPPLY,
+						 xfrin_apply, xfr,
+						 sizeof(*ap));
+	if (ap == NULL)
+		return (ISC_R_NOMEMORY);
+	dns_diff_init(xfr->mctx, &ap->diff);
+	ISC_LIST_APPENDLIST(ap->diff.tuples, xfr->diff.tuples, link);
+	xfr->difflen = 0;
+	ap->commit = commit;
+	ap->result = ISC_R_UNSET;
+
+	xfr->applies++;
+	isc_task_send(xfr->applytask, ISC_EVENT_PTR(&ap));
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Load a batch of AXFR records, in 'applytask'.  Batches arrive in
+ * order and only this task touches the database being loaded until
+ * the last one is done.
+ */
+static void
+xfrin_apply(isc_task_t *task, isc_event_t *event) {
+	xfrin_apply_t *ap = (xfrin_apply_t *)event;
+	dns_xfrin_ctx_t *xfr = event->ev_arg;
+	isc_uint64_t records;
+	isc_result_t result;
+
+	REQUIRE(VALID_XFRIN(xfr));
+
+	UNUSED(task);
+
+	CHECK(xfr->applyresult);
+	CHECK(dns_diff_load(&ap->diff, xfr->axfr.add, xfr->axfr.add_private));
+	if (xfr->maxrecords != 0U) {
+		result = dns_db_getsize(xfr->db, NULL, &records, NULL);
+		if (result == ISC_R_SUCCESS && records > xfr->maxrecords)
+			FAIL(DNS_R_TOOMANYRECORDS);
+	}
+	if (ap->commit)
+		CHECK(dns_db_endload(xfr->db, &xfr->axfr));
+	result = ISC_R_SUCCESS;
+
+ failure:
+	dns_diff_clear(&ap->diff);
+	xfr->applyresult = result;
+	ap->result = result;
+	event->ev_action = xfrin_applydone;
+	isc_task_send(xfr->task, &event);
+}
+
+static void
+xfrin_applydone(isc_task_t *task, isc_event_t *event) {
+	xfrin_apply_t *ap = (xfrin_apply_t *)event;
+	dns_xfrin_ctx_t *xfr = event->ev_arg;
+	isc_boolean_t commit = ap->commit;
+	isc_result_t result = ap->result;
+
+	REQUIRE(VALID_XFRIN(xfr));
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	xfr->applies--;
+	if (xfr->shuttingdown) {
+		maybe_free(xfr);
+		return;
+	}
+
+	CHECK(result);
+	if (commit) {
+		CHECK(xfrin_end(xfr));
+	} else if (xfr->stalled) {
+		xfr->stalled = ISC_FALSE;
+		CHECK(isc_timer_touch(xfr->timer));
+		CHECK(dns_tcpmsg_readmessage(&xfr->tcpmsg, xfr->task,
+					     xfrin_recv_done, xfr));
+		xfr->recvs++;
+	}
+	return;
+
+ failure:
+	xfrin_fail(xfr, result, "failed while receiving responses");
+}
+
 static isc_result_t
 axfr_finalize(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
@@ -675,6 +809,20 @@ dns_xfrin_create3(dns_zone_t *zone, dns_rdatatype_t xfrtype,
 		  isc_timermgr_t *timermgr, isc_socketmgr_t *socketmgr,
 		  isc_task_t *task, dns_xfrindone_t done,
 		  dns_xfrin_ctx_t **xfrp)
+{
+	return (dns_xfrin_create4(zone, xfrtype, masteraddr, sourceaddr, dscp,
+				  tsigkey, mctx, timermgr, socketmgr, task,
+				  NULL, done, xfrp));
+}
+
+isc_result_t
+dns_xfrin_create4(dns_zone_t *zone, dns_rdatatype_t xfrtype,
+		  const isc_sockaddr_t *masteraddr,
+		  const isc_sockaddr_t *sourceaddr,
+		  isc_dscp_t dscp, dns_tsigkey_t *tsigkey, isc_mem_t *mctx,
+		  isc_timermgr_t *timermgr, isc_socketmgr_t *socketmgr,
+		  isc_task_t *task, isc_task_t *applytask,
+		  dns_xfrindone_t done, dns_xfrin_ctx_t **xfrp)
 {
 	dns_name_t *zonename = dns_zone_getorigin(zone);
 	dns_xfrin_ctx_t *xfr = NULL;
@@ -688,9 +836,10 @@ dns_xfrin_create3(dns_zone_t *zone, dns_rdatatype_t xfrtype,
 	if (xfrtype == dns_rdatatype_soa || xfrtype == dns_rdatatype_ixfr)
 		REQUIRE(db != NULL);
 
-	CHECK(xfrin_create(mctx, zone, db, task, timermgr, socketmgr, zonename,
-			   dns_zone_getclass(zone), xfrtype, masteraddr,
-			   sourceaddr, dscp, tsigkey, &xfr));
+	CHECK(xfrin_create(mctx, zone, db, task, applytask, timermgr,
+			   socketmgr, zonename, dns_zone_getclass(zone),
+			   xfrtype, masteraddr, sourceaddr, dscp, tsigkey,
+			   &xfr));
 
 	CHECK(xfrin_start(xfr));
 
@@ -808,6 +957,7 @@ xfrin_create(isc_mem_t *mctx,
 	     dns_zone_t *zone,
 	     dns_db_t *db,
 	     isc_task_t *task,
+	     isc_task_t *applytask,
 	     isc_timermgr_t *timermgr,
 	     isc_socketmgr_t *socketmgr,
 	     dns_name_t *zonename,
@@ -833,6 +983,9 @@ xfrin_create(isc_mem_t *mctx,
 	dns_zone_iattach(zone, &xfr->zone);
 	xfr->task = NULL;
 	isc_task_attach(task, &xfr->task);
+	xfr->applytask = NULL;
+	if (applytask != NULL)
+		isc_task_attach(applytask, &xfr->applytask);
 	xfr->timer = NULL;
 	xfr->socketmgr = socketmgr;
 	xfr->done = NULL;
@@ -840,6 +993,8 @@ xfrin_create(isc_mem_t *mctx,
 	xfr->connects = 0;
 	xfr->sends = 0;
 	xfr->recvs = 0;
+	xfr->applies = 0;
+	xfr->stalled = ISC_FALSE;
 	xfr->shuttingdown = ISC_FALSE;
 	xfr->shutdown_result = ISC_R_UNSET;
 
@@ -891,6 +1046,7 @@ xfrin_create(isc_mem_t *mctx,
 
 	xfr->axfr.add = NULL;
 	xfr->axfr.add_private = NULL;
+	xfr->applyresult = ISC_R_SUCCESS;
 
 	CHECK(dns_name_dup(zonename, mctx, &xfr->name));
 
@@ -926,6 +1082,8 @@ xfrin_create(isc_mem_t *mctx,
 		dns_tsigkey_detach(&xfr->tsigkey);
 	if (xfr->db != NULL)
 		dns_db_detach(&xfr->db);
+	if (xfr->applytask != NULL)
+		isc_task_detach(&xfr->applytask);
 	isc_task_detach(&xfr->task);
 	dns_zone_idetach(&xfr->zone);
 	isc_mem_putanddetach(&xfr->mctx, xfr, sizeof(*xfr));
@@ -1296,7 +1454,7 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		else if (result == ISC_R_SUCCESS || result == DNS_R_NOERROR)
 			result = DNS_R_UNEXPECTEDID;
 		if (xfr->reqtype == dns_rdatatype_axfr ||
-		    xfr->reqtype == dns_rdatatype_soa)
+		    xfr->reqtype == dns_rdatatype_soa || xfr->applies != 0)
 			goto failure;
 		xfrin_log(xfr, ISC_LOG_DEBUG(3), "got %s, retrying with AXFR",
 		       isc_result_totext(result));
@@ -1416,34 +1574,23 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		CHECK(xfrin_send_request(xfr));
 		break;
 	case XFRST_AXFR_END:
-		CHECK(axfr_finalize(xfr));
-		/* FALLTHROUGH */
 	case XFRST_IXFR_END:
 		/*
-		 * Close the journal.
-		 */
-		if (xfr->ixfr.journal != NULL)
-			dns_journal_destroy(&xfr->ixfr.journal);
-
-		/*
-		 * Inform the caller we succeeded.
-		 */
-		if (xfr->done != NULL) {
-			(xfr->done)(xfr->zone, ISC_R_SUCCESS);
-			xfr->done = NULL;
-		}
-		/*
-		 * We should have no outstanding events at this
-		 * point, thus maybe_free() should succeed.
+		 * If the last records are still being loaded,
+		 * xfrin_applydone() finishes the transfer.
 		 */
-		xfr->shuttingdown = ISC_TRUE;
-		xfr->shutdown_result = ISC_R_SUCCESS;
-		maybe_free(xfr);
+		if (xfr->applies == 0)
+			CHECK(xfrin_end(xfr));
 		break;
 	default:
 		/*
-		 * Read the next message.
+		 * Read the next message, unless the loader is too far
+		 * behind; xfrin_applydone() resumes reading then.
 		 */
+		if (xfr->applies >= XFRIN_MAXAPPLIES) {
+			xfr->stalled = ISC_TRUE;
+			break;
+		}
 		CHECK(dns_tcpmsg_readmessage(&xfr->tcpmsg, xfr->task,
 					     xfrin_recv_done, xfr));
 		xfr->recvs++;
@@ -1457,6 +1604,43 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		xfrin_fail(xfr, result, "failed while receiving responses");
 }
 
+/*
+ * The transfer is complete and all of it is in the database.
+ */
+static isc_result_t
+xfrin_end(dns_xfrin_ctx_t *xfr) {
+	isc_result_t result;
+
+	INSIST(xfr->applies == 0);
+
+	if (xfr->state == XFRST_AXFR_END)
+		CHECK(axfr_finalize(xfr));
+
+	/*
+	 * Close the journal.
+	 */
+	if (xfr->ixfr.journal != NULL)
+		dns_journal_destroy(&xfr->ixfr.journal);
+
+	/*
+	 * Inform the caller we succeeded.
+	 */
+	if (xfr->done != NULL) {
+		(xfr->done)(xfr->zone, ISC_R_SUCCESS);
+		xfr->done = NULL;
+	}
+	/*
+	 * We should have no outstanding events at this
+	 * point, thus maybe_free() should succeed.
+	 */
+	xfr->shuttingdown = ISC_TRUE;
+	xfr->shutdown_result = ISC_R_SUCCESS;
+	maybe_free(xfr);
+	result = ISC_R_SUCCESS;
+ failure:
+	return (result);
+}
+
 static void
 xfrin_timeout(isc_task_t *task, isc_event_t *event) {
 	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *) event->ev_arg;
@@ -1482,7 +1666,7 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 
 	if (! xfr->shuttingdown || xfr->refcount != 0 ||
 	    xfr->connects != 0 || xfr->sends != 0 ||
-	    xfr->recvs != 0)
+	    xfr->recvs != 0 || xfr->applies != 0)
 		return;
 
 	INSIST(! xfr->shuttingdown || xfr->shutdown_result != ISC_R_UNSET);
@@ -1521,6 +1705,9 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 	if (xfr->task != NULL)
 		isc_task_detach(&xfr->task);
 
+	if (xfr->applytask != NULL)
+		isc_task_detach(&xfr->applytask);
+
 	if (xfr->tsigkey != NULL)
 		dns_tsigkey_detach(&xfr->tsigkey);
 
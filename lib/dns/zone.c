@@ -12,8 +12,10 @@
 #include <errno.h>
 
 #include <isc/file.h>
+#include <isc/heap.h>
 #include <isc/hex.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/pool.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -128,6 +130,33 @@
 #define DNS_DUMP_DELAY 900		/*%< 15 minutes */
 #endif
 
+/*%
+ * Number of zone files that may be read or written at once, per CPU.
+ * Loading is mostly CPU bound, so a second slot per CPU is enough to
+ * keep the cores busy while other loads wait on storage.  The total is
+ * capped by DEFAULT_IOLIMIT_MAX so that large machines do not flood
+ * the disks at startup.  Both can be set at compilation time.
+ */
+#ifdef DNS_ZONE_IOPERCPU
+#if DNS_ZONE_IOPERCPU < 1
+#error "DNS_ZONE_IOPERCPU must be at least 1"
+#else
+#define DEFAULT_IOPERCPU	DNS_ZONE_IOPERCPU
+#endif
+#else
+#define DEFAULT_IOPERCPU	2
+#endif	/* DNS_ZONE_IOPERCPU */
+
+#ifdef DNS_ZONE_IOLIMIT_MAX
+#if DNS_ZONE_IOLIMIT_MAX < 1
+#error "DNS_ZONE_IOLIMIT_MAX must be at least 1"
+#else
+#define DEFAULT_IOLIMIT_MAX	DNS_ZONE_IOLIMIT_MAX
+#endif
+#else
+#define DEFAULT_IOLIMIT_MAX	32
+#endif	/* DNS_ZONE_IOLIMIT_MAX */
+
 typedef struct dns_notify dns_notify_t;
 typedef struct dns_stub dns_stub_t;
 typedef struct dns_load dns_load_t;
@@ -142,6 +171,7 @@ typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
 typedef struct dns_include dns_include_t;
+typedef struct dns_journalwaiter dns_journalwaiter_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -212,6 +242,17 @@ struct dns_zone {
 	const dns_master_style_t *masterstyle;
 	char			*journal;
 	isc_int32_t		journalsize;
+	/*%
+	 * Group commit of dynamic updates: 'gcjournal' is open, with
+	 * transactions not yet synced, while 'committimer' runs; the
+	 * callers waiting for them are on 'journalwaiters'.  Protected
+	 * by 'journallock', which may be taken with the zone locked.
+	 */
+	isc_mutex_t		journallock;
+	isc_uint32_t		commitdelay;	/* milliseconds */
+	dns_journal_t		*gcjournal;
+	isc_timer_t		*committimer;
+	ISC_LIST(dns_journalwaiter_t) journalwaiters;
 	dns_rdataclass_t	rdclass;
 	dns_zonetype_t		type;
 	unsigned int		flags;
@@ -223,6 +264,7 @@ struct dns_zone {
 	isc_time_t		refreshtime;
 	isc_time_t		dumptime;
 	isc_time_t		loadtime;
+	isc_uint64_t		loadduration;	/* microseconds */
 	isc_time_t		notifytime;
 	isc_time_t		resigntime;
 	isc_time_t		keywarntime;
@@ -339,6 +381,11 @@ struct dns_zone {
 	 * Serial number for deferred journal compaction.
 	 */
 	isc_uint32_t		compact_serial;
+	/*%
+	 * A compacted copy of the journal is being written by
+	 * zone_compactjournal() on the load task.
+	 */
+	isc_boolean_t		compacting;
 	/*%
 	 * Keys that are signing the zone for the first time.
 	 */
@@ -554,7 +601,8 @@ struct dns_zonemgr {
 	/* Locked by iolock */
 	isc_uint32_t		iolimit;
 	isc_uint32_t		ioactive;
-	dns_iolist_t		high;
+	isc_uint64_t		ioseq;
+	isc_heap_t		*high;
 	dns_iolist_t		low;
 
 	/* Locked by urlock. */
@@ -606,6 +654,7 @@ struct dns_load {
 	dns_zone_t		*zone;
 	dns_db_t		*db;
 	isc_time_t		loadtime;
+	isc_time_t		start;
 	dns_rdatacallbacks_t	callbacks;
 };
 
@@ -627,12 +676,18 @@ struct dns_forward {
 };
 
 /*%
- *	Hold IO request state.
+ *	Hold IO request state.  High priority requests (loads) are
+ *	queued largest file first so that big zones are not left to
+ *	finish alone at the end of startup; equal sizes are served in
+ *	the order they were requested.
  */
 struct dns_io {
 	unsigned int	magic;
 	dns_zonemgr_t	*zmgr;
 	isc_boolean_t	high;
+	isc_uint64_t	size;
+	isc_uint64_t	seq;
+	unsigned int	index;
 	isc_task_t	*task;
 	ISC_LINK(dns_io_t) link;
 	isc_event_t	*event;
@@ -715,6 +770,15 @@ struct dns_include {
 	ISC_LINK(dns_include_t)	link;
 };
 
+/*%
+ * Caller waiting for group committed journal transactions to be synced.
+ */
+struct dns_journalwaiter {
+	dns_zone_journalsynced_t done;
+	void *arg;
+	ISC_LINK(dns_journalwaiter_t) link;
+};
+
 /*
  * These can be overridden by the -T mkeytimers option on the command
  * line, so that we can test with shorter periods than specified in
@@ -749,6 +813,10 @@ static isc_result_t zone_replacedb(dns_zone_t *zone, dns_db_t *db,
 static inline void zone_attachdb(dns_zone_t *zone, dns_db_t *db);
 static inline void zone_detachdb(dns_zone_t *zone);
 static isc_result_t default_journal(dns_zone_t *zone);
+static isc_result_t zone_journal_flush(dns_zone_t *zone);
+static isc_result_t zone_journal(dns_zone_t *zone, dns_diff_t *diff,
+				 isc_uint32_t *sourceserial,
+				 const char *caller);
 static void zone_xfrdone(dns_zone_t *zone, isc_result_t result);
 static isc_result_t zone_postload(dns_zone_t *zone, dns_db_t *db,
 				  isc_time_t loadtime, isc_result_t result);
@@ -792,9 +860,12 @@ static isc_result_t zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr,
 static void zmgr_resume_xfrs(dns_zonemgr_t *zmgr, isc_boolean_t multi);
 static void zonemgr_free(dns_zonemgr_t *zmgr);
 static isc_result_t zonemgr_getio(dns_zonemgr_t *zmgr, isc_boolean_t high,
+				  isc_uint64_t size,
 				  isc_task_t *task, isc_taskaction_t action,
 				  void *arg, dns_io_t **iop);
 static void zonemgr_putio(dns_io_t **iop);
+static isc_boolean_t io_less(void *v1, void *v2);
+static void io_index(void *what, unsigned int idx);
 static void zonemgr_cancelio(dns_io_t *io);
 
 static isc_result_t
@@ -873,6 +944,14 @@ struct ssevent {
 	isc_uint32_t serial;
 };
 
+struct compact_event {
+	isc_event_t event;
+	char *journal;
+	isc_uint32_t serial;
+	isc_uint32_t size;
+	isc_result_t result;
+};
+
 /*%
  * Increment resolver-related statistics counters.  Zone must be locked.
  */
@@ -914,6 +993,11 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 		goto free_mutex;
 	}
 
+	result = isc_mutex_init(&zone->journallock);
+	if (result != ISC_R_SUCCESS) {
+		goto free_dblock;
+	}
+
 	/* XXX MPA check that all elements are initialised */
 #ifdef DNS_ZONE_CHECKLOCK
 	zone->locked = ISC_FALSE;
@@ -923,7 +1007,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	ISC_LINK_INIT(zone, link);
 	result = isc_refcount_init(&zone->erefs, 1);	/* Implicit attach. */
 	if (result != ISC_R_SUCCESS) {
-		goto free_dblock;
+		goto free_journallock;
 	}
 	zone->irefs = 0;
 	dns_name_init(&zone->origin, NULL);
@@ -940,6 +1024,11 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->keydirectory = NULL;
 	zone->journalsize = -1;
 	zone->journal = NULL;
+	zone->commitdelay = 0;
+	zone->gcjournal = NULL;
+	zone->committimer = NULL;
+	ISC_LIST_INIT(zone->journalwaiters);
+	zone->compacting = ISC_FALSE;
 	zone->rdclass = dns_rdataclass_none;
 	zone->type = dns_zone_none;
 	zone->flags = 0;
@@ -952,6 +1041,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	isc_time_settoepoch(&zone->refreshtime);
 	isc_time_settoepoch(&zone->dumptime);
 	isc_time_settoepoch(&zone->loadtime);
+	zone->loadduration = 0;
 	zone->notifytime = now;
 	isc_time_settoepoch(&zone->resigntime);
 	isc_time_settoepoch(&zone->keywarntime);
@@ -1094,6 +1184,9 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	isc_refcount_decrement(&zone->erefs, NULL);
 	isc_refcount_destroy(&zone->erefs);
 
+ free_journallock:
+	DESTROYLOCK(&zone->journallock);
+
  free_dblock:
 	ZONEDB_DESTROYLOCK(&zone->dblock);
 
@@ -1256,6 +1349,10 @@ zone_free(dns_zone_t *zone) {
 	}
 
 	/* last stuff */
+	INSIST(zone->gcjournal == NULL);
+	INSIST(zone->committimer == NULL);
+	INSIST(ISC_LIST_EMPTY(zone->journalwaiters));
+	DESTROYLOCK(&zone->journallock);
 	ZONEDB_DESTROYLOCK(&zone->dblock);
 	DESTROYLOCK(&zone->lock);
 	isc_refcount_destroy(&zone->erefs);
@@ -1718,6 +1815,7 @@ dns_zone_setjournal(dns_zone_t *zone, const char *myjournal) {
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
+	(void)zone_journal_flush(zone);
 	result = dns_zone_setstring(zone, &zone->journal, myjournal);
 	UNLOCK_ZONE(zone);
 
@@ -2351,6 +2449,22 @@ zone_registerinclude(const char *filename, void *arg) {
 	ISC_LIST_APPEND(zone->newincludes, inc, link);
 }
 
+/*
+ * Text zone files of at least DNS_MASTER_PARALLELMIN bytes are loaded
+ * with dns_master_loadfileparallel() when there is more than one CPU.
+ */
+static isc_boolean_t
+zone_loadparallel(dns_zone_t *zone) {
+	off_t size;
+
+	if (zone->masterformat != dns_masterformat_text ||
+	    isc_os_ncpus() < 2)
+		return (ISC_FALSE);
+	if (isc_file_getsize(zone->masterfile, &size) != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	return (ISC_TF(size >= DNS_MASTER_PARALLELMIN));
+}
+
 static void
 zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 	dns_load_t *load = event->ev_arg;
@@ -2365,8 +2479,29 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 	if (result == ISC_R_CANCELED)
 		goto fail;
 
+	TIME_NOW(&load->start);
 	options = get_master_options(load->zone);
 
+	if (zone_loadparallel(load->zone)) {
+		/*
+		 * Large text zones are parsed by several threads at
+		 * once; this task waits for them to finish.
+		 */
+		result = dns_master_loadfileparallel(load->zone->masterfile,
+						     dns_db_origin(load->db),
+						     dns_db_origin(load->db),
+						     load->zone->rdclass,
+						     options, 0,
+						     &load->callbacks,
+						     zone_registerinclude,
+						     load->zone,
+						     load->zone->mctx,
+						     load->zone->maxttl,
+						     isc_os_ncpus());
+		zone_loaddone(load, result);
+		return;
+	}
+
 	result = dns_master_loadfileinc5(load->zone->masterfile,
 					 dns_db_origin(load->db),
 					 dns_db_origin(load->db),
@@ -2486,6 +2621,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	isc_result_t result;
 	isc_result_t tresult;
 	unsigned int options;
+	off_t size;
 
 	dns_zone_rpz_enable_db(zone, db);
 	dns_zone_catz_enable_db(zone, db);
@@ -2502,6 +2638,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		load->zone = NULL;
 		load->db = NULL;
 		load->loadtime = loadtime;
+		isc_time_settoepoch(&load->start);
 		load->magic = LOAD_MAGIC;
 
 		isc_mem_attach(zone->mctx, &load->mctx);
@@ -2513,9 +2650,11 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		result = dns_db_beginload(db, &load->callbacks);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
-		result = zonemgr_getio(zone->zmgr, ISC_TRUE, zone->loadtask,
-				       zone_gotreadhandle, load,
-				       &zone->readio);
+		if (isc_file_getsize(zone->masterfile, &size) != ISC_R_SUCCESS)
+			size = 0;
+		result = zonemgr_getio(zone->zmgr, ISC_TRUE, size,
+				       zone->loadtask, zone_gotreadhandle,
+				       load, &zone->readio);
 		if (result != ISC_R_SUCCESS) {
 			/*
 			 * We can't report multiple errors so ignore
@@ -2527,6 +2666,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			result = DNS_R_CONTINUE;
 	} else {
 		dns_rdatacallbacks_t callbacks;
+		isc_time_t start, now;
 
 		dns_rdatacallbacks_init(&callbacks);
 		callbacks.rawdata = zone_setrawdata;
@@ -2536,18 +2676,29 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			zone_idetach(&callbacks.zone);
 			return (result);
 		}
-		result = dns_master_loadfile5(zone->masterfile,
-					      &zone->origin, &zone->origin,
-					      zone->rdclass, options, 0,
-					      &callbacks,
-					      zone_registerinclude,
-					      zone, zone->mctx,
-					      zone->masterformat,
-					      zone->maxttl);
+		TIME_NOW(&start);
+		if (zone_loadparallel(zone))
+			result = dns_master_loadfileparallel(zone->masterfile,
+					&zone->origin, &zone->origin,
+					zone->rdclass, options, 0, &callbacks,
+					zone_registerinclude, zone, zone->mctx,
+					zone->maxttl, isc_os_ncpus());
+		else
+			result = dns_master_loadfile5(zone->masterfile,
+						      &zone->origin,
+						      &zone->origin,
+						      zone->rdclass, options,
+						      0, &callbacks,
+						      zone_registerinclude,
+						      zone, zone->mctx,
+						      zone->masterformat,
+						      zone->maxttl);
 		tresult = dns_db_endload(db, &callbacks);
 		if (result == ISC_R_SUCCESS)
 			result = tresult;
 		zone_idetach(&callbacks.zone);
+		TIME_NOW(&now);
+		zone->loadduration = isc_time_microdiff(&now, &start);
 	}
 
 	return (result);
@@ -4100,6 +4251,165 @@ update_soa_serial(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff,
 	return (result);
 }
 
+/*
+ * Sync and close the group commit journal, if open, and tell everyone
+ * waiting for it.  Anything else that touches the journal file must
+ * call zone_journal_flush() first, as the header on disk is stale
+ * until then.
+ */
+static isc_result_t
+journal_flushlocked(dns_zone_t *zone) {
+	dns_journalwaiter_t *waiter;
+	isc_result_t result;
+
+	if (zone->gcjournal == NULL) {
+		INSIST(ISC_LIST_EMPTY(zone->journalwaiters));
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_journal_sync(zone->gcjournal);
+	if (result != ISC_R_SUCCESS)
+		dns_zone_log(zone, ISC_LOG_ERROR, "journal sync failed: %s",
+			     dns_result_totext(result));
+	dns_journal_destroy(&zone->gcjournal);
+	if (zone->committimer != NULL)
+		(void)isc_timer_reset(zone->committimer,
+				      isc_timertype_inactive,
+				      NULL, NULL, ISC_TRUE);
+
+	while ((waiter = ISC_LIST_HEAD(zone->journalwaiters)) != NULL) {
+		ISC_LIST_UNLINK(zone->journalwaiters, waiter, link);
+		(waiter->done)(waiter->arg, result);
+		isc_mem_put(zone->mctx, waiter, sizeof(*waiter));
+	}
+
+	return (result);
+}
+
+static isc_result_t
+zone_journal_flush(dns_zone_t *zone) {
+	isc_result_t result;
+
+	LOCK(&zone->journallock);
+	result = journal_flushlocked(zone);
+	UNLOCK(&zone->journallock);
+
+	return (result);
+}
+
+static void
+zone_committimer(isc_task_t *task, isc_event_t *event) {
+	dns_zone_t *zone = (dns_zone_t *)event->ev_arg;
+
+	UNUSED(task);
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	isc_event_free(&event);
+	(void)zone_journal_flush(zone);
+}
+
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff) {
+	const char me[] = "dns_zone_writejournal";
+	isc_interval_t interval;
+	isc_result_t result;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(DNS_DIFF_VALID(diff));
+
+	LOCK(&zone->journallock);
+	if (zone->commitdelay == 0 || zone->journal == NULL ||
+	    zone->task == NULL || zone->zmgr == NULL ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING))
+	{
+		UNLOCK(&zone->journallock);
+		return (zone_journal(zone, diff, NULL, me));
+	}
+
+	/*
+	 * The commit timer runs in the zone's task, as does
+	 * zone_shutdown() which destroys it, so it need not hold
+	 * a reference to the zone.
+	 */
+	if (zone->committimer == NULL) {
+		result = isc_timer_create(zone->zmgr->timermgr,
+					  isc_timertype_inactive,
+					  NULL, NULL, zone->task,
+					  zone_committimer, zone,
+					  &zone->committimer);
+		if (result != ISC_R_SUCCESS) {
+			UNLOCK(&zone->journallock);
+			return (zone_journal(zone, diff, NULL, me));
+		}
+	}
+
+	if (zone->gcjournal == NULL) {
+		result = dns_journal_open(zone->mctx, zone->journal,
+					  DNS_JOURNAL_CREATE,
+					  &zone->gcjournal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "%s:dns_journal_open -> %s",
+				     me, dns_result_totext(result));
+			goto unlock;
+		}
+		dns_journal_defersync(zone->gcjournal);
+		isc_interval_set(&interval, zone->commitdelay / 1000,
+				 (zone->commitdelay % 1000) * 1000000);
+		result = isc_timer_reset(zone->committimer,
+					 isc_timertype_once, NULL,
+					 &interval, ISC_TRUE);
+		if (result != ISC_R_SUCCESS) {
+			dns_journal_destroy(&zone->gcjournal);
+			UNLOCK(&zone->journallock);
+			return (zone_journal(zone, diff, NULL, me));
+		}
+	}
+
+	result = dns_journal_write_transaction(zone->gcjournal, diff);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "%s:dns_journal_write_transaction -> %s",
+			     me, dns_result_totext(result));
+		(void)journal_flushlocked(zone);
+	}
+
+ unlock:
+	UNLOCK(&zone->journallock);
+	return (result);
+}
+
+void
+dns_zone_afterjournalsync(dns_zone_t *zone, dns_zone_journalsynced_t done,
+			  void *arg)
+{
+	dns_journalwaiter_t *waiter = NULL;
+	isc_result_t result;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(done != NULL);
+
+	LOCK(&zone->journallock);
+	if (zone->gcjournal != NULL) {
+		waiter = isc_mem_get(zone->mctx, sizeof(*waiter));
+		if (waiter != NULL) {
+			waiter->done = done;
+			waiter->arg = arg;
+			ISC_LINK_INIT(waiter, link);
+			ISC_LIST_APPEND(zone->journalwaiters, waiter, link);
+			UNLOCK(&zone->journallock);
+			return;
+		}
+	}
+
+	/*
+	 * Nothing is pending, or we could not queue: sync now.
+	 */
+	result = journal_flushlocked(zone);
+	UNLOCK(&zone->journallock);
+	(done)(arg, result);
+}
+
 /*
  * Write all transactions in 'diff' to the zone journal file.
  */
@@ -4114,6 +4424,7 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, isc_uint32_t *sourceserial,
 	unsigned int mode = DNS_JOURNAL_CREATE|DNS_JOURNAL_WRITE;
 
 	ENTER;
+	(void)zone_journal_flush(zone);
 	journalfile = dns_zone_getjournal(zone);
 	if (journalfile != NULL) {
 		result = dns_journal_open(zone->mctx, journalfile, mode,
@@ -4440,6 +4751,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 	if (inline_raw(zone))
 		INSIST(LOCKED_ZONE(zone->secure));
 
+	(void)zone_journal_flush(zone);
 	TIME_NOW(&now);
 
 	/*
@@ -10191,6 +10503,111 @@ dns_zone_refresh(dns_zone_t *zone) {
 	UNLOCK_ZONE(zone);
 }
 
+static void
+compact_log(dns_zone_t *zone, isc_result_t result) {
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case ISC_R_NOSPACE:
+	case ISC_R_NOTFOUND:
+		dns_zone_log(zone, ISC_LOG_DEBUG(3),
+			     "dns_journal_compact: %s",
+			     dns_result_totext(result));
+		break;
+	default:
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_journal_compact failed: %s",
+			     dns_result_totext(result));
+		break;
+	}
+}
+
+/*
+ * Second half of a background journal compaction, in the zone's
+ * task: bring the compacted copy up to date and put it in place.
+ * Nothing else writes the journal while we hold the zone lock and
+ * 'journallock' here, and what is left to copy is only what was
+ * added while the copy was being made.
+ */
+static void
+zone_compactdone(isc_task_t *task, isc_event_t *event) {
+	struct compact_event *ce = (struct compact_event *)event;
+	dns_zone_t *zone = event->ev_arg;
+	isc_result_t result;
+
+	UNUSED(task);
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->compacting = ISC_FALSE;
+	result = ce->result;
+	if (result == ISC_R_SUCCESS) {
+		if (zone->journal != NULL &&
+		    strcmp(zone->journal, ce->journal) == 0)
+		{
+			LOCK(&zone->journallock);
+			(void)journal_flushlocked(zone);
+			result = dns_journal_compactfinish(zone->mctx,
+							   ce->journal);
+			UNLOCK(&zone->journallock);
+		} else
+			result = ISC_R_NOTFOUND;
+	} else if (result == DNS_R_UPTODATE)
+		result = ISC_R_SUCCESS;
+	compact_log(zone, result);
+	UNLOCK_ZONE(zone);
+
+	isc_mem_free(zone->mctx, ce->journal);
+	isc_event_free(&event);
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * First half of a background journal compaction, in the zone's
+ * load task: copy the part of the journal that is kept.  The zone
+ * task carries on serving IXFR and applying updates meanwhile.
+ */
+static void
+zone_compactjournal(isc_task_t *task, isc_event_t *event) {
+	struct compact_event *ce = (struct compact_event *)event;
+	dns_zone_t *zone = event->ev_arg;
+
+	UNUSED(task);
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	ce->result = dns_journal_compactprepare(zone->mctx, ce->journal,
+						ce->serial, ce->size);
+	event->ev_action = zone_compactdone;
+	isc_task_send(zone->task, &event);
+}
+
+static isc_result_t
+zone_compactstart(dns_zone_t *zone, isc_uint32_t serial, isc_uint32_t size) {
+	struct compact_event *ce;
+	isc_event_t *e;
+	dns_zone_t *dummy = NULL;
+
+	e = isc_event_allocate(zone->mctx, NULL, DNS_EVENT_ZONECOMPACT,
+			       zone_compactjournal, zone,
+			       sizeof(struct compact_event));
+	if (e == NULL)
+		return (ISC_R_NOMEMORY);
+	ce = (struct compact_event *)e;
+	ce->journal = isc_mem_strdup(zone->mctx, zone->journal);
+	if (ce->journal == NULL) {
+		isc_event_free(&e);
+		return (ISC_R_NOMEMORY);
+	}
+	ce->serial = serial;
+	ce->size = size;
+	ce->result = ISC_R_UNSET;
+
+	zone_iattach(zone, &dummy);
+	zone->compacting = ISC_TRUE;
+	isc_task_send(zone->loadtask, &e);
+
+	return (ISC_R_SUCCESS);
+}
+
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, isc_uint32_t serial) {
 	isc_result_t result;
@@ -10219,22 +10636,23 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, isc_uint32_t serial) {
 	}
 	zone_debuglog(zone, "zone_journal_compact", 1,
 		      "target journal size %d", journalsize);
+	(void)zone_journal_flush(zone);
+
+	/*
+	 * Rewriting a large journal takes a while; do it on the load
+	 * task when we have one.  A compaction that is already
+	 * running will do.
+	 */
+	if (zone->compacting)
+		return;
+	if (zone->task != NULL && zone->loadtask != NULL &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING) &&
+	    zone_compactstart(zone, serial, journalsize) == ISC_R_SUCCESS)
+		return;
+
 	result = dns_journal_compact(zone->mctx, zone->journal,
 				     serial, journalsize);
-	switch (result) {
-	case ISC_R_SUCCESS:
-	case ISC_R_NOSPACE:
-	case ISC_R_NOTFOUND:
-		dns_zone_log(zone, ISC_LOG_DEBUG(3),
-			     "dns_journal_compact: %s",
-			     dns_result_totext(result));
-		break;
-	default:
-		dns_zone_log(zone, ISC_LOG_ERROR,
-			     "dns_journal_compact failed: %s",
-			     dns_result_totext(result));
-		break;
-	}
+	compact_log(zone, result);
 }
 
 isc_result_t
@@ -10452,7 +10870,7 @@ zone_dump(dns_zone_t *zone, isc_boolean_t compact) {
 		dns_zone_t *dummy = NULL;
 		LOCK_ZONE(zone);
 		zone_iattach(zone, &dummy);
-		result = zonemgr_getio(zone->zmgr, ISC_FALSE, zone->task,
+		result = zonemgr_getio(zone->zmgr, ISC_FALSE, 0, zone->task,
 				       zone_gotwritehandle, zone,
 				       &zone->writeio);
 		if (result != ISC_R_SUCCESS)
@@ -12820,6 +13238,12 @@ zone_shutdown(isc_task_t *task, isc_event_t *event) {
 		zone->irefs--;
 	}
 
+	LOCK(&zone->journallock);
+	(void)journal_flushlocked(zone);
+	if (zone->committimer != NULL)
+		isc_timer_detach(&zone->committimer);
+	UNLOCK(&zone->journallock);
+
 	/*
 	 * We have now canceled everything set the flag to allow exit_check()
 	 * to succeed.	We must not unlock between setting this flag and
@@ -13593,6 +14017,22 @@ dns_zone_getchecknames(dns_zone_t *zone) {
 	return (zone->check_names);
 }
 
+void
+dns_zone_setcommitdelay(dns_zone_t *zone, isc_uint32_t delay) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK(&zone->journallock);
+	zone->commitdelay = delay;
+	UNLOCK(&zone->journallock);
+}
+
+isc_uint32_t
+dns_zone_getcommitdelay(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->commitdelay);
+}
+
 void
 dns_zone_setjournalsize(dns_zone_t *zone, isc_int32_t size) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -14244,6 +14684,8 @@ receive_secure_serial(isc_task_t *task, isc_event_t *event) {
 		 * If that fails, then we'll fall back to a direct comparison
 		 * between raw and secure zones.
 		 */
+		(void)zone_journal_flush(zone->rss_raw);
+		(void)zone_journal_flush(zone);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -14336,10 +14778,12 @@ receive_secure_serial(isc_task_t *task, isc_event_t *event) {
 	if (result != ISC_R_SUCCESS)
 		goto failure;
 
-	if (rjournal == NULL)
+	if (rjournal == NULL) {
+		(void)zone_journal_flush(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
+	}
 	CHECK(zone_journal(zone, &zone->rss_diff, &end,
 			   "receive_secure_serial"));
 
@@ -14917,6 +15361,8 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, isc_boolean_t dump) {
 	if (inline_raw(zone))
 		REQUIRE(LOCKED_ZONE(zone->secure));
 
+	(void)zone_journal_flush(zone);
+
 	result = zone_get_from_db(zone, db, &nscount, &soacount,
 				  NULL, NULL, NULL, NULL, NULL, NULL);
 	if (result == ISC_R_SUCCESS) {
@@ -15355,6 +15801,7 @@ zone_loaddone(void *arg, isc_result_t result) {
 	dns_zone_t *zone;
 	isc_result_t tresult;
 	dns_zone_t *secure = NULL;
+	isc_time_t now;
 
 	REQUIRE(DNS_LOAD_VALID(load));
 	zone = load->zone;
@@ -15386,6 +15833,10 @@ zone_loaddone(void *arg, isc_result_t result) {
 			goto again;
 		}
 	}
+	if (!isc_time_isepoch(&load->start)) {
+		TIME_NOW(&now);
+		zone->loadduration = isc_time_microdiff(&now, &load->start);
+	}
 	(void)zone_postload(zone, load->db, load->loadtime, result);
 	zonemgr_putio(&zone->readio);
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADING);
@@ -15642,10 +16093,11 @@ got_transfer_quota(isc_task_t *task, isc_event_t *event) {
 	};
 	UNLOCK_ZONE(zone);
 	INSIST(isc_sockaddr_pf(&masteraddr) == isc_sockaddr_pf(&sourceaddr));
-	result = dns_xfrin_create3(zone, xfrtype, &masteraddr, &sourceaddr,
+	result = dns_xfrin_create4(zone, xfrtype, &masteraddr, &sourceaddr,
 				   dscp, zone->tsigkey, zone->mctx,
 				   zone->zmgr->timermgr, zone->zmgr->socketmgr,
-				   zone->task, zone_xfrdone, &zone->xfr);
+				   zone->task, zone->loadtask, zone_xfrdone,
+				   &zone->xfr);
 	if (result == ISC_R_SUCCESS) {
 		LOCK_ZONE(zone);
 		if (xfrtype == dns_rdatatype_axfr) {
@@ -16018,15 +16470,22 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	isc_ratelimiter_setpushpop(zmgr->startupnotifyrl, ISC_TRUE);
 	isc_ratelimiter_setpushpop(zmgr->startuprefreshrl, ISC_TRUE);
 
-	zmgr->iolimit = 1;
+	zmgr->iolimit = ISC_MIN(isc_os_ncpus() * DEFAULT_IOPERCPU,
+				DEFAULT_IOLIMIT_MAX);
+	zmgr->iolimit = ISC_MAX(zmgr->iolimit, 1);
 	zmgr->ioactive = 0;
-	ISC_LIST_INIT(zmgr->high);
+	zmgr->ioseq = 0;
+	zmgr->high = NULL;
 	ISC_LIST_INIT(zmgr->low);
 
-	result = isc_mutex_init(&zmgr->iolock);
+	result = isc_heap_create(mctx, io_less, io_index, 0, &zmgr->high);
 	if (result != ISC_R_SUCCESS)
 		goto free_startuprefreshrl;
 
+	result = isc_mutex_init(&zmgr->iolock);
+	if (result != ISC_R_SUCCESS)
+		goto free_high;
+
 	zmgr->magic = ZONEMGR_MAGIC;
 
 	*zmgrp = zmgr;
@@ -16036,6 +16495,8 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
  free_iolock:
 	DESTROYLOCK(&zmgr->iolock);
 #endif
+ free_high:
+	isc_heap_destroy(&zmgr->high);
  free_startuprefreshrl:
 	isc_ratelimiter_detach(&zmgr->startuprefreshrl);
  free_startupnotifyrl:
@@ -16374,6 +16835,7 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 	zmgr->magic = 0;
 
 	DESTROYLOCK(&zmgr->iolock);
+	isc_heap_destroy(&zmgr->high);
 	isc_ratelimiter_detach(&zmgr->notifyrl);
 	isc_ratelimiter_detach(&zmgr->refreshrl);
 	isc_ratelimiter_detach(&zmgr->startupnotifyrl);
@@ -16576,23 +17038,46 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
 	return (zmgr->iolimit);
 }
 
+/*
+ * Order the high priority queue: largest zone file first, then
+ * first come first served.
+ */
+static isc_boolean_t
+io_less(void *v1, void *v2) {
+	dns_io_t *io1 = v1;
+	dns_io_t *io2 = v2;
+
+	if (io1->size != io2->size)
+		return (ISC_TF(io1->size > io2->size));
+	return (ISC_TF(io1->seq < io2->seq));
+}
+
+static void
+io_index(void *what, unsigned int idx) {
+	dns_io_t *io = what;
+
+	io->index = idx;
+}
+
 /*
  * Get permission to request a file handle from the OS.
  * An event will be sent to action when one is available.
  * There are two queues available (high and low), the high
- * queue will be serviced before the low one.
+ * queue will be serviced before the low one.  Requests on the
+ * high queue are served largest 'size' first.
  *
  * zonemgr_putio() must be called after the event is delivered to
  * 'action'.
  */
 
 static isc_result_t
-zonemgr_getio(dns_zonemgr_t *zmgr, isc_boolean_t high,
+zonemgr_getio(dns_zonemgr_t *zmgr, isc_boolean_t high, isc_uint64_t size,
 	      isc_task_t *task, isc_taskaction_t action, void *arg,
 	      dns_io_t **iop)
 {
 	dns_io_t *io;
 	isc_boolean_t queue;
+	isc_result_t result = ISC_R_SUCCESS;
 
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 	REQUIRE(iop != NULL && *iop == NULL);
@@ -16610,21 +17095,34 @@ zonemgr_getio(dns_zonemgr_t *zmgr, isc_boolean_t high,
 
 	io->zmgr = zmgr;
 	io->high = high;
+	io->size = size;
+	io->index = 0;
 	io->task = NULL;
 	isc_task_attach(task, &io->task);
 	ISC_LINK_INIT(io, link);
 	io->magic = IO_MAGIC;
 
 	LOCK(&zmgr->iolock);
-	zmgr->ioactive++;
-	queue = ISC_TF(zmgr->ioactive > zmgr->iolimit);
+	io->seq = zmgr->ioseq++;
+	queue = ISC_TF(zmgr->ioactive >= zmgr->iolimit);
 	if (queue) {
 		if (io->high)
-			ISC_LIST_APPEND(zmgr->high, io, link);
+			result = isc_heap_insert(zmgr->high, io);
 		else
 			ISC_LIST_APPEND(zmgr->low, io, link);
 	}
+	if (result == ISC_R_SUCCESS)
+		zmgr->ioactive++;
 	UNLOCK(&zmgr->iolock);
+
+	if (result != ISC_R_SUCCESS) {
+		isc_event_free(&io->event);
+		isc_task_detach(&io->task);
+		io->magic = 0;
+		isc_mem_put(zmgr->mctx, io, sizeof(*io));
+		return (result);
+	}
+
 	*iop = io;
 
 	if (!queue)
@@ -16645,6 +17143,7 @@ zonemgr_putio(dns_io_t **iop) {
 	*iop = NULL;
 
 	INSIST(!ISC_LINK_LINKED(io, link));
+	INSIST(io->index == 0);
 	INSIST(io->event == NULL);
 
 	zmgr = io->zmgr;
@@ -16655,16 +17154,15 @@ zonemgr_putio(dns_io_t **iop) {
 	LOCK(&zmgr->iolock);
 	INSIST(zmgr->ioactive > 0);
 	zmgr->ioactive--;
-	next = HEAD(zmgr->high);
-	if (next == NULL)
-		next = HEAD(zmgr->low);
+	next = isc_heap_element(zmgr->high, 1);
 	if (next != NULL) {
-		if (next->high)
-			ISC_LIST_UNLINK(zmgr->high, next, link);
-		else
+		isc_heap_delete(zmgr->high, 1);
+	} else {
+		next = HEAD(zmgr->low);
+		if (next != NULL)
 			ISC_LIST_UNLINK(zmgr->low, next, link);
-		INSIST(next->event != NULL);
 	}
+	INSIST(next == NULL || next->event != NULL);
 	UNLOCK(&zmgr->iolock);
 	if (next != NULL)
 		isc_task_send(next->task, &next->event);
@@ -16680,15 +17178,14 @@ zonemgr_cancelio(dns_io_t *io) {
 	 * If we are queued to be run then dequeue.
 	 */
 	LOCK(&io->zmgr->iolock);
-	if (ISC_LINK_LINKED(io, link)) {
-		if (io->high)
-			ISC_LIST_UNLINK(io->zmgr->high, io, link);
-		else
-			ISC_LIST_UNLINK(io->zmgr->low, io, link);
-
+	if (io->index != 0) {
+		isc_heap_delete(io->zmgr->high, io->index);
+		send_event = ISC_TRUE;
+	} else if (ISC_LINK_LINKED(io, link)) {
+		ISC_LIST_UNLINK(io->zmgr->low, io, link);
 		send_event = ISC_TRUE;
-		INSIST(io->event != NULL);
 	}
+	INSIST(!send_event || io->event != NULL);
 	UNLOCK(&io->zmgr->iolock);
 	if (send_event) {
 		io->event->ev_attributes |= ISC_EVENTATTR_CANCELED;
@@ -17181,6 +17678,14 @@ dns_zonemgr_getcount(dns_zonemgr_t *zmgr, int state) {
 				count++;
 		}
 		break;
+	case DNS_ZONESTATE_LOADING:
+		for (zone = ISC_LIST_HEAD(zmgr->zones);
+		     zone != NULL;
+		     zone = ISC_LIST_NEXT(zone, link))
+			if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING |
+						DNS_ZONEFLG_LOADING))
+				count++;
+		break;
 	default:
 		INSIST(0);
 	}
@@ -19048,6 +19553,18 @@ dns_zone_getloadtime(dns_zone_t *zone, isc_time_t *loadtime) {
 	return (ISC_R_SUCCESS);
 }
 
+isc_uint64_t
+dns_zone_getloadduration(dns_zone_t *zone) {
+	isc_uint64_t duration;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	duration = zone->loadduration;
+	UNLOCK_ZONE(zone);
+	return (duration);
+}
+
 isc_result_t
 dns_zone_getexpiretime(dns_zone_t *zone, isc_time_t *expiretime) {
 	REQUIRE(DNS_ZONE_VALID(zone));
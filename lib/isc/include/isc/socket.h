@@ -119,12 +119,28 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_MAXSCATTERGATHER	8
 
+/*%
+ * Maximum number of datagrams moved by one recvmmsg() or sendmmsg()
+ * call when servicing requests made with ISC_SOCKFLAG_BATCH.
+ */
+#define ISC_SOCKET_MAXBATCH		32
+
 /*%
  * In isc_socket_bind() set socket option SO_REUSEADDR prior to calling
  * bind() if a non zero port is specified (AF_INET and AF_INET6).
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT (SO_REUSEPORT_LB
+ * on FreeBSD) prior to calling bind() so that several sockets can be
+ * bound to the same address and port, with the kernel distributing
+ * incoming datagrams between them.  isc_socket_bind() fails with
+ * ISC_R_NOTIMPLEMENTED on systems where the kernel does not balance
+ * datagrams across such sockets.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -254,6 +270,7 @@ struct isc_socket_connev {
  * _USEMINMTU:	Set the per packet IPV6_USE_MIN_MTU flag.
  */
 #define ISC_SOCKEVENTATTR_ATTACHED		0x80000000U /* internal */
+#define ISC_SOCKEVENTATTR_NORETRY		0x40000000U /* internal */
 #define ISC_SOCKEVENTATTR_TRUNC			0x00800000U /* public */
 #define ISC_SOCKEVENTATTR_CTRUNC		0x00400000U /* public */
 #define ISC_SOCKEVENTATTR_TIMESTAMP		0x00200000U /* public */
@@ -309,6 +326,7 @@ typedef enum {
  */
 #define ISC_SOCKFLAG_IMMEDIATE	0x00000001	/*%< send event only if needed */
 #define ISC_SOCKFLAG_NORETRY	0x00000002	/*%< drop failed UDP sends */
+#define ISC_SOCKFLAG_BATCH	0x00000004	/*%< batch UDP I/O */
 /*@}*/
 
 /*@{*/
@@ -705,6 +723,7 @@ isc_socket_bind(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	(ISC_SOCKET_REUSEPORT is not supported)
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -876,12 +895,17 @@ isc_socket_recv2(isc_socket_t *sock, isc_region_t *region,
  *	expected to be initialized.
  *
  *\li	For isc_socket_recv2():
- *	The only defined value for 'flags' is ISC_SOCKFLAG_IMMEDIATE.  If
- *	set and the operation completes, the return value will be
- *	ISC_R_SUCCESS and the event will be filled in and not sent.  If the
- *	operation does not complete, the return value will be
- *	ISC_R_INPROGRESS and the event will be sent when the operation
- *	completes.
+ *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE
+ *	and ISC_SOCKFLAG_BATCH.  If ISC_SOCKFLAG_IMMEDIATE is set and the
+ *	operation completes, the return value will be ISC_R_SUCCESS and the
+ *	event will be filled in and not sent.  If the operation does not
+ *	complete, the return value will be ISC_R_INPROGRESS and the event
+ *	will be sent when the operation completes.
+ *
+ *\li	ISC_SOCKFLAG_BATCH is a hint for UDP sockets: the request is
+ *	always queued, and queued requests are filled up to
+ *	#ISC_SOCKET_MAXBATCH at a time where the system supports it.  It is
+ *	ignored for other socket types.
  *
  * Requires:
  *
@@ -967,8 +991,8 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	expected to be initialized.
  *
  *\li	For isc_socket_sendto2():
- *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE
- *	and ISC_SOCKFLAG_NORETRY.
+ *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE,
+ *	ISC_SOCKFLAG_NORETRY and ISC_SOCKFLAG_BATCH.
  *
  *\li	If ISC_SOCKFLAG_IMMEDIATE is set and the operation completes, the
  *	return value will be ISC_R_SUCCESS and the event will be filled
@@ -982,6 +1006,12 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	Using this option along with ISC_SOCKFLAG_IMMEDIATE allows the caller
  *	to specify a region that is allocated on the stack.
  *
+ *\li	ISC_SOCKFLAG_BATCH is a hint for UDP sockets: if another send is
+ *	already in progress the datagram is queued and sent together with
+ *	others, up to #ISC_SOCKET_MAXBATCH at a time, where the system
+ *	supports it.  The region must therefore remain valid until the
+ *	done event is delivered.  It is ignored for other socket types.
+ *
  * Requires:
  *
  *\li	'socket' is a valid, bound socket.
@@ -1025,12 +1055,17 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		      unsigned int maxsocks);
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
+ * "nthreads" is the number of network threads; each one runs its own
+ * event loop (epoll, kqueue, /dev/poll or select) over the subset of
+ * sockets assigned to it, so that readiness notification is not
+ * serialized through a single watcher.  Zero means one thread.  It is
+ * ignored when built without thread support.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero and "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -1044,6 +1079,8 @@ isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
  *
  *\li	'managerp' points to a NULL isc_socketmgr_t.
  *
+ *\li	'nthreads' is not negative.
+ *
  *\li	'actx' is a valid application context (for createinctx()).
  *
  * Ensures:
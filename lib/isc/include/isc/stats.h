@@ -44,6 +44,29 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_createpercpu(isc_mem_t *mctx, isc_stats_t **statsp,
+		       int ncounters);
+/*%<
+ * Like isc_stats_create(), but keep a separate copy of the counters for
+ * each CPU (up to a compile-time limit) so that threads updating the same
+ * counter do not contend for the same cache line.  The copies are only
+ * added together when the counters are dumped.  This uses several times
+ * the memory of isc_stats_create(), so it is meant for server-wide
+ * counters that are updated for every query, not for sets created per
+ * zone.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -112,7 +135,8 @@ void
 isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	      isc_statscounter_t counter);
 /*%<
- * Set the given counter to the specfied value.
+ * Set the given counter to the specfied value.  This is not atomic with
+ * respect to concurrent increments and decrements of the same counter.
  *
  * Requires:
  *\li	'stats' is a valid isc_stats_t.
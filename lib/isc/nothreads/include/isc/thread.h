@@ -31,6 +31,7 @@ void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
 #define isc_thread_self() ((unsigned long)0)
+#define isc_thread_index() (0U)
 #define isc_thread_yield() ((void)0)
 
 ISC_LANG_ENDDECLS
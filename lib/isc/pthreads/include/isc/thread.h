@@ -42,6 +42,15 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+unsigned int
+isc_thread_index(void);
+/*%<
+ * Return a small integer identifying the calling thread.  Indexes are
+ * handed out from zero in the order in which threads first call this
+ * function and are not reused, so they are suitable for picking a
+ * per-thread slot in a table with "index % size".
+ */
+
 /* XXX We could do fancier error handling... */
 
 #define isc_thread_join(t, rp) \
@@ -16,6 +16,10 @@
 #include <sched.h>
 #endif
 
+#include <stdint.h>
+
+#include <isc/mutex.h>
+#include <isc/once.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 
@@ -23,6 +27,11 @@
 #define THREAD_MINSTACKSIZE		(1024U * 1024)
 #endif
 
+static isc_once_t index_once = ISC_ONCE_INIT;
+static isc_thread_key_t index_key;
+static isc_mutex_t index_lock;
+static unsigned int index_next = 0;
+
 isc_result_t
 isc_thread_create(isc_threadfunc_t func, isc_threadarg_t arg,
 		  isc_thread_t *thread)
@@ -96,3 +105,34 @@ isc_thread_yield(void) {
 	pthread_yield_np();
 #endif
 }
+
+static void
+index_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&index_lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&index_key, NULL) == 0);
+}
+
+unsigned int
+isc_thread_index(void) {
+	void *value;
+	unsigned int index;
+
+	RUNTIME_CHECK(isc_once_do(&index_once, index_initialize) ==
+		      ISC_R_SUCCESS);
+
+	/*
+	 * The key holds index + 1, so that NULL means "not yet assigned".
+	 */
+	value = isc_thread_key_getspecific(index_key);
+	if (value != NULL)
+		return ((unsigned int)((uintptr_t)value - 1));
+
+	LOCK(&index_lock);
+	index = index_next++;
+	UNLOCK(&index_lock);
+
+	RUNTIME_CHECK(isc_thread_key_setspecific(index_key,
+				(void *)(uintptr_t)(index + 1)) == 0);
+
+	return (index);
+}
@@ -18,10 +18,12 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #if defined(ISC_PLATFORM_HAVESTDATOMIC)
@@ -31,6 +33,27 @@
 #define ISC_STATS_MAGIC			ISC_MAGIC('S', 't', 'a', 't')
 #define ISC_STATS_VALID(x)		ISC_MAGIC_VALID(x, ISC_STATS_MAGIC)
 
+/*%
+ * Maximum number of per-thread copies of the counters kept by statistics
+ * created with isc_stats_createpercpu().  Such a set gets one copy per
+ * CPU up to this limit.  This can be configured at compilation time via
+ * the ISC_STATS_SLOTS variable.
+ */
+#ifdef ISC_STATS_SLOTS
+#if ISC_STATS_SLOTS < 1
+#error "ISC_STATS_SLOTS must be at least 1"
+#else
+#define DEFAULT_STATS_SLOTS	ISC_STATS_SLOTS
+#endif
+#else
+#define DEFAULT_STATS_SLOTS	16
+#endif	/* ISC_STATS_SLOTS */
+
+/*%
+ * Each copy of the counters starts on its own cache line.
+ */
+#define ISC_STATS_CACHELINE	64
+
 /*%
  * Local macro confirming prescence of 64-bit
  * increment and store operations, just to make
@@ -101,6 +124,8 @@ struct isc_stats {
 	unsigned int	magic;
 	isc_mem_t	*mctx;
 	int		ncounters;
+	unsigned int	nslots;
+	int		stride;
 
 	isc_mutex_t	lock;
 	unsigned int	references; /* locked by lock */
@@ -112,6 +137,11 @@ struct isc_stats {
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_t	counterlock;
 #endif
+	/*%
+	 * 'nslots' copies of the counters, 'stride' counters apart.
+	 * A thread only updates the copy selected by its thread index, and
+	 * the copies are added together when the counters are read.
+	 */
 	isc_stat_t	*counters;
 
 	/*%
@@ -128,12 +158,19 @@ struct isc_stats {
 	isc_uint64_t	*copiedcounters;
 };
 
+#define COUNTERS_SIZE(stats) \
+	(sizeof(isc_stat_t) * (stats)->stride * (stats)->nslots)
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int nslots,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
+	int perline;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
+	REQUIRE(nslots > 0);
 
 	stats = isc_mem_get(mctx, sizeof(*stats));
 	if (stats == NULL)
@@ -143,7 +180,13 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
+	stats->nslots = nslots;
+	stats->stride = ncounters;
+	if (nslots > 1) {
+		perline = ISC_STATS_CACHELINE / sizeof(isc_stat_t);
+		stats->stride = (ncounters + perline - 1) / perline * perline;
+	}
+	stats->counters = isc_mem_get(mctx, COUNTERS_SIZE(stats));
 	if (stats->counters == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
@@ -162,7 +205,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 #endif
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
+	memset(stats->counters, 0, COUNTERS_SIZE(stats));
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -173,7 +216,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	return (result);
 
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->counters, COUNTERS_SIZE(stats));
 
 #if ISC_STATS_LOCKCOUNTERS
 clean_copiedcounters:
@@ -218,7 +261,7 @@ isc_stats_detach(isc_stats_t **statsp) {
 		isc_mem_put(stats->mctx, stats->copiedcounters,
 			    sizeof(isc_stat_t) * stats->ncounters);
 		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+			    COUNTERS_SIZE(stats));
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 #if ISC_STATS_LOCKCOUNTERS
@@ -238,8 +281,20 @@ isc_stats_ncounters(isc_stats_t *stats) {
 	return (stats->ncounters);
 }
 
+/*%
+ * Return the copy of the counters that the calling thread updates.
+ */
+static inline isc_stat_t *
+getcounters(isc_stats_t *stats) {
+	if (stats->nslots == 1)
+		return (stats->counters);
+	return (&stats->counters[(isc_thread_index() % stats->nslots) *
+				 stats->stride]);
+}
+
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = getcounters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -253,10 +308,10 @@ incrementcounter(isc_stats_t *stats, int counter) {
 
 #if ISC_STATS_USEMULTIFIELDS
 #if defined(ISC_STATS_HAVESTDATOMIC)
-	prev = atomic_fetch_add_explicit(&stats->counters[counter].lo, 1,
+	prev = atomic_fetch_add_explicit(&counters[counter].lo, 1,
 					 memory_order_relaxed);
 #else
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, 1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, 1);
 #endif
 	/*
 	 * If the lower 32-bit field overflows, increment the higher field.
@@ -268,23 +323,23 @@ incrementcounter(isc_stats_t *stats, int counter) {
 	 */
 	if (prev == (isc_int32_t)0xffffffff) {
 #if defined(ISC_STATS_HAVESTDATOMIC)
-		atomic_fetch_add_explicit(&stats->counters[counter].hi, 1,
+		atomic_fetch_add_explicit(&counters[counter].hi, 1,
 					  memory_order_relaxed);
 #else
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi, 1);
 #endif
 	}
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
 #if defined(ISC_STATS_HAVESTDATOMICQ)
-	atomic_fetch_add_explicit(&stats->counters[counter], 1,
+	atomic_fetch_add_explicit(&counters[counter], 1,
 				  memory_order_relaxed);
 #else
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], 1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], 1);
 #endif
 #else
 	UNUSED(prev);
-	stats->counters[counter]++;
+	counters[counter]++;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -294,6 +349,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = getcounters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -302,31 +358,31 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 #if ISC_STATS_USEMULTIFIELDS
 #if defined(ISC_STATS_HAVESTDATOMIC)
-	prev = atomic_fetch_sub_explicit(&stats->counters[counter].lo, 1,
+	prev = atomic_fetch_sub_explicit(&counters[counter].lo, 1,
 					 memory_order_relaxed);
 #else
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, -1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, -1);
 #endif
 	if (prev == 0) {
 #if defined(ISC_STATS_HAVESTDATOMIC)
-		atomic_fetch_sub_explicit(&stats->counters[counter].hi, 1,
+		atomic_fetch_sub_explicit(&counters[counter].hi, 1,
 					  memory_order_relaxed);
 #else
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi,
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi,
 				-1);
 #endif
 	}
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
 #if defined(ISC_STATS_HAVESTDATOMICQ)
-	atomic_fetch_sub_explicit(&stats->counters[counter], 1,
+	atomic_fetch_sub_explicit(&counters[counter], 1,
 				  memory_order_relaxed);
 #else
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], -1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], -1);
 #endif
 #else
 	UNUSED(prev);
-	stats->counters[counter]--;
+	counters[counter]--;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -336,6 +392,8 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 static void
 copy_counters(isc_stats_t *stats) {
+	isc_stat_t *counters;
+	unsigned int slot;
 	int i;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -346,24 +404,34 @@ copy_counters(isc_stats_t *stats) {
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
-	for (i = 0; i < stats->ncounters; i++) {
+	memset(stats->copiedcounters, 0,
+	       sizeof(isc_uint64_t) * stats->ncounters);
+
+	/*
+	 * A copy may have been decremented more often than incremented;
+	 * the sum is still correct modulo 2^64.
+	 */
+	for (slot = 0; slot < stats->nslots; slot++) {
+		counters = &stats->counters[slot * stats->stride];
+		for (i = 0; i < stats->ncounters; i++) {
 #if ISC_STATS_USEMULTIFIELDS
-		stats->copiedcounters[i] =
-			(isc_uint64_t)(stats->counters[i].hi) << 32 |
-			stats->counters[i].lo;
+			stats->copiedcounters[i] +=
+				(isc_uint64_t)(counters[i].hi) << 32 |
+				counters[i].lo;
 #elif ISC_STATS_HAVEATOMICQ
 #if defined(ISC_STATS_HAVESTDATOMICQ)
-		stats->copiedcounters[i] =
-			atomic_load_explicit(&stats->counters[i],
-					     memory_order_relaxed);
+			stats->copiedcounters[i] +=
+				atomic_load_explicit(&counters[i],
+						     memory_order_relaxed);
 #else
-		/* use xaddq(..., 0) as an atomic load */
-		stats->copiedcounters[i] =
-			(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&stats->counters[i], 0);
+			/* use xaddq(..., 0) as an atomic load */
+			stats->copiedcounters[i] +=
+				(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&counters[i], 0);
 #endif
 #else
-		stats->copiedcounters[i] = stats->counters[i];
+			stats->copiedcounters[i] += counters[i];
 #endif
+		}
 	}
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -375,7 +443,20 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 1, statsp));
+}
+
+isc_result_t
+isc_stats_createpercpu(isc_mem_t *mctx, isc_stats_t **statsp,
+		       int ncounters)
+{
+	unsigned int nslots;
+
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	nslots = ISC_MIN(isc_os_ncpus(), DEFAULT_STATS_SLOTS);
+	nslots = ISC_MAX(nslots, 1);
+	return (create_stats(mctx, ncounters, nslots, statsp));
 }
 
 void
@@ -416,6 +497,9 @@ void
 isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	      isc_statscounter_t counter)
 {
+	isc_stat_t *counters;
+	unsigned int slot;
+
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
@@ -427,19 +511,27 @@ isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
+	/*
+	 * The first copy gets the value and the others are cleared.
+	 */
+	for (slot = 0; slot < stats->nslots; slot++) {
+		counters = &stats->counters[slot * stats->stride];
+		if (slot != 0)
+			val = 0;
 #if ISC_STATS_USEMULTIFIELDS
-	stats->counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
-	stats->counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
+		counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
+		counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
 #elif ISC_STATS_HAVEATOMICQ
 #if defined(ISC_STATS_HAVESTDATOMICQ)
-	atomic_store_explicit(&stats->counters[counter], val,
-			      memory_order_relaxed);
+		atomic_store_explicit(&counters[counter], val,
+				      memory_order_relaxed);
 #else
-	isc_atomic_storeq((isc_int64_t *)&stats->counters[counter], val);
+		isc_atomic_storeq((isc_int64_t *)&counters[counter], val);
 #endif
 #else
-	stats->counters[counter] = val;
+		counters[counter] = val;
 #endif
+	}
 
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_write);
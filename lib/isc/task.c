@@ -109,6 +109,8 @@ struct isc__task {
 	void *				tag;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of queue 'threadid'. */
+	unsigned int			threadid;
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -124,28 +126,57 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*
+ * Each worker thread has its own run queue.  A task is made ready on the
+ * queue of the worker that last ran it, and a worker whose queue is empty
+ * steals from the others before going to sleep.
+ *
+ * 'mode', 'halt' and 'finished' mirror the manager state so that workers
+ * need not take the manager lock between tasks; they are updated by
+ * sync_queues() with the manager lock held.
+ */
+typedef struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_ready;
+	unsigned int			tasks_running;
+	isc_taskmgrmode_t		mode;
+	isc_boolean_t			halt;
+	isc_boolean_t			finished;
+	isc_boolean_t			idle;
+	isc_boolean_t			poked;
+	unsigned int			nextthief;
+#ifdef USE_WORKER_THREADS
+	isc_condition_t			work_available;
+#endif /* USE_WORKER_THREADS */
+} isc__taskqueue_t;
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
 	isc_mem_t *			mctx;
 	isc_mutex_t			lock;
-#ifdef ISC_PLATFORM_USETHREADS
 	unsigned int			workers;
+	isc__taskqueue_t *		queues;
+#ifdef ISC_PLATFORM_USETHREADS
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			curq;
 	isc_taskmgrmode_t		mode;
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
+	isc_condition_t			halt_cond;
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
 #endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
+	unsigned int			halted;
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
 	isc_boolean_t			exiting;
@@ -242,13 +273,16 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskqueue_t *queue);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task);
+
+static void
+sync_queues(isc__taskmgr_t *manager);
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -311,17 +345,18 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
-#ifdef USE_WORKER_THREADS
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
 		 * task manager is exiting.  Wake up
-		 * any idle worker threads so they
-		 * can exit.
+		 * any idle or halted worker threads
+		 * so they can exit.
 		 */
-		BROADCAST(&manager->work_available);
-	}
+		sync_queues(manager);
+#ifdef USE_WORKER_THREADS
+		BROADCAST(&manager->halt_cond);
 #endif /* USE_WORKER_THREADS */
+	}
 	UNLOCK(&manager->lock);
 
 	DESTROYLOCK(&task->lock);
@@ -372,6 +407,7 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		task->threadid = manager->curq++ % manager->workers;
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -450,16 +486,46 @@ task_shutdown(isc__task_t *task) {
 	return (was_idle);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * Nudge an idle worker other than 'threadid' into stealing from the
+ * backlog on 'threadid''s queue.  Successive calls try successive
+ * workers.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_thief(isc__taskmgr_t *manager, unsigned int threadid,
+	   unsigned int hint)
+{
+	isc__taskqueue_t *thief;
+
+	INSIST(manager->workers > 1);
+
+	thief = &manager->queues[(threadid + 1 + hint % (manager->workers - 1))
+				 % manager->workers];
+	LOCK(&thief->lock);
+	thief->poked = ISC_TRUE;
+	if (thief->idle)
+		SIGNAL(&thief->work_available);
+	UNLOCK(&thief->lock);
+}
+#endif /* USE_WORKER_THREADS */
+
 /*
- * Moves a task onto the appropriate run queue.
+ * Moves a task onto the run queue of the worker it last ran on.
  *
  * Caller must NOT hold manager lock.
  */
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
+	unsigned int threadid;
 #ifdef USE_WORKER_THREADS
 	isc_boolean_t has_privilege = isc__task_privilege((isc_task_t *) task);
+	isc_boolean_t backlog = ISC_FALSE;
+	unsigned int hint = 0;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -467,13 +533,36 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
-	push_readyq(manager, task);
+	/*
+	 * The task is neither queued nor running, so nobody else can
+	 * change 'threadid' under us.
+	 */
+	threadid = task->threadid;
+	queue = &manager->queues[threadid];
+
+	LOCK(&queue->lock);
+	push_readyq(queue, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (queue->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->idle)
+			SIGNAL(&queue->work_available);
+		else if (queue->tasks_running > 0 && manager->workers > 1) {
+			/*
+			 * The owner is busy, possibly with a long event;
+			 * don't leave even a single ready task waiting
+			 * behind it while other workers sleep.
+			 */
+			backlog = ISC_TRUE;
+			hint = queue->nextthief++;
+		}
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
+#ifdef USE_WORKER_THREADS
+	if (backlog)
+		wake_thief(manager, threadid, hint);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline isc_boolean_t
@@ -935,46 +1024,47 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return ISC_TRUE if the current ready list for the manager, which is
+ * Return ISC_TRUE if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
-	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+	if (queue->mode == isc_taskmgrmode_normal)
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(list)));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list for 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
-	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+	if (queue->mode == isc_taskmgrmode_normal)
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		queue->tasks_ready--;
 	}
 
 	return (task);
@@ -984,330 +1074,397 @@ pop_readyq(isc__taskmgr_t *manager) {
  * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
  * flag set, then also push it onto the ready_priority_tasks queue.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
 }
 
+/*
+ * Copy the manager's mode, pause/exclusive and exit state to every
+ * queue and wake their workers so they notice.
+ *
+ * Caller must hold the manager lock and no queue lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
-	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
-	unsigned int total_dispatch_count = 0;
-	isc__tasklist_t new_ready_tasks;
-	isc__tasklist_t new_priority_tasks;
-	unsigned int tasks_ready = 0;
+sync_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		LOCK(&queue->lock);
+		queue->mode = manager->mode;
+		queue->halt = ISC_TF(manager->pause_requested ||
+				     manager->exclusive_requested);
+		queue->finished = FINISHED(manager);
+#ifdef USE_WORKER_THREADS
+		BROADCAST(&queue->work_available);
 #endif /* USE_WORKER_THREADS */
+		UNLOCK(&queue->lock);
+	}
+}
 
-	REQUIRE(VALID_MANAGER(manager));
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON)
+/*
+ * Sum the running and ready task counts over all queues.
+ *
+ * Caller must hold the manager lock and no queue lock.
+ */
+static void
+count_tasks(isc__taskmgr_t *manager, unsigned int *runningp,
+	    unsigned int *readyp)
+{
+	unsigned int i, running = 0, ready = 0;
 
-	/*
-	 * Again we're trying to hold the lock for as short a time as possible
-	 * and to do as little locking and unlocking as possible.
-	 *
-	 * In both while loops, the appropriate lock must be held before the
-	 * while body starts.  Code which acquired the lock at the top of
-	 * the loop would be more readable, but would result in a lot of
-	 * extra locking.  Compare:
-	 *
-	 * Straightforward:
-	 *
-	 *	LOCK();
-	 *	...
-	 *	UNLOCK();
-	 *	while (expression) {
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *	}
-	 *
-	 * Note how if the loop continues we unlock and then immediately lock.
-	 * For N iterations of the loop, this code does 2N+1 locks and 2N+1
-	 * unlocks.  Also note that the lock is not held when the while
-	 * condition is tested, which may or may not be important, depending
-	 * on the expression.
-	 *
-	 * As written:
-	 *
-	 *	LOCK();
-	 *	while (expression) {
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *	}
-	 *	UNLOCK();
-	 *
-	 * For N iterations of the loop, this code does N+1 locks and N+1
-	 * unlocks.  The while expression is always protected by the lock.
-	 */
+	for (i = 0; i < manager->workers; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_INIT(new_ready_tasks);
-	ISC_LIST_INIT(new_priority_tasks);
-#endif
-	LOCK(&manager->lock);
+		LOCK(&queue->lock);
+		running += queue->tasks_running;
+		ready += queue->tasks_ready;
+		UNLOCK(&queue->lock);
+	}
 
-	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
-		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
-		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
-		}
-#else /* USE_WORKER_THREADS */
-		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
-			break;
-#endif /* USE_WORKER_THREADS */
-		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
-					    ISC_MSG_WORKING, "working"));
+	*runningp = running;
+	*readyp = ready;
+}
+#endif /* HAVE_LIBXML2 || HAVE_JSON */
+
+/*
+ * Run the events of 'task', which the caller has just taken off a ready
+ * queue, until it has nothing left to do or its quantum expires.  Every
+ * event run is added to '*dispatchedp'.
+ *
+ * Returns ISC_TRUE if the task still has events and must be put back on
+ * a ready queue.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc_boolean_t
+task_run(isc__task_t *task, unsigned int *dispatchedp) {
+	unsigned int dispatch_count = 0;
+	isc_boolean_t done = ISC_FALSE;
+	isc_boolean_t requeue = ISC_FALSE;
+	isc_boolean_t finished = ISC_FALSE;
+	isc_event_t *event;
 
-		task = pop_readyq(manager);
-		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			isc_boolean_t done = ISC_FALSE;
-			isc_boolean_t requeue = ISC_FALSE;
-			isc_boolean_t finished = ISC_FALSE;
-			isc_event_t *event;
+	INSIST(VALID_TASK(task));
 
-			INSIST(VALID_TASK(task));
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	TIME_NOW(&task->tnow);
+	task->now = isc_time_seconds(&task->tnow);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+			task->nevents--;
 
 			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
+			 * Execute the event action.
 			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			TIME_NOW(&task->tnow);
-			task->now = isc_time_seconds(&task->tnow);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-					task->nevents--;
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					isc_boolean_t was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = ISC_TRUE;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = ISC_TRUE;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = ISC_TRUE;
-					done = ISC_TRUE;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
-
-			if (finished)
-				task_finished(task);
-
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					    ISC_MSGSET_TASK,
+					    ISC_MSG_EXECUTE,
+					    "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)(
+					(isc_task_t *)task,
+					event);
+				LOCK(&task->lock);
 			}
-#endif /* USE_WORKER_THREADS */
-			if (requeue) {
+			dispatch_count++;
+			(*dispatchedp)++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			isc_boolean_t was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY,
+					      "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
 				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * The task is done.
 				 */
-#ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
-#else
-				ENQUEUE(new_ready_tasks, task, ready_link);
-				if ((task->flags & TASK_F_PRIVILEGED) != 0)
-					ENQUEUE(new_priority_tasks, task,
-						ready_priority_link);
-				tasks_ready++;
-#endif
-			}
+				XTRACE(isc_msgcat_get(
+					       isc_msgcat,
+					       ISC_MSGSET_TASK,
+					       ISC_MSG_DONE,
+					       "done"));
+				finished = ISC_TRUE;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = ISC_TRUE;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM,
+					      "quantum"));
+			task->state = task_state_ready;
+			requeue = ISC_TRUE;
+			done = ISC_TRUE;
 		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	if (finished)
+		task_finished(task);
+
+	return (requeue);
+}
 
 #ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
+/*
+ * Take a ready task from another worker's queue.  On success the task's
+ * affinity moves to 'queue'.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc__task_t *
+steal_task(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__task_t *task = NULL;
+	unsigned int i;
+
+	for (i = 1; task == NULL && i < manager->workers; i++) {
+		isc__taskqueue_t *victim;
+
+		victim = &manager->queues[(queue->threadid + i) %
+					  manager->workers];
+		LOCK(&victim->lock);
+		task = pop_readyq(victim);
+		if (task != NULL)
+			task->threadid = queue->threadid;
+		UNLOCK(&victim->lock);
+	}
+
+	return (task);
+}
+
+/*
+ * Park the calling worker while a pause or exclusive mode is in effect.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+halt_worker(isc__taskmgr_t *manager) {
+	LOCK(&manager->lock);
+	manager->halted++;
+	if (manager->exclusive_requested &&
+	    manager->halted + 1 == manager->workers)
+		SIGNAL(&manager->exclusive_granted);
+	else if (manager->pause_requested &&
+		 manager->halted == manager->workers)
+		SIGNAL(&manager->paused);
+	while ((manager->pause_requested || manager->exclusive_requested) &&
+	       !FINISHED(manager))
+	{
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+					    ISC_MSG_WAIT, "wait"));
+		WAIT(&manager->halt_cond, &manager->lock);
+	}
+	manager->halted--;
+	UNLOCK(&manager->lock);
+}
+
+/*
+ * If we are in privileged execution mode and no privileged task is
+ * running or ready anywhere, then we're stuck.  Automatically drop
+ * privileges at that point and continue with the regular ready queues.
+ *
+ * Returns ISC_TRUE if the mode was changed.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc_boolean_t
+drop_privilege(isc__taskmgr_t *manager) {
+	isc_boolean_t busy = ISC_FALSE;
+	isc_boolean_t dropped = ISC_FALSE;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	if (manager->mode != isc_taskmgrmode_normal) {
+		for (i = 0; !busy && i < manager->workers; i++) {
+			isc__taskqueue_t *queue = &manager->queues[i];
+
+			LOCK(&queue->lock);
+			busy = ISC_TF(queue->tasks_running != 0 ||
+				      !EMPTY(queue->ready_priority_tasks));
+			UNLOCK(&queue->lock);
+		}
+		if (!busy) {
 			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+			sync_queues(manager);
+			dropped = ISC_TRUE;
 		}
-#endif
 	}
+	UNLOCK(&manager->lock);
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
-			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
-		manager->mode = isc_taskmgrmode_normal;
-#endif
+	return (dropped);
+}
 
-	UNLOCK(&manager->lock);
+static void
+dispatch(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__task_t *task;
+	unsigned int dispatched = 0;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	/*
+	 * The queue lock is held whenever the loop condition is tested;
+	 * it is only dropped while stealing, halting or running a task.
+	 */
+	LOCK(&queue->lock);
+
+	while (!queue->finished) {
+		/*
+		 * If a pause or exclusive mode has been requested, don't
+		 * do any work until it's been released.
+		 */
+		if (queue->halt) {
+			UNLOCK(&queue->lock);
+			halt_worker(manager);
+			LOCK(&queue->lock);
+			continue;
+		}
+
+		/*
+		 * Count ourselves as running while we look for work, so
+		 * that drop_privilege() can't mistake a task in the middle
+		 * of being stolen for an idle manager.
+		 */
+		queue->tasks_running++;
+		task = pop_readyq(queue);
+		if (task == NULL && manager->workers > 1) {
+			queue->poked = ISC_FALSE;
+			UNLOCK(&queue->lock);
+			task = steal_task(manager, queue);
+			LOCK(&queue->lock);
+		}
+
+		if (task == NULL) {
+			queue->tasks_running--;
+			if (queue->mode != isc_taskmgrmode_normal) {
+				isc_boolean_t dropped;
+
+				UNLOCK(&queue->lock);
+				dropped = drop_privilege(manager);
+				LOCK(&queue->lock);
+				if (dropped)
+					continue;
+			}
+			if (empty_readyq(queue) && !queue->poked &&
+			    !queue->halt && !queue->finished)
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				queue->idle = ISC_TRUE;
+				WAIT(&queue->work_available, &queue->lock);
+				queue->idle = ISC_FALSE;
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_TASK,
+							    ISC_MSG_AWAKE,
+							    "awake"));
+			}
+			continue;
+		}
+
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+		UNLOCK(&queue->lock);
+
+		/*
+		 * For reasons similar to those given in the comment in
+		 * isc_task_send() above, it is safe for us to dequeue
+		 * the task while only holding the queue lock, and then
+		 * change the task to running state while only holding the
+		 * task lock.
+		 */
+		if (task_run(task, &dispatched)) {
+			/*
+			 * The task's quantum expired.  Put it at the back
+			 * of our own queue; if we're busy, another worker
+			 * may steal it.
+			 */
+			LOCK(&queue->lock);
+			push_readyq(queue, task);
+		} else
+			LOCK(&queue->lock);
+		queue->tasks_running--;
+	}
+
+	UNLOCK(&queue->lock);
 }
 
-#ifdef USE_WORKER_THREADS
 static isc_threadresult_t
 #ifdef _WIN32
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1318,15 +1475,79 @@ run(void *uap) {
 
 	return ((isc_threadresult_t)0);
 }
+#else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue = &manager->queues[0];
+	isc__task_t *task;
+	unsigned int total_dispatch_count = 0;
+	isc__tasklist_t new_ready_tasks;
+	isc__tasklist_t new_priority_tasks;
+	unsigned int tasks_ready = 0;
+	isc_boolean_t drop;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	ISC_LIST_INIT(new_ready_tasks);
+	ISC_LIST_INIT(new_priority_tasks);
+
+	LOCK(&queue->lock);
+	while (total_dispatch_count < DEFAULT_TASKMGR_QUANTUM) {
+		task = pop_readyq(queue);
+		if (task == NULL)
+			break;
+
+		queue->tasks_running++;
+		UNLOCK(&queue->lock);
+
+		if (task_run(task, &total_dispatch_count)) {
+			/*
+			 * Tasks whose quantum expired go to the back of
+			 * the queue once this round is over.
+			 */
+			ENQUEUE(new_ready_tasks, task, ready_link);
+			if ((task->flags & TASK_F_PRIVILEGED) != 0)
+				ENQUEUE(new_priority_tasks, task,
+					ready_priority_link);
+			tasks_ready++;
+		}
+
+		LOCK(&queue->lock);
+		queue->tasks_running--;
+	}
+
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
+			    ready_priority_link);
+	queue->tasks_ready += tasks_ready;
+	drop = ISC_TF(queue->mode != isc_taskmgrmode_normal &&
+		      empty_readyq(queue));
+	UNLOCK(&queue->lock);
+
+	if (drop) {
+		LOCK(&manager->lock);
+		manager->mode = isc_taskmgrmode_normal;
+		sync_queues(manager);
+		UNLOCK(&manager->lock);
+	}
+}
 #endif /* USE_WORKER_THREADS */
 
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
+	for (i = 0; i < manager->workers; i++) {
+#ifdef USE_WORKER_THREADS
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+#endif /* USE_WORKER_THREADS */
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+	isc_mem_free(manager->mctx, manager->queues);
 #ifdef USE_WORKER_THREADS
 	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
+	(void)isc_condition_destroy(&manager->halt_cond);
 	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
@@ -1343,12 +1564,46 @@ manager_free(isc__taskmgr_t *manager) {
 #endif	/* USE_SHARED_MANAGER */
 }
 
+static isc_result_t
+queue_init(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
+	isc_result_t result;
+
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_WORKER_THREADS
+	if (isc_condition_init(&queue->work_available) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+#endif /* USE_WORKER_THREADS */
+	queue->manager = manager;
+	queue->threadid = threadid;
+	INIT_LIST(queue->ready_tasks);
+	INIT_LIST(queue->ready_priority_tasks);
+	queue->tasks_ready = 0;
+	queue->tasks_running = 0;
+	queue->mode = isc_taskmgrmode_normal;
+	queue->halt = ISC_FALSE;
+	queue->finished = ISC_FALSE;
+	queue->idle = ISC_FALSE;
+	queue->poked = ISC_FALSE;
+	queue->nextthief = 0;
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		    unsigned int default_quantum, isc_taskmgr_t **managerp)
 {
 	isc_result_t result;
-	unsigned int i, started = 0;
+	unsigned int i;
 	isc__taskmgr_t *manager;
 
 	/*
@@ -1359,8 +1614,11 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
 #ifndef USE_WORKER_THREADS
-	UNUSED(i);
-	UNUSED(started);
+	/*
+	 * Without threads there is a single queue, run by the caller of
+	 * isc__taskmgr_dispatch().
+	 */
+	workers = 1;
 #endif
 
 #ifdef USE_SHARED_MANAGER
@@ -1390,15 +1648,27 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		goto cleanup_mgr;
 	}
 
-#ifdef USE_WORKER_THREADS
 	manager->workers = 0;
+	manager->queues = isc_mem_allocate(mctx,
+					   workers * sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_lock;
+	}
+	for (i = 0; i < workers; i++) {
+		result = queue_init(manager, i);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+	}
+
+#ifdef USE_WORKER_THREADS
 	manager->threads = isc_mem_allocate(mctx,
 					    workers * sizeof(isc_thread_t));
 	if (manager->threads == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
+		goto cleanup_queues;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
+	if (isc_condition_init(&manager->halt_cond) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
@@ -1412,7 +1682,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+		goto cleanup_haltcond;
 	}
 	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1427,10 +1697,8 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
+	manager->curq = 0;
+	manager->halted = 0;
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
@@ -1441,10 +1709,12 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Each one runs the queue with its own index, so
+	 * 'workers' only counts queues that have a thread behind them;
+	 * the rest are torn down below.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[16];	/* thread name limit on Linux */
@@ -1452,16 +1722,22 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 			isc_thread_setname(manager->threads[manager->workers],
 					   name);
 			manager->workers++;
-			started++;
 		}
 	}
 	UNLOCK(&manager->lock);
 
-	if (started == 0) {
+	for (i = manager->workers; i < workers; i++) {
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+
+	if (manager->workers == 0) {
 		manager_free(manager);
 		return (ISC_R_NOTHREADS);
 	}
 	isc_thread_setconcurrency(workers);
+#else /* USE_WORKER_THREADS */
+	manager->workers = workers;
 #endif /* USE_WORKER_THREADS */
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
@@ -1475,13 +1751,22 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
+ cleanup_haltcond:
+	(void)isc_condition_destroy(&manager->halt_cond);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
+#endif /* USE_WORKER_THREADS */
+ cleanup_queues:
+	while (i-- > 0) {
+#ifdef USE_WORKER_THREADS
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+#endif /* USE_WORKER_THREADS */
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+	isc_mem_free(mctx, manager->queues);
  cleanup_lock:
+	DESTROYLOCK(&manager->excl_lock);
 	DESTROYLOCK(&manager->lock);
-#endif
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1560,17 +1845,30 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		if (task_shutdown(task)) {
+			isc__taskqueue_t *queue;
+
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			push_readyq(queue, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
+
+	/*
+	 * Tell the queues that we are exiting and that privileged mode
+	 * is off.
+	 */
+	sync_queues(manager);
 #ifdef USE_WORKER_THREADS
 	/*
-	 * Wake up any sleeping workers.  This ensures we get work done if
-	 * there's work left to do, and if there are already no tasks left
-	 * it will cause the workers to see manager->exiting.
+	 * Wake up any halted workers.  sync_queues() has woken the
+	 * sleeping ones.  This ensures we get work done if there's work
+	 * left to do, and if there are already no tasks left it will cause
+	 * the workers to see the manager has finished.
 	 */
-	BROADCAST(&manager->work_available);
+	BROADCAST(&manager->halt_cond);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1612,6 +1910,7 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 
 	LOCK(&manager->lock);
 	manager->mode = mode;
+	sync_queues(manager);
 	UNLOCK(&manager->lock);
 }
 
@@ -1638,9 +1937,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_FALSE);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(&manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1665,9 +1964,11 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = ISC_TRUE;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
+	manager->pause_requested = ISC_TRUE;
+	sync_queues(manager);
+	while (manager->halted < manager->workers) {
 		WAIT(&manager->paused, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1680,7 +1981,8 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
+		sync_queues(manager);
+		BROADCAST(&manager->halt_cond);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1736,7 +2038,8 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
-	while (manager->tasks_running > 1) {
+	sync_queues(manager);
+	while (manager->halted + 1 < manager->workers) {
 		WAIT(&manager->exclusive_granted, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1756,7 +2059,8 @@ isc__task_endexclusive(isc_task_t *task0) {
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
+	sync_queues(manager);
+	BROADCAST(&manager->halt_cond);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1767,6 +2071,8 @@ void
 isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
+	unsigned int threadid;
 	isc_boolean_t oldpriv;
 
 	LOCK(&task->lock);
@@ -1780,14 +2086,25 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	/*
+	 * The task may be stolen by another worker while we wait for
+	 * the lock, so check that we got the queue it is really on.
+	 */
+	for (;;) {
+		threadid = task->threadid;
+		queue = &manager->queues[threadid];
+		LOCK(&queue->lock);
+		if (task->threadid == threadid)
+			break;
+		UNLOCK(&queue->lock);
+	}
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 isc_boolean_t
@@ -1821,6 +2138,7 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int running, ready;
 	int xmlrc;
 
 	LOCK(&mgr->lock);
@@ -1853,12 +2171,13 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 					    mgr->default_quantum));
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
+	count_tasks(mgr, &running, &ready);
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
@@ -1932,6 +2251,7 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
+	unsigned int running, ready;
 
 	LOCK(&mgr->lock);
 
@@ -1961,11 +2281,12 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	count_tasks(mgr, &running, &ready);
+	obj = json_object_new_int(running);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
@@ -80,7 +80,7 @@ create_managers(void) {
 	isc_taskmgr_setexcltask(taskmgr, maintask);
 
 	CHECK(isc_timermgr_create(mctx, &timermgr));
-	CHECK(isc_socketmgr_create(mctx, &socketmgr));
+	CHECK(isc_socketmgr_create2(mctx, &socketmgr, 0, ncpus));
 	return (ISC_R_SUCCESS);
 
  cleanup:
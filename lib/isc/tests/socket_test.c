@@ -15,6 +15,7 @@
 #include <unistd.h>
 #include <time.h>
 
+#include <isc/event.h>
 #include <isc/platform.h>
 #include <isc/socket.h>
 #include <isc/task.h>
@@ -212,6 +213,95 @@ ATF_TC_BODY(udp_sendto, tc) {
 	isc_test_end();
 }
 
+/* Test UDP sendto/recv over a manager with several network threads */
+ATF_TC(udp_threads);
+ATF_TC_HEAD(udp_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv with multiple "
+			  "network threads");
+}
+ATF_TC_BODY(udp_threads, tc) {
+	isc_result_t result;
+	isc_socketmgr_t *mgr = NULL;
+	isc_sockaddr_t addr[8];
+	struct in_addr in;
+	isc_socket_t *s[8];
+	isc_task_t *task = NULL;
+	char sendbuf[8][16], recvbuf[8][16];
+	completion_t completion[8];
+	isc_region_t r;
+	int i, n = 8;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socketmgr_create2(mctx, &mgr, 0, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < n; i++) {
+		s[i] = NULL;
+		isc_sockaddr_fromin(&addr[i], &in, 0);
+		result = isc_socket_create(mgr, PF_INET, isc_sockettype_udp,
+					   &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i], 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(s[i], &addr[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE(isc_sockaddr_getport(&addr[i]) != 0);
+	}
+
+	/*
+	 * Post all the receives first so that every thread has a
+	 * descriptor to watch, then have each socket send to the next.
+	 */
+	for (i = 0; i < n; i++) {
+		memset(recvbuf[i], 0, sizeof(recvbuf[i]));
+		r.base = (void *) recvbuf[i];
+		r.length = sizeof(recvbuf[i]);
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; i++) {
+		completion_t sent;
+
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent);
+		result = isc_socket_sendto(s[i], &r, task, event_done, &sent,
+					   &addr[(i + 1) % n], NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&sent);
+		ATF_CHECK(sent.done);
+		ATF_CHECK_EQ(sent.result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; i++) {
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf[(i + n - 1) % n]);
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < n; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_socketmgr_destroy(&mgr);
+
+	isc_test_end();
+}
+
 /* Test UDP sendto/recv with duplicated socket */
 ATF_TC(udp_dup);
 ATF_TC_HEAD(udp_dup, tc) {
@@ -313,6 +403,389 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test batched UDP sendto/recv */
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv with "
+			  "ISC_SOCKFLAG_BATCH");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[16][16], recvbuf[16][16];
+	completion_t sent[16], received[16];
+	isc_socketevent_t *socketevent;
+	isc_region_t r;
+	int i, n = 16;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(isc_sockaddr_getport(&addr2) != 0);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Batched receives are always queued, so they are all waiting
+	 * by the time the datagrams arrive and are filled in order.
+	 */
+	for (i = 0; i < n; i++) {
+		memset(recvbuf[i], 0, sizeof(recvbuf[i]));
+		r.base = (void *) recvbuf[i];
+		r.length = sizeof(recvbuf[i]);
+		completion_init(&received[i]);
+		socketevent = isc_socket_socketevent(mctx, s2,
+						     ISC_SOCKEVENT_RECVDONE,
+						     event_done, &received[i]);
+		ATF_REQUIRE(socketevent != NULL);
+		result = isc_socket_recv2(s2, &r, 1, task, socketevent,
+					  ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent[i]);
+		socketevent = isc_socket_socketevent(mctx, s1,
+						     ISC_SOCKEVENT_SENDDONE,
+						     event_done, &sent[i]);
+		ATF_REQUIRE(socketevent != NULL);
+		result = isc_socket_sendto2(s1, &r, task, &addr2, NULL,
+					    socketevent, ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; i++) {
+		waitfor(&sent[i]);
+		ATF_CHECK(sent[i].done);
+		ATF_CHECK_EQ(sent[i].result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < n; i++) {
+		waitfor(&received[i]);
+		ATF_CHECK(received[i].done);
+		ATF_CHECK_EQ(received[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf[i]);
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+#if defined(HAVE_SENDMMSG) && defined(IP_RECVERR)
+/*
+ * Batched sends that have to wait are queued on the socket and flushed
+ * later with sendmmsg().  To get them there on demand the sender asks
+ * for ICMP errors, so that a datagram to a closed port makes the next
+ * send on the socket fail with ECONNREFUSED.  That error is soft on an
+ * unconnected socket: a plain send is queued for the watcher, and a
+ * batch is cut short behind the datagram that provoked it.
+ */
+#define FLUSH_SENDS	400
+#define FLUSH_CLOSED1	20	/* followed by an ISC_SOCKFLAG_NORETRY send */
+#define FLUSH_CLOSED2	60
+#define FLUSH_CLOSED3	(FLUSH_SENDS - 1)
+
+static completion_t flushsent[FLUSH_SENDS];
+static unsigned int flushn[FLUSH_SENDS];
+static int flushorder[FLUSH_SENDS];
+static int flushcount;
+static isc_boolean_t flushhold;
+
+static void
+flush_done(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *dev = (isc_socketevent_t *) event;
+	completion_t *completion = event->ev_arg;
+	int i = (int)(completion - flushsent);
+
+	UNUSED(task);
+
+	flushn[i] = dev->n;
+	flushorder[i] = flushcount++;
+	completion->result = dev->result;
+	completion->done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+flush_hold(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	while (flushhold)
+		isc_test_nap(1000);
+	isc_event_free(&event);
+}
+
+/* Test flushing queued batched UDP sends */
+ATF_TC(udp_batch_flush);
+ATF_TC_HEAD(udp_batch_flush, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto with ISC_SOCKFLAG_BATCH "
+			  "behind a blocked send");
+}
+ATF_TC_BODY(udp_batch_flush, tc) {
+	static char sendbuf[FLUSH_SENDS][16], recvbuf[FLUSH_SENDS][16];
+	static completion_t received[FLUSH_SENDS];
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2, closed;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_event_t *event;
+	isc_socketevent_t *socketevent;
+	isc_sockaddr_t *to;
+	isc_region_t r;
+	unsigned int flags;
+	int on = 1, rcvbuf = 1024 * 1024;
+	int fd, i, j, nrecv;
+	ISC_SOCKADDR_LEN_T len;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+	isc_sockaddr_fromin(&closed, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(setsockopt(isc_socket_getfd(s1), IPPROTO_IP, IP_RECVERR,
+			       &on, sizeof(on)) == 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)setsockopt(isc_socket_getfd(s2), SOL_SOCKET, SO_RCVBUF,
+			 &rcvbuf, sizeof(rcvbuf));
+
+	/*
+	 * Find a port nobody is listening on.  isc_socket_detach() closes
+	 * the descriptor asynchronously, so use a plain socket here.
+	 */
+	fd = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	ATF_REQUIRE(fd >= 0);
+	ATF_REQUIRE(bind(fd, &closed.type.sa, closed.length) == 0);
+	len = sizeof(closed.type);
+	ATF_REQUIRE(getsockname(fd, &closed.type.sa, &len) == 0);
+	close(fd);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queued sends are flushed from the task of the first one, so
+	 * keep that busy until everything has been queued.
+	 */
+	flushhold = ISC_TRUE;
+	event = isc_event_allocate(mctx, NULL, ISC_TASKEVENT_TEST,
+				   flush_hold, NULL, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(task, &event);
+
+	flushcount = 0;
+	for (i = 0; i < FLUSH_SENDS; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&flushsent[i]);
+		socketevent = isc_socket_socketevent(mctx, s1,
+						     ISC_SOCKEVENT_SENDDONE,
+						     flush_done, &flushsent[i]);
+		ATF_REQUIRE(socketevent != NULL);
+
+		to = &addr2;
+		flags = ISC_SOCKFLAG_BATCH | ISC_SOCKFLAG_IMMEDIATE;
+		if (i == 0 || i == FLUSH_CLOSED1 || i == FLUSH_CLOSED2 ||
+		    i == FLUSH_CLOSED3)
+		{
+			to = &closed;
+		}
+		if (i == 0 || i == 1) {
+			/* Provoke the error, then queue behind it. */
+			flags = ISC_SOCKFLAG_IMMEDIATE;
+		} else if (i == FLUSH_CLOSED1 + 1)
+			flags |= ISC_SOCKFLAG_NORETRY;
+
+		result = isc_socket_sendto2(s1, &r, task, to, NULL,
+					    socketevent, flags);
+		if (i == 0) {
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			flushsent[i].result = socketevent->result;
+			flushsent[i].done = ISC_TRUE;
+			flushn[i] = socketevent->n;
+			flushorder[i] = flushcount++;
+			isc_event_free(ISC_EVENT_PTR(&socketevent));
+			/* Give the ICMP error time to arrive. */
+			isc_test_nap(10000);
+		} else
+			ATF_REQUIRE_EQ_MSG(result, ISC_R_INPROGRESS,
+					   "send %d: %s", i,
+					   isc_result_totext(result));
+	}
+
+	/*
+	 * Batched receives are always queued, so they are filled in the
+	 * order the datagrams arrive.
+	 */
+	nrecv = 0;
+	for (i = 0; i < FLUSH_SENDS; i++) {
+		if (i == 0 || i == FLUSH_CLOSED1 || i == FLUSH_CLOSED1 + 1 ||
+		    i == FLUSH_CLOSED2 || i == FLUSH_CLOSED3)
+		{
+			continue;
+		}
+		memset(recvbuf[nrecv], 0, sizeof(recvbuf[nrecv]));
+		r.base = (void *) recvbuf[nrecv];
+		r.length = sizeof(recvbuf[nrecv]);
+		completion_init(&received[nrecv]);
+		socketevent = isc_socket_socketevent(mctx, s2,
+						     ISC_SOCKEVENT_RECVDONE,
+						     event_done, &received[nrecv]);
+		ATF_REQUIRE(socketevent != NULL);
+		result = isc_socket_recv2(s2, &r, 1, task, socketevent,
+					  ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		nrecv++;
+	}
+
+	flushhold = ISC_FALSE;
+
+	/*
+	 * Every send completes exactly once and in order.  The one queued
+	 * with ISC_SOCKFLAG_NORETRY lands right behind a datagram that
+	 * provokes an error, and must not be retried.
+	 */
+	for (i = 0; i < FLUSH_SENDS; i++) {
+		waitfor(&flushsent[i]);
+		ATF_REQUIRE_MSG(flushsent[i].done, "send %d not done", i);
+		if (i == FLUSH_CLOSED1 + 1) {
+			ATF_CHECK_EQ_MSG(flushsent[i].result,
+					 ISC_R_WOULDBLOCK, "%s",
+					 isc_result_totext(flushsent[i].result));
+			continue;
+		}
+		ATF_CHECK_EQ_MSG(flushsent[i].result, ISC_R_SUCCESS,
+				 "send %d: %s", i,
+				 isc_result_totext(flushsent[i].result));
+		ATF_CHECK_EQ(flushn[i], strlen(sendbuf[i]) + 1);
+		ATF_CHECK_EQ_MSG(flushorder[i], i, "send %d completed %d", i,
+				 flushorder[i]);
+	}
+	ATF_CHECK_EQ(flushorder[FLUSH_CLOSED1 + 1], FLUSH_CLOSED1 + 1);
+
+	for (i = 1, j = 0; i < FLUSH_SENDS; i++) {
+		if (i == FLUSH_CLOSED1 || i == FLUSH_CLOSED1 + 1 ||
+		    i == FLUSH_CLOSED2 || i == FLUSH_CLOSED3)
+		{
+			continue;
+		}
+		waitfor(&received[j]);
+		ATF_REQUIRE_MSG(received[j].done, "receive %d not done", j);
+		ATF_CHECK_EQ(received[j].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[j], sendbuf[i]);
+		j++;
+	}
+	ATF_CHECK_EQ(j, nrecv);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+#endif /* HAVE_SENDMMSG && IP_RECVERR */
+
+/* Test binding two UDP sockets to one port with SO_REUSEPORT */
+ATF_TC(udp_reuseport);
+ATF_TC_HEAD(udp_reuseport, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP SO_REUSEPORT");
+}
+ATF_TC_BODY(udp_reuseport, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_test_end();
+		atf_tc_skip("SO_REUSEPORT not supported");
+	}
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	/* A second SO_REUSEPORT socket can share the port... */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr1,
+				 ISC_SOCKET_REUSEADDRESS|ISC_SOCKET_REUSEPORT);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+
+	/* ...but a plain socket cannot. */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s3, &addr1, 0);
+	ATF_CHECK_EQ_MSG(result, ISC_R_ADDRINUSE, "%s",
+			 isc_result_totext(result));
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+
+	isc_test_end();
+}
+
 /* Test TCP sendto/recv (IPv4) */
 ATF_TC(udp_dscp_v4);
 ATF_TC_HEAD(udp_dscp_v4, tc) {
@@ -780,6 +1253,12 @@ ATF_TC_BODY(net_probedscp, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_threads);
+	ATF_TP_ADD_TC(tp, udp_reuseport);
+	ATF_TP_ADD_TC(tp, udp_batch);
+#if defined(HAVE_SENDMMSG) && defined(IP_RECVERR)
+	ATF_TP_ADD_TC(tp, udp_batch_flush);
+#endif
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2018  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	5
+#define NTHREADS	4
+#define NINCREMENTS	10000
+
+static void
+dump(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+static void
+getvalues(isc_stats_t *stats, isc_uint64_t *values) {
+	int i;
+
+	for (i = 0; i < NCOUNTERS; i++)
+		values[i] = 0;
+	isc_stats_dump(stats, dump, values, ISC_STATSDUMP_VERBOSE);
+}
+
+static void
+basic(isc_stats_t *stats) {
+	isc_uint64_t values[NCOUNTERS];
+	int i;
+
+	ATF_CHECK_EQ(isc_stats_ncounters(stats), NCOUNTERS);
+
+	for (i = 0; i < 10; i++)
+		isc_stats_increment(stats, 1);
+	for (i = 0; i < 3; i++)
+		isc_stats_decrement(stats, 1);
+	isc_stats_decrement(stats, 2);
+	isc_stats_set(stats, 42, 3);
+
+	getvalues(stats, values);
+	ATF_CHECK_EQ(values[0], 0);
+	ATF_CHECK_EQ(values[1], 7);
+	ATF_CHECK_EQ(values[2], (isc_uint64_t)-1);
+	ATF_CHECK_EQ(values[3], 42);
+	ATF_CHECK_EQ(values[4], 0);
+
+	isc_stats_increment(stats, 2);
+	isc_stats_set(stats, 0, 3);
+	getvalues(stats, values);
+	ATF_CHECK_EQ(values[2], 0);
+	ATF_CHECK_EQ(values[3], 0);
+}
+
+ATF_TC(isc_stats);
+ATF_TC_HEAD(isc_stats, tc) {
+	atf_tc_set_md_var(tc, "descr", "counting, setting and dumping");
+}
+ATF_TC_BODY(isc_stats, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	basic(stats);
+	isc_stats_detach(&stats);
+
+	result = isc_stats_createpercpu(mctx, &stats, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	basic(stats);
+	isc_stats_detach(&stats);
+
+	isc_test_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+counting(isc_threadarg_t arg) {
+	isc_stats_t *stats = arg;
+	int i;
+
+	for (i = 0; i < NINCREMENTS; i++) {
+		isc_stats_increment(stats, 0);
+		isc_stats_increment(stats, 4);
+		isc_stats_decrement(stats, 4);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_stats_threads);
+ATF_TC_HEAD(isc_stats_threads, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "per-CPU counters add up across threads");
+}
+ATF_TC_BODY(isc_stats_threads, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	isc_thread_t threads[NTHREADS];
+	isc_uint64_t values[NCOUNTERS];
+	int i;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_createpercpu(mctx, &stats, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(counting, stats, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	getvalues(stats, values);
+	ATF_CHECK_EQ(values[0], NTHREADS * NINCREMENTS);
+	ATF_CHECK_EQ(values[4], 0);
+
+	isc_stats_detach(&stats);
+	isc_test_end();
+}
+#endif
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_stats);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_stats_threads);
+#endif
+	return (atf_no_error());
+}
@@ -53,6 +53,39 @@ set_and_drop(isc_task_t *task, isc_event_t *event) {
 	isc_taskmgr_setmode(taskmgr, isc_taskmgrmode_normal);
 }
 
+/*
+ * Counts events; every EXCL_EVERY'th one also runs exclusively and
+ * checks that no other event ran meanwhile.
+ */
+#define EXCL_EVERY	100
+int in_exclusive = 0;
+int violations = 0;
+
+static void
+count_and_exclude(isc_task_t *task, isc_event_t *event) {
+	isc_boolean_t excl;
+	int n;
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	if (in_exclusive)
+		violations++;
+	n = counter++;
+	UNLOCK(&set_lock);
+
+	excl = ISC_TF((n % EXCL_EVERY) == 0);
+	if (excl && isc_task_beginexclusive(task) == ISC_R_SUCCESS) {
+		LOCK(&set_lock);
+		in_exclusive = 1;
+		UNLOCK(&set_lock);
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		in_exclusive = 0;
+		UNLOCK(&set_lock);
+		isc_task_endexclusive(task);
+	}
+}
+
 /*
  * Individual unit tests
  */
@@ -391,6 +424,217 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/*
+ * Run many events on many tasks with several worker threads, so that
+ * ready tasks are spread over the workers' queues and stolen between
+ * them, with exclusive mode requested along the way.
+ */
+#define MW_WORKERS	4
+#define MW_TASKS	16
+#define MW_EVENTS	250
+
+ATF_TC(many_workers);
+ATF_TC_HEAD(many_workers, tc) {
+	atf_tc_set_md_var(tc, "descr", "spread tasks over several workers");
+}
+ATF_TC_BODY(many_workers, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_taskmgr_t *manager = NULL;
+	isc_task_t *tasks[MW_TASKS];
+	isc_event_t *event;
+	int i, j, done = 0;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_taskmgr_create(mctx, MW_WORKERS, 0, &manager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < MW_TASKS; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(manager, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (j = 0; j < MW_EVENTS; j++) {
+		for (i = 0; i < MW_TASKS; i++) {
+			event = isc_event_allocate(mctx, tasks[i],
+						   ISC_TASKEVENT_TEST,
+						   count_and_exclude, NULL,
+						   sizeof (isc_event_t));
+			ATF_REQUIRE(event != NULL);
+			isc_task_send(tasks[i], &event);
+		}
+	}
+
+	for (i = 0; done < MW_TASKS * MW_EVENTS && i < 10000; i++) {
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		done = counter;
+		UNLOCK(&set_lock);
+	}
+
+	ATF_CHECK_EQ(done, MW_TASKS * MW_EVENTS);
+	ATF_CHECK_EQ(violations, 0);
+
+	for (i = 0; i < MW_TASKS; i++)
+		isc_task_detach(&tasks[i]);
+	isc_taskmgr_destroy(&manager);
+	ATF_REQUIRE_EQ(manager, NULL);
+
+	isc_test_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+/*
+ * One event blocks its worker until a second task, which is queued on
+ * the same worker, has run; that must be picked up by an idle worker
+ * rather than wait behind the blocking event.
+ */
+#define BL_TIMEOUT	2000	/* milliseconds */
+
+int bl_started = 0;
+int bl_released = 0;
+
+static void
+block(isc_task_t *task, isc_event_t *event) {
+	int i, released = 0;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	bl_started = 1;
+	UNLOCK(&set_lock);
+
+	for (i = 0; !released && i < BL_TIMEOUT; i++) {
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		released = bl_released;
+		UNLOCK(&set_lock);
+	}
+
+	LOCK(&set_lock);
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+static void
+release(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	bl_released = 1;
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+ATF_TC(blocked_worker);
+ATF_TC_HEAD(blocked_worker, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "ready task behind a blocked worker runs promptly");
+}
+ATF_TC_BODY(blocked_worker, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_taskmgr_t *manager = NULL;
+	isc_task_t *tasks[MW_WORKERS + 1];
+	isc_event_t *event;
+	int i, started = 0, released = 0, done = 0;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_taskmgr_create(mctx, MW_WORKERS, 0, &manager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * New tasks are handed to the workers in turn, so the first
+	 * and the last of these start out on the same worker.
+	 */
+	for (i = 0; i < MW_WORKERS + 1; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(manager, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Let the new workers settle into waiting for work, so that
+	 * none of them is around to steal the blocking event from the
+	 * worker it is queued on.
+	 */
+	isc_test_nap(200000);
+
+	event = isc_event_allocate(mctx, tasks[0], ISC_TASKEVENT_TEST,
+				   block, NULL, sizeof (isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(tasks[0], &event);
+
+	for (i = 0; !started && i < 5000; i++) {
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		started = bl_started;
+		UNLOCK(&set_lock);
+	}
+	ATF_REQUIRE(started);
+
+	event = isc_event_allocate(mctx, tasks[MW_WORKERS],
+				   ISC_TASKEVENT_TEST,
+				   release, NULL, sizeof (isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(tasks[MW_WORKERS], &event);
+
+	/*
+	 * Give the second task a quarter of the time the first one
+	 * is prepared to block for.
+	 */
+	for (i = 0; !released && i < BL_TIMEOUT / 4; i++) {
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		released = bl_released;
+		UNLOCK(&set_lock);
+	}
+	ATF_CHECK(released);
+
+	for (i = 0; done < 2 && i < 5000; i++) {
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		done = counter;
+		UNLOCK(&set_lock);
+	}
+	ATF_CHECK_EQ(done, 2);
+
+	for (i = 0; i < MW_WORKERS + 1; i++)
+		isc_task_detach(&tasks[i]);
+	isc_taskmgr_destroy(&manager);
+	ATF_REQUIRE_EQ(manager, NULL);
+
+	isc_test_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
 /*
  * Main
  */
@@ -399,6 +643,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, many_workers);
+	ATF_TP_ADD_TC(tp, blocked_worker);
 
 	return (atf_no_error());
 }
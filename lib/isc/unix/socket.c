@@ -100,6 +100,19 @@
 #include <netinet/tcp.h>
 #endif
 
+/*%
+ * ISC_SOCKET_REUSEPORT is only honoured where the kernel balances
+ * incoming datagrams across the sockets sharing an address and port:
+ * SO_REUSEPORT_LB on FreeBSD and SO_REUSEPORT on Linux.  Elsewhere
+ * SO_REUSEPORT merely permits the bind, and one socket would receive
+ * all of the traffic.
+ */
+#if defined(SO_REUSEPORT_LB)
+#define REUSEPORT_OPTION SO_REUSEPORT_LB
+#elif defined(SO_REUSEPORT) && defined(__linux__)
+#define REUSEPORT_OPTION SO_REUSEPORT
+#endif
+
 /*%
  * Choose the most preferable multiplex method.
  */
@@ -323,6 +336,7 @@ typedef isc_event_t intev_t;
 
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -339,6 +353,7 @@ struct isc__socket {
 	unsigned int		references;
 	int			fd;
 	int			pf;
+	int			threadid;
 	char				name[16];
 	void *				tag;
 
@@ -366,7 +381,9 @@ struct isc__socket {
 				bound : 1,          /* bound to local addr */
 				dupped : 1,
 				active : 1,         /* currently active */
-				pktdscp : 1;	    /* per packet dscp */
+				pktdscp : 1,	    /* per packet dscp */
+				flushing : 1,	    /* sendmmsg() in progress */
+				batchsend : 1;	    /* send_list is batched */
 
 #ifdef ISC_NET_RECVOVERFLOW
 	unsigned char		overflow; /* used for MSG_TRUNC fake */
@@ -392,8 +409,49 @@ struct isc__socketmgr {
 	isc_socketmgr_t		common;
 	isc_mem_t	       *mctx;
 	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
 	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
+	unsigned int		maxsocks;
+
+	/*
+	 * Descriptor tables, shared by all threads.  A descriptor is only
+	 * ever watched by thread gen_threadid(fd), so its entries are
+	 * locked by that thread's fdlock.
+	 */
+	isc__socket_t	       **fds;
+	int			*fdstate;
+#if defined(USE_EPOLL)
+	uint32_t		*epoll_events;
+#endif
+#ifdef USE_DEVPOLL
+	pollinfo_t		*fdpollinfo;
+#endif
+
+	/* Locked by manager lock. */
+	ISC_LIST(isc__socket_t)	socklist;
+	int			reserved;	/* unlocked */
+#ifdef USE_WATCHER_THREAD
+	isc_condition_t		shutdown_ok;
+#else /* USE_WATCHER_THREAD */
+	unsigned int		refs;
+#endif /* USE_WATCHER_THREAD */
+	int			maxudp;
+};
+
+/*%
+ * A network thread.  Each thread owns its own event multiplexer and
+ * control pipe, and watches the subset of descriptors assigned to it by
+ * gen_threadid(); a socket stays on the same thread for its whole life.
+ */
+struct isc__socketthread {
+	isc__socketmgr_t	*manager;
+	int			threadid;
+#ifdef USE_WATCHER_THREAD
+	isc_thread_t		thread;
+	int			pipe_fds[2];
+#endif
+	isc_mutex_t		*fdlock;
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -414,12 +472,8 @@ struct isc__socketmgr {
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
-	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
-	/* Locked by fdlock. */
+	/* The manager's descriptor tables.  Locked by fdlock. */
 	isc__socket_t	       **fds;
 	int			*fdstate;
 #if defined(USE_EPOLL)
@@ -430,7 +484,6 @@ struct isc__socketmgr {
 #endif
 
 	/* Locked by manager lock. */
-	ISC_LIST(isc__socket_t)	socklist;
 #ifdef USE_SELECT
 	fd_set			*read_fds;
 	fd_set			*read_fds_copy;
@@ -438,14 +491,6 @@ struct isc__socketmgr {
 	fd_set			*write_fds_copy;
 	int			maxfd;
 #endif	/* USE_SELECT */
-	int			reserved;	/* unlocked */
-#ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
-	isc_condition_t		shutdown_ok;
-#else /* USE_WATCHER_THREAD */
-	unsigned int		refs;
-#endif /* USE_WATCHER_THREAD */
-	int			maxudp;
 };
 
 #ifdef USE_SHARED_MANAGER
@@ -485,11 +530,13 @@ static void internal_fdwatch_write(isc_task_t *, isc_event_t *);
 static void internal_fdwatch_read(isc_task_t *, isc_event_t *);
 static void process_cmsg(isc__socket_t *, struct msghdr *, isc_socketevent_t *);
 static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
-			      struct msghdr *, struct iovec *, size_t *);
+			      struct msghdr *, struct iovec *, char *,
+			      size_t *);
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
-			      struct msghdr *, struct iovec *, size_t *);
+			      struct msghdr *, struct iovec *, char *,
+			      size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
@@ -599,7 +646,7 @@ isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks);
+		       unsigned int maxsocks, int nthreads);
 isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
@@ -781,8 +828,7 @@ static const isc_statscounter_t rawstatsindex[] = {
 	isc_sockstatscounter_rawactive
 };
 
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
-    defined(USE_WATCHER_THREAD)
+#ifdef USE_WATCHER_THREAD
 static void
 manager_log(isc__socketmgr_t *sockmgr,
 	    isc_logcategory_t *category, isc_logmodule_t *module, int level,
@@ -805,6 +851,33 @@ manager_log(isc__socketmgr_t *sockmgr,
 	isc_log_write(isc_lctx, category, module, level,
 		      "sockmgr %p: %s", sockmgr, msgbuf);
 }
+#endif /* USE_WATCHER_THREAD */
+
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
+    defined(USE_WATCHER_THREAD)
+static void
+thread_log(isc__socketthread_t *thread,
+	   isc_logcategory_t *category, isc_logmodule_t *module, int level,
+	   const char *fmt, ...) ISC_FORMAT_PRINTF(5, 6);
+static void
+thread_log(isc__socketthread_t *thread,
+	   isc_logcategory_t *category, isc_logmodule_t *module, int level,
+	   const char *fmt, ...)
+{
+	char msgbuf[2048];
+	va_list ap;
+
+	if (! isc_log_wouldlog(isc_lctx, level))
+		return;
+
+	va_start(ap, fmt);
+	vsnprintf(msgbuf, sizeof(msgbuf), fmt, ap);
+	va_end(ap);
+
+	isc_log_write(isc_lctx, category, module, level,
+		      "sockmgr %p thread %d: %s",
+		      thread->manager, thread->threadid, msgbuf);
+}
 #endif
 
 static void
@@ -897,7 +970,7 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -910,7 +983,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -920,18 +993,18 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	int ret;
 	int op;
 
-	oldevents = manager->epoll_events[fd];
+	oldevents = thread->epoll_events[fd];
 	if (msg == SELECT_POKE_READ)
-		manager->epoll_events[fd] |= EPOLLIN;
+		thread->epoll_events[fd] |= EPOLLIN;
 	else
-		manager->epoll_events[fd] |= EPOLLOUT;
+		thread->epoll_events[fd] |= EPOLLOUT;
 
-	event.events = manager->epoll_events[fd];
+	event.events = thread->epoll_events[fd];
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -952,32 +1025,32 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		pfd.events = POLLOUT;
 	pfd.fd = fd;
 	pfd.revents = 0;
-	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	LOCK(&thread->fdlock[lockid]);
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
-			manager->fdpollinfo[fd].want_read = 1;
+			thread->fdpollinfo[fd].want_read = 1;
 		else
-			manager->fdpollinfo[fd].want_write = 1;
+			thread->fdpollinfo[fd].want_write = 1;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	return (result);
 #elif defined(USE_SELECT)
-	LOCK(&manager->lock);
+	LOCK(&thread->manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_SET(fd, manager->read_fds);
+		FD_SET(fd, thread->read_fds);
 	if (msg == SELECT_POKE_WRITE)
-		FD_SET(fd, manager->write_fds);
-	UNLOCK(&manager->lock);
+		FD_SET(fd, thread->write_fds);
+	UNLOCK(&thread->manager->lock);
 
 	return (result);
 #endif
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -990,7 +1063,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -1000,16 +1073,16 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	int op;
 
 	if (msg == SELECT_POKE_READ)
-		manager->epoll_events[fd] &= ~(EPOLLIN);
+		thread->epoll_events[fd] &= ~(EPOLLIN);
 	else
-		manager->epoll_events[fd] &= ~(EPOLLOUT);
+		thread->epoll_events[fd] &= ~(EPOLLOUT);
 
-	event.events = manager->epoll_events[fd];
+	event.events = thread->epoll_events[fd];
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1032,45 +1105,45 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	 * only provides a way of canceling per FD, we may need to re-poll the
 	 * socket for the other operation.
 	 */
-	LOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
 	if (msg == SELECT_POKE_READ &&
-	    manager->fdpollinfo[fd].want_write == 1) {
+	    thread->fdpollinfo[fd].want_write == 1) {
 		pfds[1].events = POLLOUT;
 		pfds[1].fd = fd;
 		writelen += sizeof(pfds[1]);
 	}
 	if (msg == SELECT_POKE_WRITE &&
-	    manager->fdpollinfo[fd].want_read == 1) {
+	    thread->fdpollinfo[fd].want_read == 1) {
 		pfds[1].events = POLLIN;
 		pfds[1].fd = fd;
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
-			manager->fdpollinfo[fd].want_read = 0;
+			thread->fdpollinfo[fd].want_read = 0;
 		else
-			manager->fdpollinfo[fd].want_write = 0;
+			thread->fdpollinfo[fd].want_write = 0;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	return (result);
 #elif defined(USE_SELECT)
-	LOCK(&manager->lock);
+	LOCK(&thread->manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_CLR(fd, manager->read_fds);
+		FD_CLR(fd, thread->read_fds);
 	else if (msg == SELECT_POKE_WRITE)
-		FD_CLR(fd, manager->write_fds);
-	UNLOCK(&manager->lock);
+		FD_CLR(fd, thread->write_fds);
+	UNLOCK(&thread->manager->lock);
 
 	return (result);
 #endif
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1080,21 +1153,21 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	 * or writes.
 	 */
 
-	INSIST(fd >= 0 && fd < (int)manager->maxsocks);
+	INSIST(fd >= 0 && fd < (int)thread->manager->maxsocks);
 
 	if (msg == SELECT_POKE_CLOSE) {
 		/* No one should be updating fdstate, so no need to lock it */
-		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
-		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		INSIST(thread->fdstate[fd] == CLOSE_PENDING);
+		thread->fdstate[fd] = CLOSED;
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
 
-	LOCK(&manager->fdlock[lockid]);
-	if (manager->fdstate[fd] == CLOSE_PENDING) {
-		UNLOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
+	if (thread->fdstate[fd] == CLOSE_PENDING) {
+		UNLOCK(&thread->fdlock[lockid]);
 
 		/*
 		 * We accept (and ignore) any error from unwatch_fd() as we are
@@ -1104,20 +1177,20 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
-	if (manager->fdstate[fd] != MANAGED) {
-		UNLOCK(&manager->fdlock[lockid]);
+	if (thread->fdstate[fd] != MANAGED) {
+		UNLOCK(&thread->fdlock[lockid]);
 		return;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1138,16 +1211,19 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke(isc__socketmgr_t *mgr, int threadid, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
 
+	REQUIRE(threadid >= 0 && threadid < mgr->nthreads);
+
 	buf[0] = fd;
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(mgr->threads[threadid].pipe_fds[1], buf,
+			   sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1177,12 +1253,12 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1207,15 +1283,28 @@ select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
  * Update the state of the socketmgr when something changes.
  */
 static void
-select_poke(isc__socketmgr_t *manager, int fd, int msg) {
+select_poke(isc__socketmgr_t *manager, int threadid, int fd, int msg) {
+	REQUIRE(threadid >= 0 && threadid < manager->nthreads);
+
 	if (msg == SELECT_POKE_SHUTDOWN)
 		return;
 	else if (fd >= 0)
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(&manager->threads[threadid], fd, msg);
 	return;
 }
 #endif /* USE_WATCHER_THREAD */
 
+/*
+ * Choose the network thread that watches 'fd'.  The mapping depends only
+ * on the descriptor number, so a descriptor that is still pending close on
+ * one thread can never be claimed by another, and each slot of the shared
+ * descriptor tables is only ever touched under one thread's fdlock.
+ */
+static inline int
+gen_threadid(isc__socketmgr_t *manager, int fd) {
+	return (fd % manager->nthreads);
+}
+
 /*
  * Make a fd non-blocking.
  */
@@ -1431,12 +1520,16 @@ process_cmsg(isc__socket_t *sock, struct msghdr *msg, isc_socketevent_t *dev) {
  * Nothing can be NULL, and the done event must list at least one buffer
  * on the buffer linked list for this function to be meaningful.
  *
+ * Control messages are built in 'cmsgbuf', which must hold at least
+ * sock->sendcmsgbuflen bytes.
+ *
  * If write_countp != NULL, *write_countp will hold the number of bytes
  * this transaction can send.
  */
 static void
 build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
-		  struct msghdr *msg, struct iovec *iov, size_t *write_countp)
+		  struct msghdr *msg, struct iovec *iov, char *cmsgbuf,
+		  size_t *write_countp)
 {
 	unsigned int iovcount;
 	isc_buffer_t *buffer;
@@ -1449,7 +1542,7 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 
 	memset(msg, 0, sizeof(*msg));
 	if (sock->sendcmsgbuflen != 0U) {
-		memset(sock->sendcmsgbuf, 0, sock->sendcmsgbuflen);
+		memset(cmsgbuf, 0, sock->sendcmsgbuflen);
 	}
 
 	if (!sock->connected) {
@@ -1528,11 +1621,11 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 			   "sendto pktinfo data, ifindex %u",
 			   dev->pktinfo.ipi6_ifindex);
 
-		msg->msg_control = (void *)sock->sendcmsgbuf;
+		msg->msg_control = (void *)cmsgbuf;
 		msg->msg_controllen = cmsg_space(sizeof(struct in6_pktinfo));
 		INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
 
-		cmsgp = (struct cmsghdr *)sock->sendcmsgbuf;
+		cmsgp = (struct cmsghdr *)cmsgbuf;
 		cmsgp->cmsg_level = IPPROTO_IPV6;
 		cmsgp->cmsg_type = IPV6_PKTINFO;
 		cmsgp->cmsg_len = cmsg_len(sizeof(struct in6_pktinfo));
@@ -1547,9 +1640,9 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 	{
 		int use_min_mtu = 1;	/* -1, 0, 1 */
 
-		cmsgp = (struct cmsghdr *)(sock->sendcmsgbuf +
+		cmsgp = (struct cmsghdr *)(cmsgbuf +
 					   msg->msg_controllen);
-		msg->msg_control = (void *)sock->sendcmsgbuf;
+		msg->msg_control = (void *)cmsgbuf;
 		msg->msg_controllen += cmsg_space(sizeof(use_min_mtu));
 		INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
 
@@ -1576,9 +1669,9 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 
 #ifdef IP_TOS
 		if (sock->pf == AF_INET && sock->pktdscp) {
-			cmsgp = (struct cmsghdr *)(sock->sendcmsgbuf +
+			cmsgp = (struct cmsghdr *)(cmsgbuf +
 						   msg->msg_controllen);
-			msg->msg_control = (void *)sock->sendcmsgbuf;
+			msg->msg_control = (void *)cmsgbuf;
 			msg->msg_controllen += cmsg_space(sizeof(dscp));
 			INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
 
@@ -1607,9 +1700,9 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 #endif
 #if defined(IPPROTO_IPV6) && defined(IPV6_TCLASS)
 		if (sock->pf == AF_INET6 && sock->pktdscp) {
-			cmsgp = (struct cmsghdr *)(sock->sendcmsgbuf +
+			cmsgp = (struct cmsghdr *)(cmsgbuf +
 						   msg->msg_controllen);
-			msg->msg_control = (void *)sock->sendcmsgbuf;
+			msg->msg_control = (void *)cmsgbuf;
 			msg->msg_controllen += cmsg_space(sizeof(dscp));
 			INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
 
@@ -1638,7 +1731,7 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 		if (msg->msg_controllen != 0 &&
 		    msg->msg_controllen < sock->sendcmsgbuflen)
 		{
-			memset(sock->sendcmsgbuf + msg->msg_controllen, 0,
+			memset(cmsgbuf + msg->msg_controllen, 0,
 			       sock->sendcmsgbuflen - msg->msg_controllen);
 		}
 	}
@@ -1661,12 +1754,16 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
  * Nothing can be NULL, and the done event must list at least one buffer
  * on the buffer linked list for this function to be meaningful.
  *
+ * Control messages are received into 'cmsgbuf', which must hold at least
+ * sock->recvcmsgbuflen bytes.
+ *
  * If read_countp != NULL, *read_countp will hold the number of bytes
  * this transaction can receive.
  */
 static void
 build_msghdr_recv(isc__socket_t *sock, isc_socketevent_t *dev,
-		  struct msghdr *msg, struct iovec *iov, size_t *read_countp)
+		  struct msghdr *msg, struct iovec *iov, char *cmsgbuf,
+		  size_t *read_countp)
 {
 	unsigned int iovcount;
 	isc_buffer_t *buffer;
@@ -1768,7 +1865,7 @@ build_msghdr_recv(isc__socket_t *sock, isc_socketevent_t *dev,
 
 #ifdef ISC_NET_BSD44MSGHDR
 #if defined(USE_CMSG)
-	msg->msg_control = sock->recvcmsgbuf;
+	msg->msg_control = cmsgbuf;
 	msg->msg_controllen = sock->recvcmsgbuflen;
 #else
 	msg->msg_control = NULL;
@@ -1862,42 +1959,46 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
-static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
-	size_t actual_count;
-	struct msghdr msghdr;
-	isc_buffer_t *buffer;
-	int recv_errno;
-	char strbuf[ISC_STRERRORSIZE];
-
-	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
+/*
+ * Batched UDP I/O builds every message's control data in a stack
+ * buffer of this size rather than in the socket's own cmsg buffer.
+ */
+#define BATCH_CMSGBUFLEN	128
 
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
+/*
+ * How many sendmmsg() batches a sending caller, and the socket's own
+ * internal_send(), may flush from the send queue before leaving the
+ * rest to the next write event.
+ */
+#define FLUSH_SENDER_BATCHES	2
+#define FLUSH_WATCHER_BATCHES	8
 
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
+#define BATCH_RECV_OK(sock) \
+	((sock)->type == isc_sockettype_udp && \
+	 (sock)->recvcmsgbuflen <= BATCH_CMSGBUFLEN)
+#define BATCH_SEND_OK(sock) \
+	((sock)->type == isc_sockettype_udp && \
+	 (sock)->sendcmsgbuflen <= BATCH_CMSGBUFLEN && \
+	 (sock)->manager->maxudp == 0)
 
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
+/*
+ * Classify a failed recvmsg() or recvmmsg() on 'sock' for 'dev'.
+ */
+static int
+recv_failed(isc__socket_t *sock, isc_socketevent_t *dev, int recv_errno) {
+	char strbuf[ISC_STRERRORSIZE];
 
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
+	if (SOFT_ERROR(recv_errno))
+		return (DOIO_SOFT);
 
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
+	if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+		isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+		socket_log(sock, NULL, IOEVENT,
+			   isc_msgcat, ISC_MSGSET_SOCKET,
+			   ISC_MSG_DOIORECV,
+			  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
+			   sock->fd, -1, recv_errno, strbuf);
+	}
 
 #define SOFT_OR_HARD(_system, _isc) \
 	if (recv_errno == _system) { \
@@ -1917,34 +2018,45 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		/* HPUX 11.11 can return EADDRNOTAVAIL. */
-		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+	/* HPUX 11.11 can return EADDRNOTAVAIL. */
+	SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	/* Should never get this one but it was seen. */
 #ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
 #endif
-		/*
-		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
-		 * errors.
-		 */
+	/*
+	 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
+	 * errors.
+	 */
 #ifdef EPROTO
-		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
 #endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
-	}
+	dev->result = isc__errno2result(recv_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_RECVFAIL]);
+	return (DOIO_HARD);
+}
+
+/*
+ * Account for 'cc' bytes received into 'dev', described by 'msghdr'.
+ * 'read_count' is the number of bytes the request had room for.
+ */
+static int
+recv_done(isc__socket_t *sock, isc_socketevent_t *dev, struct msghdr *msghdr,
+	  int cc, size_t read_count)
+{
+	size_t actual_count;
+	isc_buffer_t *buffer;
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -1966,7 +2078,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -2004,7 +2116,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * If there are control messages attached, run through them and pull
 	 * out the interesting bits.
 	 */
-	process_cmsg(sock, &msghdr, dev);
+	process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -2044,6 +2156,156 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	struct msghdr msghdr;
+	int recv_errno;
+
+	build_msghdr_recv(sock, dev, &msghdr, iov, sock->recvcmsgbuf,
+			  &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	if (cc < 0)
+		return (recv_failed(sock, dev, recv_errno));
+
+	return (recv_done(sock, dev, &msghdr, cc, read_count));
+}
+
+#ifdef HAVE_RECVMMSG
+/*
+ * Fill up to ISC_SOCKET_MAXBATCH of the UDP requests queued on 'sock'
+ * with a single recvmmsg() call, and post the ones that completed.
+ *
+ * Returns DOIO_SOFT once the socket has been drained and needs to be
+ * watched again, DOIO_SUCCESS if there may be more to read.
+ *
+ * The socket must be locked.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock) {
+	isc_socketevent_t *devs[ISC_SOCKET_MAXBATCH];
+	struct mmsghdr msgs[ISC_SOCKET_MAXBATCH];
+	struct iovec iovs[ISC_SOCKET_MAXBATCH][MAXSCATTERGATHER_RECV];
+	char cmsgbufs[ISC_SOCKET_MAXBATCH][BATCH_CMSGBUFLEN];
+	size_t read_counts[ISC_SOCKET_MAXBATCH];
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int cc;
+
+	INSIST(BATCH_RECV_OK(sock));
+
+	dev = ISC_LIST_HEAD(sock->recv_list);
+	while (dev != NULL && n < ISC_SOCKET_MAXBATCH) {
+		devs[n] = dev;
+		build_msghdr_recv(sock, dev, &msgs[n].msg_hdr, iovs[n],
+				  cmsgbufs[n], &read_counts[n]);
+		msgs[n].msg_len = 0;
+		n++;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+	cc = recvmmsg(sock->fd, msgs, n, 0, NULL);
+	if (cc < 0) {
+		if (recv_failed(sock, devs[0], errno) == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_recvdone_event(sock, &devs[0]);
+		return (DOIO_SUCCESS);
+	}
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		if (recv_done(sock, devs[i], &msgs[i].msg_hdr,
+			      (int)msgs[i].msg_len,
+			      read_counts[i]) == DOIO_SUCCESS)
+		{
+			send_recvdone_event(sock, &devs[i]);
+		}
+	}
+
+	return (((unsigned int)cc < n) ? DOIO_SOFT : DOIO_SUCCESS);
+}
+#endif /* HAVE_RECVMMSG */
+
+/*
+ * Classify a failed sendmsg() or sendmmsg() on 'sock' for 'dev'.
+ */
+static int
+send_failed(isc__socket_t *sock, isc_socketevent_t *dev, int send_errno) {
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	char strbuf[ISC_STRERRORSIZE];
+
+	if (SOFT_ERROR(send_errno)) {
+		if (send_errno == EWOULDBLOCK || send_errno == EAGAIN)
+			dev->result = ISC_R_WOULDBLOCK;
+		return (DOIO_SOFT);
+	}
+
+#define SOFT_OR_HARD(_system, _isc) \
+	if (send_errno == _system) { \
+		if (sock->connected) { \
+			dev->result = _isc; \
+			inc_stats(sock->manager->stats, \
+				  sock->statsindex[STATID_SENDFAIL]); \
+			return (DOIO_HARD); \
+		} \
+		return (DOIO_SOFT); \
+	}
+#define ALWAYS_HARD(_system, _isc) \
+	if (send_errno == _system) { \
+		dev->result = _isc; \
+		inc_stats(sock->manager->stats, \
+			  sock->statsindex[STATID_SENDFAIL]); \
+		return (DOIO_HARD); \
+	}
+
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	ALWAYS_HARD(EACCES, ISC_R_NOPERM);
+	ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+#ifdef EHOSTDOWN
+	ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
+#endif
+	ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
+	ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
+	ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
+
+#undef SOFT_OR_HARD
+#undef ALWAYS_HARD
+
+	/*
+	 * The other error types depend on whether or not the
+	 * socket is UDP or TCP.  If it is UDP, some errors
+	 * that we expect to be fatal under TCP are merely
+	 * annoying, and are really soft errors.
+	 *
+	 * However, these soft errors are still returned as
+	 * a status.
+	 */
+	isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
+	isc__strerror(send_errno, strbuf, sizeof(strbuf));
+	UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
+			 addrbuf, strbuf);
+	dev->result = isc__errno2result(send_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_SENDFAIL]);
+	return (DOIO_HARD);
+}
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -2063,12 +2325,11 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	struct iovec iov[MAXSCATTERGATHER_SEND];
 	size_t write_count;
 	struct msghdr msghdr;
-	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
 	int attempts = 0;
 	int send_errno;
-	char strbuf[ISC_STRERRORSIZE];
 
-	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
+	build_msghdr_send(sock, dev, &msghdr, iov, sock->sendcmsgbuf,
+			  &write_count);
 
  resend:
 	if (sock->type == isc_sockettype_udp &&
@@ -2086,64 +2347,7 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 		if (send_errno == EINTR && ++attempts < NRETRIES)
 			goto resend;
 
-		if (SOFT_ERROR(send_errno)) {
-			if (errno == EWOULDBLOCK || errno == EAGAIN)
-				dev->result = ISC_R_WOULDBLOCK;
-			return (DOIO_SOFT);
-		}
-
-#define SOFT_OR_HARD(_system, _isc) \
-	if (send_errno == _system) { \
-		if (sock->connected) { \
-			dev->result = _isc; \
-			inc_stats(sock->manager->stats, \
-				  sock->statsindex[STATID_SENDFAIL]); \
-			return (DOIO_HARD); \
-		} \
-		return (DOIO_SOFT); \
-	}
-#define ALWAYS_HARD(_system, _isc) \
-	if (send_errno == _system) { \
-		dev->result = _isc; \
-		inc_stats(sock->manager->stats, \
-			  sock->statsindex[STATID_SENDFAIL]); \
-		return (DOIO_HARD); \
-	}
-
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		ALWAYS_HARD(EACCES, ISC_R_NOPERM);
-		ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-#ifdef EHOSTDOWN
-		ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
-#endif
-		ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
-		ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
-		ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
-
-#undef SOFT_OR_HARD
-#undef ALWAYS_HARD
-
-		/*
-		 * The other error types depend on whether or not the
-		 * socket is UDP or TCP.  If it is UDP, some errors
-		 * that we expect to be fatal under TCP are merely
-		 * annoying, and are really soft errors.
-		 *
-		 * However, these soft errors are still returned as
-		 * a status.
-		 */
-		isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
-		isc__strerror(send_errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
-				 addrbuf, strbuf);
-		dev->result = isc__errno2result(send_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_SENDFAIL]);
-		return (DOIO_HARD);
+		return (send_failed(sock, dev, send_errno));
 	}
 
 	if (cc == 0) {
@@ -2170,28 +2374,165 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef HAVE_SENDMMSG
 /*
- * Kill.
+ * Send the 'n' UDP requests in 'devs' with a single sendmmsg() call.
  *
- * Caller must ensure that the socket is not locked and no external
- * references exist.
+ * Returns the number of leading requests that were sent; their results
+ * are set to ISC_R_SUCCESS.  If nothing could be sent, '*statep' holds
+ * the doio_send() style outcome for devs[0].
  */
-static void
-socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
-	isc_sockettype_t type = sock->type;
-	int lockid = FDLOCK_ID(fd);
-
-	/*
+static unsigned int
+doio_sendbatch(isc__socket_t *sock, isc_socketevent_t **devs,
+	       unsigned int n, int *statep)
+{
+	struct mmsghdr msgs[ISC_SOCKET_MAXBATCH];
+	struct iovec iovs[ISC_SOCKET_MAXBATCH][MAXSCATTERGATHER_SEND];
+	char cmsgbufs[ISC_SOCKET_MAXBATCH][BATCH_CMSGBUFLEN];
+	unsigned int i;
+	int attempts = 0;
+	int cc, send_errno;
+
+	INSIST(n > 0 && n <= ISC_SOCKET_MAXBATCH);
+
+	for (i = 0; i < n; i++) {
+		build_msghdr_send(sock, devs[i], &msgs[i].msg_hdr, iovs[i],
+				  cmsgbufs[i], NULL);
+		msgs[i].msg_len = 0;
+	}
+
+ resend:
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	send_errno = errno;
+	if (cc < 0) {
+		if (send_errno == EINTR && ++attempts < NRETRIES)
+			goto resend;
+		*statep = send_failed(sock, devs[0], send_errno);
+		return (0);
+	}
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		devs[i]->n += msgs[i].msg_len;
+		devs[i]->result = ISC_R_SUCCESS;
+	}
+
+	*statep = (cc == 0) ? DOIO_SOFT : DOIO_SUCCESS;
+	return ((unsigned int)cc);
+}
+
+/*
+ * Send up to 'batches' batches from the send queue of a UDP socket with
+ * sendmmsg().  The socket lock is dropped around each system call so
+ * that other threads can keep queueing behind us; whatever is still
+ * queued afterwards is left to internal_send(), so that no caller is
+ * held up for long by a steady stream of new requests.
+ *
+ * Requests queued with ISC_SOCKFLAG_NORETRY are tried once, and are
+ * completed with the soft error if that fails.
+ *
+ * The socket must be locked, with 'flushing' set and a reference held
+ * for the duration.  Returns with the socket locked.
+ */
+static void
+flush_sends(isc__socket_t *sock, unsigned int batches) {
+	isc_socketevent_t *devs[ISC_SOCKET_MAXBATCH];
+	isc_socketevent_t *dev;
+	unsigned int i, n, sent;
+	isc_boolean_t blocked;
+	int state;
+
+	INSIST(sock->flushing);
+
+	while (!ISC_LIST_EMPTY(sock->send_list)) {
+		if (batches-- == 0) {
+			if (!sock->pending_send)
+				select_poke(sock->manager, sock->threadid,
+					    sock->fd, SELECT_POKE_WRITE);
+			break;
+		}
+
+		n = 0;
+		dev = ISC_LIST_HEAD(sock->send_list);
+		while (dev != NULL && n < ISC_SOCKET_MAXBATCH) {
+			/*
+			 * Without per packet DSCP the TOS is a socket
+			 * option, so only batch datagrams that agree.
+			 */
+			if (n > 0 && !sock->pktdscp &&
+			    (((dev->attributes ^ devs[0]->attributes) &
+			      ISC_SOCKEVENTATTR_DSCP) != 0 ||
+			     dev->dscp != devs[0]->dscp))
+				break;
+			ISC_LIST_DEQUEUE(sock->send_list, dev, ev_link);
+			devs[n++] = dev;
+			dev = ISC_LIST_HEAD(sock->send_list);
+		}
+
+		UNLOCK(&sock->lock);
+		sent = doio_sendbatch(sock, devs, n, &state);
+		LOCK(&sock->lock);
+
+		/*
+		 * sendmmsg() stops at the first datagram it cannot
+		 * send, so devs[sent] has had its try.
+		 */
+		blocked = ISC_FALSE;
+		if (sent == 0 && state == DOIO_HARD)
+			sent = 1;
+		else if (sent < n) {
+			blocked = ISC_TRUE;
+			if ((devs[sent]->attributes &
+			     ISC_SOCKEVENTATTR_NORETRY) != 0)
+			{
+				if (devs[sent]->result == ISC_R_UNSET)
+					devs[sent]->result = ISC_R_WOULDBLOCK;
+				sent++;
+			}
+		}
+		for (i = 0; i < sent; i++)
+			send_senddone_event(sock, &devs[i]);
+
+		/*
+		 * Put back whatever was not sent, keeping the order.
+		 */
+		for (i = n; i > sent; i--)
+			ISC_LIST_PREPEND(sock->send_list, devs[i - 1],
+					 ev_link);
+
+		if (blocked) {
+			if (!ISC_LIST_EMPTY(sock->send_list) &&
+			    !sock->pending_send)
+				select_poke(sock->manager, sock->threadid,
+					    sock->fd, SELECT_POKE_WRITE);
+			break;
+		}
+	}
+}
+#endif /* HAVE_SENDMMSG */
+
+/*
+ * Kill.
+ *
+ * Caller must ensure that the socket is not locked and no external
+ * references exist.
+ */
+static void
+socketclose(isc__socketthread_t *thread, isc__socket_t *sock, int fd) {
+	isc__socketmgr_t *manager = thread->manager;
+	isc_sockettype_t type = sock->type;
+	int lockid = FDLOCK_ID(fd);
+
+	/*
 	 * No one has this socket open, so the watcher doesn't have to be
 	 * poked, and the socket doesn't have to be locked.
 	 */
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[fd] = NULL;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[fd] = NULL;
 	if (type == isc_sockettype_fdwatch)
-		manager->fdstate[fd] = CLOSED;
+		thread->fdstate[fd] = CLOSED;
 	else
-		manager->fdstate[fd] = CLOSE_PENDING;
-	UNLOCK(&manager->fdlock[lockid]);
+		thread->fdstate[fd] = CLOSE_PENDING;
+	UNLOCK(&thread->fdlock[lockid]);
 	if (type == isc_sockettype_fdwatch) {
 		/*
 		 * The caller may close the socket once this function returns,
@@ -2202,10 +2543,10 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 	} else
-		select_poke(manager, fd, SELECT_POKE_CLOSE);
+		select_poke(manager, thread->threadid, fd, SELECT_POKE_CLOSE);
 
 	inc_stats(manager->stats, sock->statsindex[STATID_CLOSE]);
 	if (sock->active == 1) {
@@ -2214,29 +2555,31 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 	}
 
 	/*
-	 * update manager->maxfd here (XXX: this should be implemented more
+	 * update thread->maxfd here (XXX: this should be implemented more
 	 * efficiently)
 	 */
 #ifdef USE_SELECT
 	LOCK(&manager->lock);
-	if (manager->maxfd == fd) {
+	if (thread->maxfd == fd) {
 		int i;
 
-		manager->maxfd = 0;
-		for (i = fd - 1; i >= 0; i--) {
+		thread->maxfd = 0;
+		for (i = fd - manager->nthreads; i >= 0;
+		     i -= manager->nthreads)
+		{
 			lockid = FDLOCK_ID(i);
 
-			LOCK(&manager->fdlock[lockid]);
-			if (manager->fdstate[i] == MANAGED) {
-				manager->maxfd = i;
-				UNLOCK(&manager->fdlock[lockid]);
+			LOCK(&thread->fdlock[lockid]);
+			if (thread->fdstate[i] == MANAGED) {
+				thread->maxfd = i;
+				UNLOCK(&thread->fdlock[lockid]);
 				break;
 			}
-			UNLOCK(&manager->fdlock[lockid]);
+			UNLOCK(&thread->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (thread->maxfd < thread->pipe_fds[0])
+			thread->maxfd = thread->pipe_fds[0];
 #endif
 	}
 
@@ -2262,7 +2605,7 @@ destroy(isc__socket_t **sockp) {
 	if (sock->fd >= 0) {
 		fd = sock->fd;
 		sock->fd = -1;
-		socketclose(manager, sock, fd);
+		socketclose(&manager->threads[sock->threadid], sock, fd);
 	}
 
 	LOCK(&manager->lock);
@@ -2300,6 +2643,7 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 	sock->manager = manager;
 	sock->type = type;
 	sock->fd = -1;
+	sock->threadid = -1;
 	sock->dscp = 0;		/* TOS/TCLASS is zero until set. */
 	sock->dupped = 0;
 	sock->statsindex = NULL;
@@ -2373,6 +2717,8 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 	sock->connecting = 0;
 	sock->bound = 0;
 	sock->pktdscp = 0;
+	sock->flushing = 0;
+	sock->batchsend = 0;
 
 	/*
 	 * Initialize the lock.
@@ -2973,6 +3319,7 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 {
 	isc__socket_t *sock = NULL;
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	isc_result_t result;
 	int lockid;
 
@@ -3015,6 +3362,7 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 
 	sock->common.methods = (isc_socketmethods_t *)&socketmethods;
 	sock->references = 1;
+	sock->threadid = gen_threadid(manager, sock->fd);
 	*socketp = (isc_socket_t *)sock;
 
 	/*
@@ -3022,24 +3370,25 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 	 * there are no external references to it yet.
 	 */
 
+	thread = &manager->threads[sock->threadid];
 	lockid = FDLOCK_ID(sock->fd);
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[sock->fd] = sock;
-	manager->fdstate[sock->fd] = MANAGED;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[sock->fd] = sock;
+	thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-	manager->epoll_events[sock->fd] = 0;
+	thread->epoll_events[sock->fd] = 0;
 #endif
 #ifdef USE_DEVPOLL
-	INSIST(sock->manager->fdpollinfo[sock->fd].want_read == 0 &&
-	       sock->manager->fdpollinfo[sock->fd].want_write == 0);
+	INSIST(thread->fdpollinfo[sock->fd].want_read == 0 &&
+	       thread->fdpollinfo[sock->fd].want_write == 0);
 #endif
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (thread->maxfd < sock->fd)
+		thread->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
@@ -3101,23 +3450,27 @@ isc__socket_open(isc_socket_t *sock0) {
 
 	if (result == ISC_R_SUCCESS) {
 		int lockid = FDLOCK_ID(sock->fd);
+		isc__socketthread_t *thread;
+
+		sock->threadid = gen_threadid(sock->manager, sock->fd);
+		thread = &sock->manager->threads[sock->threadid];
 
-		LOCK(&sock->manager->fdlock[lockid]);
-		sock->manager->fds[sock->fd] = sock;
-		sock->manager->fdstate[sock->fd] = MANAGED;
+		LOCK(&thread->fdlock[lockid]);
+		thread->fds[sock->fd] = sock;
+		thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-		sock->manager->epoll_events[sock->fd] = 0;
+		thread->epoll_events[sock->fd] = 0;
 #endif
 #ifdef USE_DEVPOLL
-		INSIST(sock->manager->fdpollinfo[sock->fd].want_read == 0 &&
-		       sock->manager->fdpollinfo[sock->fd].want_write == 0);
+		INSIST(thread->fdpollinfo[sock->fd].want_read == 0 &&
+		       thread->fdpollinfo[sock->fd].want_write == 0);
 #endif
-		UNLOCK(&sock->manager->fdlock[lockid]);
+		UNLOCK(&thread->fdlock[lockid]);
 
 #ifdef USE_SELECT
 		LOCK(&sock->manager->lock);
-		if (sock->manager->maxfd < sock->fd)
-			sock->manager->maxfd = sock->fd;
+		if (thread->maxfd < sock->fd)
+			thread->maxfd = sock->fd;
 		UNLOCK(&sock->manager->lock);
 #endif
 	}
@@ -3137,6 +3490,7 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 			  isc_task_t *task, isc_socket_t **socketp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	isc__socket_t *sock = NULL;
 	isc_result_t result;
 	int lockid;
@@ -3160,6 +3514,7 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 
 	sock->common.methods = (isc_socketmethods_t *)&socketmethods;
 	sock->references = 1;
+	sock->threadid = gen_threadid(manager, sock->fd);
 	*socketp = (isc_socket_t *)sock;
 
 	/*
@@ -3167,27 +3522,30 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 	 * there are no external references to it yet.
 	 */
 
+	thread = &manager->threads[sock->threadid];
 	lockid = FDLOCK_ID(sock->fd);
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[sock->fd] = sock;
-	manager->fdstate[sock->fd] = MANAGED;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[sock->fd] = sock;
+	thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-	manager->epoll_events[sock->fd] = 0;
+	thread->epoll_events[sock->fd] = 0;
 #endif
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (thread->maxfd < sock->fd)
+		thread->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
 	if (flags & ISC_SOCKFDWATCH_READ)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 	if (flags & ISC_SOCKFDWATCH_WRITE)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	socket_log(sock, NULL, CREATION, isc_msgcat, ISC_MSGSET_SOCKET,
 		   ISC_MSG_CREATED, "fdwatch-created");
@@ -3218,11 +3576,11 @@ isc__socket_fdwatchpoke(isc_socket_t *sock0, int flags)
 		LOCK(&sock->lock);
 		if (((flags & ISC_SOCKFDWATCH_READ) != 0) &&
 		    !sock->pending_recv)
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_READ);
 		if (((flags & ISC_SOCKFDWATCH_WRITE) != 0) &&
 		    !sock->pending_send)
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_WRITE);
 		UNLOCK(&sock->lock);
 	}
@@ -3281,6 +3639,7 @@ isc__socket_close(isc_socket_t *sock0) {
 	isc__socket_t *sock = (isc__socket_t *)sock0;
 	int fd;
 	isc__socketmgr_t *manager;
+	isc__socketthread_t *thread;
 
 	fflush(stdout);
 	REQUIRE(VALID_SOCKET(sock));
@@ -3301,8 +3660,10 @@ isc__socket_close(isc_socket_t *sock0) {
 	INSIST(ISC_LIST_EMPTY(sock->connect_list));
 
 	manager = sock->manager;
+	thread = &manager->threads[sock->threadid];
 	fd = sock->fd;
 	sock->fd = -1;
+	sock->threadid = -1;
 	sock->dupped = 0;
 	memset(sock->name, 0, sizeof(sock->name));
 	sock->tag = NULL;
@@ -3314,7 +3675,7 @@ isc__socket_close(isc_socket_t *sock0) {
 
 	UNLOCK(&sock->lock);
 
-	socketclose(manager, sock, fd);
+	socketclose(thread, sock, fd);
 
 	return (ISC_R_SUCCESS);
 }
@@ -3696,7 +4057,8 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	 * Poke watcher if there are more pending accepts.
 	 */
 	if (!ISC_LIST_EMPTY(sock->accept_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_ACCEPT);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_ACCEPT);
 
 	UNLOCK(&sock->lock);
 
@@ -3713,8 +4075,10 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	 */
 	if (fd != -1) {
 		int lockid = FDLOCK_ID(fd);
+		isc__socketthread_t *thread;
 
 		NEWCONNSOCK(dev)->fd = fd;
+		NEWCONNSOCK(dev)->threadid = gen_threadid(manager, fd);
 		NEWCONNSOCK(dev)->bound = 1;
 		NEWCONNSOCK(dev)->connected = 1;
 
@@ -3740,19 +4104,20 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 			NEWCONNSOCK(dev)->active = 1;
 		}
 
-		LOCK(&manager->fdlock[lockid]);
-		manager->fds[fd] = NEWCONNSOCK(dev);
-		manager->fdstate[fd] = MANAGED;
+		thread = &manager->threads[NEWCONNSOCK(dev)->threadid];
+		LOCK(&thread->fdlock[lockid]);
+		thread->fds[fd] = NEWCONNSOCK(dev);
+		thread->fdstate[fd] = MANAGED;
 #if defined(USE_EPOLL)
-		manager->epoll_events[fd] = 0;
+		thread->epoll_events[fd] = 0;
 #endif
-		UNLOCK(&manager->fdlock[lockid]);
+		UNLOCK(&thread->fdlock[lockid]);
 
 		LOCK(&manager->lock);
 
 #ifdef USE_SELECT
-		if (manager->maxfd < fd)
-			manager->maxfd = fd;
+		if (thread->maxfd < fd)
+			thread->maxfd = fd;
 #endif
 
 		socket_log(sock, &NEWCONNSOCK(dev)->peer_address, CREATION,
@@ -3782,7 +4147,8 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	return;
 
  soft_error:
-	select_poke(sock->manager, sock->fd, SELECT_POKE_ACCEPT);
+	select_poke(sock->manager, sock->threadid, sock->fd,
+		    SELECT_POKE_ACCEPT);
 	UNLOCK(&sock->lock);
 
 	inc_stats(manager->stats, sock->statsindex[STATID_ACCEPTFAIL]);
@@ -3820,6 +4186,21 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
+#ifdef HAVE_RECVMMSG
+	if (dev != NULL && ISC_LIST_NEXT(dev, ev_link) != NULL &&
+	    BATCH_RECV_OK(sock))
+	{
+		/*
+		 * Several UDP requests are waiting; fill as many of them
+		 * as we can per system call.
+		 */
+		while (!ISC_LIST_EMPTY(sock->recv_list)) {
+			if (doio_recvbatch(sock) == DOIO_SOFT)
+				break;
+		}
+		goto poke;
+	}
+#endif
 	while (dev != NULL) {
 		switch (doio_recv(sock, dev)) {
 		case DOIO_SOFT:
@@ -3849,7 +4230,8 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 
  poke:
 	if (!ISC_LIST_EMPTY(sock->recv_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 
 	UNLOCK(&sock->lock);
 }
@@ -3883,6 +4265,30 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 		return;
 	}
 
+#ifdef HAVE_SENDMMSG
+	if (sock->batchsend && BATCH_SEND_OK(sock)) {
+		/*
+		 * If a sender is already flushing the queue it will
+		 * pick up whatever is left; otherwise drain it here.
+		 */
+		if (!sock->flushing) {
+			sock->flushing = 1;
+			sock->references++;
+			flush_sends(sock, FLUSH_WATCHER_BATCHES);
+			sock->flushing = 0;
+			INSIST(sock->references > 0);
+			sock->references--;
+			if (sock->references == 0) {
+				UNLOCK(&sock->lock);
+				destroy(&sock);
+				return;
+			}
+		}
+		UNLOCK(&sock->lock);
+		return;
+	}
+#endif
+
 	/*
 	 * Try to do as much I/O as possible on this socket.  There are no
 	 * limits here, currently.
@@ -3904,7 +4310,8 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 
  poke:
 	if (!ISC_LIST_EMPTY(sock->send_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	UNLOCK(&sock->lock);
 }
@@ -3945,7 +4352,8 @@ internal_fdwatch_write(isc_task_t *me, isc_event_t *ev) {
 	}
 
 	if (more_data)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	UNLOCK(&sock->lock);
 }
@@ -3986,7 +4394,8 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
 	}
 
 	if (more_data)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 
 	UNLOCK(&sock->lock);
 }
@@ -3996,7 +4405,7 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
+process_fd(isc__socketthread_t *thread, int fd, isc_boolean_t readable,
 	   isc_boolean_t writeable)
 {
 	isc__socket_t *sock;
@@ -4007,16 +4416,16 @@ process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
 	/*
 	 * If the socket is going to be closed, don't do more I/O.
 	 */
-	LOCK(&manager->fdlock[lockid]);
-	if (manager->fdstate[fd] == CLOSE_PENDING) {
-		UNLOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
+	if (thread->fdstate[fd] == CLOSE_PENDING) {
+		UNLOCK(&thread->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
-	sock = manager->fds[fd];
+	sock = thread->fds[fd];
 	unlock_sock = ISC_FALSE;
 	if (readable) {
 		if (sock == NULL) {
@@ -4055,17 +4464,17 @@ check_write:
 		UNLOCK(&sock->lock);
 
  unlock_fd:
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -4073,41 +4482,41 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
 		 * ISC_SOCKET_MAXEVENTS.
 		 */
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
-			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
-			    "maximum number of FD events (%d) received",
-			    nevents);
+		thread_log(thread, ISC_LOGCATEGORY_GENERAL,
+			   ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
+			   "maximum number of FD events (%d) received",
+			   nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].ident < manager->maxsocks);
+		REQUIRE(events[i].ident < thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
 		readable = ISC_TF(events[i].filter == EVFILT_READ);
 		writable = ISC_TF(events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events, int nevents)
 {
 	int i;
 	isc_boolean_t done = ISC_FALSE;
@@ -4115,17 +4524,17 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
-			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
-			    "maximum number of FD events (%d) received",
-			    nevents);
+	if (nevents == thread->nevents) {
+		thread_log(thread, ISC_LOGCATEGORY_GENERAL,
+			   ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
+			   "maximum number of FD events (%d) received",
+			   nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
+		REQUIRE(events[i].data.fd < (int)thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -4140,71 +4549,71 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			 * won't block because we use non-blocking sockets.
 			 */
 			int fd = events[i].data.fd;
-			events[i].events |= manager->epoll_events[fd];
+			events[i].events |= thread->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
-			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
-			    "maximum number of FD events (%d) received",
-			    nevents);
+	if (nevents == thread->nevents) {
+		thread_log(thread, ISC_LOGCATEGORY_GENERAL,
+			   ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
+			   "maximum number of FD events (%d) received",
+			   nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].fd < (int)manager->maxsocks);
+		REQUIRE(events[i].fd < (int)thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
 	int i;
 
-	REQUIRE(maxfd <= (int)manager->maxsocks);
+	REQUIRE(maxfd <= (int)thread->manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4212,17 +4621,17 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
-		manager_log(manager, IOEVENT,
-			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
-					   ISC_MSG_WATCHERMSG,
-					   "watcher got message %d "
-					   "for socket %d"), msg, fd);
+		thread_log(thread, IOEVENT,
+			   isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
+					  ISC_MSG_WATCHERMSG,
+					  "watcher got message %d "
+					  "for socket %d"), msg, fd);
 
 		/*
 		 * Nothing to read?
@@ -4245,7 +4654,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (ISC_FALSE);
@@ -4260,7 +4669,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4286,34 +4695,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4323,7 +4732,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4331,23 +4740,23 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
 #elif defined(USE_SELECT)
-			LOCK(&manager->lock);
-			memmove(manager->read_fds_copy, manager->read_fds,
-				manager->fd_bufsize);
-			memmove(manager->write_fds_copy, manager->write_fds,
-				manager->fd_bufsize);
-			maxfd = manager->maxfd + 1;
-			UNLOCK(&manager->lock);
-
-			cc = select(maxfd, manager->read_fds_copy,
-				    manager->write_fds_copy, NULL, NULL);
+			LOCK(&thread->manager->lock);
+			memmove(thread->read_fds_copy, thread->read_fds,
+				thread->fd_bufsize);
+			memmove(thread->write_fds_copy, thread->write_fds,
+				thread->fd_bufsize);
+			maxfd = thread->maxfd + 1;
+			UNLOCK(&thread->manager->lock);
+
+			cc = select(maxfd, thread->read_fds_copy,
+				    thread->write_fds_copy, NULL, NULL);
 #endif	/* USE_KQUEUE */
 
 			if (cc < 0 && !SOFT_ERROR(errno)) {
@@ -4376,11 +4785,11 @@ watcher(void *uap) {
 					 * (and it can also be a false positive)
 					 * so it would be just too noisy.
 					 */
-					manager_log(manager,
-						    ISC_LOGCATEGORY_GENERAL,
-						    ISC_LOGMODULE_SOCKET,
-						    ISC_LOG_DEBUG(1),
-						    "unexpected POLL timeout");
+					thread_log(thread,
+						   ISC_LOGCATEGORY_GENERAL,
+						   ISC_LOGMODULE_SOCKET,
+						   ISC_LOG_DEBUG(1),
+						   "unexpected POLL timeout");
 				}
 				pollstate = poll_active;
 			}
@@ -4388,22 +4797,22 @@ watcher(void *uap) {
 		} while (cc < 0);
 
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
-			    manager->write_fds_copy);
+		process_fds(thread, maxfd, thread->read_fds_copy,
+			    thread->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
-		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+		if (FD_ISSET(ctlfd, thread->read_fds_copy))
+			done = process_ctlfd(thread);
 #endif
 	}
 
-	manager_log(manager, TRACE, "%s",
-		    isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-				   ISC_MSG_EXITING, "watcher exiting"));
+	thread_log(thread, TRACE, "%s",
+		   isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+				  ISC_MSG_EXITING, "watcher exiting"));
 
 	return ((isc_threadresult_t)0);
 }
@@ -4432,20 +4841,20 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
 	isc_result_t result;
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4453,28 +4862,28 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4482,44 +4891,32 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4527,20 +4924,16 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
@@ -4553,49 +4946,49 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	 * FD_SETSIZE, but we separate the cases to avoid possible portability
 	 * issues regarding howmany() and the actual representation of fd_set.
 	 */
-	manager->fd_bufsize = howmany(manager->maxsocks, NFDBITS) *
+	thread->fd_bufsize = howmany(thread->manager->maxsocks, NFDBITS) *
 		sizeof(fd_mask);
 #else
-	manager->fd_bufsize = sizeof(fd_set);
-#endif
-
-	manager->read_fds = NULL;
-	manager->read_fds_copy = NULL;
-	manager->write_fds = NULL;
-	manager->write_fds_copy = NULL;
-
-	manager->read_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds != NULL)
-		manager->read_fds_copy = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		manager->write_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->write_fds != NULL) {
-		manager->write_fds_copy = isc_mem_get(mctx,
-						      manager->fd_bufsize);
-	}
-	if (manager->write_fds_copy == NULL) {
-		if (manager->write_fds != NULL) {
-			isc_mem_put(mctx, manager->write_fds,
-				    manager->fd_bufsize);
+	thread->fd_bufsize = sizeof(fd_set);
+#endif
+
+	thread->read_fds = NULL;
+	thread->read_fds_copy = NULL;
+	thread->write_fds = NULL;
+	thread->write_fds_copy = NULL;
+
+	thread->read_fds = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->read_fds != NULL)
+		thread->read_fds_copy = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		thread->write_fds = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->write_fds != NULL) {
+		thread->write_fds_copy = isc_mem_get(mctx,
+						      thread->fd_bufsize);
+	}
+	if (thread->write_fds_copy == NULL) {
+		if (thread->write_fds != NULL) {
+			isc_mem_put(mctx, thread->write_fds,
+				    thread->fd_bufsize);
 		}
-		if (manager->read_fds_copy != NULL) {
-			isc_mem_put(mctx, manager->read_fds_copy,
-				    manager->fd_bufsize);
+		if (thread->read_fds_copy != NULL) {
+			isc_mem_put(mctx, thread->read_fds_copy,
+				    thread->fd_bufsize);
 		}
-		if (manager->read_fds != NULL) {
-			isc_mem_put(mctx, manager->read_fds,
-				    manager->fd_bufsize);
+		if (thread->read_fds != NULL) {
+			isc_mem_put(mctx, thread->read_fds,
+				    thread->fd_bufsize);
 		}
 		return (ISC_R_NOMEMORY);
 	}
-	memset(manager->read_fds, 0, manager->fd_bufsize);
-	memset(manager->write_fds, 0, manager->fd_bufsize);
+	memset(thread->read_fds, 0, thread->fd_bufsize);
+	memset(thread->write_fds, 0, thread->fd_bufsize);
 
 #ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	thread->maxfd = thread->pipe_fds[0];
 #else /* USE_WATCHER_THREAD */
-	manager->maxfd = 0;
+	thread->maxfd = 0;
 #endif /* USE_WATCHER_THREAD */
 #endif	/* USE_KQUEUE */
 
@@ -4603,11 +4996,11 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 }
 
 static void
-cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+cleanup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
 #ifdef USE_WATCHER_THREAD
 	isc_result_t result;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "epoll_ctl(DEL) %s",
@@ -4617,48 +5010,215 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
 #elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
 #elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
-	isc_mem_put(mctx, manager->fdpollinfo,
-		    sizeof(pollinfo_t) * manager->maxsocks);
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
 #elif defined(USE_SELECT)
-	if (manager->read_fds != NULL)
-		isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		isc_mem_put(mctx, manager->read_fds_copy, manager->fd_bufsize);
-	if (manager->write_fds != NULL)
-		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
-	if (manager->write_fds_copy != NULL)
-		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
+	if (thread->read_fds != NULL)
+		isc_mem_put(mctx, thread->read_fds, thread->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		isc_mem_put(mctx, thread->read_fds_copy, thread->fd_bufsize);
+	if (thread->write_fds != NULL)
+		isc_mem_put(mctx, thread->write_fds, thread->fd_bufsize);
+	if (thread->write_fds_copy != NULL)
+		isc_mem_put(mctx, thread->write_fds_copy, thread->fd_bufsize);
 #endif	/* USE_KQUEUE */
 }
 
+/*
+ * Allocate the descriptor tables shared by the manager's threads.
+ */
+static isc_result_t
+setup_fdtables(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+	manager->fds = isc_mem_get(mctx,
+				   manager->maxsocks * sizeof(isc__socket_t *));
+	if (manager->fds == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(manager->fds, 0, manager->maxsocks * sizeof(isc__socket_t *));
+
+	manager->fdstate = isc_mem_get(mctx, manager->maxsocks * sizeof(int));
+	if (manager->fdstate == NULL)
+		goto free_fds;
+	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
+
+#if defined(USE_EPOLL)
+	manager->epoll_events = isc_mem_get(mctx, (manager->maxsocks *
+						   sizeof(uint32_t)));
+	if (manager->epoll_events == NULL)
+		goto free_fdstate;
+	memset(manager->epoll_events, 0,
+	       manager->maxsocks * sizeof(uint32_t));
+#endif
+#ifdef USE_DEVPOLL
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL)
+		goto free_fdstate;
+	memset(manager->fdpollinfo, 0,
+	       sizeof(pollinfo_t) * manager->maxsocks);
+#endif
+
+	return (ISC_R_SUCCESS);
+
+#if defined(USE_EPOLL) || defined(USE_DEVPOLL)
+ free_fdstate:
+	isc_mem_put(mctx, manager->fdstate, manager->maxsocks * sizeof(int));
+#endif
+ free_fds:
+	isc_mem_put(mctx, manager->fds,
+		    manager->maxsocks * sizeof(isc__socket_t *));
+
+	return (ISC_R_NOMEMORY);
+}
+
+static void
+cleanup_fdtables(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+#ifdef USE_DEVPOLL
+	isc_mem_put(mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
+#endif
+#if defined(USE_EPOLL)
+	isc_mem_put(mctx, manager->epoll_events,
+		    manager->maxsocks * sizeof(uint32_t));
+#endif
+	isc_mem_put(mctx, manager->fdstate, manager->maxsocks * sizeof(int));
+	isc_mem_put(mctx, manager->fds,
+		    manager->maxsocks * sizeof(isc__socket_t *));
+}
+
+/*
+ * Set up the per-thread state: the locks for its share of the descriptor
+ * tables, the control pipe and the event multiplexer.
+ */
+static isc_result_t
+setup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
+	isc_result_t result = ISC_R_SUCCESS;
+	int i;
+#ifdef USE_WATCHER_THREAD
+	char strbuf[ISC_STRERRORSIZE];
+#endif
+
+	thread->fds = manager->fds;
+	thread->fdstate = manager->fdstate;
+#if defined(USE_EPOLL)
+	thread->epoll_events = manager->epoll_events;
+#endif
+#ifdef USE_DEVPOLL
+	thread->fdpollinfo = manager->fdpollinfo;
+#endif
+
+	thread->fdlock = isc_mem_get(mctx, FDLOCK_COUNT * sizeof(isc_mutex_t));
+	if (thread->fdlock == NULL)
+		return (ISC_R_NOMEMORY);
+	for (i = 0; i < FDLOCK_COUNT; i++) {
+		result = isc_mutex_init(&thread->fdlock[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				DESTROYLOCK(&thread->fdlock[i]);
+			goto free_fdlock;
+		}
+	}
+
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		result = ISC_R_UNEXPECTED;
+		goto destroy_fdlock;
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
+	/*
+	 * Set up initial state for the select loop
+	 */
+	result = setup_watcher(mctx, thread);
+	if (result != ISC_R_SUCCESS)
+		goto close_pipe;
+
+	return (ISC_R_SUCCESS);
+
+ close_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+ destroy_fdlock:
+#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < FDLOCK_COUNT; i++)
+		DESTROYLOCK(&thread->fdlock[i]);
+ free_fdlock:
+	isc_mem_put(mctx, thread->fdlock, FDLOCK_COUNT * sizeof(isc_mutex_t));
+
+	return (result);
+}
+
+static void
+cleanup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
+	int i;
+
+	cleanup_watcher(mctx, thread);
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif /* USE_WATCHER_THREAD */
+
+	for (i = thread->threadid; i < (int)manager->maxsocks;
+	     i += manager->nthreads)
+	{
+		if (thread->fdstate[i] == CLOSE_PENDING) /* no need to lock */
+			(void)close(i);
+	}
+
+	for (i = 0; i < FDLOCK_COUNT; i++)
+		DESTROYLOCK(&thread->fdlock[i]);
+	isc_mem_put(mctx, thread->fdlock, FDLOCK_COUNT * sizeof(isc_mutex_t));
+}
+
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
 #ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
+	char name[32];
 #endif
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nthreads >= 0);
 
 #ifdef USE_SHARED_MANAGER
 	if (socketmgr != NULL) {
@@ -4675,6 +5235,16 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
 
+#ifdef USE_WATCHER_THREAD
+	if (nthreads == 0)
+		nthreads = 1;
+#else
+	/*
+	 * Without threads there is nobody to run additional loops.
+	 */
+	nthreads = 1;
+#endif /* USE_WATCHER_THREAD */
+
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
@@ -4684,53 +5254,17 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	manager->maxsocks = maxsocks;
 	manager->reserved = 0;
 	manager->maxudp = 0;
-	manager->fds = isc_mem_get(mctx,
-				   manager->maxsocks * sizeof(isc__socket_t *));
-	if (manager->fds == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-	manager->fdstate = isc_mem_get(mctx, manager->maxsocks * sizeof(int));
-	if (manager->fdstate == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-#if defined(USE_EPOLL)
-	manager->epoll_events = isc_mem_get(mctx, (manager->maxsocks *
-						   sizeof(uint32_t)));
-	if (manager->epoll_events == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-	memset(manager->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
-#endif
+	manager->nthreads = nthreads;
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
 	manager->common.magic = ISCAPI_SOCKETMGR_MAGIC;
 	manager->common.impmagic = SOCKET_MANAGER_MAGIC;
 	manager->mctx = NULL;
-	memset(manager->fds, 0, manager->maxsocks * sizeof(isc_socket_t *));
 	ISC_LIST_INIT(manager->socklist);
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS)
 		goto free_manager;
-	manager->fdlock = isc_mem_get(mctx, FDLOCK_COUNT * sizeof(isc_mutex_t));
-	if (manager->fdlock == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
-	}
-	for (i = 0; i < FDLOCK_COUNT; i++) {
-		result = isc_mutex_init(&manager->fdlock[i]);
-		if (result != ISC_R_SUCCESS) {
-			while (--i >= 0)
-				DESTROYLOCK(&manager->fdlock[i]);
-			isc_mem_put(mctx, manager->fdlock,
-				    FDLOCK_COUNT * sizeof(isc_mutex_t));
-			manager->fdlock = NULL;
-			goto cleanup_lock;
-		}
-	}
 
 #ifdef USE_WATCHER_THREAD
 	if (isc_condition_init(&manager->shutdown_ok) != ISC_R_SUCCESS) {
@@ -4741,56 +5275,54 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 #endif /* USE_SHARED_MANAGER */
 
-	/*
-	 * Set up initial state for the select loop
-	 */
-	result = setup_watcher(mctx, manager);
+	manager->threads = isc_mem_get(mctx, sizeof(isc__socketthread_t) *
+					     manager->nthreads);
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_condition;
+	}
+	memset(manager->threads, 0,
+	       sizeof(isc__socketthread_t) * manager->nthreads);
+
+	result = setup_fdtables(mctx, manager);
 	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+		goto free_threads;
 
-	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
+	for (i = 0; i < manager->nthreads; i++) {
+		manager->threads[i].manager = manager;
+		manager->threads[i].threadid = i;
+		result = setup_thread(mctx, &manager->threads[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_threads;
+	}
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_create(watcher, &manager->threads[i],
+				      &manager->threads[i].thread) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			result = ISC_R_UNEXPECTED;
+			goto stop_threads;
+		}
+		snprintf(name, sizeof(name), "isc-socket-%d", i);
+		isc_thread_setname(manager->threads[i].thread, name);
 	}
-	isc_thread_setname(manager->watcher, "isc-socket");
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
 
@@ -4801,44 +5333,33 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	return (ISC_R_SUCCESS);
 
-cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
+stop_threads:
+	while (--i >= 0) {
+		select_poke(manager, i, 0, SELECT_POKE_SHUTDOWN);
+		(void)isc_thread_join(manager->threads[i].thread, NULL);
+	}
+	i = manager->nthreads;
+#endif /* USE_WATCHER_THREAD */
+
+cleanup_threads:
+	while (--i >= 0)
+		cleanup_thread(mctx, &manager->threads[i]);
+	cleanup_fdtables(mctx, manager);
+
+free_threads:
+	isc_mem_put(mctx, manager->threads,
+		    sizeof(isc__socketthread_t) * manager->nthreads);
 
-#ifdef USE_WATCHER_THREAD
 cleanup_condition:
+#ifdef USE_WATCHER_THREAD
 	(void)isc_condition_destroy(&manager->shutdown_ok);
-#endif	/* USE_WATCHER_THREAD */
-
 
 cleanup_lock:
-	if (manager->fdlock != NULL) {
-		for (i = 0; i < FDLOCK_COUNT; i++)
-			DESTROYLOCK(&manager->fdlock[i]);
-	}
+#endif	/* USE_WATCHER_THREAD */
 	DESTROYLOCK(&manager->lock);
 
 free_manager:
-	if (manager->fdlock != NULL) {
-		isc_mem_put(mctx, manager->fdlock,
-			    FDLOCK_COUNT * sizeof(isc_mutex_t));
-	}
-#if defined(USE_EPOLL)
-	if (manager->epoll_events != NULL) {
-		isc_mem_put(mctx, manager->epoll_events,
-			    manager->maxsocks * sizeof(uint32_t));
-	}
-#endif
-	if (manager->fdstate != NULL) {
-		isc_mem_put(mctx, manager->fdstate,
-			    manager->maxsocks * sizeof(int));
-	}
-	if (manager->fds != NULL) {
-		isc_mem_put(mctx, manager->fds,
-			    manager->maxsocks * sizeof(isc_socket_t *));
-	}
 	isc_mem_put(mctx, manager, sizeof(*manager));
 
 	return (result);
@@ -4912,56 +5433,47 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	UNLOCK(&manager->lock);
 
 	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
+	 * Here, poke our select/poll threads.  Do this by closing the write
 	 * half of the pipe, which will send EOF to the read half.
 	 * This is currently a no-op in the non-threaded case.
 	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
+	for (i = 0; i < manager->nthreads; i++)
+		select_poke(manager, i, 0, SELECT_POKE_SHUTDOWN);
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Wait for threads to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+		}
+	}
 #endif /* USE_WATCHER_THREAD */
 
 	/*
 	 * Clean up.
 	 */
-	cleanup_watcher(manager->mctx, manager);
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(manager->mctx, &manager->threads[i]);
+	cleanup_fdtables(manager->mctx, manager);
+	isc_mem_put(manager->mctx, manager->threads,
+		    sizeof(isc__socketthread_t) * manager->nthreads);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
-	for (i = 0; i < (int)manager->maxsocks; i++)
-		if (manager->fdstate[i] == CLOSE_PENDING) /* no need to lock */
-			(void)close(i);
-
-#if defined(USE_EPOLL)
-	isc_mem_put(manager->mctx, manager->epoll_events,
-		    manager->maxsocks * sizeof(uint32_t));
-#endif
-	isc_mem_put(manager->mctx, manager->fds,
-		    manager->maxsocks * sizeof(isc__socket_t *));
-	isc_mem_put(manager->mctx, manager->fdstate,
-		    manager->maxsocks * sizeof(int));
-
 	if (manager->stats != NULL)
 		isc_stats_detach(&manager->stats);
 
-	if (manager->fdlock != NULL) {
-		for (i = 0; i < FDLOCK_COUNT; i++)
-			DESTROYLOCK(&manager->fdlock[i]);
-		isc_mem_put(manager->mctx, manager->fdlock,
-			    FDLOCK_COUNT * sizeof(isc_mutex_t));
-	}
 	DESTROYLOCK(&manager->lock);
 	manager->common.magic = 0;
 	manager->common.impmagic = 0;
@@ -4989,7 +5501,16 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 	dev->ev_sender = task;
 
 	if (sock->type == isc_sockettype_udp) {
-		io_state = doio_recv(sock, dev);
+#ifdef HAVE_RECVMMSG
+		/*
+		 * Batched requests are always queued so that they can be
+		 * filled together once the socket becomes readable.
+		 */
+		if ((flags & ISC_SOCKFLAG_BATCH) != 0 && BATCH_RECV_OK(sock))
+			io_state = DOIO_SOFT;
+		else
+#endif
+			io_state = doio_recv(sock, dev);
 	} else {
 		LOCK(&sock->lock);
 		have_lock = ISC_TRUE;
@@ -5021,7 +5542,8 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		 * watched, poke the watcher to start paying attention to it.
 		 */
 		if (ISC_LIST_EMPTY(sock->recv_list) && !sock->pending_recv)
-			select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+			select_poke(sock->manager, sock->threadid, sock->fd,
+				    SELECT_POKE_READ);
 		ISC_LIST_ENQUEUE(sock->recv_list, dev, ev_link);
 
 		socket_log(sock, NULL, EVENT, NULL, 0, 0,
@@ -5159,6 +5681,91 @@ isc__socket_recv2(isc_socket_t *sock0, isc_region_t *region,
 	return (socket_recv(sock, event, task, flags));
 }
 
+#ifdef HAVE_SENDMMSG
+/*
+ * Send a UDP datagram, combining it with any that other threads queue on
+ * the same socket in the meantime.  Whoever finds the socket idle sends
+ * its own datagram straight away and then drains the queue with
+ * sendmmsg(); everyone else just queues behind it.
+ */
+static isc_result_t
+socket_sendbatch(isc__socket_t *sock, isc_socketevent_t *dev,
+		 isc_task_t *task, unsigned int flags)
+{
+	int io_state;
+	isc_task_t *ntask = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	LOCK(&sock->lock);
+	sock->batchsend = 1;
+
+	if (sock->flushing || sock->pending_send ||
+	    !ISC_LIST_EMPTY(sock->send_list))
+	{
+		isc_task_attach(task, &ntask);
+		dev->attributes |= ISC_SOCKEVENTATTR_ATTACHED;
+		if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
+			dev->attributes |= ISC_SOCKEVENTATTR_NORETRY;
+		ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
+
+		socket_log(sock, NULL, EVENT, NULL, 0, 0,
+			   "socket_sendbatch: event %p -> task %p",
+			   dev, ntask);
+
+		UNLOCK(&sock->lock);
+		if ((flags & ISC_SOCKFLAG_IMMEDIATE) != 0)
+			result = ISC_R_INPROGRESS;
+		return (result);
+	}
+
+	sock->flushing = 1;
+	sock->references++;
+	UNLOCK(&sock->lock);
+
+	io_state = doio_send(sock, dev);
+
+	LOCK(&sock->lock);
+	switch (io_state) {
+	case DOIO_SOFT:
+		if ((flags & ISC_SOCKFLAG_NORETRY) == 0) {
+			isc_task_attach(task, &ntask);
+			dev->attributes |= ISC_SOCKEVENTATTR_ATTACHED;
+			ISC_LIST_PREPEND(sock->send_list, dev, ev_link);
+
+			socket_log(sock, NULL, EVENT, NULL, 0, 0,
+				   "socket_sendbatch: event %p -> task %p",
+				   dev, ntask);
+
+			if ((flags & ISC_SOCKFLAG_IMMEDIATE) != 0)
+				result = ISC_R_INPROGRESS;
+			break;
+		}
+
+		/* FALLTHROUGH */
+
+	case DOIO_HARD:
+	case DOIO_SUCCESS:
+		if ((flags & ISC_SOCKFLAG_IMMEDIATE) == 0)
+			send_senddone_event(sock, &dev);
+		break;
+	}
+
+	flush_sends(sock, FLUSH_SENDER_BATCHES);
+	sock->flushing = 0;
+
+	INSIST(sock->references > 0);
+	sock->references--;
+	if (sock->references == 0) {
+		UNLOCK(&sock->lock);
+		destroy(&sock);
+		return (result);
+	}
+	UNLOCK(&sock->lock);
+
+	return (result);
+}
+#endif /* HAVE_SENDMMSG */
+
 static isc_result_t
 socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 	    const isc_sockaddr_t *address, struct in6_pktinfo *pktinfo,
@@ -5191,6 +5798,11 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		}
 	}
 
+#ifdef HAVE_SENDMMSG
+	if ((flags & ISC_SOCKFLAG_BATCH) != 0 && BATCH_SEND_OK(sock))
+		return (socket_sendbatch(sock, dev, task, flags));
+#endif
+
 	if (sock->type == isc_sockettype_udp)
 		io_state = doio_send(sock, dev);
 	else {
@@ -5225,7 +5837,7 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 			 */
 			if (ISC_LIST_EMPTY(sock->send_list) &&
 			    !sock->pending_send)
-				select_poke(sock->manager, sock->fd,
+				select_poke(sock->manager, sock->threadid, sock->fd,
 					    SELECT_POKE_WRITE);
 			ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
 
@@ -5361,7 +5973,8 @@ isc__socket_sendto2(isc_socket_t *sock0, isc_region_t *region,
 	isc__socket_t *sock = (isc__socket_t *)sock0;
 
 	REQUIRE(VALID_SOCKET(sock));
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			   ISC_SOCKFLAG_BATCH)) == 0);
 	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
 	event->ev_sender = sock;
@@ -5597,6 +6210,19 @@ isc__socket_bind(isc_socket_t *sock0, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef REUSEPORT_OPTION
+		if (setsockopt(sock->fd, SOL_SOCKET, REUSEPORT_OPTION,
+			       (void *)&on, sizeof(on)) < 0)
+		{
+			UNLOCK(&sock->lock);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -5846,7 +6472,8 @@ isc__socket_accept(isc_socket_t *sock0,
 	ISC_LIST_ENQUEUE(sock->accept_list, dev, ev_link);
 
 	if (do_poke)
-		select_poke(manager, sock->fd, SELECT_POKE_ACCEPT);
+		select_poke(manager, sock->threadid, sock->fd,
+			    SELECT_POKE_ACCEPT);
 
 	UNLOCK(&sock->lock);
 	return (ISC_R_SUCCESS);
@@ -5997,7 +6624,8 @@ isc__socket_connect(isc_socket_t *sock0, const isc_sockaddr_t *addr,
 	 * bit of time waking it up now or later won't matter all that much.
 	 */
 	if (ISC_LIST_EMPTY(sock->connect_list) && !sock->connecting)
-		select_poke(manager, sock->fd, SELECT_POKE_CONNECT);
+		select_poke(manager, sock->threadid, sock->fd,
+			    SELECT_POKE_CONNECT);
 
 	sock->connecting = 1;
 
@@ -6071,7 +6699,7 @@ internal_connect(isc_task_t *me, isc_event_t *ev) {
 		 */
 		if (SOFT_ERROR(errno) || errno == EINPROGRESS) {
 			sock->connecting = 1;
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_CONNECT);
 			UNLOCK(&sock->lock);
 
@@ -6455,6 +7083,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -6476,6 +7105,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+	thread = &manager->threads[0];
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -6484,8 +7114,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6493,32 +7123,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6526,21 +7156,21 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
 	swait_private.nevents = n;
 #elif defined(USE_SELECT)
-	memmove(manager->read_fds_copy, manager->read_fds, manager->fd_bufsize);
-	memmove(manager->write_fds_copy, manager->write_fds,
-		manager->fd_bufsize);
+	memmove(thread->read_fds_copy, thread->read_fds, thread->fd_bufsize);
+	memmove(thread->write_fds_copy, thread->write_fds,
+		thread->fd_bufsize);
 
-	swait_private.readset = manager->read_fds_copy;
-	swait_private.writeset = manager->write_fds_copy;
-	swait_private.maxfd = manager->maxfd + 1;
+	swait_private.readset = thread->read_fds_copy;
+	swait_private.writeset = thread->write_fds_copy;
+	swait_private.maxfd = thread->maxfd + 1;
 
 	n = select(swait_private.maxfd, swait_private.readset,
 		   swait_private.writeset, NULL, tvp);
@@ -6553,6 +7183,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 isc_result_t
 isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 
 	REQUIRE(swait == &swait_private);
 
@@ -6562,12 +7193,13 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 #endif
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
+	thread = &manager->threads[0];
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(thread, thread->events, swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(thread, swait->maxfd, swait->readset, swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -77,6 +77,9 @@ isc_thread_setconcurrency(unsigned int level);
 void
 isc_thread_setname(isc_thread_t, const char *);
 
+unsigned int
+isc_thread_index(void);
+
 int
 isc_thread_key_create(isc_thread_key_t *key, void (*func)(void *));
 
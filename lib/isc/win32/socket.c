@@ -2653,18 +2653,24 @@ SocketIoThread(LPVOID ThreadContext) {
  */
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc_socketmgr_create2(mctx, managerp, 0));
+	return (isc_socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	isc_socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
+	/*
+	 * The completion port already spreads I/O over its own pool
+	 * of threads.
+	 */
+	UNUSED(nthreads);
+
 	if (maxsocks != 0)
 		return (ISC_R_NOTIMPLEMENTED);
 
@@ -3210,7 +3216,8 @@ isc__socket_sendto2(isc_socket_t *sock, isc_region_t *region, isc_task_t *task,
 	LOCK(&sock->lock);
 	CONSISTENT(sock);
 
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			   ISC_SOCKFLAG_BATCH)) == 0);
 	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
 	event->ev_sender = sock;
@@ -3272,6 +3279,13 @@ isc__socket_bind(isc_socket_t *sock, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	/*
+	 * SO_REUSEPORT load balancing is not available.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	if (bind(sock->fd, &sockaddr->type.sa, sockaddr->length) < 0) {
 		bind_errno = WSAGetLastError();
 		UNLOCK(&sock->lock);
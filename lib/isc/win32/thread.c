@@ -10,9 +10,16 @@
 
 #include <process.h>
 
+#include <stdint.h>
+
+#include <isc/once.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 
+static isc_once_t index_once = ISC_ONCE_INIT;
+static isc_thread_key_t index_key;
+static LONG index_next = 0;
+
 isc_result_t
 isc_thread_create(isc_threadfunc_t start, isc_threadarg_t arg,
 		  isc_thread_t *threadp)
@@ -84,3 +91,30 @@ int
 isc_thread_key_delete(isc_thread_key_t key) {
 	return (TlsFree(key) ? 0 : GetLastError());
 }
+
+static void
+index_initialize(void) {
+	RUNTIME_CHECK(isc_thread_key_create(&index_key, NULL) == 0);
+}
+
+unsigned int
+isc_thread_index(void) {
+	void *value;
+	unsigned int index;
+
+	RUNTIME_CHECK(isc_once_do(&index_once, index_initialize) ==
+		      ISC_R_SUCCESS);
+
+	/*
+	 * The key holds index + 1, so that NULL means "not yet assigned".
+	 */
+	value = isc_thread_key_getspecific(index_key);
+	if (value != NULL)
+		return ((unsigned int)((uintptr_t)value - 1));
+
+	index = (unsigned int)InterlockedIncrement(&index_next) - 1;
+	RUNTIME_CHECK(isc_thread_key_setspecific(index_key,
+				(void *)(uintptr_t)(index + 1)) == 0);
+
+	return (index);
+}
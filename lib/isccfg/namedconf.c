@@ -1112,6 +1112,7 @@ options_clauses[] = {
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
 	{ "reserved-sockets", &cfg_type_uint32, 0 },
+	{ "reuseport", &cfg_type_boolean, 0 },
 	{ "secroots-file", &cfg_type_qstring, 0 },
 	{ "serial-queries", &cfg_type_uint32, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "serial-query-rate", &cfg_type_uint32, 0 },
@@ -1951,6 +1952,7 @@ view_clauses[] = {
 	{ "resolver-nonbackoff-tries", &cfg_type_uint32, 0 },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
 	{ "resolver-retry-interval", &cfg_type_uint32, 0 },
+	{ "response-cache-size", &cfg_type_uint32, 0 },
 	{ "response-padding", &cfg_type_resppadding, 0 },
 	{ "response-policy", &cfg_type_rpz, 0 },
 	{ "rfc2308-type1", &cfg_type_boolean, CFG_CLAUSEFLAG_NYI },
@@ -2090,6 +2092,9 @@ zone_clauses[] = {
 	{ "inline-signing", &cfg_type_boolean,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
 	},
+	{ "journal-commit-delay", &cfg_type_uint32,
+		CFG_ZONE_MASTER
+	},
 	{ "key-directory", &cfg_type_qstring,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
 	},
@@ -43,6 +43,7 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/view.h>
@@ -603,6 +604,9 @@ exit_check(ns_client_t *client) {
 
 		ns_query_free(client);
 		isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
+		if (client->sendbuf != NULL)
+			isc_mem_put(client->mctx, client->sendbuf,
+				    SEND_BUFFER_SIZE);
 		isc_event_free((isc_event_t **)&client->sendevent);
 		isc_event_free((isc_event_t **)&client->recvevent);
 		isc_timer_detach(&client->timer);
@@ -867,7 +871,7 @@ client_senddone(isc_task_t *task, isc_event_t *event) {
 static isc_result_t
 client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 		    isc_buffer_t *tcpbuffer, isc_uint32_t length,
-		    unsigned char *sendbuf, unsigned char **datap)
+		    unsigned char **datap)
 {
 	unsigned char *data;
 	isc_uint32_t bufsize;
@@ -898,7 +902,19 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 			isc_buffer_putuint16(buffer, (isc_uint16_t)length);
 		}
 	} else {
-		data = sendbuf;
+		/*
+		 * Only UDP clients need this, and it must outlive the
+		 * send, so it is kept until the client is destroyed.
+		 */
+		if (client->sendbuf == NULL) {
+			client->sendbuf = isc_mem_get(client->mctx,
+						      SEND_BUFFER_SIZE);
+			if (client->sendbuf == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto done;
+			}
+		}
+		data = client->sendbuf;
 		if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
 			if (client->view != NULL)
 				bufsize = client->view->nocookieudp;
@@ -952,7 +968,7 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 				  env, &match, NULL) == ISC_R_SUCCESS &&
 		    match > 0)
 			return (DNS_R_BLACKHOLED);
-		sockflags |= ISC_SOCKFLAG_NORETRY;
+		sockflags |= ISC_SOCKFLAG_NORETRY | ISC_SOCKFLAG_BATCH;
 	}
 
 	if ((client->attributes & NS_CLIENTATTR_PKTINFO) != 0 &&
@@ -1009,7 +1025,6 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_buffer_t buffer;
 	isc_region_t r;
 	isc_region_t *mr;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -1022,7 +1037,7 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	}
 
 	result = client_allocsendbuf(client, &buffer, NULL, mr->length,
-				     sendbuf, &data);
+				     &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -1048,6 +1063,102 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, dns_rcode_t *rcodep,
+		     isc_boolean_t *answerp)
+{
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	isc_uint16_t flags;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(!TCP_CLIENT(client));
+	REQUIRE(client->view != NULL && client->view->respcache != NULL);
+	REQUIRE(rcodep != NULL && answerp != NULL);
+
+	result = client_allocsendbuf(client, &buffer, NULL,
+				     DNS_MESSAGE_HEADERLEN, &data);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+
+	result = dns_respcache_find(client->view->respcache,
+				    client->query.origqname,
+				    client->query.qtype,
+				    client->query.respcache.variant,
+				    client->query.respcache.generation,
+				    &buffer);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+
+	CTRACE("sendcached");
+
+	/*
+	 * Everything in the header but the id is determined by the
+	 * cache key.
+	 */
+	isc_buffer_usedregion(&buffer, &r);
+	INSIST(r.length >= DNS_MESSAGE_HEADERLEN);
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	flags = (r.base[2] << 8) | r.base[3];
+	*rcodep = flags & 0x000f;	/* NOERROR or NXDOMAIN */
+	*answerp = ISC_TF(r.base[6] != 0 || r.base[7] != 0);
+
+	result = client_sendpkg(client, &buffer);
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		isc_stats_increment(client->sctx->udpoutstats4,
+				    ISC_MIN((int)r.length / 16, 256));
+		break;
+	case AF_INET6:
+		isc_stats_increment(client->sctx->udpoutstats6,
+				    ISC_MIN((int)r.length / 16, 256));
+		break;
+	default:
+		INSIST(0);
+		break;
+	}
+
+	ns_stats_increment(client->sctx->nsstats, ns_statscounter_response);
+	dns_rcodestats_increment(client->sctx->rcodestats, *rcodep);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_edns0out);
+	}
+	if ((flags & DNS_MESSAGEFLAG_TC) != 0)
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_truncatedresp);
+
+	if (result != ISC_R_SUCCESS)
+		ns_client_next(client, result);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Save a rendered response in the view's response cache.  The query
+ * code has already decided that the response only depends on the key
+ * (NS_QUERYATTR_RESPCACHE); only authoritative NOERROR and NXDOMAIN
+ * responses are kept.
+ */
+static void
+client_cacheresponse(ns_client_t *client, isc_buffer_t *buffer) {
+	isc_region_t r;
+
+	if ((client->message->flags & DNS_MESSAGEFLAG_AA) == 0 ||
+	    (client->message->rcode != dns_rcode_noerror &&
+	     client->message->rcode != dns_rcode_nxdomain))
+		return;
+
+	isc_buffer_usedregion(buffer, &r);
+	dns_respcache_add(client->view->respcache, client->query.origqname,
+			  client->query.qtype,
+			  client->query.respcache.variant,
+			  client->query.respcache.generation, &r);
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1057,7 +1168,6 @@ client_send(ns_client_t *client) {
 	isc_region_t r;
 	dns_compress_t cctx;
 	isc_boolean_t cleanup_cctx = ISC_FALSE;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	isc_boolean_t opt_included = ISC_FALSE;
@@ -1126,8 +1236,7 @@ client_send(ns_client_t *client) {
 	/*
 	 * XXXRTH  The following doesn't deal with TCP buffer resizing.
 	 */
-	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
-				     sendbuf, &data);
+	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0, &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -1269,6 +1378,8 @@ client_send(ns_client_t *client) {
 			break;
 		}
 	} else {
+		if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0)
+			client_cacheresponse(client, &buffer);
 		respsize = isc_buffer_usedlength(&buffer);
 		result = client_sendpkg(client, &buffer);
 #ifdef HAVE_DNSTAP
@@ -2988,6 +3099,8 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 		goto cleanup_sendevent;
 	}
 
+	client->sendbuf = NULL;
+
 	client->recvevent = isc_socket_socketevent(client->mctx, client,
 						   ISC_SOCKEVENT_RECVDONE,
 						   ns__client_request, client);
@@ -3282,14 +3395,16 @@ client_udprecv(ns_client_t *client) {
 	r.base = client->recvbuf;
 	r.length = RECV_BUFFER_SIZE;
 	result = isc_socket_recv2(client->udpsocket, &r, 1,
-				  client->task, client->recvevent, 0);
+				  client->task, client->recvevent,
+				  ISC_SOCKFLAG_BATCH);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socket_recv2() failed: %s",
 				 isc_result_totext(result));
 		/*
 		 * This cannot happen in the current implementation, since
-		 * isc_socket_recv2() cannot fail if flags == 0.
+		 * isc_socket_recv2() cannot fail without
+		 * ISC_SOCKFLAG_IMMEDIATE.
 		 *
 		 * If this does fail, we just go idle.
 		 */
@@ -3703,8 +3818,15 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 
 	MTRACE("createclients");
 
+	if (!tcp)
+		REQUIRE(ifp->nudpdispatch > 0);
+
 	for (disp = 0; disp < n; disp++) {
-		result = get_client(manager, ifp, ifp->udpdispatch[disp], tcp);
+		dns_dispatch_t *dispatch = NULL;
+
+		if (!tcp)
+			dispatch = ifp->udpdispatch[disp % ifp->nudpdispatch];
+		result = get_client(manager, ifp, dispatch, tcp);
 		if (result != ISC_R_SUCCESS)
 			break;
 	}
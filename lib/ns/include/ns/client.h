@@ -113,6 +113,7 @@ struct ns_client {
 	isc_socketevent_t *	sendevent;
 	isc_socketevent_t *	recvevent;
 	unsigned char *		recvbuf;
+	unsigned char *		sendbuf;
 	dns_rdataset_t *	opt;
 	isc_uint16_t		udpsize;
 	isc_uint16_t		extflags;
@@ -227,6 +228,26 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, dns_rcode_t *rcodep,
+		     isc_boolean_t *answerp);
+/*%<
+ * Finish processing the current client request by sending the response
+ * for client->query.origqname and client->query.qtype found in the
+ * view's response cache under client->query.respcache, with the
+ * message id of the request.  On success '*rcodep' is set to the RCODE
+ * of the response and '*answerp' to whether its answer section is
+ * non-empty, for the caller's statistics.
+ *
+ * Requires:
+ *\li	'client' is a valid UDP client whose view has a response cache.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the response was found and the request is
+ *				finished (even if sending it failed).
+ *\li	#ISC_R_NOTFOUND		the response is not cached; nothing was done.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -294,7 +315,8 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 /*%<
  * Create up to 'n' clients listening on interface 'ifp'.
  * If 'tcp' is ISC_TRUE, the clients will listen for TCP connections,
- * otherwise for UDP requests.
+ * otherwise for UDP requests, in which case they are spread round
+ * robin over the interface's UDP dispatches.
  */
 
 isc_sockaddr_t *
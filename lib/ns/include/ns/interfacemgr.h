@@ -117,6 +117,14 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog);
  * Set the size of the listen() backlog queue.
  */
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, isc_boolean_t value);
+/*%<
+ * If 'value' is ISC_TRUE, give each UDP dispatch of an interface its own
+ * socket bound with SO_REUSEPORT, instead of dup()ing a single socket.
+ * Takes effect for interfaces set up by subsequent scans.
+ */
+
 isc_boolean_t
 ns_interfacemgr_islistening(ns_interfacemgr_t *mgr);
 /*%<
@@ -26,6 +26,7 @@
 typedef struct ns_dbversion {
 	dns_db_t			*db;
 	dns_dbversion_t			*version;
+	isc_uint32_t			generation;
 	isc_boolean_t			acl_checked;
 	isc_boolean_t			queryok;
 	ISC_LINK(struct ns_dbversion)	link;
@@ -72,6 +73,10 @@ struct ns_query {
 		isc_boolean_t		authoritative;
 		isc_boolean_t		is_zone;
 	} redirect;
+	struct {
+		isc_uint32_t		variant;
+		isc_uint32_t		generation;
+	} respcache;
 };
 
 #define NS_QUERYATTR_RECURSIONOK	0x0001
@@ -92,6 +97,7 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_RESPCACHE		0x40000
 
 /* query context structure */
 
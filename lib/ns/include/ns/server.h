@@ -14,6 +14,7 @@
 #include <isc/log.h>
 #include <isc/fuzz.h>
 #include <isc/magic.h>
+#include <isc/mutex.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/sockaddr.h>
@@ -121,6 +122,10 @@ struct ns_server {
 	isc_stats_t *		tcpoutstats4;
 	isc_stats_t *		tcpinstats6;
 	isc_stats_t *		tcpoutstats6;
+
+	/*% Rendered zone data shared by concurrent AXFRs */
+	isc_mutex_t		xfrcachelock;
+	ns_xfrcachelist_t	xfrcache;
 };
 
 struct ns_altsecret {
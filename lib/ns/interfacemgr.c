@@ -52,6 +52,21 @@
 #define UDPBUFFERS 1000
 #endif /* TUNE_LARGE */
 
+/*
+ * Number of UDP clients listening on each dispatch.  A recvmmsg() batch
+ * can only fill receives that are already outstanding, so with a single
+ * client per socket there is nothing to batch.  Eight lets a burst be
+ * picked up in one system call while costing each dispatch only a few
+ * more idle clients (a 4k receive buffer each; send buffers are
+ * allocated on first use); anything beyond that waits in the kernel's
+ * receive queue as before.
+ */
+#ifdef HAVE_RECVMMSG
+#define UDPCLIENTS 8
+#else
+#define UDPCLIENTS 1
+#endif
+
 #define IFMGR_MAGIC			ISC_MAGIC('I', 'F', 'M', 'G')
 #define NS_INTERFACEMGR_VALID(t)	ISC_MAGIC_VALID(t, IFMGR_MAGIC)
 
@@ -78,6 +93,7 @@ struct ns_interfacemgr {
 	ISC_LIST(isc_sockaddr_t) listenon;
 	int			backlog;	/*%< Listen queue size */
 	unsigned int		udpdisp;	/*%< UDP dispatch count */
+	isc_boolean_t		reuseport;	/*%< SO_REUSEPORT listeners */
 #ifdef USE_ROUTE_SOCKET
 	isc_task_t *		task;
 	isc_socket_t *		route;
@@ -214,6 +230,7 @@ ns_interfacemgr_create(isc_mem_t *mctx,
 	mgr->listenon4 = NULL;
 	mgr->listenon6 = NULL;
 	mgr->udpdisp = udpdisp;
+	mgr->reuseport = ISC_FALSE;
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
@@ -321,6 +338,14 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog) {
 
 }
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, isc_boolean_t value) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+	LOCK(&mgr->lock);
+	mgr->reuseport = value;
+	UNLOCK(&mgr->lock);
+}
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr) {
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
@@ -469,8 +494,21 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	/*
+	 * With SO_REUSEPORT every dispatch gets its own socket, and
+	 * therefore its own kernel receive queue, so the UDP load is
+	 * spread across the socket manager threads.  Otherwise the extra
+	 * dispatches share dup()ed copies of the first socket.
+	 */
+	if (ifp->mgr->reuseport && isc_sockaddr_getport(&ifp->addr) != 0)
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+
 	ifp->nudpdispatch = ISC_MIN(ifp->mgr->udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
+		dns_dispatch_t *dupdisp = NULL;
+
+		if ((attrs & DNS_DISPATCHATTR_REUSEPORT) == 0 && disp != 0)
+			dupdisp = ifp->udpdispatch[0];
 		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
 						 ifp->mgr->socketmgr,
 						 ifp->mgr->taskmgr, &ifp->addr,
@@ -478,19 +516,35 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 						 32768, 8219, 8237,
 						 attrs, attrmask,
 						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
+						 dupdisp);
+		if (result == ISC_R_NOTIMPLEMENTED && disp == 0 &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "'reuseport' is not supported on this "
+				      "system, sharing one UDP socket");
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+							 ifp->mgr->socketmgr,
+							 ifp->mgr->taskmgr,
+							 &ifp->addr,
+							 4096, UDPBUFFERS,
+							 32768, 8219, 8237,
+							 attrs, attrmask,
+							 &ifp->udpdispatch[0],
+							 NULL);
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
 				      isc_result_totext(result));
-			goto udp_dispatch_failure;
+			goto addtodispatch_failure;
 		}
 
 	}
 
-	result = ns_clientmgr_createclients(ifp->clientmgr, ifp->nudpdispatch,
+	result = ns_clientmgr_createclients(ifp->clientmgr,
+					    ifp->nudpdispatch * UDPCLIENTS,
 					    ifp, ISC_FALSE);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -509,7 +563,6 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	}
 	ifp->nudpdispatch = 0;
 
- udp_dispatch_failure:
 	return (result);
 }
 
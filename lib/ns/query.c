@@ -46,6 +46,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -985,6 +986,10 @@ query_findversion(ns_client_t *client, dns_db_t *db) {
 		if (dbversion == NULL)
 			return (NULL);
 		dns_db_attach(db, &dbversion->db);
+		/*
+		 * Read the generation first; see dns_db_generation().
+		 */
+		dbversion->generation = dns_db_generation(db);
 		dns_db_currentversion(db, &dbversion->version);
 		dbversion->acl_checked = ISC_FALSE;
 		dbversion->queryok = ISC_FALSE;
@@ -1185,6 +1190,12 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 	if (result != ISC_R_SUCCESS)
 		goto fail;
 
+	/*
+	 * A response which uses more than one zone cannot be cached.
+	 */
+	if (client->query.authdbset && db != client->query.authdb)
+		client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	/* Transfer ownership. */
 	*zonep = zone;
 	*dbp = db;
@@ -1373,6 +1384,7 @@ query_getcachedb(ns_client_t *client, const dns_name_t *name,
 	if (!USECACHE(client))
 		return (DNS_R_REFUSED);
 	dns_db_attach(client->view->cachedb, &db);
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
 
 	if ((client->query.attributes & NS_QUERYATTR_CACHEACLOKVALID) != 0) {
 		/*
@@ -2046,6 +2058,11 @@ query_addrdataset(ns_client_t *client, dns_section_t section,
 						       fname, rdataset->type,
 						       rdataset->rdclass);
 	rdataset->attributes |= DNS_RDATASETATTR_LOADORDER;
+	if ((rdataset->attributes &
+	     (DNS_RDATASETATTR_RANDOMIZE | DNS_RDATASETATTR_CYCLIC)) != 0)
+	{
+		client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+	}
 
 	if (NOADDITIONAL(client))
 		return;
@@ -5127,6 +5144,170 @@ query_setup(ns_client_t *client, dns_rdatatype_t qtype) {
 	return (ns__query_start(&qctx));
 }
 
+/*%
+ * Bits of the variant under which a response is stored in the view's
+ * response cache.  The EDNS UDP buffer size occupies the top 16 bits.
+ */
+#define RESPCACHE_RD		0x0001
+#define RESPCACHE_CD		0x0002
+#define RESPCACHE_DNSSEC	0x0004
+#define RESPCACHE_AD		0x0008
+#define RESPCACHE_EDNS		0x0010
+#define RESPCACHE_INET6		0x0020	/* preferred glue */
+
+/*%
+ * Client attributes that make the response differ from client to client
+ * or cannot be reproduced by a copy.
+ */
+#define RESPCACHE_NOCLIENTATTRS	(NS_CLIENTATTR_RA | \
+				 NS_CLIENTATTR_WANTNSID | \
+				 NS_CLIENTATTR_FILTER_AAAA | \
+				 NS_CLIENTATTR_WANTCOOKIE | \
+				 NS_CLIENTATTR_HAVECOOKIE | \
+				 NS_CLIENTATTR_WANTEXPIRE | \
+				 NS_CLIENTATTR_HAVEECS | \
+				 NS_CLIENTATTR_WANTPAD | \
+				 NS_CLIENTATTR_USEKEEPALIVE)
+
+/*%
+ * Can the response to this query be taken from, and stored in, the
+ * view's response cache?  Only a response which depends on nothing but
+ * the zone data, the question and the variant bits above qualifies.
+ */
+static isc_boolean_t
+query_respcacheok(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = client->view;
+
+	if (view->respcache == NULL || qctx->event != NULL ||
+	    client->query.restarts != 0 || !qctx->is_zone ||
+	    qctx->zone == NULL || dns_db_ispersistent(qctx->db))
+	{
+		return (ISC_FALSE);
+	}
+
+	if (TCP(client) || client->sendcb != NULL ||
+	    client->sctx->delay != 0 ||
+	    (client->attributes & RESPCACHE_NOCLIENTATTRS) != 0 ||
+	    client->keytag != NULL || client->signer != NULL ||
+	    client->message->tsigkey != NULL ||
+	    client->message->querytsig != NULL ||
+	    client->message->rdclass != view->rdclass ||
+	    qctx->qtype == dns_rdatatype_any)
+	{
+		return (ISC_FALSE);
+	}
+
+	if (view->sortlist != NULL || view->nocasecompress != NULL ||
+	    view->rrl != NULL || view->rpzs != NULL || view->dns64cnt != 0 ||
+	    view->v4_aaaa != dns_aaaa_ok || view->v6_aaaa != dns_aaaa_ok ||
+	    view->redirect != NULL || view->redirectzone != NULL ||
+	    view->dtenv != NULL)
+	{
+		return (ISC_FALSE);
+	}
+
+#ifdef NS_HOOKS_ENABLE
+	if (ns__hook_table != NULL) {
+		return (ISC_FALSE);
+	}
+#endif
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Look the query up in the view's response cache.  If it is found, the
+ * cached response is sent and the query is finished; otherwise
+ * ISC_R_COMPLETE is returned, and NS_QUERYATTR_RESPCACHE is set if
+ * the response may be added to the cache when it is sent.  Anything
+ * that later makes the response unsuitable for caching clears it.
+ */
+static isc_result_t
+query_respcache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	ns_dbversion_t *dbversion;
+	isc_uint32_t variant = 0;
+	isc_statscounter_t counter;
+	isc_result_t result;
+	dns_rcode_t rcode;
+	isc_boolean_t answer;
+
+	if (!query_respcacheok(qctx)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	for (dbversion = ISC_LIST_HEAD(client->query.activeversions);
+	     dbversion != NULL;
+	     dbversion = ISC_LIST_NEXT(dbversion, link))
+	{
+		if (dbversion->db == qctx->db) {
+			break;
+		}
+	}
+	if (dbversion == NULL) {
+		return (ISC_R_COMPLETE);
+	}
+
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		variant |= RESPCACHE_RD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		variant |= RESPCACHE_CD;
+	}
+	if (WANTDNSSEC(client)) {
+		variant |= RESPCACHE_DNSSEC;
+	}
+	if (WANTAD(client)) {
+		variant |= RESPCACHE_AD;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		variant |= RESPCACHE_EDNS;
+	}
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		variant |= RESPCACHE_INET6;
+	}
+	variant |= (isc_uint32_t)client->udpsize << 16;
+
+	client->query.respcache.variant = variant;
+	client->query.respcache.generation = dbversion->generation;
+
+	result = ns_client_sendcached(client, &rcode, &answer);
+	if (result != ISC_R_SUCCESS) {
+		client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+		return (ISC_R_COMPLETE);
+	}
+
+	if (isc_log_wouldlog(ns_lctx, ISC_LOG_DEBUG(3))) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char typename[DNS_RDATATYPE_FORMATSIZE];
+
+		dns_name_format(client->query.qname, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(qctx->qtype, typename, sizeof(typename));
+		ns_client_log(client, NS_LOGCATEGORY_CLIENT,
+			      NS_LOGMODULE_QUERY, ISC_LOG_DEBUG(3),
+			      "response cache hit %s/%s", namebuf, typename);
+	}
+
+	/*
+	 * Only authoritative NOERROR and NXDOMAIN responses are cached.
+	 */
+	inc_stats(client, ns_statscounter_authans);
+	if (rcode == dns_rcode_nxdomain) {
+		counter = ns_statscounter_nxdomain;
+	} else if (answer) {
+		counter = ns_statscounter_success;
+	} else {
+		counter = ns_statscounter_nxrrset;
+	}
+	inc_stats(client, counter);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+	ns_client_detach(&qctx->client);
+	return (ISC_R_SUCCESS);
+}
+
 /*%
  * Starting point for a client query or a chaining query.
  *
@@ -5305,6 +5486,14 @@ ns__query_start(query_ctx_t *qctx) {
 		}
 	}
 
+	/*
+	 * Answer from the rendered response cache if we can.
+	 */
+	result = query_respcache(qctx);
+	if (result != ISC_R_COMPLETE) {
+		return (result);
+	}
+
 	return (query_lookup(qctx));
 }
 
@@ -7533,6 +7722,7 @@ query_zone_delegation(query_ctx_t *qctx) {
 		SAVE(qctx->zrdataset, qctx->rdataset);
 		SAVE(qctx->zsigrdataset, qctx->sigrdataset);
 		dns_db_attach(qctx->client->view->cachedb, &qctx->db);
+		qctx->client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
 		qctx->is_zone = ISC_FALSE;
 
 		return (query_lookup(qctx));
@@ -9831,6 +10021,7 @@ query_addbestns(query_ctx_t *qctx) {
 			SAVE(zsigrdataset, sigrdataset);
 			version = NULL;
 			dns_db_attach(client->view->cachedb, &db);
+			client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
 			is_zone = ISC_FALSE;
 			goto db_find;
 		}
@@ -10517,6 +10708,13 @@ query_done(query_ctx_t *qctx) {
 		qctx->result = ISC_R_FAILURE;
 	}
 
+	/*
+	 * Don't cache a partial answer.
+	 */
+	if (qctx->result != ISC_R_SUCCESS) {
+		qctx->client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+	}
+
 	query_send(qctx->client);
 
 	ns_client_detach(&qctx->client);
@@ -58,35 +58,35 @@ ns_server_create(isc_mem_t *mctx, isc_entropy_t *entropy,
 
 	CHECKFATAL(ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats));
 
-	CHECKFATAL(dns_rdatatypestats_create(mctx, &sctx->rcvquerystats));
+	CHECKFATAL(dns_rdatatypestats_createpercpu(mctx, &sctx->rcvquerystats));
 
 	CHECKFATAL(dns_opcodestats_create(mctx, &sctx->opcodestats));
 
 	CHECKFATAL(dns_rcodestats_create(mctx, &sctx->rcodestats));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->udpinstats4,
+					  dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->udpoutstats4,
+					  dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->udpinstats6,
+					  dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->udpoutstats6,
+					  dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->tcpinstats4,
+					  dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->tcpoutstats4,
+					  dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->tcpinstats6,
+					  dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createpercpu(mctx, &sctx->tcpoutstats6,
+					  dns_sizecounter_out_max));
 
 	sctx->initialtimo = 300;
 	sctx->idletimo = 300;
@@ -104,6 +104,9 @@ ns_server_create(isc_mem_t *mctx, isc_entropy_t *entropy,
 
 	ISC_LIST_INIT(sctx->altsecrets);
 
+	CHECKFATAL(isc_mutex_init(&sctx->xfrcachelock));
+	ISC_LIST_INIT(sctx->xfrcache);
+
 	sctx->magic = SCTX_MAGIC;
 	*sctxp = sctx;
 
@@ -145,6 +148,9 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_mem_put(sctx->mctx, altsecret, sizeof(*altsecret));
 		}
 
+		INSIST(ISC_LIST_EMPTY(sctx->xfrcache));
+		DESTROYLOCK(&sctx->xfrcachelock);
+
 		isc_quota_destroy(&sctx->recursionquota);
 		isc_quota_destroy(&sctx->tcpquota);
 		isc_quota_destroy(&sctx->xfroutquota);
@@ -244,6 +244,7 @@ typedef struct {
 
 static void update_action(isc_task_t *task, isc_event_t *event);
 static void updatedone_action(isc_task_t *task, isc_event_t *event);
+static void update_journalsynced(void *arg, isc_result_t result);
 static isc_result_t send_forward_event(ns_client_t *client, dns_zone_t *zone);
 static void forward_done(isc_task_t *task, isc_event_t *event);
 static isc_result_t add_rr_prepare_action(void *data, rr_t *rr);
@@ -3121,7 +3122,6 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	 */
 	if (! ISC_LIST_EMPTY(diff.tuples)) {
 		char *journalfile;
-		dns_journal_t *journal;
 		isc_boolean_t has_dnskey;
 
 		/*
@@ -3210,19 +3210,9 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			update_log(client, zone, LOGLEVEL_DEBUG,
 				   "writing journal %s", journalfile);
 
-			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
+			result = dns_zone_writejournal(zone, &diff);
 			if (result != ISC_R_SUCCESS)
-				FAILS(result, "journal open failed");
-
-			result = dns_journal_write_transaction(journal, &diff);
-			if (result != ISC_R_SUCCESS) {
-				dns_journal_destroy(&journal);
 				FAILS(result, "journal write failed");
-			}
-
-			dns_journal_destroy(&journal);
 		}
 
 		/*
@@ -3348,12 +3338,33 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		INSIST(uev->zone == zone); /* we use this later */
 	uev->ev_type = DNS_EVENT_UPDATEDONE;
 	uev->ev_action = updatedone_action;
-	isc_task_send(client->task, &event);
+
+	/*
+	 * With journal group commit, transactions (ours or earlier ones
+	 * whose results we may have seen) can still be waiting to be
+	 * synced: hold the response until they are on disk.
+	 */
+	if (zone != NULL) {
+		dns_zone_afterjournalsync(zone, update_journalsynced, event);
+		event = NULL;
+	} else
+		isc_task_send(client->task, &event);
 
 	INSIST(ver == NULL);
 	INSIST(event == NULL);
 }
 
+static void
+update_journalsynced(void *arg, isc_result_t result) {
+	isc_event_t *event = arg;
+	update_event_t *uev = (update_event_t *) event;
+	ns_client_t *client = (ns_client_t *) event->ev_arg;
+
+	if (result != ISC_R_SUCCESS && uev->result == ISC_R_SUCCESS)
+		uev->result = result;
+	isc_task_send(client->task, &event);
+}
+
 static void
 updatedone_action(isc_task_t *task, isc_event_t *event) {
 	update_event_t *uev = (update_event_t *) event;
@@ -638,6 +638,174 @@ static rrstream_methods_t compound_rrstream_methods = {
 	compound_rrstream_destroy
 };
 
+/**************************************************************************/
+/*
+ * Rendered AXFR data.
+ *
+ * Every full transfer of a zone version sends the same records in the
+ * same order.  Transfers over TCP in many-answers format send the first
+ * SOA in a message of its own and then split the rest of the zone at
+ * points that depend only on server-wide limits, so the answer section
+ * of each later message is the same for all transfers of that version.
+ * Those answer sections ("blocks") are rendered once, by whichever
+ * transfer needs one first, and kept in an ns_xfrcache_t for the other
+ * transfers of the version running at the time; these only add their
+ * own header, OPT and TSIG.
+ */
+
+/*%
+ * Room left in each message for the OPT and TSIG records.
+ */
+#define XFRCACHE_SLACK		2048
+
+/*%
+ * Most rendered data kept for one zone version.  Transfers past that
+ * point render their own messages.
+ */
+#define XFRCACHE_MAXSIZE	(256 * 1024 * 1024)
+
+typedef struct xfrblock {
+	unsigned int		count;		/* RRs in the block */
+	isc_boolean_t		last;		/* Ends the transfer */
+	isc_region_t		region;		/* Rendered answer section */
+} xfrblock_t;
+
+struct ns_xfrcache {
+	dns_db_t		*db;
+	dns_dbversion_t		*ver;
+	isc_uint16_t		msgsize;	/* Message size limit */
+	unsigned int		refs;
+	xfrblock_t		**blocks;
+	unsigned int		nblocks;
+	unsigned int		nalloc;
+	size_t			size;		/* Bytes in blocks */
+	isc_boolean_t		full;		/* XFRCACHE_MAXSIZE reached */
+	ISC_LINK(ns_xfrcache_t)	link;
+};
+
+static void
+xfrblock_free(isc_mem_t *mctx, xfrblock_t **blockp) {
+	xfrblock_t *block = *blockp;
+
+	isc_mem_put(mctx, block, sizeof(*block) + block->region.length);
+	*blockp = NULL;
+}
+
+/*
+ * Find or create the rendered data for 'ver' of 'db'.
+ */
+static isc_result_t
+xfrcache_attach(ns_server_t *sctx, dns_db_t *db, dns_dbversion_t *ver,
+		ns_xfrcache_t **cachep)
+{
+	ns_xfrcache_t *cache;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	LOCK(&sctx->xfrcachelock);
+	for (cache = ISC_LIST_HEAD(sctx->xfrcache);
+	     cache != NULL;
+	     cache = ISC_LIST_NEXT(cache, link))
+	{
+		if (cache->db == db && cache->ver == ver &&
+		    cache->msgsize == sctx->transfer_tcp_message_size)
+			break;
+	}
+	if (cache == NULL) {
+		cache = isc_mem_get(sctx->mctx, sizeof(*cache));
+		if (cache == NULL) {
+			UNLOCK(&sctx->xfrcachelock);
+			return (ISC_R_NOMEMORY);
+		}
+		cache->db = NULL;
+		dns_db_attach(db, &cache->db);
+		cache->ver = NULL;
+		dns_db_attachversion(db, ver, &cache->ver);
+		cache->msgsize = sctx->transfer_tcp_message_size;
+		cache->refs = 0;
+		cache->blocks = NULL;
+		cache->nblocks = 0;
+		cache->nalloc = 0;
+		cache->size = 0;
+		cache->full = ISC_FALSE;
+		ISC_LINK_INIT(cache, link);
+		ISC_LIST_APPEND(sctx->xfrcache, cache, link);
+	}
+	cache->refs++;
+	UNLOCK(&sctx->xfrcachelock);
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+xfrcache_detach(ns_server_t *sctx, ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = *cachep;
+	unsigned int i;
+
+	*cachep = NULL;
+
+	LOCK(&sctx->xfrcachelock);
+	INSIST(cache->refs > 0);
+	if (--cache->refs > 0) {
+		UNLOCK(&sctx->xfrcachelock);
+		return;
+	}
+	ISC_LIST_UNLINK(sctx->xfrcache, cache, link);
+	UNLOCK(&sctx->xfrcachelock);
+
+	for (i = 0; i < cache->nblocks; i++)
+		xfrblock_free(sctx->mctx, &cache->blocks[i]);
+	if (cache->blocks != NULL)
+		isc_mem_put(sctx->mctx, cache->blocks,
+			    cache->nalloc * sizeof(cache->blocks[0]));
+	dns_db_closeversion(cache->db, &cache->ver, ISC_FALSE);
+	dns_db_detach(&cache->db);
+	isc_mem_put(sctx->mctx, cache, sizeof(*cache));
+}
+
+/*
+ * Offer 'block', the 'n'th of the transfer, to the cache.  Returns
+ * ISC_TRUE if the cache took it.
+ */
+static isc_boolean_t
+xfrcache_addblock(ns_server_t *sctx, ns_xfrcache_t *cache, unsigned int n,
+		  xfrblock_t *block)
+{
+	xfrblock_t **blocks;
+	unsigned int nalloc;
+	isc_boolean_t added = ISC_FALSE;
+
+	LOCK(&sctx->xfrcachelock);
+	if (n != cache->nblocks || cache->full)
+		goto unlock;
+	if (cache->size + block->region.length > XFRCACHE_MAXSIZE) {
+		cache->full = ISC_TRUE;
+		goto unlock;
+	}
+	if (cache->nblocks == cache->nalloc) {
+		nalloc = (cache->nalloc == 0) ? 64 : cache->nalloc * 2;
+		blocks = isc_mem_get(sctx->mctx, nalloc * sizeof(blocks[0]));
+		if (blocks == NULL)
+			goto unlock;
+		if (cache->blocks != NULL) {
+			memmove(blocks, cache->blocks,
+				cache->nblocks * sizeof(blocks[0]));
+			isc_mem_put(sctx->mctx, cache->blocks,
+				    cache->nalloc * sizeof(blocks[0]));
+		}
+		cache->blocks = blocks;
+		cache->nalloc = nalloc;
+	}
+	cache->blocks[cache->nblocks++] = block;
+	cache->size += block->region.length;
+	added = ISC_TRUE;
+
+ unlock:
+	UNLOCK(&sctx->xfrcachelock);
+	return (added);
+}
+
 /**************************************************************************/
 /*
  * An 'xfrout_ctx_t' contains the state of an outgoing AXFR or IXFR
@@ -671,6 +839,10 @@ typedef struct {
 	int			sends;		/* Send in progress */
 	isc_boolean_t		shuttingdown;
 	const char		*mnemonic;	/* Style of transfer */
+	ns_xfrcache_t		*cache;		/* Shared rendered data */
+	unsigned int		nrrs;		/* Number of RRs sent */
+	unsigned int		streampos;	/* Number of RRs consumed
+						   from the stream */
 } xfrout_ctx_t;
 
 static isc_result_t
@@ -689,6 +861,10 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client,
 static void
 sendstream(xfrout_ctx_t *xfr);
 
+static isc_result_t
+addrrs(xfrout_ctx_t *xfr, dns_message_t *msg, isc_buffer_t *buf,
+       isc_boolean_t many, unsigned int limit, unsigned int *countp);
+
 static void
 xfrout_senddone(isc_task_t *task, isc_event_t *event);
 
@@ -1055,6 +1231,16 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	stream = NULL;
 	quota = NULL;
 
+	/*
+	 * Full transfers of the same version over TCP share their
+	 * rendered messages, unless each RR is to be logged.
+	 */
+	if (!is_dlz && !is_ixfr && !is_poll && xfr->many_answers &&
+	    (client->attributes & NS_CLIENTATTR_TCP) != 0 &&
+	    !isc_log_wouldlog(ns_lctx, XFROUT_RR_LOGLEVEL))
+		(void)xfrcache_attach(client->sctx, xfr->db, xfr->ver,
+				      &xfr->cache);
+
 	CHECK(xfr->stream->methods->first(xfr->stream));
 
 	if (xfr->tsigkey != NULL)
@@ -1184,6 +1370,9 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 	xfr->txmemlen = 0;
 	xfr->stream = NULL;
 	xfr->quota = NULL;
+	xfr->cache = NULL;
+	xfr->nrrs = 0;
+	xfr->streampos = 0;
 
 	/*
 	 * Allocate a temporary buffer for the uncompressed response
@@ -1244,6 +1433,252 @@ failure:
 }
 
 
+/*
+ * Add RRs from the stream to 'msg', keeping their uncompressed owner
+ * names and rdata in 'buf'.  Stop when the next RR would not fit in
+ * 'buf', after the first RR unless 'many' is set, or once 'limit'
+ * bytes of 'buf' are used if 'limit' is non-zero.  The number of RRs
+ * added is returned in '*countp'.
+ */
+static isc_result_t
+addrrs(xfrout_ctx_t *xfr, dns_message_t *msg, isc_buffer_t *buf,
+       isc_boolean_t many, unsigned int limit, unsigned int *countp)
+{
+	isc_result_t result;
+	dns_name_t *msgname = NULL;
+	dns_rdata_t *msgrdata = NULL;
+	dns_rdatalist_t *msgrdl = NULL;
+	dns_rdataset_t *msgrds = NULL;
+	unsigned int count = 0;
+
+	for (;;) {
+		dns_name_t *name = NULL;
+		isc_uint32_t ttl;
+		dns_rdata_t *rdata = NULL;
+
+		unsigned int size;
+		isc_region_t r;
+
+		msgname = NULL;
+		msgrdata = NULL;
+		msgrdl = NULL;
+		msgrds = NULL;
+
+		xfr->stream->methods->current(xfr->stream,
+					      &name, &ttl, &rdata);
+		size = name->length + 10 + rdata->length;
+		isc_buffer_availableregion(buf, &r);
+		if (size >= r.length) {
+			/*
+			 * RR would not fit.  If there are other RRs in the
+			 * buffer, send them now and leave this RR to the
+			 * next message.  If this RR overflows the buffer
+			 * all by itself, fail.
+			 *
+			 * In theory some RRs might fit in a TCP message
+			 * when compressed even if they do not fit when
+			 * uncompressed, but surely we don't want
+			 * to send such monstrosities to an unsuspecting
+			 * slave.
+			 */
+			if (count == 0) {
+				xfrout_log(xfr, ISC_LOG_WARNING,
+					   "RR too large for zone transfer "
+					   "(%d bytes)", size);
+				/* XXX DNS_R_RRTOOLARGE? */
+				result = ISC_R_NOSPACE;
+				goto failure;
+			}
+			break;
+		}
+
+		if (isc_log_wouldlog(ns_lctx, XFROUT_RR_LOGLEVEL))
+			log_rr(name, rdata, ttl); /* XXX */
+
+		result = dns_message_gettempname(msg, &msgname);
+		if (result != ISC_R_SUCCESS)
+			goto failure;
+		dns_name_init(msgname, NULL);
+		isc_buffer_availableregion(buf, &r);
+		INSIST(r.length >= name->length);
+		r.length = name->length;
+		isc_buffer_putmem(buf, name->ndata, name->length);
+		dns_name_fromregion(msgname, &r);
+
+		/* Reserve space for RR header. */
+		isc_buffer_add(buf, 10);
+
+		result = dns_message_gettemprdata(msg, &msgrdata);
+		if (result != ISC_R_SUCCESS)
+			goto failure;
+		isc_buffer_availableregion(buf, &r);
+		r.length = rdata->length;
+		isc_buffer_putmem(buf, rdata->data, rdata->length);
+		dns_rdata_init(msgrdata);
+		dns_rdata_fromregion(msgrdata,
+				     rdata->rdclass, rdata->type, &r);
+
+		result = dns_message_gettemprdatalist(msg, &msgrdl);
+		if (result != ISC_R_SUCCESS)
+			goto failure;
+		msgrdl->type = rdata->type;
+		msgrdl->rdclass = rdata->rdclass;
+		msgrdl->ttl = ttl;
+		if (rdata->type == dns_rdatatype_sig ||
+		    rdata->type == dns_rdatatype_rrsig)
+			msgrdl->covers = dns_rdata_covers(rdata);
+		else
+			msgrdl->covers = dns_rdatatype_none;
+		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
+
+		result = dns_message_gettemprdataset(msg, &msgrds);
+		if (result != ISC_R_SUCCESS)
+			goto failure;
+		result = dns_rdatalist_tordataset(msgrdl, msgrds);
+		INSIST(result == ISC_R_SUCCESS);
+
+		ISC_LIST_APPEND(msgname->list, msgrds, link);
+
+		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
+		msgname = NULL;
+		count++;
+
+		result = xfr->stream->methods->next(xfr->stream);
+		xfr->streampos++;
+		if (result == ISC_R_NOMORE) {
+			xfr->end_of_stream = ISC_TRUE;
+			break;
+		}
+		CHECK(result);
+
+		if (! many)
+			break;
+		/*
+		 * At this stage, at least 1 RR has been rendered into
+		 * the message. Check if we want to clamp this message
+		 * here (TCP only).
+		 */
+		if (limit != 0 && isc_buffer_usedlength(buf) >= limit)
+			break;
+	}
+
+	*countp = count;
+	result = ISC_R_SUCCESS;
+
+ failure:
+	if (msgname != NULL) {
+		if (msgrds != NULL) {
+			if (dns_rdataset_isassociated(msgrds))
+				dns_rdataset_disassociate(msgrds);
+			dns_message_puttemprdataset(msg, &msgrds);
+		}
+		if (msgrdl != NULL) {
+			ISC_LIST_UNLINK(msgrdl->rdata, msgrdata, link);
+			dns_message_puttemprdatalist(msg, &msgrdl);
+		}
+		if (msgrdata != NULL)
+			dns_message_puttemprdata(msg, &msgrdata);
+		dns_message_puttempname(msg, &msgname);
+	}
+
+	return (result);
+}
+
+/*
+ * Render the next block of the transfer from our own stream, which is
+ * first moved past any RRs that were sent from the cache.
+ */
+static isc_result_t
+renderblock(xfrout_ctx_t *xfr, xfrblock_t **blockp) {
+	isc_mem_t *mctx = xfr->client->sctx->mctx;
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	isc_boolean_t cleanup_cctx = ISC_FALSE;
+	isc_buffer_t buf;
+	isc_region_t used;
+	xfrblock_t *block;
+	unsigned int count;
+	isc_result_t result;
+
+	while (xfr->streampos < xfr->nrrs) {
+		CHECK(xfr->stream->methods->next(xfr->stream));
+		xfr->streampos++;
+	}
+
+	CHECK(dns_message_create(xfr->mctx, DNS_MESSAGE_INTENTRENDER, &msg));
+	msg->tcp_continuation = 1;
+
+	/*
+	 * Render as a continuation message with no question, so that
+	 * the block can follow any message header, and leave room for
+	 * each transfer's OPT and TSIG.
+	 */
+	isc_buffer_init(&buf, xfr->buf.base, xfr->buf.length - XFRCACHE_SLACK);
+	isc_buffer_add(&buf, DNS_MESSAGE_HEADERLEN);
+	CHECK(addrrs(xfr, msg, &buf, ISC_TRUE, xfr->cache->msgsize, &count));
+
+	isc_buffer_clear(&xfr->txbuf);
+	CHECK(dns_compress_init(&cctx, -1, xfr->mctx));
+	dns_compress_setsensitive(&cctx, ISC_TRUE);
+	cleanup_cctx = ISC_TRUE;
+	CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
+	CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+	CHECK(dns_message_renderend(msg));
+
+	isc_buffer_usedregion(&xfr->txbuf, &used);
+	isc_region_consume(&used, DNS_MESSAGE_HEADERLEN);
+	block = isc_mem_get(mctx, sizeof(*block) + used.length);
+	if (block == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto failure;
+	}
+	block->count = count;
+	block->last = xfr->end_of_stream;
+	block->region.base = (unsigned char *)(block + 1);
+	block->region.length = used.length;
+	memmove(block->region.base, used.base, used.length);
+	*blockp = block;
+
+ failure:
+	if (cleanup_cctx)
+		dns_compress_invalidate(&cctx);
+	if (msg != NULL)
+		dns_message_destroy(&msg);
+	return (result);
+}
+
+/*
+ * Get the block to send in the current message, from the cache if
+ * another transfer has rendered it already.  '*ownp' is set if the
+ * caller must free the block once it has been copied into a message.
+ */
+static isc_result_t
+getblock(xfrout_ctx_t *xfr, xfrblock_t **blockp, isc_boolean_t *ownp) {
+	ns_server_t *sctx = xfr->client->sctx;
+	unsigned int n = xfr->nmsg - 1;
+	xfrblock_t *block = NULL;
+	isc_result_t result;
+
+	LOCK(&sctx->xfrcachelock);
+	if (n < xfr->cache->nblocks)
+		block = xfr->cache->blocks[n];
+	UNLOCK(&sctx->xfrcachelock);
+
+	if (block != NULL) {
+		*blockp = block;
+		*ownp = ISC_FALSE;
+		return (ISC_R_SUCCESS);
+	}
+
+	result = renderblock(xfr, &block);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	*blockp = block;
+	*ownp = ISC_TF(!xfrcache_addblock(sctx, xfr->cache, n, block));
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Arrange to send as much as we can of "stream" without blocking.
  *
@@ -1260,15 +1695,19 @@ sendstream(xfrout_ctx_t *xfr) {
 	isc_region_t used;
 	isc_region_t region;
 	dns_rdataset_t *qrdataset;
-	dns_name_t *msgname = NULL;
-	dns_rdata_t *msgrdata = NULL;
-	dns_rdatalist_t *msgrdl = NULL;
-	dns_rdataset_t *msgrds = NULL;
 	dns_compress_t cctx;
 	isc_boolean_t cleanup_cctx = ISC_FALSE;
 	isc_boolean_t is_tcp;
+	xfrblock_t *block = NULL;
+	isc_boolean_t ownblock = ISC_FALSE;
+	unsigned int count;
 
-	int n_rrs;
+	/*
+	 * When sharing rendered data, every message after the first
+	 * carries the next block of it.
+	 */
+	if (xfr->cache != NULL && xfr->nmsg > 0)
+		CHECK(getblock(xfr, &block, &ownblock));
 
 	isc_buffer_clear(&xfr->buf);
 	isc_buffer_clear(&xfr->txlenbuf);
@@ -1374,118 +1813,22 @@ sendstream(xfrout_ctx_t *xfr) {
 		}
 	}
 
-	/*
-	 * Try to fit in as many RRs as possible, unless "one-answer"
-	 * format has been requested.
-	 */
-	for (n_rrs = 0; ; n_rrs++) {
-		dns_name_t *name = NULL;
-		isc_uint32_t ttl;
-		dns_rdata_t *rdata = NULL;
-
-		unsigned int size;
-		isc_region_t r;
-
-		msgname = NULL;
-		msgrdata = NULL;
-		msgrdl = NULL;
-		msgrds = NULL;
-
-		xfr->stream->methods->current(xfr->stream,
-					      &name, &ttl, &rdata);
-		size = name->length + 10 + rdata->length;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		if (size >= r.length) {
-			/*
-			 * RR would not fit.  If there are other RRs in the
-			 * buffer, send them now and leave this RR to the
-			 * next message.  If this RR overflows the buffer
-			 * all by itself, fail.
-			 *
-			 * In theory some RRs might fit in a TCP message
-			 * when compressed even if they do not fit when
-			 * uncompressed, but surely we don't want
-			 * to send such monstrosities to an unsuspecting
-			 * slave.
-			 */
-			if (n_rrs == 0) {
-				xfrout_log(xfr, ISC_LOG_WARNING,
-					   "RR too large for zone transfer "
-					   "(%d bytes)", size);
-				/* XXX DNS_R_RRTOOLARGE? */
-				result = ISC_R_NOSPACE;
-				goto failure;
-			}
-			break;
-		}
-
-		if (isc_log_wouldlog(ns_lctx, XFROUT_RR_LOGLEVEL))
-			log_rr(name, rdata, ttl); /* XXX */
-
-		result = dns_message_gettempname(msg, &msgname);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		dns_name_init(msgname, NULL);
-		isc_buffer_availableregion(&xfr->buf, &r);
-		INSIST(r.length >= name->length);
-		r.length = name->length;
-		isc_buffer_putmem(&xfr->buf, name->ndata, name->length);
-		dns_name_fromregion(msgname, &r);
-
-		/* Reserve space for RR header. */
-		isc_buffer_add(&xfr->buf, 10);
-
-		result = dns_message_gettemprdata(msg, &msgrdata);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		r.length = rdata->length;
-		isc_buffer_putmem(&xfr->buf, rdata->data, rdata->length);
-		dns_rdata_init(msgrdata);
-		dns_rdata_fromregion(msgrdata,
-				     rdata->rdclass, rdata->type, &r);
-
-		result = dns_message_gettemprdatalist(msg, &msgrdl);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		msgrdl->type = rdata->type;
-		msgrdl->rdclass = rdata->rdclass;
-		msgrdl->ttl = ttl;
-		if (rdata->type == dns_rdatatype_sig ||
-		    rdata->type == dns_rdatatype_rrsig)
-			msgrdl->covers = dns_rdata_covers(rdata);
-		else
-			msgrdl->covers = dns_rdatatype_none;
-		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
-
-		result = dns_message_gettemprdataset(msg, &msgrds);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		result = dns_rdatalist_tordataset(msgrdl, msgrds);
-		INSIST(result == ISC_R_SUCCESS);
-
-		ISC_LIST_APPEND(msgname->list, msgrds, link);
-
-		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
-		msgname = NULL;
-
-		result = xfr->stream->methods->next(xfr->stream);
-		if (result == ISC_R_NOMORE) {
+	if (block != NULL) {
+		xfr->nrrs += block->count;
+		if (block->last)
 			xfr->end_of_stream = ISC_TRUE;
-			break;
-		}
-		CHECK(result);
-
-		if (! xfr->many_answers)
-			break;
+	} else {
 		/*
-		 * At this stage, at least 1 RR has been rendered into
-		 * the message. Check if we want to clamp this message
-		 * here (TCP only).
+		 * Try to fit in as many RRs as possible, unless
+		 * "one-answer" format has been requested or this is
+		 * the first message of a transfer sharing rendered data.
 		 */
-		if ((isc_buffer_usedlength(&xfr->buf) >=
-		     xfr->client->sctx->transfer_tcp_message_size) && is_tcp)
-			break;
+		CHECK(addrrs(xfr, msg, &xfr->buf,
+			     ISC_TF(xfr->many_answers && xfr->cache == NULL),
+			     is_tcp ?
+			      xfr->client->sctx->transfer_tcp_message_size : 0,
+			     &count));
+		xfr->nrrs += count;
 	}
 
 	if (is_tcp) {
@@ -1494,7 +1837,13 @@ sendstream(xfrout_ctx_t *xfr) {
 		cleanup_cctx = ISC_TRUE;
 		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+		if (block != NULL)
+			CHECK(dns_message_renderraw(msg, DNS_SECTION_ANSWER,
+						    &block->region,
+						    block->count));
+		else
+			CHECK(dns_message_rendersection(msg,
+							DNS_SECTION_ANSWER, 0));
 		CHECK(dns_message_renderend(msg));
 		dns_compress_invalidate(&cctx);
 		cleanup_cctx = ISC_FALSE;
@@ -1526,20 +1875,8 @@ sendstream(xfrout_ctx_t *xfr) {
 	xfr->nmsg++;
 
  failure:
-	if (msgname != NULL) {
-		if (msgrds != NULL) {
-			if (dns_rdataset_isassociated(msgrds))
-				dns_rdataset_disassociate(msgrds);
-			dns_message_puttemprdataset(msg, &msgrds);
-		}
-		if (msgrdl != NULL) {
-			ISC_LIST_UNLINK(msgrdl->rdata, msgrdata, link);
-			dns_message_puttemprdatalist(msg, &msgrdl);
-		}
-		if (msgrdata != NULL)
-			dns_message_puttemprdata(msg, &msgrdata);
-		dns_message_puttempname(msg, &msgname);
-	}
+	if (ownblock)
+		xfrblock_free(xfr->client->sctx->mctx, &block);
 
 	if (tcpmsg != NULL)
 		dns_message_destroy(&tcpmsg);
@@ -1570,6 +1907,8 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 
 	if (xfr->stream != NULL)
 		xfr->stream->methods->destroy(&xfr->stream);
+	if (xfr->cache != NULL)
+		xfrcache_detach(xfr->client->sctx, &xfr->cache);
 	if (xfr->buf.base != NULL)
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	if (xfr->txmem != NULL)